@@ -0,0 +1,175 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+#include "database.h"
+#include "http.h"
+
+// API密钥的作用域，每个作用域占一位，一个密钥的作用域是这些位的组合
+namespace ApiScope {
+    constexpr uint64_t UsersRead = 1ULL << 0;     // 读取用户
+    constexpr uint64_t UsersWrite = 1ULL << 1;    // 创建、修改、删除和导入用户
+    constexpr uint64_t LogsRead = 1ULL << 2;      // 请求统计、日志搜索和实时日志
+    constexpr uint64_t Admin = 1ULL << 3;         // /api/admin 下的管理接口，包括密钥管理
+    constexpr uint64_t All = UsersRead | UsersWrite | LogsRead | Admin;
+
+    // 解析 "users:read,users:write" 或 "*"（全部），有无法识别的作用域时返回false
+    bool parse(std::string_view text, uint64_t& scopes);
+
+    // 逗号分隔的作用域名称
+    std::string toString(uint64_t scopes);
+}
+
+// api_keys表的一条记录（不包含摘要）
+struct ApiKey {
+    long long id = 0;
+    std::string name;
+    std::string prefix;             // 密钥的前11个字符，用于辨认，不足以校验
+    uint64_t scopes = 0;
+    std::string createdAt;
+    long long expiresAt = 0;        // Unix时间（秒），0表示不过期
+    bool revoked = false;
+};
+
+// 内存中的API密钥索引
+// 数据库只保存密钥的SHA-256摘要和前11个字符（prefix列），校验不访问数据库：
+//   - 格式不对的密钥（不以ak_开头或长度不符）直接拒绝
+//   - 第一级按前缀的快速哈希查找：Bloom过滤器（每个密钥16位、4个探测位置）拒绝绝大多数未知密钥，
+//     开放寻址哈希表（线性探测，负载不超过一半）找到前缀相同的槽，这一步不计算SHA-256
+//   - 只有前缀命中时才计算密钥的SHA-256并比较完整的摘要，槽中直接存放作用域位图和过期时间
+// 索引以不可变快照发布，校验只有一次原子加载，可以在任何线程上同时进行；修改在数据库执行器上复制重建。
+// 表中的行被修改或删除时（吊销、修改作用域），update_hook 在语句执行期间立即把它移出索引，
+// 写事务提交或回滚之后 refresh() 重新读取这些行，仍然有效的密钥重新加入
+class ApiKeyIndex {
+public:
+    using Digest = std::array<uint8_t, 32>;
+
+    // 校验结果；Missing、Unknown、Expired 返回401，Forbidden 返回403
+    enum class Result { Ok, Missing, Unknown, Expired, Forbidden };
+
+    static constexpr std::string_view kKeyPrefix = "ak_";
+    static const size_t kKeyLength = 3 + 48;            // ak_ 加24个随机字节的十六进制
+    static const size_t kDisplayPrefixLength = 11;      // 保存到prefix列的长度
+
+    ApiKeyIndex();
+
+    ApiKeyIndex(const ApiKeyIndex&) = delete;
+    ApiKeyIndex& operator=(const ApiKeyIndex&) = delete;
+
+    // 注册行监听和提交监听并加载所有未吊销的密钥，在数据库连接后、处理请求之前调用一次
+    bool attach(Database& database);
+
+    // 重新读取上次刷新以来被修改的行；由提交监听在执行写语句的线程（数据库执行器）上调用，
+    // 事务中调用时推迟到下一次
+    bool refresh(Database& database);
+
+    // 校验密钥并检查它具有requiredScopes中的全部作用域，可以在任何线程上调用
+    Result check(std::string_view key, uint64_t requiredScopes) const;
+
+    // 索引中的密钥数
+    size_t size() const;
+
+    // 请求中的密钥：Authorization: Bearer <key>，或 X-API-Key: <key>
+    static std::string_view keyFrom(const HttpRequest& request);
+
+    // 校验失败的响应，401带 WWW-Authenticate
+    static int statusFor(Result result);
+    static const char* messageFor(Result result);
+    static void reject(Result result, HttpResponse& response);
+
+    // 密钥的摘要，失败时返回false
+    static bool digest(std::string_view key, Digest& out);
+
+private:
+    static const size_t kBloomBitsPerKey = 16;
+    static const int kBloomProbes = 4;
+
+    // 哈希表的槽，id为0表示空槽；正好一个缓存行
+    struct Entry {
+        uint64_t lookup = 0;            // 前缀的哈希
+        long long id = 0;
+        uint64_t scopes = 0;
+        long long expiresAt = 0;
+        Digest digest{};
+    };
+
+    struct Table {
+        std::vector<Entry> slots;
+        size_t mask = 0;
+        std::vector<uint64_t> bloom;
+        size_t bloomMask = 0;           // 位数减一
+        size_t count = 0;
+
+        bool mayContain(uint64_t lookup) const;
+
+        // 前缀哈希相同的槽中摘要与密钥相符的一个，前缀第一次命中时才计算密钥的摘要
+        const Entry* find(uint64_t lookup, std::string_view key) const;
+    };
+
+    std::atomic<std::shared_ptr<const Table>> table_;
+
+    // 修改在数据库执行器上进行（行监听也在这个线程上回调），attach() 可能在启动线程上，所以仍然加锁
+    std::mutex mutex_;
+    std::unordered_map<long long, Entry> entries_;   // 重建快照的来源
+    std::vector<long long> pending_;                 // 被修改、等待重新读取的行
+    bool attached_ = false;
+
+    // 行被插入、修改或删除，已有的密钥立即移出索引
+    void onRowChanged(long long rowid);
+
+    // 读取一行，未吊销且前缀和摘要有效时返回true
+    static bool readEntry(const DbRow& row, Entry& entry);
+
+    // 密钥前缀的哈希，用于第一级查找
+    static uint64_t lookupHash(std::string_view prefix);
+
+    // 由entries_重建快照并发布，调用方持有mutex_
+    void publish();
+};
+
+// api_keys表的访问，只能在数据库执行器上调用（命令行工具中直接使用）
+// 已连接索引的数据库在写入提交后自动刷新索引，新建的密钥立即可用
+class ApiKeyRepository {
+public:
+    explicit ApiKeyRepository(Database& database) : db_(database) {}
+
+    // 生成新密钥，key为明文密钥，只在这里出现一次；失败时返回false
+    bool create(const std::string& name, uint64_t scopes, long long expiresAt, ApiKey& created, std::string& key);
+
+    // 所有密钥，按id排列
+    bool list(std::vector<ApiKey>& keys);
+
+    // 吊销密钥，found表示密钥存在且尚未吊销；出错时返回false
+    bool revoke(long long id, bool& found);
+
+    // 序列化为JSON对象
+    static std::string toJson(const ApiKey& key);
+
+private:
+    Database& db_;
+};
+
+// API密钥中间件：路由声明了作用域时校验请求的密钥，失败时返回401或403
+struct RequireApiKey {
+    template<typename Context, typename Next>
+    void operator()(Context& context, Next&& next) const {
+        if (!context.route || context.route->requiredScopes == 0) {
+            next();
+            return;
+        }
+        ApiKeyIndex::Result result = context.apiKeys.check(ApiKeyIndex::keyFrom(context.request), context.route->requiredScopes);
+        if (result == ApiKeyIndex::Result::Ok) {
+            next();
+            return;
+        }
+        HttpResponse response;
+        ApiKeyIndex::reject(result, response);
+        context.respond(response);
+    }
+};
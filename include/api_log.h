@@ -0,0 +1,154 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <set>
+#include <atomic>
+#include <cstdint>
+#include "database.h"
+#include "latency_sketch.h"
+#include "id_generator.h"
+
+// 一次请求的访问记录
+struct ApiLogEntry {
+    std::string method;
+    std::string path;               // 实际请求路径，写入api_logs
+    std::string route;              // 匹配的路由模式，用于汇总；未匹配时为空
+    int statusCode = 0;
+    long long responseTimeUs = 0;   // 从读完请求头到生成响应（微秒）
+    std::string ipAddress;
+    std::string userAgent;
+    long long timestamp = 0;        // Unix秒
+};
+
+// api_logs中的一行
+struct ApiLogRecord {
+    long long id = 0;
+    std::string method;
+    std::string path;
+    int statusCode = 0;
+    long long responseTimeUs = 0;
+    std::string ipAddress;
+    std::string userAgent;
+    std::string createdAt;          // UTC "YYYY-MM-DD HH:MM:SS"
+};
+
+// 汇总表的时间粒度
+enum class RollupResolution { Minute, Hour, Day };
+
+// 统计结果的分组方式
+enum class StatsGroup { Route, Status, All };
+
+// 汇总表中的一行，或按分组合并后的结果
+struct ApiStatsRow {
+    long long bucket = 0;           // 桶的开始时间（Unix秒）
+    std::string method;
+    std::string route;
+    int statusCode = 0;
+    uint64_t count = 0;
+    long long totalUs = 0;
+    long long minUs = 0;
+    long long maxUs = 0;
+    LatencySketch latency;
+};
+
+// 访问日志写入器
+// 处理请求的线程调用record()只是追加到内存队列，由数据库执行器批量写入api_logs，
+// 同一个事务中把这一批记录合并到分钟、小时、天三张汇总表（api_stats_minute/hour/day）。
+// 统计查询只读取汇总表，耗时与时间范围内的桶数有关，与原始日志的行数无关。
+//
+// 原始日志按UTC日期分区，每天一张表 api_logs_YYYYMMDD，api_logs 是合并所有分区的 UNION ALL 视图。
+// 过期的日志整张表删除，不执行逐行的DELETE；释放的页由增量清理分批归还给文件系统。
+// 每个分区有一张FTS5全文索引 api_logs_fts_YYYYMMDD（path、user_agent），与日志在同一个事务中写入，随分区一起删除
+class ApiLogWriter {
+public:
+    static const size_t kMaxPending = 100000;     // 数据库跟不上时最多积压的记录数，超出的丢弃
+    static const long long kMaxBuckets = 1440;    // 一次统计查询最多返回的桶数
+    static const int kDefaultRetentionDays = 30;
+    static constexpr int kMaxRetentionDays = 400; // 视图的子查询数受 SQLITE_MAX_COMPOUND_SELECT（500）限制
+    static const int kVacuumPagesPerStep = 1024;  // 每次增量清理归还的页数
+    static const int kMaxSearchLimit = 100;
+
+    ApiLogWriter() : ids_(0) {}
+
+    // 加载已有的分区并创建 api_logs 视图；旧版本的 api_logs 表改名为 api_logs_legacy 后并入视图
+    // 在数据库连接并初始化表之后、数据库执行器启动之前调用
+    bool open(Database& database, long long now);
+
+    // 追加一条记录；返回true表示需要调度一次flush()（之前没有待写入的记录）
+    bool record(ApiLogEntry entry);
+
+    // 写入积压的记录，然后执行maintain()；只能在数据库执行器上调用
+    bool flush(Database& database);
+
+    // 删除超出保留天数的分区和分钟汇总（每分钟最多检查一次），并在有空闲页时执行一步增量清理（每秒最多一次）
+    bool maintain(Database& database, long long now);
+
+    // 日志保留的天数（包括今天），可以在运行中调用
+    void setRetentionDays(int days) { retentionDays_ = days; }
+    int getRetentionDays() const { return retentionDays_; }
+
+    // 全文搜索，query为FTS5查询语法（词、前缀 abc*、短语 "a b"、列过滤 path:users、AND/OR/NOT）
+    // 按id从新到旧返回id小于beforeId（0表示不限）的前limit条，hasMore表示还有更早的结果
+    // 查询语法错误或不支持FTS5时返回false并设置error，数据库错误时error为空；只能在数据库执行器上调用
+    bool search(Database& database, const std::string& query, long long beforeId, int limit,
+                std::vector<ApiLogRecord>& records, bool& hasMore, std::string& error);
+
+    // SQLite是否支持FTS5，open()之后有效
+    bool searchEnabled() const { return searchEnabled_; }
+
+    // 当前的分区数，只在数据库执行器上读取
+    size_t partitionCount() const { return partitions_.size(); }
+
+    // 分区表名 api_logs_YYYYMMDD，day为自1970-01-01起的天数
+    static std::string partitionName(long long day);
+
+    // 因积压过多丢弃的记录数
+    uint64_t droppedCount() const;
+
+    // 查询 [from, to) 内的汇总，按bucket升序，同一个桶内按分组合并
+    static bool queryStats(Database& database, RollupResolution resolution, long long from, long long to,
+                           StatsGroup group, std::vector<ApiStatsRow>& rows);
+
+    // 桶的长度（秒）
+    static long long bucketSeconds(RollupResolution resolution);
+
+    // "minute"、"hour"、"day"
+    static bool parseResolution(const std::string& text, RollupResolution& resolution);
+
+    // "route"、"status"、"all"
+    static bool parseGroup(const std::string& text, StatsGroup& group);
+
+    // 序列化为JSON对象，包含计数、平均值和p50/p95/p99（微秒）
+    static std::string toJson(const ApiStatsRow& row, StatsGroup group);
+
+    static std::string toJson(const ApiLogRecord& record);
+
+    // 尚未写入的记录，用于实时推送
+    static std::string toJson(const ApiLogEntry& entry);
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<ApiLogEntry> pending_;
+    bool flushScheduled_ = false;
+    uint64_t dropped_ = 0;
+
+    // 以下只在数据库执行器上访问
+    std::set<long long> partitions_;              // 已有分区的日期（天数）
+    bool hasLegacy_ = false;
+    bool searchEnabled_ = false;
+    long long lastRetentionCheck_ = 0;
+    long long lastVacuum_ = 0;
+
+    std::atomic<int> retentionDays_{kDefaultRetentionDays};
+    SnowflakeGenerator ids_;                      // 日志id在所有分区中唯一且按时间递增
+
+    // 分区不存在时创建并重建视图，调用时已在事务中
+    bool ensurePartition(Database& database, long long day);
+
+    // 按partitions_和hasLegacy_重建 api_logs 视图
+    bool rebuildView(Database& database);
+
+    // 删除过期的分区、旧表和分钟汇总
+    bool dropExpired(Database& database, long long today);
+};
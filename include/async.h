@@ -0,0 +1,159 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <chrono>
+#include <type_traits>
+#include "thread_pool.h"
+#include "io_backend.h"
+#include "tracing.h"
+
+// 前向声明
+struct HttpRequest;
+struct HttpResponse;
+
+// 协程处理器的返回类型
+// 协程创建后处于挂起状态，由服务器调用start()开始执行；执行结束时自动释放协程帧
+class Task {
+public:
+    struct promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    // 协程结束回调，参数为未捕获的异常（正常结束时为空）
+    using CompletionCallback = std::function<void(std::exception_ptr)>;
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(Handle handle) noexcept {
+            CompletionCallback onComplete = std::move(handle.promise().onComplete);
+            std::exception_ptr error = handle.promise().error;
+            handle.destroy();
+            if (onComplete) onComplete(error);
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    struct promise_type {
+        CompletionCallback onComplete;
+        std::exception_ptr error;
+
+        Task get_return_object() { return Task(Handle::from_promise(*this)); }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task() = default;
+    Task(Task&& other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = other.handle_;
+            other.handle_ = nullptr;
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (handle_) handle_.destroy();
+    }
+
+    // 开始执行协程，所有权转移给协程自身
+    void start(CompletionCallback onComplete) {
+        Handle handle = handle_;
+        handle_ = nullptr;
+        handle.promise().onComplete = std::move(onComplete);
+        handle.resume();
+    }
+
+    bool valid() const { return static_cast<bool>(handle_); }
+
+private:
+    Handle handle_;
+
+    explicit Task(Handle handle) : handle_(handle) {}
+};
+
+// 协程处理器
+using AsyncHandler = std::function<Task(const HttpRequest&, HttpResponse&)>;
+
+// 在执行器上运行任务，完成后回到事件循环线程恢复协程
+// 协程所属的请求被追踪时，任务的排队和执行时间记为stage阶段
+template<typename Result>
+class ExecutorAwaiter {
+public:
+    ExecutorAwaiter(ThreadPool& executor, IoBackend& loop, std::function<Result()> work, const char* stage)
+        : executor_(executor), loop_(loop), work_(std::move(work)), stage_(stage), traceId_(Tracing::current()) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        int64_t queuedAt = traceId_ ? Tracing::now() : 0;
+        
+        // 恢复操作投递回事件循环，await_suspend返回之前协程不会被恢复
+        executor_.submit([this, handle, queuedAt]() {
+            uint64_t traceId = traceId_;
+            if (traceId) {
+                Tracing::recordAsync(traceId, "queue", queuedAt, Tracing::now(), stage_);
+            }
+            try {
+                Tracing::Span span(traceId, stage_);
+                Tracing::Scope scope(traceId);
+                if constexpr (std::is_void_v<Result>) {
+                    work_();
+                } else {
+                    result_.emplace(work_());
+                }
+            } catch (...) {
+                error_ = std::current_exception();
+            }
+            loop_.post([handle, traceId]() {
+                Tracing::Scope scope(traceId);
+                handle.resume();
+            });
+        });
+    }
+
+    Result await_resume() {
+        if (error_) std::rethrow_exception(error_);
+        if constexpr (!std::is_void_v<Result>) {
+            return std::move(*result_);
+        }
+    }
+
+private:
+    ThreadPool& executor_;
+    IoBackend& loop_;
+    std::function<Result()> work_;
+    const char* stage_;
+    uint64_t traceId_;
+    std::optional<std::conditional_t<std::is_void_v<Result>, char, Result>> result_;
+    std::exception_ptr error_;
+};
+
+// 在事件循环上等待指定时间
+class SleepAwaiter {
+public:
+    SleepAwaiter(IoBackend& loop, std::chrono::milliseconds delay) : loop_(loop), delay_(delay) {}
+
+    bool await_ready() const noexcept { return delay_.count() <= 0; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        loop_.postAfter(delay_, [handle, traceId = Tracing::current()]() {
+            Tracing::Scope scope(traceId);
+            handle.resume();
+        });
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    IoBackend& loop_;
+    std::chrono::milliseconds delay_;
+};
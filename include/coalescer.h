@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include "http.h"
+
+// 请求合并（singleflight）
+// 键相同的并发请求只有第一个（领头请求）执行处理器，其余的登记为等待者；
+// 领头请求的响应生成后交给所有等待者，序列化好的HTTP/1.1响应只生成一次。
+// 只合并同时在执行的请求，不缓存响应：领头请求完成之后到达的请求重新执行处理器。
+// 登记和完成都在事件循环线程上进行，不加锁；计数可以在任何线程上读取
+class RequestCoalescer {
+public:
+    // 等待者收到领头请求的响应和它序列化后的HTTP/1.1形式（保持连接，没有 Connection: close）
+    using Waiter = std::function<void(const HttpResponse& response, const std::string& serialized)>;
+
+    // headers为参与计算键的请求头（小写），响应随这些请求头变化时必须列出
+    explicit RequestCoalescer(std::vector<std::string> headers);
+
+    // 合并的键：方法、路径、查询字符串和列出的请求头
+    std::string keyFor(const HttpRequest& request) const;
+
+    // 没有同一个键的请求在执行时登记为领头请求并返回true，由调用方执行处理器；
+    // 返回false时调用方用 wait() 登记等待者
+    bool lead(const std::string& key);
+    void wait(const std::string& key, Waiter waiter);
+
+    // 领头请求完成，取出这个键的等待者
+    std::vector<Waiter> finish(const std::string& key);
+
+    const std::vector<std::string>& headers() const { return headers_; }
+
+    // 执行处理器的次数和被合并（没有执行处理器）的请求数
+    uint64_t flights() const { return flights_.load(std::memory_order_relaxed); }
+    uint64_t coalesced() const { return coalesced_.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<std::string> headers_;
+    std::unordered_map<std::string, std::vector<Waiter>> inFlight_;
+    std::atomic<uint64_t> flights_{0};
+    std::atomic<uint64_t> coalesced_{0};
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <array>
+#include <thread>
+#include <cstdint>
+
+// 粗粒度时钟服务
+// 后台线程每毫秒刷新一次预先格式化好的本地时间戳和HTTP Date头部（RFC 7231），
+// 读取只是从双缓冲中复制几个字，不调用系统时间和格式化函数。
+// 毫秒字段的实际精度取决于系统定时器分辨率；未启动时退化为每次直接计算
+class CoarseClock {
+public:
+    // 启动和停止刷新线程
+    static void start();
+    static void stop();
+
+    // 本地时间 "YYYY-MM-DD HH:MM:SS.mmm"
+    static std::string timestamp();
+
+    // HTTP Date 头部的值，如 "Sun, 06 Nov 1994 08:49:37 GMT"
+    static std::string httpDate();
+
+    // 把HTTP Date 追加到输出缓冲区
+    static void appendHttpDate(std::string& out);
+
+    // 自1970年以来的毫秒数
+    static long long nowMillis();
+
+private:
+    static const size_t kTimestampLength = 23;
+    static const size_t kDateLength = 29;
+    static const size_t kWords = 8;      // 时间戳24字节 + Date 32字节 + 毫秒数8字节
+
+    // 一份格式化好的快照，按64位字存放，读写都是原子操作
+    struct Slot {
+        std::atomic<uint32_t> sequence{0};   // 奇数表示正在写入
+        std::array<std::atomic<uint64_t>, kWords> words{};
+    };
+
+    struct Snapshot {
+        char timestamp[24];
+        char date[32];
+        long long millis;
+    };
+    static_assert(sizeof(Snapshot) == kWords * sizeof(uint64_t), "Snapshot必须正好占满kWords个字");
+
+    CoarseClock() = default;
+    ~CoarseClock();
+
+    static CoarseClock& instance();
+
+    std::array<Slot, 2> slots_;
+    std::atomic<int> current_{0};
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+
+    // 读取当前快照，刷新线程未运行时返回false
+    bool read(Snapshot& snapshot) const;
+
+    // 写入另一个槽位后切换
+    void publish(const Snapshot& snapshot);
+
+    // 刷新线程主循环
+    void run();
+
+    // 格式化快照；previous是上一毫秒的快照，同一秒内只需要改写毫秒
+    static void format(long long millis, Snapshot& snapshot, const Snapshot* previous);
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <cstdint>
+#include <windows.h>
+#include "io_backend.h"
+#include "rate_limiter.h"
+#include "middleware.h"
+#include "logger.h"
+#include "proxy.h"
+
+// 服务器配置快照
+// 发布后不再修改，重新加载时整体替换，读者持有的旧快照保持有效
+struct ServerConfig {
+    // 以下配置需要重启服务器才能生效
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    std::string database = "api_manager.db";
+    IoBackendType ioBackend = IoBackendType::Iocp;
+    CorsConfig cors;
+    std::vector<ProxyConfig> proxies;          // 反向代理路由
+    bool authEnabled = false;                  // 用户、统计和日志接口需要API密钥（管理接口始终需要）
+
+    // 以下配置在重新加载时立即生效
+    LogLevel logLevel = LogLevel::Info;
+    int maxConnections = 100;                  // 0表示不限制
+    int timeout = 30;                          // 保持连接的空闲超时（秒）
+    int headerTimeout = 10;                    // 读取请求头的期限（秒）
+    int writeTimeout = 30;                     // 发送响应没有进展的超时（秒）
+    size_t maxBodyMb = 8;                      // 非流式请求的请求体上限（MB）
+    size_t workerThreads = 0;                  // 0表示按CPU核心数
+    size_t rowCacheMb = 32;                    // 行缓存容量（MB），0表示不缓存
+    int logRetentionDays = 30;                 // 访问日志保留的天数（包括今天）
+    uint32_t traceSampleInterval = 0;          // 每N个请求追踪一个，0表示关闭
+    long long slowQueryMs = 100;               // 超过这个时间的SQL语句捕获执行计划，0表示不捕获
+    size_t proxyThreads = 16;                  // 与上游读写的代理线程数
+    RateLimitConfig writeLimit;                // 用户写接口的限流参数
+};
+
+// 从JSON文本解析配置，未出现的键保留默认值；类型或取值错误时返回false
+// 无法识别的键不算错误，记录在 unknownKeys 中
+bool parseServerConfig(const std::string& text, ServerConfig& config, std::string& error,
+                       std::vector<std::string>* unknownKeys = nullptr);
+
+// 配置管理器：加载配置文件，监视文件变化并在变化后重新加载
+// 当前配置以不可变快照发布，读取只需一次原子加载，不会看到更新到一半的配置
+class ConfigManager {
+public:
+    // 重新加载成功后在监视线程上调用，参数为新旧两个快照
+    using ReloadCallback = std::function<void(const ServerConfig& previous, const ServerConfig& current)>;
+
+    explicit ConfigManager(std::string path);
+    ~ConfigManager();
+
+    ConfigManager(const ConfigManager&) = delete;
+    ConfigManager& operator=(const ConfigManager&) = delete;
+
+    // 首次加载，文件不存在时使用默认配置；文件内容无效时返回false
+    bool load();
+
+    // 立即重新加载，内容无效时保留当前快照并返回false
+    bool reload();
+
+    // 当前配置快照
+    std::shared_ptr<const ServerConfig> current() const { return current_.load(std::memory_order_acquire); }
+
+    // 注册重新加载回调，需在startWatching()之前调用
+    void onReload(ReloadCallback callback) { callbacks_.push_back(std::move(callback)); }
+
+    // 启动监视线程
+    bool startWatching();
+
+    // 停止监视线程
+    void stopWatching();
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    std::atomic<std::shared_ptr<const ServerConfig>> current_;
+    std::vector<ReloadCallback> callbacks_;
+    std::mutex reloadMutex_;
+    std::string lastContent_;
+    std::thread watcher_;
+    HANDLE stopEvent_;
+
+    // 读取并解析文件，内容与上次相同时直接返回true
+    bool loadFile(bool initial);
+
+    // 监视线程主循环
+    void watchLoop(HANDLE change);
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <winsock2.h>
+#include "timer_wheel.h"
+
+class HttpStream;
+class Http2Session;
+class WebSocketSession;
+
+// 客户端连接状态（仅由事件循环线程访问）
+struct Connection : std::enable_shared_from_this<Connection> {
+    SOCKET socket = INVALID_SOCKET;
+    std::string clientIp;
+    std::string inBuffer;          // 已接收但尚未解析的数据
+    bool busy = false;             // 是否有请求正在处理
+    bool parsing = false;          // 正在解析缓冲区中的请求
+    bool closeAfterWrite = false;  // 发送完毕后关闭连接
+    bool readClosed = false;       // 对端已关闭写方向
+    bool closed = false;
+    bool headerDeadline = false;   // readTimer当前是读取请求头的期限，收到数据不顺延
+    bool readPaused = false;       // 由服务器设置，后端暂停读取socket，直到调用IoBackend::resumeRead
+    bool continueSent = false;     // 已为当前请求发送 100 Continue
+    int64_t requestStart = 0;      // 启用追踪时，当前请求第一个字节到达的时间（Tracing::now()），0表示尚未收到
+    std::shared_ptr<HttpStream> stream;   // 正在处理的流式请求（由服务器管理）
+    std::shared_ptr<Http2Session> http2;  // 切换到HTTP/2后的协议状态（由服务器管理）
+    std::shared_ptr<WebSocketSession> websocket;  // 升级为WebSocket后的协议状态（由服务器管理）
+    Timer readTimer;               // 空闲和读取请求的超时（由服务器管理）
+    Timer writeTimer;              // 发送超时（由I/O后端管理）
+
+    virtual ~Connection() = default;
+};
+
+using ConnectionPtr = std::shared_ptr<Connection>;
+
+// 连接事件处理接口，由服务器实现，I/O后端回调
+class ConnectionHandler {
+public:
+    virtual ~ConnectionHandler() = default;
+
+    // 新连接建立
+    virtual void onOpen(const ConnectionPtr& conn) = 0;
+
+    // 收到新数据（已追加到conn->inBuffer），或对端关闭了写方向（conn->readClosed）
+    virtual void onData(const ConnectionPtr& conn) = 0;
+
+    // 待发送的数据取得了进展（部分或全部发出）
+    virtual void onSent(const ConnectionPtr& conn) = 0;
+
+    // 连接已关闭
+    virtual void onClose(const ConnectionPtr& conn) = 0;
+};
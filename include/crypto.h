@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// 密码学工具，随机数、SHA-1和PBKDF2基于Windows CNG（bcrypt）
+namespace Crypto {
+    // 密码学安全的随机字节，失败时返回false
+    bool randomBytes(uint8_t* data, size_t length);
+
+    // SHA-1摘要（20字节），只用于协议要求的场合（如WebSocket握手），不要用于安全用途；失败时返回false
+    bool sha1(std::string_view data, uint8_t digest[20]);
+
+    // SHA-256摘要（32字节），进程内实现，不会失败（为了与其他函数一致仍返回bool）；可以在多个线程上同时调用
+    bool sha256(std::string_view data, uint8_t digest[32]);
+
+    // 生成加盐的密码哈希，格式为 "pbkdf2-sha256$<迭代次数>$<盐>$<哈希>"（十六进制）
+    // 计算量较大（约数十毫秒），不要在事件循环或数据库执行器上调用；失败时返回空字符串
+    std::string hashPassword(std::string_view password);
+
+    // 校验密码与hashPassword生成的哈希是否匹配，比较时间与内容无关
+    bool verifyPassword(std::string_view password, std::string_view hash);
+}
@@ -1,8 +1,14 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <memory>
+#include <variant>
+#include <functional>
+#include <unordered_map>
+#include "row_cache.h"
+#include "query_profiler.h"
 
 // SQLite前向声明
 struct sqlite3;
@@ -14,9 +20,30 @@ using RowData = std::map<std::string, std::string>;
 // 数据库结果集
 using ResultSet = std::vector<RowData>;
 
+// 按位置绑定到SQL语句 '?' 的参数
+using DbValue = std::variant<std::nullptr_t, long long, double, std::string>;
+
+// 查询结果的当前行，只在 forEachRow 的回调中有效；文本列直接指向SQLite的缓冲区，不复制
+class DbRow {
+public:
+    int columnCount() const;
+    bool isNull(int column) const;
+    long long getInt(int column) const;
+    double getDouble(int column) const;
+    std::string_view getText(int column) const;
+    
+private:
+    friend class Database;
+    explicit DbRow(sqlite3_stmt* stmt) : stmt_(stmt) {}
+    
+    sqlite3_stmt* stmt_;
+};
+
 // 数据库类
 class Database {
 public:
+    static const size_t kDefaultRowCacheBytes = 32 * 1024 * 1024;
+    
     Database(const std::string& dbPath);
     ~Database();
     
@@ -44,6 +71,19 @@ public:
     // 删除数据并返回影响的行数
     int remove(const std::string& sql);
     
+    // 参数化语句：预编译语句按SQL文本缓存复用，参数按位置绑定，不需要拼接或转义
+    ResultSet query(const std::string& sql, const std::vector<DbValue>& params);
+    
+    // 逐行处理查询结果，不复制列值；回调返回false时停止读取，出错时返回false
+    bool forEachRow(const std::string& sql, const std::vector<DbValue>& params,
+                    const std::function<bool(const DbRow&)>& callback);
+    
+    // 参数化插入，返回最后插入的行ID，失败返回-1
+    long long insert(const std::string& sql, const std::vector<DbValue>& params);
+    
+    // 参数化更新或删除，返回影响的行数，失败返回-1
+    int update(const std::string& sql, const std::vector<DbValue>& params);
+    
     // 开始事务
     bool beginTransaction();
     
@@ -56,6 +96,40 @@ public:
     // 获取最后错误信息
     std::string getLastError() const { return lastError_; }
     
+    // 最后错误的SQLite主错误码，如 SQLITE_CONSTRAINT（19）
+    int getLastErrorCode() const { return lastErrorCode_; }
+    
+    // 释放缓存的预编译语句，删除表后调用，避免缓存引用已删除表的语句
+    // 不能在 forEachRow 的回调中调用
+    void clearStatementCache();
+    
+    // 是否处于显式事务中
+    bool inTransaction() const;
+    
+    // 按主键缓存的行，任何线程都可以读取
+    // 本连接上的写入通过 sqlite3_update_hook 在语句执行时逐行失效，提交或回滚时再失效一次；
+    // 事务中读到的行可能被回滚，只在 inTransaction() 为false时填充。
+    // 不会触发 update_hook 的写入需要调用方自己失效：不带WHERE的DELETE（清空表）、
+    // REPLACE冲突删除的旧行、WITHOUT ROWID表，以及其他连接或进程的写入
+    RowCache& rowCache() { return rowCache_; }
+    
+    // 语句级的性能分析：每条语句（包括 execute() 中的多条语句）的耗时、行数和全表扫描步数按规范化的SQL汇总，
+    // 超过慢查询阈值的语句在执行结束后自动捕获执行计划。只在使用本连接的线程上读取
+    QueryProfiler& profiler() { return profiler_; }
+    
+    // 监听一个表的行变化：插入、更新或删除每一行时以rowid回调（包括之后被回滚的修改）
+    // 在执行写语句的线程上、语句执行期间调用，回调中不能使用这个连接；需在执行写语句之前注册
+    using RowListener = std::function<void(long long rowid)>;
+    void addRowListener(const std::string& table, RowListener listener);
+    
+    // 写事务提交或回滚之后、语句结束时在执行语句的线程上调用，这时可以使用这个连接；
+    // 自动提交的写语句在语句结束时调用，显式事务在COMMIT或ROLLBACK之后调用
+    using CommitListener = std::function<void()>;
+    void addCommitListener(CommitListener listener);
+    
+    // 捕获排队的执行计划；公共方法在语句结束后自动调用，读取报告之前也应调用一次
+    void capturePlans();
+    
     // 初始化数据库表
     bool initializeTables();
     
@@ -64,9 +138,31 @@ private:
     sqlite3* db_;
     bool connected_;
     std::string lastError_;
+    int lastErrorCode_;
+    std::unordered_map<std::string, sqlite3_stmt*> statements_;   // 缓存的预编译语句
+    RowCache rowCache_;
+    QueryProfiler profiler_;
+    std::vector<std::pair<std::string, long long>> changedRows_;  // 当前事务中修改的行
+    std::vector<std::pair<std::string, RowListener>> rowListeners_;
+    std::vector<CommitListener> commitListeners_;
+    bool transactionEnded_ = false;                              // 提交或回滚钩子触发后置位，语句结束时通知
+    
+    // SQLite钩子，在执行写语句的线程上调用
+    static void onRowChanged(void* context, int operation, const char* database, const char* table, long long rowid);
+    static int onCommit(void* context);
+    static void onRollback(void* context);
     
-    // 设置错误信息
-    void setLastError(const std::string& error);
+    // 公共方法的语句结束之后：捕获排队的执行计划，写事务结束时通知提交监听
+    void afterStatement();
+    
+    // sqlite3_trace_v2 回调：SQLITE_TRACE_ROW 计数返回的行，SQLITE_TRACE_PROFILE 在语句结束时记录
+    static int onTrace(unsigned type, void* context, void* statement, void* detail);
+    
+    // 失效当前事务修改的行
+    void flushChangedRows();
+    
+    // 设置错误信息，code为SQLite错误码
+    void setLastError(const std::string& error, int code = 1);
     
     // 执行SQL语句
     bool executeStatement(const std::string& sql);
@@ -74,8 +170,17 @@ private:
     // 准备SQL语句
     sqlite3_stmt* prepareStatement(const std::string& sql);
     
+    // 取出缓存的预编译语句并绑定参数；同一条语句正在使用时（回调中再次执行）临时编译一条，cached为false
+    sqlite3_stmt* acquireStatement(const std::string& sql, const std::vector<DbValue>& params, bool& cached);
+    
+    // 重置缓存的语句以便复用，或释放临时语句
+    void releaseStatement(sqlite3_stmt* stmt, bool cached);
+    
+    // 执行参数化的写语句，成功返回true
+    bool executeParameterized(const std::string& sql, const std::vector<DbValue>& params);
+    
     // 绑定参数到语句
-    bool bindParameters(sqlite3_stmt* stmt, const std::vector<std::string>& params);
+    bool bindParameters(sqlite3_stmt* stmt, const std::vector<DbValue>& params);
     
     // 从结果集获取列值
     std::string getColumnValue(sqlite3_stmt* stmt, int column);
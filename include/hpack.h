@@ -0,0 +1,99 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+// HPACK头部压缩（RFC 7541），用于HTTP/2的头部块
+// 编码器和解码器各有一张动态表，与对端的对应表保持同步，因此同一个连接上的头部块必须按顺序编码和解码
+
+struct HeaderField {
+    std::string name;
+    std::string value;
+};
+
+// 动态表：新条目插在最前面（索引最小），超出容量时从末尾淘汰
+// 每个条目的大小按 名称长度 + 值长度 + 32 计算
+class HpackTable {
+public:
+    static const size_t kEntryOverhead = 32;
+
+    explicit HpackTable(size_t capacity) : capacity_(capacity) {}
+
+    void add(std::string name, std::string value);
+
+    // 缩小时立即淘汰超出的条目
+    void setCapacity(size_t capacity);
+    size_t capacity() const { return capacity_; }
+
+    size_t count() const { return entries_.size(); }
+
+    // index从0开始，0为最新的条目
+    const HeaderField& at(size_t index) const { return entries_[index]; }
+
+private:
+    std::deque<HeaderField> entries_;
+    size_t size_ = 0;
+    size_t capacity_;
+
+    void evict(size_t limit);
+};
+
+class HpackDecoder {
+public:
+    static const size_t kDefaultTableSize = 4096;
+
+    // 解码一个完整的头部块，字段按顺序追加到headers；格式错误时返回false（连接错误 COMPRESSION_ERROR）
+    bool decode(std::string_view block, std::vector<HeaderField>& headers);
+
+    // 本端在SETTINGS_HEADER_TABLE_SIZE中允许的最大表大小，对端的表大小更新不能超过它
+    void setMaxTableSize(size_t size) { maxTableSize_ = size; }
+
+private:
+    HpackTable table_{kDefaultTableSize};
+    size_t maxTableSize_ = kDefaultTableSize;
+
+    // 按HPACK索引（静态表1-61，之后为动态表）取字段，结果在下一次修改动态表之前有效
+    bool lookup(uint64_t index, std::string_view& name, std::string_view& value) const;
+};
+
+class HpackEncoder {
+public:
+    static const size_t kDefaultTableSize = 4096;
+
+    // 开始一个头部块，对端缩小了表大小时先写出表大小更新
+    void beginBlock(std::string& out);
+
+    // 编码一个字段追加到out，name必须为小写
+    // indexed为false时不加入动态表，用于每次都不同的值（date、content-length），避免挤掉常用的条目
+    void encode(std::string_view name, std::string_view value, std::string& out, bool indexed = true);
+
+    // 对端的SETTINGS_HEADER_TABLE_SIZE，本端最多使用kDefaultTableSize
+    void setMaxTableSize(size_t size);
+
+private:
+    HpackTable table_{kDefaultTableSize};
+    bool tableSizeChanged_ = false;
+    size_t minTableSize_ = kDefaultTableSize;     // 上一个头部块之后出现过的最小表大小
+
+    // 在动态表中查找，返回HPACK索引（0表示没有）；exact表示名称和值都相同
+    size_t findDynamic(std::string_view name, std::string_view value, bool& exact) const;
+};
+
+namespace Hpack {
+    // 前缀整数（RFC 7541 5.1），first的高位为其他标志位
+    void encodeInteger(uint64_t value, int prefixBits, uint8_t first, std::string& out);
+    bool decodeInteger(std::string_view data, size_t& pos, int prefixBits, uint64_t& value);
+
+    // 字符串字面量，Huffman编码更短时使用Huffman编码
+    void encodeString(std::string_view str, std::string& out);
+
+    // Huffman编码和解码，解码遇到无效的填充或EOS时返回false
+    size_t huffmanLength(std::string_view str);
+    void huffmanEncode(std::string_view str, std::string& out);
+    bool huffmanDecode(std::string_view data, std::string& out);
+
+    // 静态表中的查找，返回索引（0表示没有）；exact表示名称和值都相同
+    size_t findStatic(std::string_view name, std::string_view value, bool& exact);
+}
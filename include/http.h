@@ -0,0 +1,103 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <map>
+#include <array>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+class HttpStream;
+
+// 路由参数类型，在路由模式中写作 :id<int>、:price<double>、:slug<str>，未注明时为str
+enum class ParamType { String, Int, Double };
+
+// 类型化参数在路由匹配时解析后的值
+struct ParamValue {
+    ParamType type = ParamType::String;
+    long long intValue = 0;
+    double doubleValue = 0;
+};
+
+// 路由匹配得到的一个参数，名字指向路由的声明
+// 路径参数的值按在path中的位置保存，不复制字符串，请求被移动或复制后仍然有效
+struct MatchedParam {
+    std::string_view name;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+    bool inPath = false;            // false为声明了类型的查询参数，原始字符串在queryParams中
+    ParamValue value;               // 声明为<int>或<double>时已解析
+};
+
+// HTTP请求结构
+struct HttpRequest {
+    // 一个路由最多声明的参数（路径和查询参数合计）
+    static const size_t kMaxRouteParams = 8;
+    
+    std::string method;
+    std::string path;
+    std::string version;
+    std::string clientIp;
+    std::string query;
+    std::string body;
+    std::map<std::string, std::string> headers;
+    std::map<std::string, std::string, std::less<>> queryParams;     // 查询参数（已解码）
+    std::array<MatchedParam, kMaxRouteParams> routeParams;           // 路由匹配时提取的参数，前routeParamCount个有效
+    size_t routeParamCount = 0;
+    std::chrono::steady_clock::time_point receivedAt;                 // 读完请求的时间，用于访问日志的响应时间
+    std::shared_ptr<HttpStream> stream;                               // 流式路由的请求体和响应，其他路由为空
+    uint64_t traceId = 0;                                             // 被采样追踪的请求的追踪ID，0表示不追踪
+    int64_t traceStart = 0;                                           // 追踪：请求的第一个字节到达的时间（Tracing::now()）
+    
+    // 获取查询参数
+    std::string getQueryParam(const std::string& key) const;
+    
+    // 获取头部信息
+    std::string getHeader(const std::string& key) const;
+    
+    // 获取路径参数
+    std::string getParam(const std::string& key) const;
+    
+    // 获取路径参数，不复制，指向path；不存在时返回空
+    std::string_view paramView(std::string_view key) const;
+    
+    // 路由声明为<int>或<double>的参数（路径或查询），已在路由匹配时校验，读取不需要再解析
+    // 参数不存在（可选的查询参数未提供）时返回defaultValue
+    long long getInt(std::string_view key, long long defaultValue = 0) const;
+    double getDouble(std::string_view key, double defaultValue = 0) const;
+    
+private:
+    // 按名字查找路由参数，inPath为true时只查找路径参数
+    const MatchedParam* findRouteParam(std::string_view key, bool inPath) const;
+};
+
+// HTTP响应结构
+struct HttpResponse {
+    int statusCode;
+    std::map<std::string, std::string> headers;
+    std::string body;
+    
+    HttpResponse();
+    
+    // 设置状态码
+    HttpResponse& status(int code);
+    
+    // 设置头部；同名头部的多个值用换行分隔，发送时拆成多行
+    HttpResponse& header(const std::string& key, const std::string& value);
+    
+    // 设置JSON响应
+    HttpResponse& json(const std::string& jsonData);
+    
+    // 设置文本响应
+    HttpResponse& text(const std::string& text);
+    
+    // 转换为HTTP响应字符串
+    std::string toString() const;
+    
+    // 流式响应的状态行和头部（不含Content-Length），chunked时使用分块传输编码，否则以关闭连接结束正文
+    std::string toStreamHead(bool chunked) const;
+    
+private:
+    // 状态行、Date和所有头部
+    void appendHead(std::string& out) const;
+};
@@ -0,0 +1,151 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include "hpack.h"
+#include "http.h"
+
+// HTTP/2错误码（RFC 9113 第7节）
+enum class Http2Error : uint32_t {
+    NoError = 0x0,
+    ProtocolError = 0x1,
+    InternalError = 0x2,
+    FlowControlError = 0x3,
+    SettingsTimeout = 0x4,
+    StreamClosed = 0x5,
+    FrameSizeError = 0x6,
+    RefusedStream = 0x7,
+    Cancel = 0x8,
+    CompressionError = 0x9,
+    ConnectError = 0xa,
+    EnhanceYourCalm = 0xb,
+    InadequateSecurity = 0xc,
+    Http11Required = 0xd
+};
+
+// 收齐请求体的HTTP/2请求
+struct Http2Request {
+    uint32_t streamId = 0;
+    std::string target;             // :path，包括查询字符串，由服务器拆分
+    HttpRequest request;            // method、version、headers和body已填好
+};
+
+// 一个明文HTTP/2（h2c）连接的协议状态，只在事件循环线程上使用
+// 会话只处理字节：receive() 解析收到的帧，需要发出的帧追加到输出缓冲区，由服务器取出发送。
+// 请求收到END_STREAM后整体交给服务器分派，各个流的响应按完成的先后独立发出，慢请求不阻塞同一连接上的其他请求。
+// 发送受对端的流和连接窗口限制，窗口耗尽时正文留在流中，收到WINDOW_UPDATE后继续；
+// 接收窗口随请求体的到达补充，单个流的请求体超过maxBodySize时返回413并重置流
+class Http2Session {
+public:
+    static constexpr std::string_view kPreface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+    static const uint32_t kMaxConcurrentStreams = 100;
+    static const uint32_t kStreamWindow = 1024 * 1024;           // 每个流的接收窗口
+    static const uint32_t kConnectionWindow = 16 * 1024 * 1024;  // 连接的接收窗口
+    static const uint32_t kMaxFrameSize = 16384;                 // 本端接收的最大帧（协议默认值）
+
+    // 构造时写出本端的SETTINGS和连接窗口的WINDOW_UPDATE
+    Http2Session(size_t maxHeaderListSize, size_t maxBodySize);
+
+    // h2c升级：settings为HTTP2-Settings头部（base64url编码的SETTINGS负载），
+    // 升级的请求成为流1，由服务器照常分派后调用respond(1, ...)；头部无效时返回false
+    bool upgrade(std::string_view settings);
+
+    // 处理inBuffer中完整的帧并移除，请求体收齐的请求追加到requests
+    // 返回false表示连接错误，GOAWAY已写入输出，发送后应关闭连接
+    bool receive(std::string& inBuffer, std::vector<Http2Request>& requests);
+
+    // 发送流的响应；流已被重置或已响应时忽略
+    void respond(uint32_t streamId, HttpResponse response);
+
+    // 重置流，之后的respond()被忽略
+    void resetStream(uint32_t streamId, Http2Error error);
+
+    // 发送GOAWAY，不再接受新的流
+    void goAway(Http2Error error);
+
+    // 取出待发送的帧
+    std::string takeOutput();
+
+    // 有请求已交给服务器、尚未响应；等待对端窗口的流不算在内
+    bool handling() const;
+
+    // 对端发送了GOAWAY且所有流都已结束
+    bool finished() const { return goAwayReceived_ && streams_.empty(); }
+
+private:
+    struct Stream {
+        HttpRequest request;
+        std::string target;
+        long long expectedLength = -1;      // content-length，未提供时为-1
+        int64_t sendWindow = 0;
+        int64_t recvWindow = 0;
+        uint32_t recvUnacked = 0;           // 已收到、尚未用WINDOW_UPDATE归还的字节
+        bool remoteClosed = false;          // 收到END_STREAM，请求已交给服务器
+        bool responding = false;            // 响应头已发出
+        std::string body;                   // 等待发送窗口的响应正文
+        size_t bodyOffset = 0;
+    };
+    using StreamMap = std::map<uint32_t, Stream>;
+
+    size_t maxHeaderListSize_;
+    size_t maxBodySize_;
+    HpackDecoder decoder_;
+    HpackEncoder encoder_;
+    StreamMap streams_;
+    std::string output_;
+
+    bool prefaceReceived_ = false;
+    bool settingsReceived_ = false;
+    bool goAwayReceived_ = false;
+    bool goAwaySent_ = false;
+    bool failed_ = false;
+    uint32_t lastStreamId_ = 0;             // 对端打开过的最大流ID
+
+    int64_t connSendWindow_ = 65535;
+    int64_t connRecvWindow_ = kConnectionWindow;
+    uint32_t connRecvUnacked_ = 0;
+    uint32_t peerInitialWindow_ = 65535;
+    uint32_t peerMaxFrameSize_ = 16384;
+
+    // 正在接收的头部块，HEADERS之后必须紧跟同一个流的CONTINUATION
+    uint32_t headerStreamId_ = 0;
+    uint8_t headerFlags_ = 0;
+    std::string headerBlock_;
+
+    bool handleFrame(uint8_t type, uint8_t flags, uint32_t streamId, std::string_view payload,
+                     std::vector<Http2Request>& requests);
+    bool onDataFrame(uint8_t flags, uint32_t streamId, std::string_view payload, std::vector<Http2Request>& requests);
+    bool onHeadersFrame(uint8_t flags, uint32_t streamId, std::string_view payload, std::vector<Http2Request>& requests);
+    bool onContinuationFrame(uint8_t flags, uint32_t streamId, std::string_view payload,
+                             std::vector<Http2Request>& requests);
+    bool onSettingsFrame(uint8_t flags, uint32_t streamId, std::string_view payload);
+    bool onWindowUpdateFrame(uint32_t streamId, std::string_view payload);
+
+    // 头部块接收完毕：解码并打开流，或作为请求尾部结束流
+    bool onHeaderBlock(uint32_t streamId, std::vector<Http2Request>& requests);
+
+    // 由伪头部和普通头部构造请求，格式错误时返回false
+    bool buildRequest(std::vector<HeaderField>& fields, Stream& stream);
+
+    // 请求体收齐，交给服务器
+    void endOfRequest(StreamMap::iterator it, std::vector<Http2Request>& requests);
+
+    // 不调用处理器，直接响应并结束流
+    void rejectStream(uint32_t streamId, int statusCode, const std::string& message);
+
+    // 应用SETTINGS负载，无效的值返回false并给出错误码
+    bool applySettings(std::string_view payload, Http2Error& error);
+
+    // 在窗口允许的范围内发送正文，发送完毕时结束流；返回下一个流
+    StreamMap::iterator flushStream(StreamMap::iterator it);
+    void flushAll();
+
+    bool connectionError(Http2Error error);
+
+    void writeFrameHeader(size_t length, uint8_t type, uint8_t flags, uint32_t streamId);
+    void writeHeaders(uint32_t streamId, const std::string& block, bool endStream);
+    void writeRstStream(uint32_t streamId, Http2Error error);
+    void writeWindowUpdate(uint32_t streamId, uint32_t increment);
+};
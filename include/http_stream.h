@@ -0,0 +1,129 @@
+#pragma once
+#include <string>
+#include <coroutine>
+#include <functional>
+#include "connection.h"
+#include "io_backend.h"
+#include "tracing.h"
+
+struct HttpResponse;
+
+// 流式路由的请求体和响应，只在事件循环线程上使用
+// 请求体不缓冲到 HttpRequest::body，处理器用 read() 逐块读取；已收到但未读取的数据超过 kReadAhead 时
+// 暂停读取socket，由TCP流量控制让客户端放慢发送。
+// 响应先用 begin() 发送状态行和头部，再用 write() 逐块发送正文（HTTP/1.1使用分块传输编码）；
+// 发送队列超过 kWriteAhead 时 write() 挂起，直到对端接收到只剩一半。
+//   std::string chunk;
+//   while (!(chunk = co_await req.stream->read()).empty()) { ... }
+//   if (req.stream->aborted()) ...   // 连接中途关闭
+class HttpStream {
+public:
+    static const size_t kReadAhead = 1024 * 1024;
+    static const size_t kWriteAhead = 1024 * 1024;
+
+    // 客户端带 Expect: 100-continue 时，在接收请求体之前发送的中间响应
+    static constexpr const char* kContinueResponse = "HTTP/1.1 100 Continue\r\n\r\n";
+
+    // chunked为false时（HTTP/1.0客户端）响应正文以关闭连接结束
+    HttpStream(IoBackend& backend, ConnectionPtr conn, size_t contentLength, bool chunked);
+
+    class ReadAwaiter {
+    public:
+        explicit ReadAwaiter(HttpStream& stream) : stream_(stream) {}
+        bool await_ready() const noexcept { return stream_.readable(); }
+        void await_suspend(std::coroutine_handle<> handle) {
+            stream_.reader_ = handle;
+            stream_.traceId_ = Tracing::current();
+        }
+        std::string await_resume() { return stream_.take(); }
+
+    private:
+        HttpStream& stream_;
+    };
+
+    class WriteAwaiter {
+    public:
+        explicit WriteAwaiter(HttpStream& stream) : stream_(stream) {}
+        bool await_ready() const noexcept { return stream_.writable(); }
+        void await_suspend(std::coroutine_handle<> handle) {
+            stream_.writer_ = handle;
+            stream_.traceId_ = Tracing::current();
+        }
+        bool await_resume() const noexcept { return !stream_.aborted_; }
+
+    private:
+        HttpStream& stream_;
+    };
+
+    // 取出已收到的请求体，没有数据时等待；读完或连接已关闭时返回空串
+    // 客户端在等待 100 Continue 时，第一次调用发送100；不调用read()就回复的请求不会让客户端上传请求体
+    ReadAwaiter read() {
+        sendContinue();
+        return ReadAwaiter(*this);
+    }
+
+    // 请求头中的Content-Length
+    size_t contentLength() const { return contentLength_; }
+
+    // 请求体是否已全部收到
+    bool bodyReceived() const { return received_ == contentLength_; }
+
+    // 连接在请求完成之前关闭
+    bool aborted() const { return aborted_; }
+
+    // 发送状态行和头部，response为处理器的res（状态码同时用于访问日志），其正文被忽略；只能调用一次
+    void begin(HttpResponse& response);
+    bool started() const { return started_; }
+
+    // 发送一块正文，co_await 返回false表示连接已关闭；必须先调用begin()
+    WriteAwaiter write(std::string data);
+
+    // 以下由服务器调用
+
+    // 在发送响应头之前调整响应（CORS、Connection等）
+    void setPrepare(std::function<void(HttpResponse&)> prepare) { prepare_ = std::move(prepare); }
+
+    // 客户端带 Expect: 100-continue 且还没有发送请求体，由第一次read()发送100
+    void expectContinue() { expectContinue_ = true; }
+
+    // 从inBuffer中取出属于请求体的数据，返回true表示请求体已全部收到
+    bool feed(std::string& inBuffer);
+
+    // 待发送的数据取得进展，队列降到一半以下时恢复等待的write()
+    void onSent();
+
+    // 连接关闭，恢复所有等待中的读写
+    void abort();
+
+    // 处理器结束后发送的正文结尾：分块编码为最后一个空块，否则为空（以关闭连接结束正文）
+    std::string trailer() const { return chunked_ ? "0\r\n\r\n" : ""; }
+
+    bool chunked() const { return chunked_; }
+
+private:
+    IoBackend& backend_;
+    ConnectionPtr conn_;
+    std::function<void(HttpResponse&)> prepare_;
+    size_t contentLength_;
+    size_t received_ = 0;
+    std::string buffer_;                   // 已收到、尚未被read()取走的请求体
+    bool chunked_;
+    bool started_ = false;
+    bool aborted_ = false;
+    bool expectContinue_ = false;
+    std::coroutine_handle<> reader_;
+    std::coroutine_handle<> writer_;
+    uint64_t traceId_ = 0;                 // 挂起的协程所属请求的追踪ID，恢复时设回
+
+    bool readable() const { return !buffer_.empty() || bodyReceived() || aborted_; }
+    bool writable() const;
+
+    // 取走buffer_，读取暂停时恢复
+    std::string take();
+
+    // 客户端仍在等待时发送 100 Continue，只发送一次
+    void sendContinue();
+
+    // 投递到事件循环恢复等待的协程，避免在后端回调中重入
+    void wake(std::coroutine_handle<>& handle);
+};
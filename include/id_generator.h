@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// 128位UUID
+struct Uuid {
+    std::array<uint8_t, 16> bytes{};
+
+    // 写入36个字符的标准格式 "xxxxxxxx-xxxx-7xxx-yxxx-xxxxxxxxxxxx"，不追加结束符
+    void format(char* out) const;
+
+    std::string toString() const;
+
+    bool operator==(const Uuid& other) const { return bytes == other.bytes; }
+    bool operator<(const Uuid& other) const { return bytes < other.bytes; }
+};
+
+// ID生成
+// 随机数来自线程本地的xoshiro256**，各线程互不干扰，不需要加锁；不适用于密码学用途
+class IdGenerator {
+public:
+    // 线程本地的64位随机数
+    static uint64_t random64();
+
+    // [0, bound) 内均匀分布的随机数，bound为0时返回0
+    static uint64_t randomBelow(uint64_t bound);
+
+    // RFC 9562 UUIDv7：48位毫秒时间戳 + 版本 + 随机数
+    // 同一线程同一毫秒内生成的UUID严格递增（26位计数器），按时间排序，适合作为B树主键
+    static Uuid uuidV7();
+    static std::string uuidV7String();
+
+    // 把字节写成小写十六进制，out需要 2*length 个字符
+    static void writeHex(const uint8_t* data, size_t length, char* out);
+
+    // 把64位整数写成16个小写十六进制字符
+    static void writeHex(uint64_t value, char* out);
+};
+
+// Snowflake风格的64位ID：41位毫秒时间戳（自2024-01-01起）+ 10位节点号 + 12位序号
+// 整体单调递增；同一毫秒的4096个序号用完后借用下一毫秒，时钟追上后恢复
+class SnowflakeGenerator {
+public:
+    static const long long kEpochMillis = 1704067200000LL;   // 2024-01-01T00:00:00Z
+    static const unsigned kMaxWorkerId = 1023;
+
+    // workerId 超出范围时取低10位
+    explicit SnowflakeGenerator(unsigned workerId);
+
+    // 生成下一个ID（线程安全）
+    uint64_t next();
+
+    // 从ID中取出生成时间（自1970年以来的毫秒数）
+    static long long timestampOf(uint64_t id) { return static_cast<long long>(id >> 22) + kEpochMillis; }
+
+    unsigned workerId() const { return workerId_; }
+
+private:
+    unsigned workerId_;
+    std::atomic<uint64_t> state_;   // 高位为时间戳，低12位为序号
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <atomic>
+#include <winsock2.h>
+#include "connection.h"
+#include "timer_wheel.h"
+
+// I/O后端类型
+enum class IoBackendType {
+    Poll,   // 基于WSAPoll的就绪通知模型
+    Iocp    // 基于完成端口的异步I/O模型
+};
+
+// 解析后端名称（"poll" / "iocp"），无法识别时返回false
+bool parseIoBackendType(const std::string& name, IoBackendType& type);
+
+// 多个连接共享的只读发送数据，例如广播给所有订阅者的同一个WebSocket帧
+using SharedBuffer = std::shared_ptr<const std::string>;
+
+// 发送队列中的一段数据：连接独占的字符串，或共享的缓冲区（只持有引用，不复制内容）
+class SendChunk {
+public:
+    SendChunk(std::string data) : owned_(std::move(data)) {}
+    SendChunk(SharedBuffer data) : shared_(std::move(data)) {}
+
+    const char* data() const { return (shared_ ? shared_->data() : owned_.data()) + offset_; }
+    size_t size() const { return (shared_ ? shared_->size() : owned_.size()) - offset_; }
+
+    // 跳过已发出的字节
+    void consume(size_t count) { offset_ += count; }
+
+    // 追加到独占的数据之后，用于合并小块；共享的缓冲区返回false
+    bool append(std::string_view data) {
+        if (shared_) return false;
+        owned_ += data;
+        return true;
+    }
+
+private:
+    std::string owned_;
+    SharedBuffer shared_;
+    size_t offset_ = 0;
+};
+
+// I/O后端接口
+// 所有连接操作都在事件循环线程上执行，跨线程只能通过post()投递任务
+class IoBackend {
+public:
+    explicit IoBackend(ConnectionHandler& handler) : handler_(handler) {}
+    virtual ~IoBackend() = default;
+
+    // 后端名称
+    virtual const char* name() const = 0;
+
+    // 绑定监听socket，当前系统不支持该后端时返回false
+    virtual bool open(SOCKET listenSocket) = 0;
+
+    // 运行事件循环，直到stop()被调用
+    virtual void run() = 0;
+
+    // 停止事件循环（线程安全）
+    virtual void stop() = 0;
+
+    // 投递任务到事件循环线程执行（线程安全）
+    virtual void post(std::function<void()> task) = 0;
+
+    // 延迟指定时间后在事件循环线程执行任务（线程安全）
+    void postAfter(std::chrono::milliseconds delay, std::function<void()> task);
+
+    // 发送数据（仅限事件循环线程）
+    virtual void send(const ConnectionPtr& conn, std::string data) = 0;
+
+    // 发送共享的数据，同一个缓冲区可以同时交给多个连接（仅限事件循环线程）
+    virtual void send(const ConnectionPtr& conn, SharedBuffer data) = 0;
+
+    // 关闭连接（仅限事件循环线程）
+    virtual void close(const ConnectionPtr& conn) = 0;
+
+    // 清除conn->readPaused并恢复读取；不会在调用中同步回调onData（仅限事件循环线程）
+    virtual void resumeRead(const ConnectionPtr& conn) = 0;
+
+    // 已交给后端但尚未发出的字节数（仅限事件循环线程）
+    virtual size_t pendingSendBytes(const ConnectionPtr& conn) const = 0;
+
+    // 事件循环的时间轮（仅限事件循环线程）
+    TimerWheel& timers() { return timers_; }
+
+    // 设置发送超时：待发送的数据在这段时间内没有任何进展时关闭连接，0表示不限制（线程安全）
+    void setWriteTimeout(std::chrono::milliseconds timeout) { writeTimeoutMs_ = timeout.count(); }
+
+protected:
+    ConnectionHandler& handler_;
+    TimerWheel timers_;
+    std::atomic<long long> writeTimeoutMs_{0};
+
+    // 有数据等待发送且刚刚取得进展时调用，启动或推迟发送超时
+    void refreshWriteDeadline(const ConnectionPtr& conn);
+};
+
+// 创建指定类型的I/O后端
+std::unique_ptr<IoBackend> createIoBackend(IoBackendType type, ConnectionHandler& handler);
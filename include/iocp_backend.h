@@ -0,0 +1,116 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <winsock2.h>
+#include <mswsock.h>
+#include "io_backend.h"
+
+// 基于I/O完成端口的异步后端
+// - 预先投递多个AcceptEx，相当于持续有效的accept请求
+// - 空闲连接只挂起零字节WSARecv，不占用接收缓冲区；数据到达后读入事件循环共享的缓冲区
+// - 多个待发送响应合并为一次WSASend的分散/聚集缓冲区
+// - 使用GetQueuedCompletionStatusEx批量获取完成通知，
+//   并开启FILE_SKIP_COMPLETION_PORT_ON_SUCCESS，同步完成的操作不再产生完成包
+class IocpBackend : public IoBackend {
+public:
+    explicit IocpBackend(ConnectionHandler& handler);
+    ~IocpBackend() override;
+
+    const char* name() const override { return "iocp"; }
+    bool open(SOCKET listenSocket) override;
+    void run() override;
+    void stop() override;
+    void post(std::function<void()> task) override;
+    void send(const ConnectionPtr& conn, std::string data) override;
+    void send(const ConnectionPtr& conn, SharedBuffer data) override;
+    void close(const ConnectionPtr& conn) override;
+    void resumeRead(const ConnectionPtr& conn) override;
+    size_t pendingSendBytes(const ConnectionPtr& conn) const override;
+
+private:
+    enum class OperationType { Accept, Recv, Send };
+
+    // 重叠操作，OVERLAPPED必须是第一个成员
+    struct Operation {
+        OVERLAPPED overlapped;
+        OperationType type;
+        void* owner;
+    };
+
+    struct IocpConnection : Connection {
+        Operation recvOp;
+        Operation sendOp;
+        bool recvPending = false;
+        bool sendPending = false;
+        bool skipOnSuccess = false;
+        std::deque<SendChunk> sendQueue;       // 等待发送的数据
+        std::vector<SendChunk> sending;        // 正在发送的数据
+        std::vector<WSABUF> sendBuffers;
+        size_t pendingBytes = 0;               // sendQueue和sending中尚未发送的字节数
+    };
+
+    // AcceptEx所需的地址缓冲区大小
+    static const DWORD kAddressLength = sizeof(sockaddr_in) + 16;
+
+    struct AcceptSlot {
+        Operation op;
+        SOCKET socket;
+        char addressBuffer[2 * kAddressLength];
+    };
+
+    HANDLE iocp_;
+    SOCKET listenSocket_;
+    std::atomic<bool> stopping_;
+    LPFN_ACCEPTEX acceptEx_;
+    LPFN_GETACCEPTEXSOCKADDRS getAcceptExSockaddrs_;
+    std::vector<AcceptSlot> acceptSlots_;
+    std::unordered_map<Connection*, std::shared_ptr<IocpConnection>> connections_;
+    std::vector<char> readBuffer_;
+    long pendingOperations_;
+
+    std::mutex postMutex_;
+    std::vector<std::function<void()>> posted_;
+
+    // 获取Winsock扩展函数指针
+    bool loadExtensions();
+
+    // 投递AcceptEx
+    bool postAccept(AcceptSlot& slot);
+
+    // 处理AcceptEx完成
+    void onAcceptComplete(AcceptSlot& slot, bool success);
+
+    // 为槽位重新投递AcceptEx，失败时用定时器稍后重试
+    void repostAccept(AcceptSlot& slot);
+
+    // 处理单个完成通知
+    void onCompletion(Operation* op, DWORD bytesTransferred, bool success);
+
+    // 持续读取，直到零字节WSARecv进入挂起状态
+    void startRead(const std::shared_ptr<IocpConnection>& conn);
+
+    // 投递零字节WSARecv，同步完成时返回true
+    bool postZeroByteRecv(const std::shared_ptr<IocpConnection>& conn);
+
+    // 读取socket中所有可读数据，连接仍可读时返回true
+    bool drainSocket(const std::shared_ptr<IocpConnection>& conn);
+
+    // 加入发送队列并开始发送
+    void enqueue(const std::shared_ptr<IocpConnection>& conn, SendChunk chunk);
+
+    // 发送队列中的数据
+    void startSend(const std::shared_ptr<IocpConnection>& conn);
+
+    // 发送完成处理，返回是否还需要继续发送
+    bool finishSend(const std::shared_ptr<IocpConnection>& conn, DWORD bytesSent);
+
+    // 执行投递的任务
+    void runPosted();
+
+    // 没有挂起操作的已关闭连接可以释放
+    void releaseIfIdle(IocpConnection* conn);
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+
+// JSON值
+class JsonValue {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    using Array = std::vector<JsonValue>;
+    using Object = std::vector<std::pair<std::string, JsonValue>>;   // 保持键的原始顺序
+
+    JsonValue() : type_(Type::Null) {}
+    JsonValue(bool value) : type_(Type::Bool), bool_(value) {}
+    JsonValue(double value) : type_(Type::Number), number_(value) {}
+    JsonValue(int value) : type_(Type::Number), number_(value) {}
+    JsonValue(long long value) : type_(Type::Number), number_(static_cast<double>(value)) {}
+    JsonValue(const char* value) : type_(Type::String), string_(value) {}
+    JsonValue(std::string value) : type_(Type::String), string_(std::move(value)) {}
+
+    static JsonValue array() { JsonValue value; value.type_ = Type::Array; return value; }
+    static JsonValue object() { JsonValue value; value.type_ = Type::Object; return value; }
+
+    // 解析JSON文本，失败时返回false并给出错误位置
+    static bool parse(const std::string& text, JsonValue& out, std::string& error);
+
+    Type type() const { return type_; }
+    bool isNull() const { return type_ == Type::Null; }
+    bool isBool() const { return type_ == Type::Bool; }
+    bool isNumber() const { return type_ == Type::Number; }
+    bool isString() const { return type_ == Type::String; }
+    bool isArray() const { return type_ == Type::Array; }
+    bool isObject() const { return type_ == Type::Object; }
+
+    // 类型不匹配时返回默认值
+    bool asBool(bool defaultValue = false) const;
+    double asNumber(double defaultValue = 0) const;
+    long long asInt(long long defaultValue = 0) const;
+    std::string asString(const std::string& defaultValue = "") const;
+
+    // 对象成员，不存在时返回null
+    const JsonValue& operator[](const std::string& key) const;
+    bool has(const std::string& key) const;
+
+    // 数组元素，越界时返回null
+    const JsonValue& operator[](size_t index) const;
+    size_t size() const;
+
+    const Array& elements() const { return array_; }
+    const Object& members() const { return object_; }
+
+    // 修改数组或对象
+    void push(JsonValue value);
+    void set(const std::string& key, JsonValue value);
+
+    // 序列化为紧凑的JSON文本
+    std::string dump() const;
+
+private:
+    Type type_;
+    bool bool_ = false;
+    double number_ = 0;
+    std::string string_;
+    Array array_;
+    Object object_;
+
+    void dumpTo(std::string& out) const;
+};
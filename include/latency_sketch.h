@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// 延迟分布的DDSketch：按对数划分桶，任何分位数的相对误差不超过 kRelativeAccuracy
+// 两个草图可以无损合并，因此分钟桶可以直接合成小时、天或跨路由的分布。
+// 值小于1（微秒）时计入零桶，分位数返回0
+class LatencySketch {
+public:
+    static constexpr double kRelativeAccuracy = 0.01;
+
+    void add(double value);
+    void merge(const LatencySketch& other);
+
+    // q取0到1，空草图返回0
+    double quantile(double q) const;
+
+    uint64_t count() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    // 文本格式 "零桶计数|桶号:计数,桶号:计数"，只写非空的桶
+    std::string serialize() const;
+    static bool deserialize(std::string_view text, LatencySketch& sketch);
+
+private:
+    static constexpr int kMaxKey = 1400;      // 约1e12，超出的值计入最后一个桶
+
+    std::vector<uint64_t> bins_;              // bins_[i] 对应桶号 offset_ + i
+    int offset_ = 0;
+    uint64_t zeroCount_ = 0;
+    uint64_t count_ = 0;
+
+    static int keyFor(double value);
+    static double valueFor(int key);
+
+    // 增加桶号key的计数，按需扩展bins_
+    void addToBin(int key, uint64_t count);
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+
+// 日志级别
+enum class LogLevel {
+    Debug,
+    Info,
+    Warn,
+    Error
+};
+
+// 解析级别名称（"DEBUG" / "INFO" / "WARN" / "ERROR"，不区分大小写），无法识别时返回false
+bool parseLogLevel(const std::string& name, LogLevel& level);
+
+// 级别名称
+const char* logLevelName(LogLevel level);
+
+// 进程级日志，级别可以在运行时修改
+namespace Logger {
+
+    // 设置最低输出级别
+    void setLevel(LogLevel level);
+    LogLevel level();
+
+    // 该级别的日志是否会输出，拼接开销大的消息应先检查
+    bool enabled(LogLevel level);
+
+    // 输出日志，Warn及以上写到标准错误
+    void log(LogLevel level, const std::string& message, const std::string& source = "");
+
+    inline void debug(const std::string& message, const std::string& source = "") { log(LogLevel::Debug, message, source); }
+    inline void info(const std::string& message, const std::string& source = "") { log(LogLevel::Info, message, source); }
+    inline void warn(const std::string& message, const std::string& source = "") { log(LogLevel::Warn, message, source); }
+    inline void error(const std::string& message, const std::string& source = "") { log(LogLevel::Error, message, source); }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include "http.h"
+
+// 中间件约定：
+//   template<typename Context, typename Next>
+//   void operator()(Context& context, Next&& next) const;
+// 调用 next() 进入下一层（最内层是请求的分派），不调用则由这一层通过 context 给出响应。
+// 服务器在事件循环线程上为每个请求调用一次整条链，处理器是同步的、协程的、流式的还是HTTP/2的都经过同一条链；
+// 中间件本身不保存请求的状态，operator() 必须是 const。
+
+// 编译期组合的中间件链
+// 每一层的 next 都是具体的lambda类型，整条链可以内联成一次调用，不经过 std::function
+template<typename... Middlewares>
+class MiddlewareChain {
+public:
+    explicit MiddlewareChain(Middlewares... middlewares) : layers_(std::move(middlewares)...) {}
+
+    template<typename Context, typename Handler>
+    void operator()(Context& context, Handler&& handler) const {
+        call<0>(context, handler);
+    }
+
+private:
+    std::tuple<Middlewares...> layers_;
+
+    template<size_t Index, typename Context, typename Handler>
+    void call(Context& context, Handler& handler) const {
+        if constexpr (Index == sizeof...(Middlewares)) {
+            handler();
+        } else {
+            std::get<Index>(layers_)(context, [&]() {
+                call<Index + 1>(context, handler);
+            });
+        }
+    }
+};
+
+// CORS配置
+struct CorsConfig {
+    bool enabled = false;
+    std::string origin = "*";                               // "*" 或逗号分隔的源列表
+    std::string methods = "GET,POST,PUT,DELETE,OPTIONS";
+    std::string headers = "Content-Type,Authorization,X-API-Key";
+    int maxAge = 600;                                       // 预检结果缓存时间（秒）
+};
+
+// CORS：应答预检请求，并为普通响应添加允许的源
+class Cors {
+public:
+    explicit Cors(const CorsConfig& config);
+
+    // 是否为预检请求
+    bool isPreflight(const HttpRequest& request) const;
+
+    // 生成预检响应
+    void preflight(const HttpRequest& request, HttpResponse& response) const;
+
+    // 为普通响应添加CORS头部
+    void apply(const HttpRequest& request, HttpResponse& response) const;
+
+    // 请求的源是否在允许的列表中，没有Origin头部（非浏览器客户端）时视为允许
+    // WebSocket握手不受浏览器同源策略限制，由服务器用它检查
+    bool allowsOrigin(const HttpRequest& request) const;
+
+private:
+    CorsConfig config_;
+    bool anyOrigin_;
+    std::vector<std::string> origins_;
+
+    // 返回允许的源，请求的源不在列表中时返回空字符串
+    std::string allowedOrigin(const HttpRequest& request) const;
+};
+
+// 预检中间件：没有显式注册OPTIONS路由时由全局CORS应答预检请求
+// context.cors 为空表示没有启用CORS；普通响应的CORS头部由 context.respond() 和各个完成路径添加
+struct CorsPreflight {
+    template<typename Context, typename Next>
+    void operator()(Context& context, Next&& next) const {
+        if (context.route || !context.cors || !context.cors->isPreflight(context.request)) {
+            next();
+            return;
+        }
+        HttpResponse response;
+        context.cors->preflight(context.request, response);
+        context.respond(response);
+    }
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include "io_backend.h"
+
+// 基于WSAPoll的就绪通知后端，所有Windows版本均可用
+class PollBackend : public IoBackend {
+public:
+    explicit PollBackend(ConnectionHandler& handler);
+    ~PollBackend() override;
+
+    const char* name() const override { return "poll"; }
+    bool open(SOCKET listenSocket) override;
+    void run() override;
+    void stop() override;
+    void post(std::function<void()> task) override;
+    void send(const ConnectionPtr& conn, std::string data) override;
+    void send(const ConnectionPtr& conn, SharedBuffer data) override;
+    void close(const ConnectionPtr& conn) override;
+    void resumeRead(const ConnectionPtr& conn) override;
+    size_t pendingSendBytes(const ConnectionPtr& conn) const override;
+
+private:
+    // 带发送缓冲的连接
+    struct PollConnection : Connection {
+        std::deque<SendChunk> outQueue;     // 相邻的独占数据合并为一块
+        size_t outBytes = 0;
+    };
+
+    SOCKET listenSocket_;
+    SOCKET wakeSocket_;
+    std::atomic<bool> stopping_;
+    std::unordered_map<SOCKET, std::shared_ptr<PollConnection>> connections_;
+    std::vector<WSAPOLLFD> pollFds_;
+    std::vector<char> readBuffer_;
+
+    std::mutex postMutex_;
+    std::vector<std::function<void()>> posted_;
+
+    // 创建用于唤醒事件循环的本地UDP socket
+    bool createWakeSocket();
+
+    // 唤醒事件循环
+    void wakeup();
+
+    // 执行投递的任务
+    void runPosted();
+
+    // 接受所有挂起的连接
+    void acceptConnections();
+
+    // 读取连接上的所有可读数据
+    void readConnection(const std::shared_ptr<PollConnection>& conn);
+
+    // 加入发送队列并尝试直接发送
+    void enqueue(const std::shared_ptr<PollConnection>& conn, SendChunk chunk);
+
+    // 尽可能多地发送缓冲数据
+    void flushConnection(const std::shared_ptr<PollConnection>& conn);
+};
@@ -0,0 +1,200 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <winsock2.h>
+#include "async.h"
+#include "http.h"
+
+// 选择上游的方式
+enum class ProxyBalance {
+    LeastOutstanding,   // 进行中的请求最少的上游，相同时轮流选择
+    PowerOfTwo          // 随机取两个上游，选进行中的请求较少的一个
+};
+
+// 解析 "least_outstanding" / "p2c"，无法识别时返回false
+bool parseProxyBalance(const std::string& name, ProxyBalance& balance);
+const char* proxyBalanceName(ProxyBalance balance);
+
+// 一条反向代理路由
+struct ProxyConfig {
+    std::string prefix;                         // 路径前缀，如 /svc；匹配 /svc 和 /svc/...，不匹配 /svcx
+    std::vector<std::string> upstreams;         // 上游HTTP/1.1服务器，"host:port"
+    ProxyBalance balance = ProxyBalance::LeastOutstanding;
+    bool stripPrefix = false;                   // 转发时去掉前缀：/svc/users 转发为 /users
+    int connectTimeoutMs = 3000;
+    int timeoutMs = 30000;                      // 每次向上游发送或等待上游数据的超时
+    size_t maxIdle = 32;                        // 每个上游保留的空闲连接数
+    int maxFails = 3;                           // 连续失败多少次后摘除
+    int ejectSeconds = 10;                      // 第一次摘除的时间，恢复后再次被摘除时加倍，最长 kMaxEjectSeconds
+
+    bool operator==(const ProxyConfig& other) const = default;
+};
+
+// 与上游通信的错误；超时的请求回复504，其他错误回复502
+struct ProxyError {
+    std::string message;
+    bool timeout = false;
+
+    bool empty() const { return message.empty(); }
+};
+
+// 上游响应的状态行和头部
+struct UpstreamResponse {
+    int statusCode = 0;
+    std::vector<std::pair<std::string, std::string>> headers;
+};
+
+// 到上游的一条连接
+// socket为非阻塞模式，读写用WSAPoll等待，每次等待不超过超时，只在代理线程上阻塞。
+// 连接在一个请求的各个步骤之间可以换线程，但同一时刻只有一个线程使用
+class UpstreamConnection {
+public:
+    explicit UpstreamConnection(SOCKET socket);
+    ~UpstreamConnection();
+
+    UpstreamConnection(const UpstreamConnection&) = delete;
+    UpstreamConnection& operator=(const UpstreamConnection&) = delete;
+
+    // 建立连接，失败时返回nullptr并设置error
+    static std::unique_ptr<UpstreamConnection> connect(const std::string& host, int port, int timeoutMs,
+                                                       ProxyError& error);
+
+    // 发送全部数据
+    bool send(std::string_view data, int timeoutMs, ProxyError& error);
+
+    // 读取响应头，跳过1xx中间响应；headRequest为true时响应没有正文
+    bool readHead(bool headRequest, int timeoutMs, UpstreamResponse& response, ProxyError& error);
+
+    // 读取下一段正文（分块编码已解码），最多maxBytes；正文结束时done为true
+    bool readBody(size_t maxBytes, int timeoutMs, std::string& chunk, bool& done, ProxyError& error);
+
+    // 响应已完整读完，上游没有要求关闭连接，可以放回连接池
+    bool reusable() const { return complete_ && keepAlive_ && buffer_.empty(); }
+
+    // 还没有收到这次请求的任何响应数据，复用的连接在这时失败说明上游已经关闭了它
+    bool receivedNothing() const { return !received_; }
+
+    // 空闲期间上游关闭了连接或发来了意外的数据
+    bool stale() const;
+
+    // 放回连接池时重置响应状态
+    void resetForReuse();
+
+    std::chrono::steady_clock::time_point idleSince() const { return idleSince_; }
+
+private:
+    enum class BodyMode { None, Length, Chunked, UntilClose };
+    enum class ChunkState { Size, Data, DataEnd, Trailer };
+
+    SOCKET socket_;
+    std::string buffer_;                // 已收到、尚未解析的数据
+    BodyMode mode_ = BodyMode::None;
+    ChunkState chunkState_ = ChunkState::Size;
+    uint64_t remaining_ = 0;            // Length：剩余的正文；Chunked：当前块剩余的数据
+    bool complete_ = false;
+    bool keepAlive_ = false;
+    bool received_ = false;
+    std::chrono::steady_clock::time_point idleSince_;
+
+    // 等待socket可读或可写，超时或出错时返回false
+    bool wait(short events, int timeoutMs, ProxyError& error) const;
+
+    // 接收更多数据追加到buffer_，对端关闭时返回false且error为空
+    bool fill(int timeoutMs, ProxyError& error);
+
+    // 从buffer_中解析正文，最多取limit字节追加到chunk；buffer_中的数据不够前进一步时返回false
+    bool decode(size_t limit, std::string& chunk, ProxyError& error);
+};
+
+// 一个上游服务器：空闲连接池、进行中的请求数和被动健康检查
+// 选择在事件循环线程上进行，连接的取出、读写和归还在代理线程上，都是线程安全的
+class Upstream {
+public:
+    static const int kMaxEjectSeconds = 300;
+    static constexpr std::chrono::seconds kMaxIdleTime{30};     // 空闲超过这个时间的连接不再复用
+
+    Upstream(std::string host, int port, const ProxyConfig& config);
+
+    const std::string& name() const { return name_; }
+    int outstanding() const { return outstanding_.load(std::memory_order_relaxed); }
+
+    // 没有被摘除，或摘除已经到期（到期后的第一次失败会再次摘除）
+    bool available(std::chrono::steady_clock::time_point now) const;
+
+    // 请求开始和结束，维护进行中的请求数
+    void begin();
+    void end() { outstanding_.fetch_sub(1, std::memory_order_relaxed); }
+
+    // 被动健康检查：连接失败、读写出错或超时、5xx响应计为失败，连续 maxFails 次后摘除
+    void reportSuccess();
+    void reportFailure(const std::string& reason);
+
+    // 取出一条空闲连接，没有时新建；reused表示是否复用的连接
+    std::unique_ptr<UpstreamConnection> acquire(bool& reused, ProxyError& error);
+
+    // 归还读完响应的连接，不能复用或空闲连接已满时关闭
+    void release(std::unique_ptr<UpstreamConnection> connection);
+
+    // {"address": ..., "outstanding": ..., ...}
+    std::string toJson() const;
+
+private:
+    std::string host_;
+    int port_;
+    std::string name_;
+    const ProxyConfig& config_;
+    std::atomic<int> outstanding_{0};
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> failures_{0};
+    std::atomic<int64_t> ejectedUntil_{0};      // steady_clock的纳秒数，0表示没有被摘除
+
+    mutable std::mutex mutex_;                  // 保护空闲连接和连续失败计数
+    std::vector<std::unique_ptr<UpstreamConnection>> idle_;
+    int consecutiveFailures_ = 0;
+    int ejections_ = 0;                         // 恢复之前连续被摘除的次数
+};
+
+// 反向代理路由：把前缀下的请求转发到一组上游，请求体和响应正文都边收边转发
+// 处理器在事件循环上运行，与上游的读写交给代理线程池，期间协程挂起；
+// 对客户端的写入受 HttpStream 的发送队列限制，客户端接收慢时不再读取上游，由TCP流量控制让上游放慢
+class ReverseProxy {
+public:
+    static const size_t kBodyChunk = 64 * 1024;     // 每次从上游读取的正文
+
+    explicit ReverseProxy(ProxyConfig config);
+
+    // 上游引用config_，不能复制或移动
+    ReverseProxy(const ReverseProxy&) = delete;
+    ReverseProxy& operator=(const ReverseProxy&) = delete;
+
+    // 配置有误（前缀不以/开头、没有上游、地址格式错误）时返回false，error为原因
+    static bool validate(const ProxyConfig& config, std::string& error);
+
+    // 解析 "host:port"
+    static bool parseAddress(const std::string& text, std::string& host, int& port);
+
+    const ProxyConfig& config() const { return config_; }
+
+    // 转发一个请求，作为流式协程路由的处理器；pool为执行阻塞读写的代理线程池
+    Task forward(const HttpRequest& request, HttpResponse& response, ThreadPool& pool, IoBackend& loop);
+
+    // {"prefix": ..., "balance": ..., "upstreams": [...]}
+    std::string toJson() const;
+
+private:
+    ProxyConfig config_;
+    std::vector<std::unique_ptr<Upstream>> upstreams_;
+    size_t next_ = 0;               // 最少请求数相同时轮流的起点，只在事件循环线程上使用
+
+    // 选择上游，全部被摘除时返回nullptr（仅限事件循环线程）
+    Upstream* pick();
+
+    // 发往上游的请求行和头部
+    std::string requestHead(const HttpRequest& request, size_t contentLength, const std::string& host) const;
+};
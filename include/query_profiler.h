@@ -0,0 +1,118 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+#include "latency_sketch.h"
+
+// 一条语句执行完毕时的测量值，来自 sqlite3_trace_v2 和 sqlite3_stmt_status
+struct StatementProfile {
+    uint64_t elapsedNs = 0;         // 从第一次step到执行结束
+    uint64_t rows = 0;              // 读语句为返回的行，写语句为修改的行
+    uint64_t fullScanSteps = 0;     // 全表扫描前进的步数（SQLITE_STMTSTATUS_FULLSCAN_STEP）
+    uint64_t sorts = 0;             // 排序次数（没有可用索引的ORDER BY、GROUP BY）
+    uint64_t autoIndexes = 0;       // 为查询临时建立的自动索引插入的行
+    bool explainable = false;       // 可以用 EXPLAIN QUERY PLAN 分析（查询和增删改，不包括DDL和事务语句）
+};
+
+// 按规范化SQL汇总的统计
+struct QueryStats {
+    std::string sql;                // 规范化的SQL：字面量替换为?，空白压缩
+    uint64_t count = 0;
+    uint64_t totalUs = 0;
+    uint64_t maxUs = 0;
+    uint64_t rows = 0;
+    uint64_t slowCount = 0;         // 超过慢查询阈值的次数
+    uint64_t fullScanSteps = 0;
+    uint64_t sorts = 0;
+    uint64_t autoIndexes = 0;
+    LatencySketch latency;          // 微秒
+    bool planCaptured = false;      // 已捕获执行计划，或已排队等待捕获
+    std::string plan;               // 第一次超过阈值时捕获的 EXPLAIN QUERY PLAN，每行一个节点，按层级缩进
+    std::vector<std::string> scannedTables;     // 计划中全表扫描的表
+};
+
+// 报告的排序方式
+enum class QuerySort { Total, Max, Count, Rows, Scans };
+
+// 语句级的性能分析
+// Database 在 sqlite3_trace_v2 的回调中把每条语句的耗时、行数和扫描计数交给 record()，按规范化的SQL文本汇总，
+// 预编译语句的原始文本到汇总项的映射被缓存，规范化只在第一次遇到时进行。
+// 超过慢查询阈值的语句排队等待捕获执行计划；回调中不能在同一连接上执行其他语句，
+// 由 Database 在语句结束后执行 EXPLAIN QUERY PLAN 并调用 setPlan()。
+// 和数据库连接一样只在数据库执行器上使用，阈值可以在任何线程上修改
+class QueryProfiler {
+public:
+    static const size_t kMaxStatements = 1000;     // 不同语句的上限，超出的汇总到 kOverflowSql
+    static const size_t kMaxRawSql = 4096;         // 原始文本缓存的上限，拼接字面量的SQL不会无限增长
+    static constexpr const char* kOverflowSql = "(other)";
+
+    // 规范化SQL：字符串和数字字面量替换为?，逗号分隔的连续参数合并为 "?, ..."，连续的空白压缩为一个空格
+    static std::string normalize(std::string_view sql);
+
+    // 计划中的全表扫描（"SCAN users" 或旧版本的 "SCAN TABLE users"），返回表名
+    // 按索引扫描、虚拟表、子查询和CTE（计划中有 CO-ROUTINE 或 MATERIALIZE）不算
+    static std::vector<std::string> findFullScans(std::string_view plan);
+
+    // 慢查询阈值，0表示不捕获执行计划
+    void setSlowThreshold(long long milliseconds) { slowThresholdUs_ = milliseconds * 1000; }
+    long long slowThresholdMs() const { return slowThresholdUs_ / 1000; }
+
+    // 语句执行完毕
+    void record(std::string_view sql, const StatementProfile& profile);
+
+    // 语句开始执行（SQLITE_TRACE_STMT），now为单调时钟的纳秒数；statement 只用作标识
+    void statementStarted(const void* statement, int64_t now);
+
+    // 语句返回了一行（SQLITE_TRACE_ROW）
+    void countRow(const void* statement);
+
+    // 语句执行完毕，取出开始时间和返回的行数；没有记录开始时间时返回false
+    bool takeStatement(const void* statement, int64_t& started, uint64_t& rows);
+
+    // 有等待捕获执行计划的语句
+    bool planPending() const { return !pendingPlans_.empty(); }
+
+    // 取出等待捕获的语句：（规范化SQL，原始SQL）
+    std::vector<std::pair<std::string, std::string>> takePendingPlans();
+
+    // 保存捕获的执行计划并检查全表扫描
+    void setPlan(const std::string& sql, std::string plan);
+
+    // 按排序方式取前limit条
+    std::vector<QueryStats> report(QuerySort sort, size_t limit) const;
+
+    // 清空统计
+    void reset();
+
+    // 解析排序参数，空串为total
+    static bool parseSort(const std::string& text, QuerySort& sort);
+
+    static std::string toJson(const QueryStats& stats);
+
+private:
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view text) const { return std::hash<std::string_view>()(text); }
+    };
+    using StatsMap = std::unordered_map<std::string, QueryStats, StringHash, std::equal_to<>>;
+
+    std::atomic<long long> slowThresholdUs_{100 * 1000};
+    StatsMap stats_;
+    std::unordered_map<std::string, QueryStats*, StringHash, std::equal_to<>> rawSql_;  // 原始SQL到汇总项
+    std::vector<std::pair<std::string, std::string>> pendingPlans_;
+    // 正在执行的语句，通常只有一两条（forEachRow 的回调中执行的语句）
+    struct ActiveStatement {
+        const void* statement;
+        int64_t started;
+        uint64_t rows;
+    };
+    std::vector<ActiveStatement> active_;
+
+    ActiveStatement* findActive(const void* statement);
+
+    // 原始SQL对应的汇总项
+    QueryStats& statsFor(std::string_view sql);
+};
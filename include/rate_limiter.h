@@ -0,0 +1,105 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
+#include <array>
+#include <memory>
+#include "http.h"
+
+// 限流范围
+enum class RateLimitScope {
+    Route,   // 路由级：所有客户端共享一个令牌桶
+    Client   // 客户端级：每个客户端IP一个令牌桶
+};
+
+// 限流配置
+struct RateLimitConfig {
+    double requestsPerSecond = 10.0;           // 令牌补充速率
+    double burst = 20.0;                       // 令牌桶容量
+    RateLimitScope scope = RateLimitScope::Client;
+    std::chrono::seconds idleTimeout{60};      // 令牌桶装满后保留的时间
+};
+
+// 令牌桶限流器
+// 每个令牌桶只有一个原子变量（GCRA算法记录的理论到达时间），检查只需一次CAS；
+// 客户端级令牌桶按IP哈希分片存放，读锁下查找，空闲的令牌桶定期清理
+class RateLimiter {
+public:
+    explicit RateLimiter(const RateLimitConfig& config);
+
+    // 消耗一个令牌，被拒绝时返回false并给出需要等待的时间
+    bool tryAcquire(std::string_view clientKey, std::chrono::nanoseconds& retryAfter);
+
+    // 修改速率和容量，已有令牌桶保留各自的状态，立即按新参数检查
+    void reconfigure(double requestsPerSecond, double burst);
+
+    // 当前令牌桶数量
+    size_t bucketCount() const;
+
+    RateLimitConfig config() const;
+
+private:
+    struct Bucket {
+        std::atomic<long long> arrivalTime{0};   // 理论到达时间（纳秒）
+    };
+
+    // 支持用string_view查找，避免为每个请求构造字符串
+    struct KeyHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view key) const { return std::hash<std::string_view>()(key); }
+    };
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, Bucket, KeyHash, std::equal_to<>> buckets;
+    };
+
+    static const size_t kShardCount = 64;
+
+    RateLimitConfig config_;                 // 范围和空闲时间创建后不变
+    std::atomic<double> requestsPerSecond_;
+    std::atomic<double> burst_;
+    std::atomic<long long> interval_;        // 每个令牌的间隔（纳秒）
+    std::atomic<long long> tolerance_;       // 允许的突发量（纳秒）
+    long long idleNanos_;
+    Bucket routeBucket_;
+    std::array<Shard, kShardCount> shards_;
+    std::atomic<unsigned long long> checks_;
+
+    // 在令牌桶上尝试消耗一个令牌
+    bool acquire(Bucket& bucket, long long now, std::chrono::nanoseconds& retryAfter);
+
+    // 清理一个分片中的空闲令牌桶
+    void evictIdle(Shard& shard, long long now);
+
+    static long long nowNanos();
+};
+
+// 限流中间件：路由设置了限流器时消耗一个令牌，超出限制时返回429
+struct RateLimit {
+    template<typename Context, typename Next>
+    void operator()(Context& context, Next&& next) const {
+        std::chrono::nanoseconds retryAfter(0);
+        if (!context.route || !context.route->rateLimiter ||
+            context.route->rateLimiter->tryAcquire(context.request.clientIp, retryAfter)) {
+            next();
+            return;
+        }
+
+        // Retry-After以秒为单位，向上取整
+        long long seconds = (retryAfter.count() + 999999999LL) / 1000000000LL;
+
+        HttpResponse response;
+        response.status(429)
+                .header("Retry-After", std::to_string(seconds))
+                .json("{\"error\": \"Too Many Requests\"}");
+        // Retry-After不在浏览器默认可读的响应头中
+        if (context.cors) {
+            response.header("Access-Control-Expose-Headers", "Retry-After");
+        }
+        context.respond(response);
+    }
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// 路由计数的一次读取：请求数、4xx和5xx响应数以及延迟的对数直方图（微秒）
+struct RouteMetricsSnapshot {
+    static const int kSubBuckets = 8;          // 每个2的幂分为8个桶，分位数的相对误差约6%
+    static const int kBuckets = 34 * kSubBuckets;   // 最大约2^37微秒，超出的值计入最后一个桶
+
+    uint64_t hits = 0;
+    uint64_t clientErrors = 0;
+    uint64_t serverErrors = 0;
+    uint64_t totalUs = 0;
+    std::array<uint64_t, kBuckets> buckets{};
+
+    // q取0到1，没有请求时返回0
+    double quantile(double q) const;
+
+    // 从earlier到这次读取之间的增量，用于按时间区间统计
+    RouteMetricsSnapshot since(const RouteMetricsSnapshot& earlier) const;
+
+    static int bucketFor(uint64_t us);
+    static double valueFor(int bucket);         // 桶的中点
+};
+
+// 一条路由（或未匹配的请求）的实时计数
+// 请求路径上只对本线程所在的分片做relaxed原子加法：不加锁，分片按缓存行对齐，不同线程之间没有伪共享。
+// 读取只做原子加载，控制台每秒读取一次也不会和请求竞争；各计数器之间不是同一时刻的快照，相差几个请求
+class RouteMetrics {
+public:
+    static const size_t kShards = 8;
+
+    void record(int statusCode, uint64_t latencyUs);
+
+    // 合并所有分片
+    RouteMetricsSnapshot snapshot() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> clientErrors{0};
+        std::atomic<uint64_t> serverErrors{0};
+        std::atomic<uint64_t> totalUs{0};
+        std::array<std::atomic<uint64_t>, RouteMetricsSnapshot::kBuckets> buckets{};
+    };
+
+    std::array<Shard, kShards> shards_;
+
+    // 当前线程使用的分片，线程第一次记录时轮流分配
+    static size_t shardIndex();
+};
@@ -1,22 +1,61 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <functional>
 #include <vector>
-#include <regex>
 #include <map>
-#include "server.h"
+#include <memory>
+#include <cstdint>
+#include "async.h"
+#include "http.h"
+#include "rate_limiter.h"
+#include "route_metrics.h"
+#include "coalescer.h"
+
+// 路由声明的参数
+struct RouteParam {
+    std::string name;
+    ParamType type = ParamType::String;
+};
+
+// 路径中以'/'分隔的一段：整段字面量，或字面前缀加一个参数
+struct RouteSegment {
+    std::string literal;
+    int param = -1;                          // params中的下标，-1表示整段都是字面量
+};
 
 // 路由结构
+// 方法为 "*" 时匹配任意方法。
+// 路径模式如 /api/users/:id<int>，'?'之后可以声明查询参数的类型，如 /api/users?limit<int>&after<int>；
+// 查询参数都是可选的，提供了但无法按声明的类型解析时返回400
 struct Route {
     std::string method;
-    std::string path;
-    std::string pattern;
-    std::regex pathRegex;
-    std::vector<std::string> paramNames;
+    std::string path;                        // 注册时的完整模式
+    std::vector<RouteSegment> segments;
+    std::vector<RouteParam> params;          // 路径参数
+    std::vector<RouteParam> queryParams;     // 声明的查询参数
+    bool valid = true;                       // 模式无效时不参与匹配
     std::function<void(const HttpRequest&, HttpResponse&)> handler;
+    AsyncHandler asyncHandler;
+    std::shared_ptr<RateLimiter> rateLimiter;   // 可选，调用处理器之前检查
+    uint64_t requiredScopes = 0;             // 非0时需要API密钥，密钥必须具有其中的全部作用域（见 ApiScope）
+    std::shared_ptr<RequestCoalescer> coalescer;    // 可选，合并键相同的并发请求
+    bool streaming = false;                  // 不缓冲请求体，处理器通过 request.stream 读取请求体和发送响应
+    size_t maxBodySize = 0;                  // 流式路由的请求体上限，0表示不限制
+    bool prefix = false;                     // 前缀路由：路径的前几段与模式相符即匹配，如 /svc 匹配 /svc 和 /svc/a/b
+    std::string websocketChannel;            // 非空时为WebSocket端点，升级后的连接订阅这个频道
+    std::shared_ptr<RouteMetrics> metrics;   // 命中数、错误数和延迟，每个请求结束时记录
     
     Route(const std::string& method, const std::string& path, 
           std::function<void(const HttpRequest&, HttpResponse&)> handler);
+    Route(const std::string& method, const std::string& path, AsyncHandler asyncHandler);
+    
+    // 是否为协程处理器
+    bool isAsync() const { return static_cast<bool>(asyncHandler); }
+    
+private:
+    // 把路径模式拆分为段和参数声明
+    void compilePattern();
 };
 
 // 路由器类
@@ -29,9 +68,34 @@ public:
     void addRoute(const std::string& method, const std::string& path, 
                   std::function<void(const HttpRequest&, HttpResponse&)> handler);
     
-    // 路由匹配
-    bool route(const std::string& method, const std::string& path, 
-               HttpRequest& request, HttpResponse& response);
+    // 添加协程路由
+    void addRoute(const std::string& method, const std::string& path, AsyncHandler handler);
+    
+    // 路由匹配，成功时提取路径参数并返回路由，否则返回nullptr；path必须是request.path，参数按在其中的位置保存
+    // 路径结构相符但参数类型不符、且没有其他路由匹配时，invalidParam设为该参数名，调用方应返回400
+    const Route* match(const std::string& method, const std::string& path, HttpRequest& request,
+                       std::string* invalidParam = nullptr);
+    
+    // 为已注册的路由设置限流器，路由不存在时返回false
+    bool setRateLimiter(const std::string& method, const std::string& path, std::shared_ptr<RateLimiter> limiter);
+    
+    // 为已注册的路由要求API密钥，路由不存在时返回false
+    bool setRequiredScopes(const std::string& method, const std::string& path, uint64_t scopes);
+    
+    // 为已注册的GET路由启用请求合并，路由不存在、是流式路由或WebSocket端点时返回false
+    bool setCoalescer(const std::string& path, std::shared_ptr<RequestCoalescer> coalescer);
+    
+    // 把已注册的协程路由设为流式路由，maxBodySize为请求体上限（0表示不限制）；路由不存在或不是协程处理器时返回false
+    bool setStreaming(const std::string& method, const std::string& path, size_t maxBodySize = 0);
+    
+    // 把已注册的路由设为前缀路由，路由不存在时返回false
+    bool setPrefix(const std::string& method, const std::string& path);
+    
+    // 把已注册的GET路由设为WebSocket端点，路由不存在时返回false
+    bool setWebSocket(const std::string& path, const std::string& channel);
+    
+    // 调用同步处理器，处理器抛出的异常转换为500响应
+    void invoke(const Route& route, HttpRequest& request, HttpResponse& response);
     
     // 获取所有路由
     const std::vector<Route>& getRoutes() const { return routes_; }
@@ -39,13 +103,8 @@ public:
 private:
     std::vector<Route> routes_;
     
-    // 将路径转换为正则表达式
-    std::string pathToRegex(const std::string& path, std::vector<std::string>& paramNames);
-    
-    // 提取路径参数
-    bool extractParams(const std::string& path, const Route& route, 
-                      std::map<std::string, std::string>& params);
-    
-    // 匹配路径
-    bool matchPath(const std::string& path, const Route& route);
+    // 按段匹配路径并校验参数类型，类型不符时invalidParam设为参数名
+    // 匹配成功时把路径参数的位置和解析后的值保存到request.routeParams，不再重新解析
+    bool matchPath(std::string_view path, const Route& route, HttpRequest& request,
+                   std::string& invalidParam) const;
 };
@@ -0,0 +1,121 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include <typeindex>
+#include <atomic>
+#include <array>
+#include <cstdint>
+
+// 行缓存的统计
+struct RowCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;          // 超出容量被淘汰
+    uint64_t invalidations = 0;      // 因行变更被删除
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t capacity = 0;
+};
+
+// 按 (表名, rowid) 缓存的只读行对象
+// 分为多个分片，每个分片一把锁和一条LRU链表，可以在任何线程上读取；
+// 失效由 Database 的 update_hook 在写连接上触发，因此填充只能在数据库执行器上进行（见 Database::rowCache）。
+// 容量按字节计算，各分片平分，超出时淘汰最久未使用的行；容量为0时不缓存
+class RowCache {
+public:
+    explicit RowCache(size_t capacityBytes);
+
+    RowCache(const RowCache&) = delete;
+    RowCache& operator=(const RowCache&) = delete;
+
+    // 查找缓存的行，类型与放入时不同视为未命中
+    template<typename T>
+    std::shared_ptr<const T> get(std::string_view table, long long rowid) {
+        auto value = find(table, rowid, std::type_index(typeid(T)));
+        return std::static_pointer_cast<const T>(value);
+    }
+
+    // 放入或替换一行，bytes为值占用内存的估计
+    template<typename T>
+    void put(std::string_view table, long long rowid, std::shared_ptr<const T> value, size_t bytes) {
+        store(table, rowid, std::type_index(typeid(T)), std::move(value), bytes);
+    }
+
+    // 删除一行
+    void invalidate(std::string_view table, long long rowid);
+
+    // 删除所有行
+    void clear();
+
+    // 调整容量，缩小时立即淘汰
+    void setCapacity(size_t capacityBytes);
+
+    size_t capacity() const { return capacity_.load(std::memory_order_relaxed); }
+
+    RowCacheStats stats() const;
+
+private:
+    static const size_t kShards = 16;
+    static const size_t kEntryOverhead = 96;     // 键、链表和哈希表节点的估计开销
+
+    struct Key {
+        std::string table;
+        long long rowid;
+    };
+
+    struct KeyView {
+        std::string_view table;
+        long long rowid;
+    };
+
+    // 支持用 KeyView 查找，不为表名分配内存
+    struct KeyHash {
+        using is_transparent = void;
+        size_t operator()(const KeyView& key) const;
+        size_t operator()(const Key& key) const { return (*this)(KeyView{key.table, key.rowid}); }
+    };
+
+    struct KeyEqual {
+        using is_transparent = void;
+        bool operator()(const KeyView& a, const KeyView& b) const { return a.rowid == b.rowid && a.table == b.table; }
+        bool operator()(const Key& a, const KeyView& b) const { return (*this)(KeyView{a.table, a.rowid}, b); }
+        bool operator()(const KeyView& a, const Key& b) const { return (*this)(a, KeyView{b.table, b.rowid}); }
+        bool operator()(const Key& a, const Key& b) const { return (*this)(KeyView{a.table, a.rowid}, KeyView{b.table, b.rowid}); }
+    };
+
+    struct Entry {
+        Key key;
+        std::type_index type;
+        std::shared_ptr<const void> value;
+        size_t bytes;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        EntryList lru;                                   // 表头为最近使用
+        std::unordered_map<Key, EntryList::iterator, KeyHash, KeyEqual> index;
+        size_t bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t invalidations = 0;
+    };
+
+    std::array<Shard, kShards> shards_;
+    std::atomic<size_t> capacity_;
+
+    Shard& shardFor(const KeyView& key);
+
+    std::shared_ptr<const void> find(std::string_view table, long long rowid, std::type_index type);
+    void store(std::string_view table, long long rowid, std::type_index type,
+               std::shared_ptr<const void> value, size_t bytes);
+
+    // 淘汰到分片容量以内，调用时持有分片的锁
+    void evict(Shard& shard, size_t limit);
+};
@@ -4,60 +4,61 @@
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <type_traits>
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include "router.h"
 #include "database.h"
+#include "connection.h"
+#include "io_backend.h"
+#include "thread_pool.h"
+#include "async.h"
+#include "http.h"
+#include "http_stream.h"
+#include "http2.h"
+#include "websocket.h"
+#include "middleware.h"
+#include "api_log.h"
+#include "tracing.h"
+#include "proxy.h"
+#include "api_keys.h"
 
 // 前向声明
 class Router;
 class Database;
 
-// HTTP请求结构
-struct HttpRequest {
-    std::string method;
-    std::string path;
-    std::string query;
-    std::string body;
-    std::map<std::string, std::string> headers;
-    std::map<std::string, std::string> params;
-    
-    // 获取查询参数
-    std::string getQueryParam(const std::string& key) const;
-    
-    // 获取头部信息
-    std::string getHeader(const std::string& key) const;
-    
-    // 获取路径参数
-    std::string getParam(const std::string& key) const;
+// 服务器负载的一次读取，不加锁；繁忙时间为累计值，两次读取之差除以间隔得到利用率
+struct ServerLoad {
+    int activeConnections = 0;
+    size_t workerThreads = 0;
+    size_t workerQueue = 0;             // 等待工作线程的任务
+    size_t databaseQueue = 0;           // 等待数据库执行器的任务
+    uint64_t workerBusyNs = 0;
+    uint64_t databaseBusyNs = 0;
 };
 
-// HTTP响应结构
-struct HttpResponse {
-    int statusCode;
-    std::map<std::string, std::string> headers;
-    std::string body;
-    
-    HttpResponse();
-    
-    // 设置状态码
-    HttpResponse& status(int code);
-    
-    // 设置头部
-    HttpResponse& header(const std::string& key, const std::string& value);
-    
-    // 设置JSON响应
-    HttpResponse& json(const std::string& jsonData);
-    
-    // 设置文本响应
-    HttpResponse& text(const std::string& text);
+class ApiServer;
+
+// 一个请求在分派链中的上下文，中间件通过它读取请求，或者直接给出响应结束请求
+struct DispatchContext {
+    ApiServer& server;
+    const ConnectionPtr& conn;
+    const HttpRequest& request;
+    const Route* route;             // 为空表示没有匹配的路由
+    bool keepAlive;
+    uint32_t streamId;
+    const Cors* cors;               // 没有启用CORS时为空
+    const ApiKeyIndex& apiKeys;
     
-    // 转换为HTTP响应字符串
-    std::string toString() const;
+    // 添加CORS头部并发送响应，不再进入下一层
+    void respond(HttpResponse& response);
 };
 
 // API服务器类
-class ApiServer {
+class ApiServer : public ConnectionHandler {
 public:
     ApiServer(const std::string& host = "127.0.0.1", int port = 8080);
     ~ApiServer();
@@ -74,17 +75,176 @@ public:
     void put(const std::string& path, std::function<void(const HttpRequest&, HttpResponse&)> handler);
     void del(const std::string& path, std::function<void(const HttpRequest&, HttpResponse&)> handler);
     
+    // 协程路由注册，处理器在事件循环线程上执行，遇到co_await时让出线程
+    template<typename Handler>
+        requires std::is_same_v<std::invoke_result_t<Handler&, const HttpRequest&, HttpResponse&>, Task>
+    void get(const std::string& path, Handler handler) { router_->addRoute("GET", path, AsyncHandler(std::move(handler))); }
+    
+    template<typename Handler>
+        requires std::is_same_v<std::invoke_result_t<Handler&, const HttpRequest&, HttpResponse&>, Task>
+    void post(const std::string& path, Handler handler) { router_->addRoute("POST", path, AsyncHandler(std::move(handler))); }
+    
+    template<typename Handler>
+        requires std::is_same_v<std::invoke_result_t<Handler&, const HttpRequest&, HttpResponse&>, Task>
+    void put(const std::string& path, Handler handler) { router_->addRoute("PUT", path, AsyncHandler(std::move(handler))); }
+    
+    template<typename Handler>
+        requires std::is_same_v<std::invoke_result_t<Handler&, const HttpRequest&, HttpResponse&>, Task>
+    void del(const std::string& path, Handler handler) { router_->addRoute("DELETE", path, AsyncHandler(std::move(handler))); }
+    
+    // 启用全局CORS：应答所有预检请求，并为所有响应添加允许的源，需在start()之前调用
+    void setCors(const CorsConfig& config);
+    
+    // 为已注册的路由添加限流，超出限制时在调用处理器之前返回429
+    std::shared_ptr<RateLimiter> rateLimit(const std::string& method, const std::string& path, const RateLimitConfig& config);
+    
+    // 多个路由共享同一个限流器
+    bool rateLimit(const std::string& method, const std::string& path, std::shared_ptr<RateLimiter> limiter);
+    
+    // 要求已注册的路由带有API密钥（Authorization: Bearer 或 X-API-Key），密钥必须具有scopes中的全部作用域；
+    // 在限流和处理器之前检查，失败时返回401或403。WebSocket端点在升级之前检查。路由不存在时返回false
+    bool requireApiKey(const std::string& method, const std::string& path, uint64_t scopes);
+    
+    // 为已注册的GET路由启用请求合并：键（路径、查询字符串和headers中列出的请求头）相同的并发请求只执行一次处理器，
+    // 响应复制给同时在等待的所有请求。响应随请求头（如Authorization、Accept）变化时必须列在headers中；
+    // 启用CORS时Origin自动参与计算键。需在start()之前调用，路由不存在或是流式路由时返回false
+    bool coalesce(const std::string& path, std::vector<std::string> headers = {});
+    
+    // 把已注册的协程路由设为流式路由：请求体不缓冲，处理器通过 req.stream 边收边处理，
+    // 也可以用它分块发送响应（见 HttpStream）。请求体不受 setMaxBodySize 限制，maxBodySize 为这条路由自己的上限，
+    // 0表示不限制；Content-Length超过上限的请求在分派之前返回413
+    bool enableStreaming(const std::string& method, const std::string& path, size_t maxBodySize = 0);
+    
+    // 注册WebSocket端点：GET path 上的升级请求成为频道的订阅者，没有升级的请求返回426
+    // 端点只推送消息，客户端发来的数据消息被丢弃；启用CORS时握手的Origin必须在允许的源之中
+    void websocket(const std::string& path, const std::string& channel);
+    
+    // 向频道的所有订阅者广播一条文本消息，可以在任何线程上调用；没有订阅者时什么也不做
+    void publish(const std::string& channel, std::string message);
+    
+    // 把访问日志实时推送到频道：每个请求一条 {"type": "log", ...}，每秒一条 {"type": "metrics", ...}
+    // 只在频道有订阅者时序列化，需在start()之前调用
+    void setLiveChannel(const std::string& channel) { liveChannel_ = channel; }
+    
+    // 反向代理：prefix 下任意方法的请求转发到上游（见 ReverseProxy），需在start()之前调用；配置无效时返回false
+    // 与其他路由一样按注册顺序匹配，前缀下需要本地处理的路由应先注册
+    bool proxy(const ProxyConfig& config);
+    
+    // 已注册的反向代理
+    const std::vector<std::shared_ptr<ReverseProxy>>& getProxies() const { return proxies_; }
+    
+    // 设置代理线程数量，即同时与上游读写的请求数上限，运行中调用时立即调整线程池
+    void setProxyThreads(size_t count);
+    
+    // 在数据库执行器上运行 work(Database&)，供协程处理器 co_await
+    template<typename Work>
+    auto onDatabase(Work work) {
+        using Result = std::invoke_result_t<Work&, Database&>;
+        Database* database = database_.get();
+        return ExecutorAwaiter<Result>(*dbExecutor_, *backend_,
+            [work = std::move(work), database]() mutable -> Result { return work(*database); }, "database");
+    }
+    
+    // 在工作线程池上运行 work()，用于阻塞的外部调用
+    template<typename Work>
+    auto offload(Work work) {
+        using Result = std::invoke_result_t<Work&>;
+        return ExecutorAwaiter<Result>(*workers_, *backend_, std::move(work), "offload");
+    }
+    
+    // 在事件循环上等待指定时间
+    SleepAwaiter sleepFor(std::chrono::milliseconds delay) { return SleepAwaiter(*backend_, delay); }
+    
+    // 选择I/O后端，需在start()之前调用；不可用时自动回退到poll
+    void setIoBackend(IoBackendType type) { backendType_ = type; }
+    
+    // 设置处理请求的工作线程数量，运行中调用时立即调整线程池
+    void setWorkerThreads(size_t count);
+    
+    // 设置最大连接数，超出时新连接收到503后关闭；0表示不限制，可以在运行中调用
+    void setMaxConnections(int count) { maxConnections_ = count; }
+    
+    // 设置非流式请求的请求体上限（字节），Content-Length超过上限的请求在接收请求体之前返回413；
+    // 可以在运行中调用，已建立的HTTP/2连接保留原来的上限
+    void setMaxBodySize(size_t bytes) { maxBodySize_ = bytes; }
+    
+    // 设置连接超时，0表示不限制，可以在运行中调用
+    //   idle   - 保持连接的空闲时间，以及接收请求体时两次数据之间的最长间隔
+    //   header - 从连接建立或请求的第一个字节开始，读完请求头的期限
+    //   write  - 待发送的响应在这段时间内没有任何进展时关闭连接
+    void setTimeouts(std::chrono::seconds idle, std::chrono::seconds header, std::chrono::seconds write);
+    
+    // 设置数据库文件路径，需在start()之前调用
+    void setDatabasePath(const std::string& path) { database_ = std::make_unique<Database>(path); }
+    
     // 获取数据库实例
     Database* getDatabase() const { return database_.get(); }
     
+    // 访问日志，每个请求一条，由数据库执行器批量写入并维护汇总表
+    ApiLogWriter& getApiLog() { return *apiLog_; }
+    
+    // API密钥索引，start()连接数据库后加载；之后在数据库执行器上提交的写入自动刷新
+    ApiKeyIndex& getApiKeys() { return *apiKeys_; }
+    
+    // 当前活动连接数
+    int getActiveConnections() const { return activeConnections_; }
+    
+    // 已注册的路由，每条路由带有实时计数；只在start()之前注册，之后可以在任何线程上读取
+    const Router& getRouter() const { return *router_; }
+    
+    // 没有匹配任何路由的请求（404、CORS预检等）的计数
+    const RouteMetrics& getUnmatchedMetrics() const { return unmatchedMetrics_; }
+    
+    // 连接数、线程池队列和繁忙时间
+    ServerLoad getLoad() const;
+    
+    // 当前使用的I/O后端名称
+    const char* getIoBackendName() const { return backend_ ? backend_->name() : "none"; }
+    
+    // ConnectionHandler 接口
+    void onOpen(const ConnectionPtr& conn) override;
+    void onData(const ConnectionPtr& conn) override;
+    void onSent(const ConnectionPtr& conn) override;
+    void onClose(const ConnectionPtr& conn) override;
+    
 private:
+    friend struct DispatchContext;
+    
     std::string host_;
     int port_;
     std::atomic<bool> running_;
     std::unique_ptr<Router> router_;
     std::unique_ptr<Database> database_;
-    std::thread serverThread_;
     SOCKET serverSocket_;
+    IoBackendType backendType_;
+    std::atomic<size_t> workerThreads_;
+    std::atomic<int> maxConnections_;
+    std::atomic<long long> idleTimeoutMs_;
+    std::atomic<long long> headerTimeoutMs_;
+    std::atomic<long long> writeTimeoutMs_;
+    std::atomic<size_t> maxBodySize_;
+    std::unique_ptr<IoBackend> backend_;
+    std::unique_ptr<ThreadPool> workers_;
+    std::unique_ptr<ThreadPool> dbExecutor_;
+    std::unique_ptr<ThreadPool> proxyPool_;             // 有反向代理时创建
+    std::atomic<size_t> proxyThreads_;
+    std::vector<std::shared_ptr<ReverseProxy>> proxies_;
+    std::atomic<int> activeConnections_;
+    std::unique_ptr<Cors> cors_;
+    std::unique_ptr<ApiLogWriter> apiLog_;
+    std::unique_ptr<ApiKeyIndex> apiKeys_;
+    std::unique_ptr<WebSocketHub> hub_;
+    std::string liveChannel_;
+    RouteMetrics unmatchedMetrics_;
+    
+    // 每个请求在分派给处理器之前经过的中间件，按顺序执行
+    MiddlewareChain<CorsPreflight, RequireApiKey, RateLimit> chain_{CorsPreflight(), RequireApiKey(), RateLimit()};
+    
+    // 实时指标：上一次推送以来的请求数、5xx响应数和延迟分布，只在有订阅者时累计
+    std::mutex liveMutex_;
+    uint64_t liveRequests_ = 0;
+    uint64_t liveErrors_ = 0;
+    LatencySketch liveLatency_;
     
     // 初始化Winsock
     bool initializeWinsock();
@@ -95,21 +255,98 @@ private:
     // 创建服务器socket
     bool createSocket();
     
-    // 服务器主循环
-    void serverLoop();
+    // 创建I/O后端，首选后端不可用时回退到poll
+    bool createBackend();
+    
+    // 分派请求：先经过中间件链，再交给dispatchHandler
+    // route和invalidParam为路由匹配的结果；streamId为HTTP/2的流，0表示HTTP/1.1
+    void dispatchRequest(const ConnectionPtr& conn, HttpRequest request, const Route* route,
+                         const std::string& invalidParam, bool keepAlive, uint32_t streamId);
+    
+    // 中间件放行之后：合并相同的请求，同步处理器交给工作线程，协程处理器直接启动
+    void dispatchHandler(const ConnectionPtr& conn, HttpRequest request, const Route* route, bool keepAlive,
+                         uint32_t streamId);
+    
+    // 启动协程处理器；coalesceKey非空时为合并请求的领头请求
+    void dispatchAsync(const ConnectionPtr& conn, const Route& route, HttpRequest request, bool keepAlive,
+                       uint32_t streamId, std::string coalesceKey);
+    
+    // 同一个键的领头请求在执行，登记为等待者，领头请求完成时收到同一个响应
+    void waitCoalesced(const ConnectionPtr& conn, const Route& route, const std::string& key, HttpRequest request,
+                       bool keepAlive, uint32_t streamId);
+    
+    // 领头请求完成：把响应交给所有等待者，再发送领头请求自己的响应（仅限事件循环线程）
+    void finishCoalesced(const ConnectionPtr& conn, const HttpRequest& request, const Route* route,
+                         HttpResponse& response, bool keepAlive, uint32_t streamId, const std::string& key);
+    
+    // 解析并分派一个完整的请求，数据不完整时返回false；流式路由读完请求头即分派
+    // 遇到HTTP/2前言或h2c升级时把连接切换到HTTP/2
+    bool processRequest(const ConnectionPtr& conn);
     
-    // 处理客户端连接
-    void handleClient(SOCKET clientSocket);
+    // 把请求的第一个字节到路由匹配之间的阶段记入追踪，traceId为0时只重置连接的计时
+    void beginTrace(const ConnectionPtr& conn, HttpRequest& request, uint64_t traceId, int64_t parseStart,
+                    int64_t routeStart, int64_t routeEnd);
     
-    // 解析HTTP请求
+    // 请求带有 Upgrade: h2c 时发送101并创建HTTP/2会话，请求本身成为流1
+    bool upgradeToHttp2(const ConnectionPtr& conn, const HttpRequest& request);
+    
+    // WebSocket端点上的升级请求：校验握手并发送101，连接订阅路由的频道
+    // 返回false表示不是升级请求，按普通请求分派；握手无效时返回错误响应并关闭连接
+    bool upgradeToWebSocket(const ConnectionPtr& conn, const HttpRequest& request, const Route& route);
+    
+    // 处理WebSocket连接收到的帧
+    void onWebSocketData(const ConnectionPtr& conn);
+    
+    // 发送WebSocket会话产生的控制帧；close为true时发送后关闭连接
+    void flushWebSocket(const ConnectionPtr& conn, bool close);
+    
+    // 每秒向实时频道推送一次指标
+    void scheduleLiveMetrics();
+    void publishLiveMetrics();
+    
+    // 处理HTTP/2连接收到的帧，分派请求体已收齐的流
+    void onHttp2Data(const ConnectionPtr& conn);
+    
+    // 分派一个HTTP/2请求
+    void dispatchHttp2(const ConnectionPtr& conn, Http2Request ready);
+    
+    // 发送HTTP/2会话产生的帧并更新连接状态；close为true时发送后关闭连接
+    void flushHttp2(const ConnectionPtr& conn, bool close);
+    
+    // 在事件循环线程上发送HTTP/2流的响应
+    void sendHttp2Response(const ConnectionPtr& conn, uint32_t streamId, HttpResponse response, uint64_t traceId = 0);
+    
+    // 根据连接当前的状态启动、顺延或取消读取超时
+    void updateReadDeadline(const ConnectionPtr& conn);
+    
+    // 启动读取超时，timeoutMs为0时取消
+    void armReadTimer(const ConnectionPtr& conn, long long timeoutMs);
+    
+    // 读取超时：空闲连接直接关闭，请求读到一半时返回408
+    void onReadTimeout(const ConnectionPtr& conn);
+    
+    // 记录访问日志，可以在任何线程上调用；route为空表示没有匹配的路由
+    void logRequest(const HttpRequest& request, const Route* route, int statusCode);
+    
+    // 记录访问日志并在事件循环线程上发送响应，HTTP/1.1序列化后交给completeRequest，HTTP/2交给会话
+    void finishRequest(const ConnectionPtr& conn, const HttpRequest& request, const Route* route,
+                       HttpResponse& response, bool keepAlive, uint32_t streamId);
+    
+    // 在事件循环线程上发送响应，并继续处理管线化的请求；traceId为被追踪的请求
+    void completeRequest(const ConnectionPtr& conn, std::string data, bool keepAlive, uint64_t traceId = 0);
+    
+    // 解析HTTP请求（请求行和头部）
     HttpRequest parseRequest(const std::string& requestData);
     
-    // 发送HTTP响应
-    bool sendResponse(SOCKET clientSocket, const HttpResponse& response);
+    // 返回错误响应并在发送后关闭连接
+    void rejectRequest(const ConnectionPtr& conn, int statusCode, const std::string& message);
+    
+    // 判断请求是否保持连接
+    bool isKeepAlive(const HttpRequest& request) const;
     
     // 解析URL
     void parseUrl(const std::string& url, std::string& path, std::string& query);
     
     // 解析查询字符串
-    std::map<std::string, std::string> parseQueryString(const std::string& query);
+    std::map<std::string, std::string, std::less<>> parseQueryString(const std::string& query);
 };
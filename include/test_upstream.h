@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <winsock2.h>
+
+// 用于测试反向代理的本地上游（命令行 --test-upstream）
+// 每条连接一个线程，阻塞读写。按请求路径的最后一段选择响应方式，查询参数调整大小和时间：
+//   chunked   分块编码，第一块带块扩展，末尾带尾部字段；?size=&chunk=&delay_ms=（块之间的间隔）
+//   close     不带长度，写完正文后关闭连接；?size=
+//   status    ?code= 指定的状态码，如 /status?code=503
+//   stall     ?ms= 毫秒后才响应；?at=body 时先发出响应头和一半正文再停顿
+//   early     最终响应之前先发出 100 Continue 和 103 Early Hints
+//   drop      读完请求后不响应，直接关闭连接
+//   stale     正常响应并保持连接，但这条连接上的下一个请求不响应直接关闭，模拟上游关闭了空闲连接
+//   其他路径  带Content-Length的JSON：上游端口、方法、路径、查询字符串、Host、X-Forwarded-For和请求体字节数
+// 正文是循环的 a-z，可以逐字节核对；所有响应带 X-Upstream: <端口>
+class TestUpstream {
+public:
+    explicit TestUpstream(int port);
+    ~TestUpstream();
+
+    TestUpstream(const TestUpstream&) = delete;
+    TestUpstream& operator=(const TestUpstream&) = delete;
+
+    // 在127.0.0.1上监听，调用前需要初始化Winsock；失败时返回false
+    bool open();
+
+    // 接受连接并为每条连接启动一个线程，直到进程结束
+    void run();
+
+    int port() const { return port_; }
+
+private:
+    struct Request {
+        std::string method;
+        std::string path;
+        std::string query;
+        std::string host;
+        std::string forwardedFor;
+        uint64_t contentLength = 0;
+        bool close = false;             // 请求带 Connection: close
+    };
+
+    int port_;
+    SOCKET listenSocket_ = INVALID_SOCKET;
+    std::atomic<uint64_t> requests_{0};
+
+    // 处理一条连接上的所有请求
+    void serve(SOCKET client);
+
+    // 读取请求头，连接关闭或请求无效时返回false；buffer中保留已读到的请求体
+    static bool readRequest(SOCKET client, std::string& buffer, Request& request);
+
+    // 读取并丢弃请求体，返回是否读完
+    static bool skipBody(SOCKET client, std::string& buffer, uint64_t length);
+
+    // 按路径选择响应并发送，返回连接能否继续使用
+    bool respond(SOCKET client, const Request& request, bool& closeNext);
+
+    // 状态行和头部，extra为额外的头部（每行以 \r\n 结尾）
+    std::string head(int status, const std::string& extra) const;
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+// 工作线程池，线程数量可以在运行时调整
+class ThreadPool {
+public:
+    // name为线程的名称，显示在导出的追踪中
+    explicit ThreadPool(size_t threadCount, std::string name = "worker");
+    ~ThreadPool();
+
+    // 提交任务；shutdown() 返回之后提交的任务在调用方的线程上直接执行
+    void submit(std::function<void()> task);
+
+    // 停止并等待所有线程退出，已提交的任务都会执行完
+    void shutdown();
+
+    // 调整线程数量：增加时立即创建线程，减少时多余的线程执行完当前任务后退出
+    void resize(size_t threadCount);
+
+    // 线程数量
+    size_t size() const;
+
+    // 等待执行的任务数量，不加锁
+    size_t queueDepth() const { return queued_.load(std::memory_order_relaxed); }
+
+    // 所有线程执行任务累计的时间（纳秒），任务结束时计入；两次读取之差除以间隔即为繁忙的线程数
+    uint64_t busyNanoseconds() const { return busyNs_.load(std::memory_order_relaxed); }
+
+private:
+    std::string name_;
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::vector<std::thread::id> retired_;   // 已退出、等待回收的线程
+    size_t targetSize_;
+    size_t activeCount_;
+    bool stopping_;
+    bool stopped_;                          // 线程都已退出
+    std::atomic<size_t> queued_{0};         // tasks_.size()，供不加锁的读取
+    std::atomic<uint64_t> busyNs_{0};
+
+    // 工作线程主循环
+    void workerLoop();
+};
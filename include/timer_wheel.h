@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <array>
+#include <cstdint>
+
+class TimerWheel;
+
+// 定时器链表节点
+struct TimerLink {
+    TimerLink* prev = this;
+    TimerLink* next = this;
+
+    TimerLink() = default;
+    TimerLink(const TimerLink&) = delete;
+    TimerLink& operator=(const TimerLink&) = delete;
+};
+
+// 可嵌入其他对象的定时器，由 TimerWheel::schedule 启动
+// 每次启动触发一次，触发前回调被取出，回调中可以重新启动或销毁定时器本身
+// 析构时自动取消；只能在所属事件循环线程上使用
+class Timer : private TimerLink {
+public:
+    Timer() = default;
+    ~Timer() { cancel(); }
+
+    // 是否已启动且尚未触发
+    bool active() const { return wheel_ != nullptr; }
+
+    // 取消定时器，未启动时什么也不做
+    void cancel();
+
+private:
+    friend class TimerWheel;
+
+    TimerWheel* wheel_ = nullptr;
+    uint64_t expires_ = 0;        // 到期的时钟刻度
+    uint16_t slot_ = 0;           // 所在的槽位
+    bool owned_ = false;          // 由时间轮分配和释放
+    std::function<void()> callback_;
+};
+
+// 分层时间轮（仅由事件循环线程访问）
+// 4层，每层64个槽位，刻度1毫秒，直接覆盖约4.6小时，更远的定时器在最高层循环等待。
+// 启动和取消都是常数时间的链表操作，只有到达某层的边界时才把该槽位的定时器降到下一层；
+// 每层用一个位图记录非空槽位，计算下一次唤醒时间不需要遍历定时器
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimerWheel();
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // 启动或重新启动定时器
+    void schedule(Timer& timer, Clock::time_point deadline, std::function<void()> callback);
+    void schedule(Timer& timer, std::chrono::milliseconds delay, std::function<void()> callback) {
+        schedule(timer, Clock::now() + delay, std::move(callback));
+    }
+
+    // 添加一次性任务，定时器由时间轮管理
+    void add(Clock::time_point deadline, std::function<void()> task);
+
+    // 取消定时器
+    void cancel(Timer& timer);
+
+    // 距离下一次需要处理的毫秒数，没有定时器时返回-1
+    // 只有远期定时器时返回的是它们降层的时刻，事件循环会被提前唤醒一次
+    int nextTimeoutMs() const;
+
+    // 执行所有已到期的定时器
+    void runExpired();
+
+    // 已启动的定时器数量
+    size_t size() const { return count_; }
+
+private:
+    static const int kLevels = 4;
+    static const int kSlotBits = 6;
+    static const uint64_t kSlots = 1 << kSlotBits;
+    static const uint64_t kSlotMask = kSlots - 1;
+
+    Clock::time_point origin_;                       // 刻度0对应的时间
+    uint64_t current_;                               // 下一个要处理的刻度
+    size_t count_;
+    std::array<TimerLink, kLevels * kSlots> slots_;
+    std::array<uint64_t, kLevels> occupied_;         // 每层非空槽位的位图
+
+    // 时间点换算为刻度，向上取整保证不会提前触发
+    uint64_t toTick(Clock::time_point time, bool roundUp) const;
+
+    // 按到期刻度放入对应的层和槽位
+    void insert(Timer& timer);
+
+    // 从所在槽位摘下
+    void unlink(Timer& timer);
+
+    // 把高层槽位中的定时器重新放入较低的层
+    void cascade(int level, uint64_t index);
+
+    // 执行第0层一个槽位中的全部定时器
+    void expireSlot(uint64_t index);
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <cstdint>
+
+// 请求的分阶段追踪
+// 按采样间隔每N个请求选中一个，给它分配非零的追踪ID；请求经过的各个阶段（接收、解析、路由、排队、处理器、
+// 数据库、序列化、发送）把单调时钟的开始和结束时间写入当前线程的环形缓冲区，只保留每个线程最近的事件。
+// 未被选中的请求追踪ID为0，每个记录点只有一次判断；关闭采样时连采样计数也不做。
+// 导出为Chrome Trace Event格式的JSON，可以在 chrome://tracing 或 ui.perfetto.dev 中打开：
+// 线程上的阶段按线程显示，跨线程或跨越协程挂起的阶段（整个请求、排队、协程处理器）显示在请求自己的轨道上
+namespace Tracing {
+    static const size_t kBufferEvents = 4096;      // 每个线程保留的事件数
+
+    // 0表示关闭采样；以下只在本模块内部使用
+    extern std::atomic<uint32_t> sampleInterval_;
+    extern thread_local uint64_t current_;
+
+    // 每interval个请求采样一个，1表示全部采样，0表示关闭（线程安全，可以在运行中调用）
+    void setSampleInterval(uint32_t interval);
+    inline uint32_t sampleInterval() { return sampleInterval_.load(std::memory_order_relaxed); }
+    inline bool enabled() { return sampleInterval() != 0; }
+
+    // 为新请求决定是否采样，返回追踪ID，未选中时返回0
+    uint64_t sampleSlow();
+    inline uint64_t sample() { return enabled() ? sampleSlow() : 0; }
+
+    // 单调时钟，进程内第一次调用以来的纳秒数
+    int64_t now();
+
+    // 记录当前线程上的一个阶段；name必须是静态字符串，detail为附加说明
+    void record(uint64_t traceId, const char* name, int64_t begin, int64_t end, std::string_view detail = {});
+
+    // 记录在请求自己的轨道上的阶段：开始和结束不在同一个线程上，或中间让出过线程
+    void recordAsync(uint64_t traceId, const char* name, int64_t begin, int64_t end, std::string_view detail = {});
+
+    // 给当前线程命名，显示在导出的轨道上；在线程第一次记录事件之前调用
+    void setThreadName(std::string name);
+
+    // 导出所有线程缓冲区中的事件
+    std::string exportJson();
+
+    // 清空所有线程缓冲区
+    void clear();
+
+    // 缓冲区中的事件总数
+    size_t eventCount();
+
+    // 当前线程正在执行的请求，协程处理器里 co_await 的数据库和卸载任务据此归属到请求
+    inline uint64_t current() { return current_; }
+
+    // 在作用域内把当前线程的请求设为traceId，离开时恢复
+    class Scope {
+    public:
+        explicit Scope(uint64_t traceId) : previous_(current_) { current_ = traceId; }
+        ~Scope() { current_ = previous_; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        uint64_t previous_;
+    };
+
+    // 在作用域内计时的阶段，traceId为0时什么也不做
+    class Span {
+    public:
+        Span(uint64_t traceId, const char* name) : traceId_(traceId), name_(name), begin_(traceId ? now() : 0) {}
+        ~Span() {
+            if (traceId_) record(traceId_, name_, begin_, now());
+        }
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        uint64_t traceId_;
+        const char* name_;
+        int64_t begin_;
+    };
+}
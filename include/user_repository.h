@@ -0,0 +1,85 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include "database.h"
+
+// 用户记录（不包含密码哈希）
+struct User {
+    long long id = 0;
+    std::string username;
+    std::string email;
+    std::string createdAt;
+    std::string updatedAt;          // 列表查询不读取，为空时不输出
+};
+
+// 批量导入的一行；id为0时自动分配，createdAt、updatedAt为空时取当前时间
+struct UserImportRow {
+    long long id = 0;
+    std::string username;
+    std::string email;
+    std::string passwordHash;       // 为空时写入不能登录的占位值
+    std::string createdAt;
+    std::string updatedAt;
+};
+
+// 写操作的结果
+enum class UserWriteResult { Ok, NotFound, Conflict, Error };
+
+// users表的访问
+// 所有语句都是参数化的，由Database按SQL文本缓存预编译结果；Database不是线程安全的，只能在数据库执行器上调用
+class UserRepository {
+public:
+    static const int kMaxPageSize = 100;
+    static const size_t kMaxBatchSize = 100;
+
+    explicit UserRepository(Database& database) : db_(database) {}
+
+    // 键集分页：返回id大于afterId的前limit个用户（按id升序），hasMore表示后面还有数据
+    // 下一页以本页最后一个id作为afterId，不使用OFFSET，翻到任何位置的代价都相同
+    bool list(long long afterId, int limit, std::vector<User>& users, bool& hasMore);
+
+    // 按id查找，先查行缓存，未命中时读取并填充；不存在或出错时返回false
+    bool find(long long id, User& user);
+    
+    // 只查行缓存，可以在任何线程上调用，未命中返回nullptr
+    static std::shared_ptr<const User> cachedUser(Database& database, long long id);
+
+    // 一条语句取出多个用户，按ids中第一次出现的顺序返回存在的用户
+    bool findMany(const std::vector<long long>& ids, std::vector<User>& users);
+
+    // 创建用户，passwordHash由调用方预先计算（见Crypto::hashPassword）
+    UserWriteResult create(const std::string& username, const std::string& email,
+                           const std::string& passwordHash, User& user);
+
+    // 更新用户，空字符串表示不修改该字段
+    UserWriteResult update(long long id, const std::string& username, const std::string& email,
+                           const std::string& passwordHash, User& user);
+
+    // 删除用户
+    UserWriteResult remove(long long id);
+
+    // 生成count个测试用户（user<N>、user<N>@example.com，不能登录），每批一个事务
+    // 返回实际插入的数量，出错时返回-1
+    long long generate(long long count);
+
+    // 在一个事务中插入rows，与已有用户冲突（id、用户名或邮箱重复）的行跳过
+    // 返回插入的行数，出错时整批回滚并返回-1
+    long long importRows(const std::vector<UserImportRow>& rows);
+
+    // 导出id大于afterId的最多limit个用户，每个用户一行JSON追加到out（NDJSON，格式与导入相同）
+    // withHash时包含password_hash，用于迁移；返回最后一个用户的id，没有更多用户时返回afterId，出错时返回-1
+    long long exportRows(long long afterId, int limit, bool withHash, std::string& out);
+
+    // 批量导入的开始和结束：导入期间加大页缓存，使唯一索引的随机插入尽量不读写磁盘
+    // deferIndex时删除列表查询的覆盖索引 idx_users_list，结束时一次排序建成，比逐行维护快；
+    // 导入中断未能重建时，下次启动由 Database::initializeTables 重建
+    bool beginBulkLoad(bool deferIndex);
+    bool endBulkLoad(bool deferIndex);
+
+    // 序列化为JSON对象
+    static std::string toJson(const User& user);
+
+private:
+    Database& db_;
+};
@@ -1,28 +1,149 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <iterator>
+#include <charconv>
+#include <type_traits>
 #include <vector>
 #include <map>
 #include <sstream>
 #include <iomanip>
 #include <chrono>
+#include <ctime>
 #include <random>
 
 namespace Utils {
     
-    // 字符串操作
+    // 按分隔符惰性切分，每次递增才查找下一个分隔符，片段指向原字符串，不分配内存
+    // 默认跳过空片段，与split一致；原字符串必须在迭代期间保持有效
+    class SplitView {
+    public:
+        class iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::string_view;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const std::string_view*;
+            using reference = const std::string_view&;
+
+            iterator() = default;
+
+            reference operator*() const { return token_; }
+            pointer operator->() const { return &token_; }
+
+            iterator& operator++() {
+                advance();
+                return *this;
+            }
+
+            iterator operator++(int) {
+                iterator previous = *this;
+                advance();
+                return previous;
+            }
+
+            bool operator==(const iterator& other) const {
+                if (done_ || other.done_) return done_ == other.done_;
+                return token_.data() == other.token_.data() && token_.size() == other.token_.size();
+            }
+
+        private:
+            friend class SplitView;
+
+            std::string_view rest_;          // 尚未切分的部分
+            std::string_view token_;         // 当前片段
+            char delimiter_ = 0;
+            bool skipEmpty_ = true;
+            bool last_ = false;              // 当前片段之后没有剩余内容
+            bool done_ = true;
+
+            iterator(std::string_view str, char delimiter, bool skipEmpty)
+                : rest_(str), delimiter_(delimiter), skipEmpty_(skipEmpty), done_(false) {
+                advance();
+            }
+
+            void advance() {
+                do {
+                    if (last_) {
+                        done_ = true;
+                        return;
+                    }
+                    size_t pos = rest_.find(delimiter_);
+                    if (pos == std::string_view::npos) {
+                        token_ = rest_;
+                        rest_ = std::string_view();
+                        last_ = true;
+                    } else {
+                        token_ = rest_.substr(0, pos);
+                        rest_.remove_prefix(pos + 1);
+                    }
+                } while (skipEmpty_ && token_.empty());
+            }
+        };
+
+        SplitView(std::string_view str, char delimiter, bool skipEmpty = true)
+            : str_(str), delimiter_(delimiter), skipEmpty_(skipEmpty) {}
+
+        iterator begin() const { return iterator(str_, delimiter_, skipEmpty_); }
+        iterator end() const { return iterator(); }
+
+    private:
+        std::string_view str_;
+        char delimiter_;
+        bool skipEmpty_;
+    };
+
+    inline SplitView splitView(std::string_view str, char delimiter, bool skipEmpty = true) {
+        return SplitView(str, delimiter, skipEmpty);
+    }
+
+    // 去除首尾空白，返回原字符串的一部分
+    std::string_view trimView(std::string_view str);
+
+    // 只处理ASCII字母的大小写转换，不查询locale，其他字节原样保留
+    constexpr char asciiToLower(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    constexpr char asciiToUpper(char c) {
+        return (c >= 'a' && c <= 'z') ? static_cast<char>(c - ('a' - 'A')) : c;
+    }
+
+    void toLowerInPlace(std::string& str);
+    void toUpperInPlace(std::string& str);
+
+    // 忽略ASCII大小写比较，用于HTTP头部名称和标记值
+    bool equalsIgnoreCase(std::string_view a, std::string_view b);
+
+    // 字符串操作（返回新字符串的版本，内部调用上面的实现）
     std::vector<std::string> split(const std::string& str, char delimiter);
     std::string trim(const std::string& str);
     std::string toLower(const std::string& str);
     std::string toUpper(const std::string& str);
-    bool startsWith(const std::string& str, const std::string& prefix);
-    bool endsWith(const std::string& str, const std::string& suffix);
+    bool startsWith(std::string_view str, std::string_view prefix);
+    bool endsWith(std::string_view str, std::string_view suffix);
     
     // URL处理
+    // 解码结果追加到out；无效的%转义原样保留，'+'解码为空格
+    void urlDecode(std::string_view str, std::string& out);
+    
+    // 原地解码，解码后的长度不会超过原长度
+    void urlDecodeInPlace(std::string& str);
+    
     std::string urlDecode(const std::string& str);
     std::string urlEncode(const std::string& str);
     
+    // Base64解码，结果追加到out；同时接受标准字母表和URL安全字母表（-_），末尾的=可以省略
+    bool base64Decode(std::string_view str, std::string& out);
+    
+    // 标准字母表的Base64编码，带=填充
+    std::string base64Encode(std::string_view data);
+    
     // JSON处理
     std::string escapeJsonString(const std::string& str);
+    
+    // 转义结果追加到out，不分配临时字符串
+    void appendJsonEscaped(std::string_view str, std::string& out);
     std::string createJsonObject(const std::map<std::string, std::string>& data);
     std::string createJsonArray(const std::vector<std::string>& data);
     
@@ -31,6 +152,10 @@ namespace Utils {
     std::string formatTimestamp(long long timestamp);
     long long getCurrentTimeMillis();
     
+    // 线程安全的时间分解，seconds为自1970年以来的秒数
+    bool localTime(long long seconds, std::tm& result);
+    bool utcTime(long long seconds, std::tm& result);
+    
     // 随机数生成
     std::string generateUUID();
     int randomInt(int min, int max);
@@ -55,12 +180,21 @@ namespace Utils {
         return oss.str();
     }
     
+    // 数值类型用from_chars解析（忽略首尾空白），解析失败时返回0
     template<typename T>
     T fromString(const std::string& str) {
-        std::istringstream iss(str);
-        T value;
-        iss >> value;
-        return value;
+        if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) {
+            std::string_view text = trimView(str);
+            if (!text.empty() && text.front() == '+') text.remove_prefix(1);
+            T value{};
+            auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+            return result.ec == std::errc() ? value : T{};
+        } else {
+            std::istringstream iss(str);
+            T value;
+            iss >> value;
+            return value;
+        }
     }
     
     // 特殊化字符串转换
@@ -0,0 +1,122 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "connection.h"
+#include "io_backend.h"
+
+// WebSocket操作码（RFC 6455 5.2）
+enum class WebSocketOpcode : uint8_t {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA
+};
+
+// 关闭状态码（RFC 6455 7.4.1）
+enum class WebSocketCloseCode : uint16_t {
+    Normal = 1000,
+    GoingAway = 1001,
+    ProtocolError = 1002,
+    InvalidPayload = 1007,
+    PolicyViolation = 1008,
+    MessageTooBig = 1009
+};
+
+namespace WebSocket {
+    // 握手响应的 Sec-WebSocket-Accept：base64(SHA-1(key + GUID))，失败时返回空字符串
+    std::string acceptKey(std::string_view key);
+
+    // 用4字节的掩码键异或data（加掩码和去掩码相同），phase为data在负载中的起始位置
+    // x64上用SSE2每次处理16字节，编译时启用AVX2则每次32字节，其他平台按8字节的字处理
+    void applyMask(char* data, size_t length, const uint8_t key[4], size_t phase = 0);
+
+    // 追加一个服务器发出的帧：FIN置位，不加掩码
+    void appendFrame(WebSocketOpcode opcode, std::string_view payload, std::string& out);
+
+    // 文本消息和关闭原因必须是有效的UTF-8
+    bool isValidUtf8(std::string_view text);
+}
+
+// 一个WebSocket连接的协议状态，只在事件循环线程上使用
+// 与Http2Session一样只处理字节：receive() 解析客户端的帧，需要回复的控制帧追加到输出缓冲区，由服务器取出发送。
+// 端点是只推送的广播频道，客户端的数据消息按协议检查后丢弃；ping自动回复pong
+class WebSocketSession {
+public:
+    static const size_t kMaxMessageSize = 64 * 1024;    // 客户端消息（分片合并后）的上限
+
+    explicit WebSocketSession(std::string channel) : channel_(std::move(channel)) {}
+
+    // 处理inBuffer中完整的帧并移除
+    // 返回false表示发送输出后应关闭连接：协议错误（对应的关闭帧已写入输出），或关闭握手已完成
+    bool receive(std::string& inBuffer);
+
+    // 发起关闭握手，之后不再发送数据帧
+    void close(WebSocketCloseCode code, std::string_view reason = {});
+
+    // 空闲检测：写出一个ping；上一个ping之后没有收到任何帧时返回false，连接已失效
+    bool ping();
+
+    // 取出待发送的帧
+    std::string takeOutput();
+
+    const std::string& channel() const { return channel_; }
+
+    // 已发出关闭帧，不应再广播数据
+    bool closing() const { return closeSent_; }
+
+private:
+    std::string channel_;
+    std::string output_;
+    std::string message_;                   // 正在接收的分片消息
+    bool fragmented_ = false;               // 收到了FIN未置位的数据帧
+    bool text_ = false;                     // 正在接收的消息是文本
+    bool closeSent_ = false;
+    bool pingOutstanding_ = false;
+
+    // 处理一个完整的帧，payload已去掩码
+    bool onFrame(bool fin, uint8_t opcode, std::string_view payload);
+    bool onClose(std::string_view payload);
+
+    // 写出关闭帧并返回false
+    bool fail(WebSocketCloseCode code);
+};
+
+// 广播频道
+// publish() 可以在任何线程上调用，消息先进入队列；事件循环线程上的 flush() 把每个频道积压的消息编码成帧，
+// 拼接到一个共享缓冲区，所有订阅者引用同一个缓冲区发送，每条消息只序列化一次，不为订阅者复制。
+// 发送积压超过 kMaxBacklog 的订阅者跟不上广播，直接关闭连接，由客户端重连
+class WebSocketHub {
+public:
+    static const size_t kMaxBacklog = 4 * 1024 * 1024;
+    static const size_t kMaxQueued = 10000;     // 两次flush之间每个频道最多排队的消息，超出的丢弃
+
+    // 追加一条文本消息，没有任何订阅者时直接丢弃；返回true表示需要在事件循环上调度一次flush()（线程安全）
+    bool publish(const std::string& channel, std::string message);
+
+    // 所有频道的订阅者总数（线程安全）
+    size_t subscriberCount() const { return subscriberCount_; }
+
+    // 以下只在事件循环线程上调用
+    void subscribe(const ConnectionPtr& conn);
+    void unsubscribe(const ConnectionPtr& conn);
+
+    // 广播排队的消息
+    void flush(IoBackend& backend);
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::vector<std::string>> queued_;
+    bool flushScheduled_ = false;
+    std::atomic<size_t> subscriberCount_{0};
+
+    // 以下只在事件循环线程上访问
+    std::unordered_map<std::string, std::vector<ConnectionPtr>> subscribers_;
+    bool broadcasting_ = false;
+};
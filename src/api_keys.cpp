@@ -0,0 +1,397 @@
+#include "api_keys.h"
+#include "crypto.h"
+#include "coarse_clock.h"
+#include "id_generator.h"
+#include "logger.h"
+#include "utils.h"
+#include <charconv>
+#include <bit>
+
+namespace {
+    struct ScopeName {
+        uint64_t bit;
+        const char* name;
+    };
+
+    const ScopeName kScopeNames[] = {
+        {ApiScope::UsersRead, "users:read"},
+        {ApiScope::UsersWrite, "users:write"},
+        {ApiScope::LogsRead, "logs:read"},
+        {ApiScope::Admin, "admin"},
+    };
+
+    const std::string kLoadSql =
+        "SELECT id, prefix, key_hash, scopes, expires_at FROM api_keys WHERE revoked_at IS NULL";
+
+    const std::string kLoadOneSql =
+        "SELECT id, prefix, key_hash, scopes, expires_at FROM api_keys WHERE id = ? AND revoked_at IS NULL";
+
+    const std::string kInsertSql =
+        "INSERT INTO api_keys (name, prefix, key_hash, scopes, expires_at) VALUES (?, ?, ?, ?, ?)";
+
+    const std::string kListSql =
+        "SELECT id, name, prefix, scopes, created_at, COALESCE(expires_at, 0), revoked_at IS NOT NULL "
+        "FROM api_keys ORDER BY id";
+
+    const std::string kRevokeSql =
+        "UPDATE api_keys SET revoked_at = CURRENT_TIMESTAMP WHERE id = ? AND revoked_at IS NULL";
+
+    const size_t kKeyRandomBytes = 24;
+    const size_t kMinSlots = 16;
+    const size_t kMinBloomBits = 1024;
+
+    bool decodeDigest(std::string_view hex, ApiKeyIndex::Digest& digest) {
+        if (hex.size() != 2 * digest.size()) return false;
+        for (size_t i = 0; i < digest.size(); ++i) {
+            auto result = std::from_chars(hex.data() + 2 * i, hex.data() + 2 * i + 2, digest[i], 16);
+            if (result.ec != std::errc() || result.ptr != hex.data() + 2 * i + 2) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Bloom过滤器双重哈希的第二个值，取前缀哈希的另一半，必须是奇数
+    uint64_t bloomStep(uint64_t lookup) {
+        return std::rotl(lookup, 32) | 1;
+    }
+}
+
+namespace ApiScope {
+
+bool parse(std::string_view text, uint64_t& scopes) {
+    scopes = 0;
+    for (std::string_view item : Utils::splitView(text, ',')) {
+        item = Utils::trimView(item);
+        if (item == "*") {
+            scopes |= All;
+            continue;
+        }
+        bool known = false;
+        for (const auto& scope : kScopeNames) {
+            if (item == scope.name) {
+                scopes |= scope.bit;
+                known = true;
+                break;
+            }
+        }
+        if (!known) return false;
+    }
+    return true;
+}
+
+std::string toString(uint64_t scopes) {
+    std::string text;
+    for (const auto& scope : kScopeNames) {
+        if (scopes & scope.bit) {
+            if (!text.empty()) text += ',';
+            text += scope.name;
+        }
+    }
+    return text;
+}
+
+} // namespace ApiScope
+
+ApiKeyIndex::ApiKeyIndex() {
+    // 没有连接数据库时使用空索引，所有密钥都被拒绝
+    std::lock_guard<std::mutex> lock(mutex_);
+    publish();
+}
+
+bool ApiKeyIndex::attach(Database& database) {
+    if (!attached_) {
+        attached_ = true;
+        database.addRowListener("api_keys", [this](long long rowid) { onRowChanged(rowid); });
+        // 任何写入（包括其他表的语句和显式事务）提交或回滚之后，重新读取其间被修改的行
+        database.addCommitListener([this, &database]() { refresh(database); });
+    }
+
+    std::unordered_map<long long, Entry> loaded;
+    bool ok = database.forEachRow(kLoadSql, {}, [&](const DbRow& row) {
+        Entry entry;
+        if (readEntry(row, entry)) {
+            loaded.emplace(entry.id, entry);
+        }
+        return true;
+    });
+    if (!ok) {
+        Logger::error("加载API密钥失败: " + database.getLastError(), "auth");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_ = std::move(loaded);
+    pending_.clear();
+    publish();
+    return true;
+}
+
+bool ApiKeyIndex::refresh(Database& database) {
+    // 事务中读到的行可能被回滚，提交之后再读取；在这之前被修改的密钥保持移出状态
+    if (database.inTransaction()) return true;
+
+    std::vector<long long> rows;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.empty()) return true;
+        rows.swap(pending_);
+    }
+
+    std::vector<Entry> loaded;
+    bool ok = true;
+    for (long long rowid : rows) {
+        ok = database.forEachRow(kLoadOneSql, {rowid}, [&](const DbRow& row) {
+            Entry entry;
+            if (readEntry(row, entry)) {
+                loaded.push_back(entry);
+            }
+            return false;
+        }) && ok;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Entry& entry : loaded) {
+        entries_[entry.id] = entry;
+    }
+    if (!ok) {
+        // 读取失败的行留到下一次刷新
+        pending_.insert(pending_.end(), rows.begin(), rows.end());
+        Logger::error("刷新API密钥失败: " + database.getLastError(), "auth");
+    }
+    if (!loaded.empty()) {
+        publish();
+    }
+    return ok;
+}
+
+void ApiKeyIndex::onRowChanged(long long rowid) {
+    // 在写语句执行期间调用，不能读取数据库；先移出索引，不会有请求在吊销之后还能通过
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(rowid);
+    if (entries_.erase(rowid) > 0) {
+        publish();
+    }
+}
+
+bool ApiKeyIndex::readEntry(const DbRow& row, Entry& entry) {
+    entry.id = row.getInt(0);
+    std::string_view prefix = row.getText(1);
+    if (prefix.size() != kDisplayPrefixLength || prefix.substr(0, kKeyPrefix.size()) != kKeyPrefix) {
+        Logger::warn("API密钥 " + std::to_string(entry.id) + " 的前缀无效，已忽略", "auth");
+        return false;
+    }
+    entry.lookup = lookupHash(prefix);
+    if (!decodeDigest(row.getText(2), entry.digest)) {
+        Logger::warn("API密钥 " + std::to_string(entry.id) + " 的摘要格式无效，已忽略", "auth");
+        return false;
+    }
+    if (!ApiScope::parse(row.getText(3), entry.scopes)) {
+        // 可能来自更新的版本，只保留能识别的作用域会扩大或缩小权限，整个密钥不可用
+        Logger::warn("API密钥 " + std::to_string(entry.id) + " 包含无法识别的作用域，已忽略", "auth");
+        return false;
+    }
+    entry.expiresAt = row.isNull(4) ? 0 : row.getInt(4);
+    return true;
+}
+
+uint64_t ApiKeyIndex::lookupHash(std::string_view prefix) {
+    // 前缀在ak_之后是随机的十六进制，FNV-1a加上splitmix64的末尾混合就足够均匀，11个字节只需几纳秒。
+    // 前缀只有32位随机，猜中前缀并不能通过校验，剩下的部分仍由摘要比较保护
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : prefix) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL;
+    }
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+void ApiKeyIndex::publish() {
+    auto table = std::make_shared<Table>();
+    size_t count = entries_.size();
+
+    size_t slots = std::bit_ceil(std::max(kMinSlots, count * 2));
+    table->slots.resize(slots);
+    table->mask = slots - 1;
+
+    size_t bloomBits = std::bit_ceil(std::max(kMinBloomBits, count * kBloomBitsPerKey));
+    table->bloom.assign(bloomBits / 64, 0);
+    table->bloomMask = bloomBits - 1;
+    table->count = count;
+
+    for (const auto& [id, entry] : entries_) {
+        size_t slot = entry.lookup & table->mask;
+        while (table->slots[slot].id != 0) {
+            slot = (slot + 1) & table->mask;
+        }
+        table->slots[slot] = entry;
+
+        uint64_t h1 = entry.lookup;
+        uint64_t h2 = bloomStep(entry.lookup);
+        for (int i = 0; i < kBloomProbes; ++i) {
+            size_t bit = (h1 + i * h2) & table->bloomMask;
+            table->bloom[bit / 64] |= 1ULL << (bit % 64);
+        }
+    }
+
+    table_.store(std::move(table), std::memory_order_release);
+}
+
+bool ApiKeyIndex::Table::mayContain(uint64_t lookup) const {
+    uint64_t h1 = lookup;
+    uint64_t h2 = bloomStep(lookup);
+    for (int i = 0; i < kBloomProbes; ++i) {
+        size_t bit = (h1 + i * h2) & bloomMask;
+        if (!(bloom[bit / 64] & (1ULL << (bit % 64)))) return false;
+    }
+    return true;
+}
+
+const ApiKeyIndex::Entry* ApiKeyIndex::Table::find(uint64_t lookup, std::string_view key) const {
+    // 比较的是摘要而不是密钥本身，比较时间泄露不了密钥的内容
+    Digest keyDigest;
+    bool hashed = false;
+    size_t slot = lookup & mask;
+    while (slots[slot].id != 0) {
+        if (slots[slot].lookup == lookup) {
+            if (!hashed) {
+                if (!digest(key, keyDigest)) return nullptr;
+                hashed = true;
+            }
+            if (slots[slot].digest == keyDigest) return &slots[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return nullptr;
+}
+
+ApiKeyIndex::Result ApiKeyIndex::check(std::string_view key, uint64_t requiredScopes) const {
+    if (key.empty()) return Result::Missing;
+    if (key.size() != kKeyLength || key.substr(0, kKeyPrefix.size()) != kKeyPrefix) return Result::Unknown;
+
+    // 未知密钥在这里被拒绝，不计算SHA-256
+    uint64_t lookup = lookupHash(key.substr(0, kDisplayPrefixLength));
+    std::shared_ptr<const Table> table = table_.load(std::memory_order_acquire);
+    if (!table->mayContain(lookup)) return Result::Unknown;
+    const Entry* entry = table->find(lookup, key);
+    if (!entry) return Result::Unknown;
+
+    if (entry->expiresAt != 0 && CoarseClock::nowMillis() / 1000 >= entry->expiresAt) return Result::Expired;
+    if ((entry->scopes & requiredScopes) != requiredScopes) return Result::Forbidden;
+    return Result::Ok;
+}
+
+size_t ApiKeyIndex::size() const {
+    return table_.load(std::memory_order_acquire)->count;
+}
+
+std::string_view ApiKeyIndex::keyFrom(const HttpRequest& request) {
+    auto authorization = request.headers.find("authorization");
+    if (authorization != request.headers.end()) {
+        std::string_view value = Utils::trimView(authorization->second);
+        if (value.size() > 7 && Utils::equalsIgnoreCase(value.substr(0, 7), "Bearer ")) {
+            return Utils::trimView(value.substr(7));
+        }
+    }
+    auto header = request.headers.find("x-api-key");
+    if (header != request.headers.end()) {
+        return Utils::trimView(header->second);
+    }
+    return {};
+}
+
+int ApiKeyIndex::statusFor(Result result) {
+    return result == Result::Forbidden ? 403 : 401;
+}
+
+const char* ApiKeyIndex::messageFor(Result result) {
+    switch (result) {
+        case Result::Missing: return "API key required";
+        case Result::Expired: return "API key expired";
+        case Result::Forbidden: return "API key lacks required scope";
+        default: return "Invalid API key";
+    }
+}
+
+void ApiKeyIndex::reject(Result result, HttpResponse& response) {
+    int status = statusFor(result);
+    response.status(status);
+    if (status == 401) {
+        response.header("WWW-Authenticate", "Bearer");
+    }
+    response.json(std::string("{\"error\": \"") + messageFor(result) + "\"}");
+}
+
+bool ApiKeyIndex::digest(std::string_view key, Digest& out) {
+    return Crypto::sha256(key, out.data());
+}
+
+bool ApiKeyRepository::create(const std::string& name, uint64_t scopes, long long expiresAt, ApiKey& created,
+                              std::string& key) {
+    uint8_t random[kKeyRandomBytes];
+    if (!Crypto::randomBytes(random, sizeof(random))) return false;
+
+    key.assign(ApiKeyIndex::kKeyPrefix);
+    size_t offset = key.size();
+    key.resize(offset + 2 * sizeof(random));
+    IdGenerator::writeHex(random, sizeof(random), &key[offset]);
+
+    ApiKeyIndex::Digest digest;
+    if (!ApiKeyIndex::digest(key, digest)) return false;
+    std::string digestHex(2 * digest.size(), '0');
+    IdGenerator::writeHex(digest.data(), digest.size(), &digestHex[0]);
+
+    created = ApiKey();
+    created.name = name;
+    created.prefix = key.substr(0, ApiKeyIndex::kDisplayPrefixLength);
+    created.scopes = scopes;
+    created.expiresAt = expiresAt;
+
+    DbValue expires = expiresAt > 0 ? DbValue(expiresAt) : DbValue(nullptr);
+    created.id = db_.insert(kInsertSql, {name, created.prefix, digestHex, ApiScope::toString(scopes), expires});
+    if (created.id < 0) return false;
+
+    db_.forEachRow("SELECT created_at FROM api_keys WHERE id = ?", {created.id}, [&](const DbRow& row) {
+        created.createdAt = std::string(row.getText(0));
+        return false;
+    });
+    return true;
+}
+
+bool ApiKeyRepository::list(std::vector<ApiKey>& keys) {
+    keys.clear();
+    return db_.forEachRow(kListSql, {}, [&](const DbRow& row) {
+        ApiKey key;
+        key.id = row.getInt(0);
+        key.name = std::string(row.getText(1));
+        key.prefix = std::string(row.getText(2));
+        // 无法识别的作用域不显示，索引中这样的密钥不可用
+        ApiScope::parse(row.getText(3), key.scopes);
+        key.createdAt = std::string(row.getText(4));
+        key.expiresAt = row.getInt(5);
+        key.revoked = row.getInt(6) != 0;
+        keys.push_back(std::move(key));
+        return true;
+    });
+}
+
+bool ApiKeyRepository::revoke(long long id, bool& found) {
+    // update_hook 在这条语句执行时已经把密钥移出索引，提交后的刷新只是确认它不再有效
+    int changed = db_.update(kRevokeSql, {id});
+    found = changed > 0;
+    return changed >= 0;
+}
+
+std::string ApiKeyRepository::toJson(const ApiKey& key) {
+    std::string json = "{\"id\": " + std::to_string(key.id) +
+                       ", \"name\": \"" + Utils::escapeJsonString(key.name) +
+                       "\", \"prefix\": \"" + key.prefix +
+                       "\", \"scopes\": \"" + ApiScope::toString(key.scopes) +
+                       "\", \"created_at\": \"" + Utils::escapeJsonString(key.createdAt) + "\", \"expires_at\": ";
+    json += key.expiresAt > 0 ? std::to_string(key.expiresAt) : "null";
+    json += ", \"revoked\": ";
+    json += key.revoked ? "true" : "false";
+    json += "}";
+    return json;
+}
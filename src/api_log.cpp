@@ -0,0 +1,660 @@
+#include "api_log.h"
+#include "utils.h"
+#include "coarse_clock.h"
+#include <sqlite3.h>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <charconv>
+#include <limits>
+
+namespace {
+    const char kUnmatchedRoute[] = "(unmatched)";
+
+    const long long kSecondsPerDay = 86400;
+    const char kPartitionPrefix[] = "api_logs_";
+    const char kSearchPrefix[] = "api_logs_fts_";
+    const char kLegacyTable[] = "api_logs_legacy";
+    const char kLogColumns[] = "id, method, path, status_code, response_time, ip_address, user_agent, created_at";
+
+    // 自1970-01-01起的天数与公历日期互相转换（proleptic Gregorian）
+    void civilFromDays(long long days, long long& year, unsigned& month, unsigned& day) {
+        days += 719468;
+        long long era = (days >= 0 ? days : days - 146096) / 146097;
+        unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+        unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        unsigned shiftedMonth = (5 * dayOfYear + 2) / 153;
+        day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+        month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+        year = static_cast<long long>(yearOfEra) + era * 400 + (month <= 2 ? 1 : 0);
+    }
+
+    long long daysFromCivil(long long year, unsigned month, unsigned day) {
+        year -= month <= 2 ? 1 : 0;
+        long long era = (year >= 0 ? year : year - 399) / 400;
+        unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+        unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + static_cast<long long>(dayOfEra) - 719468;
+    }
+
+    // 全文索引表名 api_logs_fts_YYYYMMDD
+    std::string searchTableName(long long day) {
+        return kSearchPrefix + ApiLogWriter::partitionName(day).substr(sizeof(kPartitionPrefix) - 1);
+    }
+
+    // 从表名解析日期，prefix之后不是8位日期时返回false
+    bool parseDatedName(std::string_view name, std::string_view prefix, long long& day) {
+        if (name.size() != prefix.size() + 8 || name.substr(0, prefix.size()) != prefix) return false;
+
+        std::string_view digits = name.substr(prefix.size());
+        unsigned date = 0;
+        auto result = std::from_chars(digits.data(), digits.data() + digits.size(), date);
+        if (result.ec != std::errc() || result.ptr != digits.data() + digits.size()) return false;
+        day = daysFromCivil(date / 10000, date / 100 % 100, date % 100);
+        return ApiLogWriter::partitionName(day).substr(sizeof(kPartitionPrefix) - 1) == digits;
+    }
+
+    std::string insertLogSql(const std::string& partition) {
+        return "INSERT INTO " + partition + " (" + kLogColumns + ") VALUES (?, ?, ?, ?, ?, ?, ?, datetime(?, 'unixepoch'))";
+    }
+
+    std::string insertSearchSql(long long day) {
+        return "INSERT INTO " + searchTableName(day) + " (rowid, path, user_agent) VALUES (?, ?, ?)";
+    }
+
+    // 按rowid倒序读取FTS5的文档列表，LIMIT之后不再读取；列值按id从分区表取
+    std::string searchSql(long long day) {
+        std::string search = searchTableName(day);
+        return "SELECT l.id, l.method, l.path, l.status_code, l.response_time, l.ip_address, l.user_agent, l.created_at "
+               "FROM " + search + " JOIN " + ApiLogWriter::partitionName(day) + " AS l ON l.id = " + search + ".rowid "
+               "WHERE " + search + " MATCH ? AND " + search + ".rowid < ? ORDER BY " + search + ".rowid DESC LIMIT ?";
+    }
+
+    void readRecord(const DbRow& row, ApiLogRecord& record) {
+        record.id = row.getInt(0);
+        record.method = std::string(row.getText(1));
+        record.path = std::string(row.getText(2));
+        record.statusCode = static_cast<int>(row.getInt(3));
+        record.responseTimeUs = row.getInt(4);
+        record.ipAddress = std::string(row.getText(5));
+        record.userAgent = std::string(row.getText(6));
+        record.createdAt = std::string(row.getText(7));
+    }
+
+    // 外部内容的FTS5表，列值从分区表读取，索引只保存词项；prefix为2、3个字符的前缀建立额外索引
+    std::string createSearchTableSql(long long day) {
+        return "CREATE VIRTUAL TABLE IF NOT EXISTS " + searchTableName(day) +
+               " USING fts5(path, user_agent, content='" + ApiLogWriter::partitionName(day) +
+               "', content_rowid='id', prefix='2 3')";
+    }
+
+    // 汇总表的SQL，三张表结构相同
+    struct RollupSql {
+        std::string select;
+        std::string replace;
+        std::string range;
+    };
+
+    RollupSql makeRollupSql(const std::string& table) {
+        return RollupSql{
+            "SELECT count, total_us, min_us, max_us, sketch FROM " + table +
+                " WHERE bucket = ? AND method = ? AND route = ? AND status_code = ?",
+            "INSERT OR REPLACE INTO " + table +
+                " (bucket, method, route, status_code, count, total_us, min_us, max_us, sketch)"
+                " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
+            "SELECT bucket, method, route, status_code, count, total_us, min_us, max_us, sketch FROM " + table +
+                " WHERE bucket >= ? AND bucket < ? ORDER BY bucket"
+        };
+    }
+
+    const RollupSql& rollupSql(RollupResolution resolution) {
+        static const RollupSql sql[] = {
+            makeRollupSql("api_stats_minute"),
+            makeRollupSql("api_stats_hour"),
+            makeRollupSql("api_stats_day")
+        };
+        return sql[static_cast<int>(resolution)];
+    }
+
+    const RollupResolution kResolutions[] = { RollupResolution::Minute, RollupResolution::Hour, RollupResolution::Day };
+
+    using RollupKey = std::tuple<long long, std::string, std::string, int>;
+
+    // 把b合并到a，a为空时直接复制
+    void mergeRow(ApiStatsRow& a, const ApiStatsRow& b) {
+        if (a.count == 0) {
+            a.minUs = b.minUs;
+            a.maxUs = b.maxUs;
+        } else if (b.count > 0) {
+            a.minUs = std::min(a.minUs, b.minUs);
+            a.maxUs = std::max(a.maxUs, b.maxUs);
+        }
+        a.count += b.count;
+        a.totalUs += b.totalUs;
+        a.latency.merge(b.latency);
+    }
+
+    void readRow(const DbRow& row, int first, ApiStatsRow& stats) {
+        stats.count = static_cast<uint64_t>(row.getInt(first));
+        stats.totalUs = row.getInt(first + 1);
+        stats.minUs = row.getInt(first + 2);
+        stats.maxUs = row.getInt(first + 3);
+        if (!LatencySketch::deserialize(row.getText(first + 4), stats.latency)) {
+            stats.latency = LatencySketch();
+        }
+    }
+
+    // 读出已有的汇总行，合并这一批的增量后写回
+    bool mergeRollup(Database& database, const RollupSql& sql, ApiStatsRow& delta) {
+        ApiStatsRow existing;
+        if (!database.forEachRow(sql.select, {delta.bucket, delta.method, delta.route, static_cast<long long>(delta.statusCode)},
+                                 [&](const DbRow& row) {
+                                     readRow(row, 0, existing);
+                                     return false;
+                                 })) {
+            return false;
+        }
+        mergeRow(delta, existing);
+
+        return database.update(sql.replace, {
+            delta.bucket, delta.method, delta.route, static_cast<long long>(delta.statusCode),
+            static_cast<long long>(delta.count), delta.totalUs, delta.minUs, delta.maxUs, delta.latency.serialize()
+        }) >= 0;
+    }
+}
+
+bool ApiLogWriter::record(ApiLogEntry entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.size() >= kMaxPending) {
+        ++dropped_;
+        return false;
+    }
+    pending_.push_back(std::move(entry));
+    if (flushScheduled_) return false;
+    flushScheduled_ = true;
+    return true;
+}
+
+uint64_t ApiLogWriter::droppedCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+bool ApiLogWriter::flush(Database& database) {
+    std::vector<ApiLogEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries.swap(pending_);
+        flushScheduled_ = false;
+    }
+    if (entries.empty()) return true;
+    if (!database.isConnected()) return false;
+
+    // 先在内存中按桶合并，每个桶每批只读写一次汇总表
+    std::map<RollupKey, ApiStatsRow> rollups[3];
+
+    if (!database.beginTransaction()) {
+        std::cerr << "访问日志写入失败: " << database.getLastError() << std::endl;
+        return false;
+    }
+
+    // 回滚同时撤销这一批中新建的分区
+    std::set<long long> partitions = partitions_;
+    auto fail = [&](const char* message) {
+        std::cerr << message << database.getLastError() << std::endl;
+        database.rollbackTransaction();
+        partitions_ = std::move(partitions);
+        return false;
+    };
+
+    long long currentDay = -1;
+    std::string insertSql;
+    std::string insertSearch;
+    for (const auto& entry : entries) {
+        // 一批记录通常属于同一天，只在日期变化时查找分区
+        long long day = entry.timestamp / kSecondsPerDay;
+        if (day != currentDay) {
+            if (!ensurePartition(database, day)) {
+                return fail("创建日志分区失败: ");
+            }
+            currentDay = day;
+            insertSql = insertLogSql(partitionName(day));
+            insertSearch = insertSearchSql(day);
+        }
+
+        long long id = static_cast<long long>(ids_.next());
+        if (database.insert(insertSql, {id, entry.method, entry.path, static_cast<long long>(entry.statusCode),
+                                        entry.responseTimeUs, entry.ipAddress, entry.userAgent, entry.timestamp}) < 0) {
+            return fail("访问日志写入失败: ");
+        }
+        if (searchEnabled_ && database.update(insertSearch, {id, entry.path, entry.userAgent}) < 0) {
+            return fail("访问日志索引失败: ");
+        }
+
+        ApiStatsRow sample;
+        sample.method = entry.method;
+        sample.route = entry.route.empty() ? kUnmatchedRoute : entry.route;
+        sample.statusCode = entry.statusCode;
+        sample.count = 1;
+        sample.totalUs = entry.responseTimeUs;
+        sample.minUs = entry.responseTimeUs;
+        sample.maxUs = entry.responseTimeUs;
+        sample.latency.add(static_cast<double>(entry.responseTimeUs));
+
+        for (RollupResolution resolution : kResolutions) {
+            long long length = bucketSeconds(resolution);
+            sample.bucket = entry.timestamp - entry.timestamp % length;
+            ApiStatsRow& row = rollups[static_cast<int>(resolution)][RollupKey(sample.bucket, sample.method, sample.route, sample.statusCode)];
+            if (row.count == 0) {
+                row.bucket = sample.bucket;
+                row.method = sample.method;
+                row.route = sample.route;
+                row.statusCode = sample.statusCode;
+            }
+            mergeRow(row, sample);
+        }
+    }
+
+    for (RollupResolution resolution : kResolutions) {
+        const RollupSql& sql = rollupSql(resolution);
+        for (auto& entry : rollups[static_cast<int>(resolution)]) {
+            if (!mergeRollup(database, sql, entry.second)) {
+                return fail("访问日志汇总失败: ");
+            }
+        }
+    }
+
+    if (!database.commitTransaction()) {
+        return fail("访问日志提交失败: ");
+    }
+    return maintain(database, CoarseClock::nowMillis() / 1000);
+}
+
+bool ApiLogWriter::open(Database& database, long long now) {
+    if (!database.isConnected()) return false;
+
+    // 旧版本的单表改名后并入视图，保留到其中最新的记录过期
+    std::string existingType;
+    if (!database.forEachRow("SELECT type FROM sqlite_master WHERE name = 'api_logs'", {}, [&](const DbRow& row) {
+            existingType = std::string(row.getText(0));
+            return false;
+        })) {
+        return false;
+    }
+    if (existingType == "table" && !database.execute(std::string("ALTER TABLE api_logs RENAME TO ") + kLegacyTable)) {
+        std::cerr << "迁移api_logs失败: " << database.getLastError() << std::endl;
+        return false;
+    }
+
+    // SQLite可能没有编译FTS5，这时日志照常写入，只是不能搜索
+    searchEnabled_ = database.execute("CREATE VIRTUAL TABLE temp.fts5_probe USING fts5(x); DROP TABLE temp.fts5_probe");
+    if (!searchEnabled_) {
+        std::cout << "警告: SQLite不支持FTS5，日志搜索不可用" << std::endl;
+    }
+
+    partitions_.clear();
+    hasLegacy_ = false;
+    std::set<long long> indexed;
+    bool success = database.forEachRow("SELECT name FROM sqlite_master WHERE type = 'table' AND name GLOB 'api_logs_*'", {},
+                                       [&](const DbRow& row) {
+        std::string_view name = row.getText(0);
+        long long day = 0;
+        if (name == kLegacyTable) {
+            hasLegacy_ = true;
+        } else if (parseDatedName(name, kPartitionPrefix, day)) {
+            partitions_.insert(day);
+        } else if (parseDatedName(name, kSearchPrefix, day)) {
+            indexed.insert(day);
+        }
+        return true;
+    });
+    if (!success) return false;
+
+    // 没有全文索引的分区（FTS5启用之前写入的）从分区表重建索引
+    std::set<long long> unindexed;
+    for (long long day : partitions_) {
+        if (!indexed.count(day)) unindexed.insert(day);
+    }
+
+    if (!database.beginTransaction()) return false;
+    success = ensurePartition(database, now / kSecondsPerDay) && rebuildView(database);
+
+    if (searchEnabled_) {
+        for (long long day : unindexed) {
+            if (!success) break;
+            std::cout << "正在为 " << partitionName(day) << " 建立全文索引..." << std::endl;
+            success = database.execute(createSearchTableSql(day)) &&
+                      database.execute("INSERT INTO " + searchTableName(day) + " (" + searchTableName(day) + ") VALUES ('rebuild')");
+        }
+    }
+
+    if (!success || !database.commitTransaction()) {
+        std::cerr << "创建api_logs视图失败: " << database.getLastError() << std::endl;
+        database.rollbackTransaction();
+        return false;
+    }
+    return true;
+}
+
+bool ApiLogWriter::search(Database& database, const std::string& query, long long beforeId, int limit,
+                          std::vector<ApiLogRecord>& records, bool& hasMore, std::string& error) {
+    records.clear();
+    hasMore = false;
+    error.clear();
+    if (!searchEnabled_) {
+        error = "Full-text search is not available";
+        return false;
+    }
+    if (limit <= 0) return true;
+
+    long long before = beforeId > 0 ? beforeId : std::numeric_limits<long long>::max();
+    size_t wanted = static_cast<size_t>(limit) + 1;
+
+    // 从最新的分区开始。id按写入时间生成，相邻分区只在日期边界附近有少量交错，
+    // 已经取够并且下一个分区中最大的id更小时，更早的分区不可能有更新的结果
+    for (auto it = partitions_.rbegin(); it != partitions_.rend(); ++it) {
+        long long day = *it;
+        if (records.size() >= wanted) {
+            long long maxId = 0;
+            if (!database.forEachRow("SELECT COALESCE(MAX(id), 0) FROM " + partitionName(day), {}, [&](const DbRow& row) {
+                    maxId = row.getInt(0);
+                    return false;
+                })) {
+                return false;
+            }
+            if (maxId < records.back().id) break;
+        }
+
+        size_t existing = records.size();
+        bool success = database.forEachRow(searchSql(day), {query, before, static_cast<long long>(wanted)}, [&](const DbRow& row) {
+            records.emplace_back();
+            readRecord(row, records.back());
+            return true;
+        });
+        if (!success) {
+            // 语句本身是固定的，SQLITE_ERROR只可能来自MATCH表达式
+            records.clear();
+            if (database.getLastErrorCode() == SQLITE_ERROR) {
+                error = "Invalid search query";
+            }
+            return false;
+        }
+
+        if (existing > 0 && records.size() > existing) {
+            std::inplace_merge(records.begin(), records.begin() + existing, records.end(),
+                               [](const ApiLogRecord& a, const ApiLogRecord& b) { return a.id > b.id; });
+        }
+        if (records.size() > wanted) {
+            records.resize(wanted);
+        }
+    }
+
+    hasMore = records.size() > static_cast<size_t>(limit);
+    if (hasMore) {
+        records.resize(static_cast<size_t>(limit));
+    }
+    return true;
+}
+
+std::string ApiLogWriter::partitionName(long long day) {
+    long long year = 0;
+    unsigned month = 0;
+    unsigned dayOfMonth = 0;
+    civilFromDays(day, year, month, dayOfMonth);
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%s%04lld%02u%02u", kPartitionPrefix, year, month, dayOfMonth);
+    return buffer;
+}
+
+bool ApiLogWriter::ensurePartition(Database& database, long long day) {
+    if (partitions_.count(day)) return true;
+
+    std::string sql = "CREATE TABLE IF NOT EXISTS " + partitionName(day) + R"( (
+        id INTEGER PRIMARY KEY,
+        method TEXT NOT NULL,
+        path TEXT NOT NULL,
+        status_code INTEGER NOT NULL,
+        response_time INTEGER,
+        ip_address TEXT,
+        user_agent TEXT,
+        created_at DATETIME DEFAULT CURRENT_TIMESTAMP
+    ))";
+    if (!database.execute(sql)) return false;
+    if (searchEnabled_ && !database.execute(createSearchTableSql(day))) return false;
+
+    partitions_.insert(day);
+    if (!rebuildView(database)) {
+        partitions_.erase(day);
+        return false;
+    }
+    return true;
+}
+
+bool ApiLogWriter::rebuildView(Database& database) {
+    std::string sql = "DROP VIEW IF EXISTS api_logs; CREATE VIEW api_logs AS ";
+    bool first = true;
+    auto addTable = [&](const std::string& table) {
+        if (!first) sql += " UNION ALL ";
+        first = false;
+        sql += std::string("SELECT ") + kLogColumns + " FROM " + table;
+    };
+
+    if (hasLegacy_) {
+        addTable(kLegacyTable);
+    }
+    for (long long day : partitions_) {
+        addTable(partitionName(day));
+    }
+    if (first) {
+        // 没有任何分区时保持视图的列
+        sql += "SELECT NULL AS id, NULL AS method, NULL AS path, NULL AS status_code, NULL AS response_time, "
+               "NULL AS ip_address, NULL AS user_agent, NULL AS created_at WHERE 0";
+    }
+    return database.execute(sql);
+}
+
+bool ApiLogWriter::maintain(Database& database, long long now) {
+    if (!database.isConnected()) return false;
+
+    bool success = true;
+    if (now - lastRetentionCheck_ >= 60) {
+        lastRetentionCheck_ = now;
+        success = dropExpired(database, now / kSecondsPerDay);
+    }
+
+    // 删除分区释放的页分批归还，每一步只持有很短的写锁
+    if (now != lastVacuum_) {
+        lastVacuum_ = now;
+        long long freePages = 0;
+        database.forEachRow("PRAGMA freelist_count", {}, [&](const DbRow& row) {
+            freePages = row.getInt(0);
+            return false;
+        });
+        if (freePages > 0 && !database.execute("PRAGMA incremental_vacuum(" + std::to_string(kVacuumPagesPerStep) + ")")) {
+            std::cerr << "增量清理失败: " << database.getLastError() << std::endl;
+            success = false;
+        }
+    }
+    return success;
+}
+
+bool ApiLogWriter::dropExpired(Database& database, long long today) {
+    long long retention = std::clamp(retentionDays_.load(), 1, kMaxRetentionDays);
+    long long cutoff = today - retention + 1;
+
+    std::vector<long long> expired;
+    for (long long day : partitions_) {
+        if (day >= cutoff) break;
+        expired.push_back(day);
+    }
+
+    // 旧表按最后一条记录判断，按id倒序只读一行
+    bool dropLegacy = false;
+    if (hasLegacy_) {
+        dropLegacy = true;
+        if (!database.forEachRow(std::string("SELECT created_at < datetime(?, 'unixepoch') FROM ") + kLegacyTable +
+                                 " ORDER BY id DESC LIMIT 1", {cutoff * kSecondsPerDay}, [&](const DbRow& row) {
+                                     dropLegacy = row.getInt(0) != 0;
+                                     return false;
+                                 })) {
+            return false;
+        }
+    }
+
+    if (!database.beginTransaction()) return false;
+
+    std::set<long long> previous = partitions_;
+    bool previousLegacy = hasLegacy_;
+    bool success = ensurePartition(database, today);
+    for (long long day : expired) {
+        success = success && database.execute("DROP TABLE IF EXISTS " + searchTableName(day)) &&
+                  database.execute("DROP TABLE IF EXISTS " + partitionName(day));
+    }
+    if (dropLegacy) {
+        success = success && database.execute(std::string("DROP TABLE IF EXISTS ") + kLegacyTable);
+    }
+
+    // 分钟汇总与原始日志保留相同的天数，小时和天的汇总很小，一直保留
+    success = success && database.update("DELETE FROM api_stats_minute WHERE bucket < ?", {cutoff * kSecondsPerDay}) >= 0;
+
+    if (success && (!expired.empty() || dropLegacy)) {
+        for (long long day : expired) {
+            partitions_.erase(day);
+        }
+        hasLegacy_ = hasLegacy_ && !dropLegacy;
+        success = rebuildView(database);
+    }
+
+    if (!success || !database.commitTransaction()) {
+        std::cerr << "删除过期日志失败: " << database.getLastError() << std::endl;
+        database.rollbackTransaction();
+        partitions_ = std::move(previous);
+        hasLegacy_ = previousLegacy;
+        return false;
+    }
+
+    if (!expired.empty() || dropLegacy) {
+        // 缓存的插入语句引用了已删除的表
+        database.clearStatementCache();
+        std::cout << "已删除 " << expired.size() + (dropLegacy ? 1 : 0) << " 个过期的日志分区" << std::endl;
+    }
+    return true;
+}
+
+bool ApiLogWriter::queryStats(Database& database, RollupResolution resolution, long long from, long long to,
+                              StatsGroup group, std::vector<ApiStatsRow>& rows) {
+    rows.clear();
+
+    std::map<RollupKey, ApiStatsRow> merged;
+    bool success = database.forEachRow(rollupSql(resolution).range, {from, to}, [&](const DbRow& row) {
+        ApiStatsRow stats;
+        stats.bucket = row.getInt(0);
+        if (group == StatsGroup::Route) {
+            stats.method = std::string(row.getText(1));
+            stats.route = std::string(row.getText(2));
+        } else if (group == StatsGroup::Status) {
+            stats.statusCode = static_cast<int>(row.getInt(3));
+        }
+        readRow(row, 4, stats);
+
+        ApiStatsRow& target = merged[RollupKey(stats.bucket, stats.method, stats.route, stats.statusCode)];
+        if (target.count == 0) {
+            target.bucket = stats.bucket;
+            target.method = stats.method;
+            target.route = stats.route;
+            target.statusCode = stats.statusCode;
+        }
+        mergeRow(target, stats);
+        return true;
+    });
+    if (!success) return false;
+
+    rows.reserve(merged.size());
+    for (auto& entry : merged) {
+        rows.push_back(std::move(entry.second));
+    }
+    return true;
+}
+
+long long ApiLogWriter::bucketSeconds(RollupResolution resolution) {
+    switch (resolution) {
+        case RollupResolution::Hour: return 3600;
+        case RollupResolution::Day: return 86400;
+        default: return 60;
+    }
+}
+
+bool ApiLogWriter::parseResolution(const std::string& text, RollupResolution& resolution) {
+    if (text.empty() || text == "minute") {
+        resolution = RollupResolution::Minute;
+    } else if (text == "hour") {
+        resolution = RollupResolution::Hour;
+    } else if (text == "day") {
+        resolution = RollupResolution::Day;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ApiLogWriter::parseGroup(const std::string& text, StatsGroup& group) {
+    if (text.empty() || text == "route") {
+        group = StatsGroup::Route;
+    } else if (text == "status") {
+        group = StatsGroup::Status;
+    } else if (text == "all") {
+        group = StatsGroup::All;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string ApiLogWriter::toJson(const ApiStatsRow& row, StatsGroup group) {
+    std::string json = "{\"bucket\": " + std::to_string(row.bucket);
+    if (group == StatsGroup::Route) {
+        json += ", \"method\": \"" + Utils::escapeJsonString(row.method) +
+                "\", \"route\": \"" + Utils::escapeJsonString(row.route) + "\"";
+    } else if (group == StatsGroup::Status) {
+        json += ", \"status_code\": " + std::to_string(row.statusCode);
+    }
+
+    long long average = row.count > 0 ? row.totalUs / static_cast<long long>(row.count) : 0;
+    json += ", \"count\": " + std::to_string(row.count) +
+            ", \"avg_us\": " + std::to_string(average) +
+            ", \"min_us\": " + std::to_string(row.minUs) +
+            ", \"max_us\": " + std::to_string(row.maxUs) +
+            ", \"p50_us\": " + std::to_string(std::llround(row.latency.quantile(0.50))) +
+            ", \"p95_us\": " + std::to_string(std::llround(row.latency.quantile(0.95))) +
+            ", \"p99_us\": " + std::to_string(std::llround(row.latency.quantile(0.99))) + "}";
+    return json;
+}
+
+std::string ApiLogWriter::toJson(const ApiLogRecord& record) {
+    // id超过2^53，以字符串输出，避免JavaScript客户端丢失精度
+    return "{\"id\": \"" + std::to_string(record.id) +
+           "\", \"method\": \"" + Utils::escapeJsonString(record.method) +
+           "\", \"path\": \"" + Utils::escapeJsonString(record.path) +
+           "\", \"status_code\": " + std::to_string(record.statusCode) +
+           ", \"response_time_us\": " + std::to_string(record.responseTimeUs) +
+           ", \"ip_address\": \"" + Utils::escapeJsonString(record.ipAddress) +
+           "\", \"user_agent\": \"" + Utils::escapeJsonString(record.userAgent) +
+           "\", \"created_at\": \"" + Utils::escapeJsonString(record.createdAt) + "\"}";
+}
+
+std::string ApiLogWriter::toJson(const ApiLogEntry& entry) {
+    return "{\"method\": \"" + Utils::escapeJsonString(entry.method) +
+           "\", \"path\": \"" + Utils::escapeJsonString(entry.path) +
+           "\", \"route\": \"" + Utils::escapeJsonString(entry.route) +
+           "\", \"status_code\": " + std::to_string(entry.statusCode) +
+           ", \"response_time_us\": " + std::to_string(entry.responseTimeUs) +
+           ", \"ip_address\": \"" + Utils::escapeJsonString(entry.ipAddress) +
+           "\", \"user_agent\": \"" + Utils::escapeJsonString(entry.userAgent) +
+           "\", \"timestamp\": " + std::to_string(entry.timestamp) + "}";
+}
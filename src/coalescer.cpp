@@ -0,0 +1,49 @@
+#include "coalescer.h"
+#include "utils.h"
+
+RequestCoalescer::RequestCoalescer(std::vector<std::string> headers) : headers_(std::move(headers)) {
+    // 请求头在解析时已转为小写
+    for (auto& header : headers_) {
+        Utils::toLowerInPlace(header);
+    }
+}
+
+std::string RequestCoalescer::keyFor(const HttpRequest& request) const {
+    // 各部分用'\0'分隔，不会和路径、查询字符串或请求头的内容混淆
+    std::string key;
+    key.reserve(request.method.size() + request.path.size() + request.query.size() + 16);
+    key += request.method;
+    key += '\0';
+    key += request.path;
+    key += '\0';
+    key += request.query;
+    for (const auto& header : headers_) {
+        key += '\0';
+        auto it = request.headers.find(header);
+        if (it != request.headers.end()) {
+            key += it->second;
+        }
+    }
+    return key;
+}
+
+bool RequestCoalescer::lead(const std::string& key) {
+    if (!inFlight_.try_emplace(key).second) return false;
+    flights_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void RequestCoalescer::wait(const std::string& key, Waiter waiter) {
+    inFlight_[key].push_back(std::move(waiter));
+    coalesced_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<RequestCoalescer::Waiter> RequestCoalescer::finish(const std::string& key) {
+    std::vector<Waiter> waiters;
+    auto it = inFlight_.find(key);
+    if (it != inFlight_.end()) {
+        waiters = std::move(it->second);
+        inFlight_.erase(it);
+    }
+    return waiters;
+}
@@ -0,0 +1,195 @@
+#include "coarse_clock.h"
+#include "utils.h"
+#include <chrono>
+#include <cstring>
+#include <ctime>
+
+namespace {
+    const char* const kWeekdays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    const char* const kMonths[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+    // 写入定宽的十进制数字
+    void writeDigits(char* out, int value, int width) {
+        for (int i = width - 1; i >= 0; --i) {
+            out[i] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+    }
+
+    long long systemMillis() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+CoarseClock& CoarseClock::instance() {
+    static CoarseClock clock;
+    return clock;
+}
+
+CoarseClock::~CoarseClock() {
+    // 进程退出前没有调用stop()时在这里结束刷新线程
+    if (thread_.joinable()) {
+        stopping_ = true;
+        thread_.join();
+    }
+}
+
+void CoarseClock::start() {
+    CoarseClock& clock = instance();
+    if (clock.thread_.joinable()) return;
+
+    // 先发布一份快照，启动后的第一次读取就能命中缓存
+    Snapshot snapshot;
+    format(systemMillis(), snapshot, nullptr);
+    clock.publish(snapshot);
+
+    clock.stopping_ = false;
+    clock.thread_ = std::thread([&clock]() { clock.run(); });
+    clock.running_.store(true, std::memory_order_release);
+}
+
+void CoarseClock::stop() {
+    CoarseClock& clock = instance();
+    if (!clock.thread_.joinable()) return;
+
+    clock.running_.store(false, std::memory_order_release);
+    clock.stopping_ = true;
+    clock.thread_.join();
+}
+
+void CoarseClock::run() {
+    Snapshot snapshot;
+    format(systemMillis(), snapshot, nullptr);
+
+    while (!stopping_) {
+        // 睡到下一毫秒的边界
+        long long millis = systemMillis();
+        auto next = std::chrono::system_clock::time_point(std::chrono::milliseconds(millis + 1));
+        std::this_thread::sleep_until(next);
+
+        format(systemMillis(), snapshot, &snapshot);
+        publish(snapshot);
+    }
+}
+
+void CoarseClock::format(long long millis, Snapshot& snapshot, const Snapshot* previous) {
+    long long second = millis / 1000;
+    bool sameSecond = previous && previous->millis / 1000 == second;
+    snapshot.millis = millis;
+
+    // 同一秒内日期和时分秒不变，只改写毫秒
+    if (!sameSecond) {
+        std::tm local = {};
+        Utils::localTime(second, local);
+        writeDigits(snapshot.timestamp, local.tm_year + 1900, 4);
+        snapshot.timestamp[4] = '-';
+        writeDigits(snapshot.timestamp + 5, local.tm_mon + 1, 2);
+        snapshot.timestamp[7] = '-';
+        writeDigits(snapshot.timestamp + 8, local.tm_mday, 2);
+        snapshot.timestamp[10] = ' ';
+        writeDigits(snapshot.timestamp + 11, local.tm_hour, 2);
+        snapshot.timestamp[13] = ':';
+        writeDigits(snapshot.timestamp + 14, local.tm_min, 2);
+        snapshot.timestamp[16] = ':';
+        writeDigits(snapshot.timestamp + 17, local.tm_sec, 2);
+        snapshot.timestamp[19] = '.';
+        snapshot.timestamp[23] = '\0';
+
+        // RFC 7231 IMF-fixdate，固定使用GMT
+        std::tm utc = {};
+        Utils::utcTime(second, utc);
+        char* date = snapshot.date;
+        std::memcpy(date, kWeekdays[utc.tm_wday], 3);
+        date[3] = ',';
+        date[4] = ' ';
+        writeDigits(date + 5, utc.tm_mday, 2);
+        date[7] = ' ';
+        std::memcpy(date + 8, kMonths[utc.tm_mon], 3);
+        date[11] = ' ';
+        writeDigits(date + 12, utc.tm_year + 1900, 4);
+        date[16] = ' ';
+        writeDigits(date + 17, utc.tm_hour, 2);
+        date[19] = ':';
+        writeDigits(date + 20, utc.tm_min, 2);
+        date[22] = ':';
+        writeDigits(date + 23, utc.tm_sec, 2);
+        std::memcpy(date + 25, " GMT", 4);
+        std::memset(date + kDateLength, 0, sizeof(snapshot.date) - kDateLength);
+    } else if (previous != &snapshot) {
+        std::memcpy(snapshot.timestamp, previous->timestamp, sizeof(snapshot.timestamp));
+        std::memcpy(snapshot.date, previous->date, sizeof(snapshot.date));
+    }
+
+    writeDigits(snapshot.timestamp + 20, static_cast<int>(millis % 1000), 3);
+}
+
+void CoarseClock::publish(const Snapshot& snapshot) {
+    uint64_t words[kWords];
+    std::memcpy(words, &snapshot, sizeof(words));
+
+    // 只有刷新线程写入：写不在使用中的槽位，读者几乎不会遇到重试
+    int next = 1 - current_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[next];
+
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; ++i) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+
+    current_.store(next, std::memory_order_release);
+}
+
+bool CoarseClock::read(Snapshot& snapshot) const {
+    if (!running_.load(std::memory_order_acquire)) return false;
+
+    uint64_t words[kWords];
+    while (true) {
+        const Slot& slot = slots_[current_.load(std::memory_order_acquire)];
+        uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+
+        for (size_t i = 0; i < kWords; ++i) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) break;
+    }
+
+    std::memcpy(&snapshot, words, sizeof(snapshot));
+    return true;
+}
+
+std::string CoarseClock::timestamp() {
+    Snapshot snapshot;
+    if (!instance().read(snapshot)) {
+        format(systemMillis(), snapshot, nullptr);
+    }
+    return std::string(snapshot.timestamp, kTimestampLength);
+}
+
+std::string CoarseClock::httpDate() {
+    std::string date;
+    appendHttpDate(date);
+    return date;
+}
+
+void CoarseClock::appendHttpDate(std::string& out) {
+    Snapshot snapshot;
+    if (!instance().read(snapshot)) {
+        format(systemMillis(), snapshot, nullptr);
+    }
+    out.append(snapshot.date, kDateLength);
+}
+
+long long CoarseClock::nowMillis() {
+    Snapshot snapshot;
+    if (!instance().read(snapshot)) {
+        return systemMillis();
+    }
+    return snapshot.millis;
+}
@@ -0,0 +1,331 @@
+#include "config.h"
+#include "json.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace {
+    // 文件变化后等待编辑器写完再读取（毫秒）
+    const DWORD kDebounceMs = 200;
+
+    const char* const kKnownKeys[] = {
+        "host", "port", "database", "log_level", "max_connections", "timeout", "header_timeout", "write_timeout",
+        "io_backend", "worker_threads", "row_cache_mb", "log_retention_days", "rate_limit_rps", "rate_limit_burst",
+        "cors_enabled", "cors_origin", "cors_methods", "cors_headers", "trace_sample_interval",
+        "slow_query_ms", "proxy_threads", "proxies", "max_body_mb", "auth_enabled"
+    };
+
+    const char* const kProxyKeys[] = {
+        "prefix", "upstreams", "balance", "strip_prefix", "connect_timeout_ms", "timeout_ms", "max_idle", "max_fails",
+        "eject_seconds"
+    };
+
+    bool readString(const JsonValue& root, const char* key, std::string& out, std::string& error) {
+        const JsonValue& value = root[key];
+        if (value.isNull()) return true;
+        if (!value.isString()) {
+            error = std::string(key) + " 必须是字符串";
+            return false;
+        }
+        out = value.asString();
+        return true;
+    }
+
+    bool readBool(const JsonValue& root, const char* key, bool& out, std::string& error) {
+        const JsonValue& value = root[key];
+        if (value.isNull()) return true;
+        if (!value.isBool()) {
+            error = std::string(key) + " 必须是布尔值";
+            return false;
+        }
+        out = value.asBool();
+        return true;
+    }
+
+    bool readNumber(const JsonValue& root, const char* key, double& out, double minValue, std::string& error) {
+        const JsonValue& value = root[key];
+        if (value.isNull()) return true;
+        if (!value.isNumber() || value.asNumber() < minValue) {
+            error = std::string(key) + " 必须是不小于 " + Utils::toString(minValue) + " 的数字";
+            return false;
+        }
+        out = value.asNumber();
+        return true;
+    }
+
+    template<typename Integer>
+    bool readInteger(const JsonValue& root, const char* key, Integer& out, long long minValue, long long maxValue,
+                     std::string& error) {
+        const JsonValue& value = root[key];
+        if (value.isNull()) return true;
+        double number = value.asNumber(-1e300);
+        if (!value.isNumber() || number != std::floor(number) || number < minValue || number > maxValue) {
+            error = std::string(key) + " 必须是 " + std::to_string(minValue) + " 到 " +
+                    std::to_string(maxValue) + " 之间的整数";
+            return false;
+        }
+        out = static_cast<Integer>(number);
+        return true;
+    }
+
+    // proxies: [{"prefix": "/svc", "upstreams": ["127.0.0.1:9001", ...], ...}, ...]
+    // 元素中无法识别的键记为 proxies[i].key
+    bool readProxies(const JsonValue& root, std::vector<ProxyConfig>& out, std::string& error,
+                     std::vector<std::string>* unknownKeys) {
+        const JsonValue& value = root["proxies"];
+        if (value.isNull()) return true;
+        if (!value.isArray()) {
+            error = "proxies 必须是数组";
+            return false;
+        }
+
+        std::vector<ProxyConfig> proxies;
+        for (size_t i = 0; i < value.size(); ++i) {
+            const JsonValue& item = value[i];
+            if (!item.isObject()) {
+                error = "proxies 的元素必须是对象";
+                return false;
+            }
+            ProxyConfig proxy;
+            std::string balance;
+            if (!readString(item, "prefix", proxy.prefix, error) ||
+                !readString(item, "balance", balance, error) ||
+                !readBool(item, "strip_prefix", proxy.stripPrefix, error) ||
+                !readInteger(item, "connect_timeout_ms", proxy.connectTimeoutMs, 1, 600000, error) ||
+                !readInteger(item, "timeout_ms", proxy.timeoutMs, 1, 3600000, error) ||
+                !readInteger(item, "max_idle", proxy.maxIdle, 0, 10000, error) ||
+                !readInteger(item, "max_fails", proxy.maxFails, 1, 1000, error) ||
+                !readInteger(item, "eject_seconds", proxy.ejectSeconds, 1, Upstream::kMaxEjectSeconds, error)) {
+                error = "proxies: " + error;
+                return false;
+            }
+            if (!balance.empty() && !parseProxyBalance(balance, proxy.balance)) {
+                error = "proxies: 未知的负载均衡方式: " + balance;
+                return false;
+            }
+
+            const JsonValue& upstreams = item["upstreams"];
+            if (!upstreams.isArray()) {
+                error = "proxies: upstreams 必须是字符串数组";
+                return false;
+            }
+            for (const JsonValue& upstream : upstreams.elements()) {
+                if (!upstream.isString()) {
+                    error = "proxies: upstreams 必须是字符串数组";
+                    return false;
+                }
+                proxy.upstreams.push_back(upstream.asString());
+            }
+
+            for (const auto& member : item.members()) {
+                if (unknownKeys &&
+                    std::find(std::begin(kProxyKeys), std::end(kProxyKeys), member.first) == std::end(kProxyKeys)) {
+                    unknownKeys->push_back("proxies[" + std::to_string(i) + "]." + member.first);
+                }
+            }
+            if (!ReverseProxy::validate(proxy, error)) {
+                error = "proxies: " + error;
+                return false;
+            }
+            proxies.push_back(std::move(proxy));
+        }
+        out = std::move(proxies);
+        return true;
+    }
+
+    // 列出需要重启才能生效的改动
+    std::vector<std::string> restartRequiredChanges(const ServerConfig& previous, const ServerConfig& current) {
+        std::vector<std::string> changed;
+        if (previous.host != current.host) changed.push_back("host");
+        if (previous.port != current.port) changed.push_back("port");
+        if (previous.database != current.database) changed.push_back("database");
+        if (previous.ioBackend != current.ioBackend) changed.push_back("io_backend");
+        if (previous.cors.enabled != current.cors.enabled || previous.cors.origin != current.cors.origin ||
+            previous.cors.methods != current.cors.methods || previous.cors.headers != current.cors.headers) {
+            changed.push_back("cors_*");
+        }
+        if (previous.proxies != current.proxies) changed.push_back("proxies");
+        if (previous.authEnabled != current.authEnabled) changed.push_back("auth_enabled");
+        return changed;
+    }
+
+    std::string directoryOf(const std::string& path) {
+        size_t slash = path.find_last_of("/\\");
+        if (slash == std::string::npos) return ".";
+        if (slash == 0) return path.substr(0, 1);
+        return path.substr(0, slash);
+    }
+}
+
+bool parseServerConfig(const std::string& text, ServerConfig& config, std::string& error,
+                       std::vector<std::string>* unknownKeys) {
+    JsonValue root;
+    if (!JsonValue::parse(text, root, error)) {
+        error = "JSON格式错误: " + error;
+        return false;
+    }
+    if (!root.isObject()) {
+        error = "配置文件顶层必须是对象";
+        return false;
+    }
+
+    // 先解析到副本，出错时不影响调用方的配置
+    ServerConfig parsed = config;
+
+    std::string ioBackend;
+    std::string logLevel;
+    if (!readString(root, "host", parsed.host, error) ||
+        !readInteger(root, "port", parsed.port, 1, 65535, error) ||
+        !readString(root, "database", parsed.database, error) ||
+        !readString(root, "io_backend", ioBackend, error) ||
+        !readString(root, "log_level", logLevel, error) ||
+        !readInteger(root, "max_connections", parsed.maxConnections, 0, 1000000, error) ||
+        !readInteger(root, "timeout", parsed.timeout, 0, 86400, error) ||
+        !readInteger(root, "header_timeout", parsed.headerTimeout, 0, 86400, error) ||
+        !readInteger(root, "write_timeout", parsed.writeTimeout, 0, 86400, error) ||
+        !readInteger(root, "max_body_mb", parsed.maxBodyMb, 1, 4096, error) ||
+        !readInteger(root, "worker_threads", parsed.workerThreads, 0, 1024, error) ||
+        !readInteger(root, "row_cache_mb", parsed.rowCacheMb, 0, 65536, error) ||
+        !readInteger(root, "log_retention_days", parsed.logRetentionDays, 1, 400, error) ||
+        !readInteger(root, "trace_sample_interval", parsed.traceSampleInterval, 0, 1000000, error) ||
+        !readInteger(root, "slow_query_ms", parsed.slowQueryMs, 0, 3600000, error) ||
+        !readInteger(root, "proxy_threads", parsed.proxyThreads, 1, 1024, error) ||
+        !readProxies(root, parsed.proxies, error, unknownKeys) ||
+        !readNumber(root, "rate_limit_rps", parsed.writeLimit.requestsPerSecond, 0.001, error) ||
+        !readNumber(root, "rate_limit_burst", parsed.writeLimit.burst, 1, error) ||
+        !readBool(root, "auth_enabled", parsed.authEnabled, error) ||
+        !readBool(root, "cors_enabled", parsed.cors.enabled, error) ||
+        !readString(root, "cors_origin", parsed.cors.origin, error) ||
+        !readString(root, "cors_methods", parsed.cors.methods, error) ||
+        !readString(root, "cors_headers", parsed.cors.headers, error)) {
+        return false;
+    }
+
+    if (!ioBackend.empty() && !parseIoBackendType(ioBackend, parsed.ioBackend)) {
+        error = "未知的I/O后端: " + ioBackend;
+        return false;
+    }
+    if (!logLevel.empty() && !parseLogLevel(logLevel, parsed.logLevel)) {
+        error = "未知的日志级别: " + logLevel;
+        return false;
+    }
+
+    if (unknownKeys) {
+        for (const auto& member : root.members()) {
+            if (std::find(std::begin(kKnownKeys), std::end(kKnownKeys), member.first) == std::end(kKnownKeys)) {
+                unknownKeys->push_back(member.first);
+            }
+        }
+    }
+
+    config = std::move(parsed);
+    return true;
+}
+
+ConfigManager::ConfigManager(std::string path)
+    : path_(std::move(path)), current_(std::make_shared<const ServerConfig>()), stopEvent_(NULL) {
+}
+
+ConfigManager::~ConfigManager() {
+    stopWatching();
+}
+
+bool ConfigManager::load() {
+    if (!Utils::fileExists(path_)) {
+        Logger::warn("配置文件 " + path_ + " 不存在，使用默认配置", "config");
+        return true;
+    }
+    return loadFile(true);
+}
+
+bool ConfigManager::reload() {
+    return loadFile(false);
+}
+
+bool ConfigManager::loadFile(bool initial) {
+    std::lock_guard<std::mutex> lock(reloadMutex_);
+
+    std::string content = Utils::readFile(path_);
+    // 同一目录下其他文件的变化也会触发通知，内容没变就不重新发布
+    if (!initial && content == lastContent_) {
+        return true;
+    }
+
+    ServerConfig next;
+    std::string error;
+    std::vector<std::string> unknownKeys;
+    if (!parseServerConfig(content, next, error, &unknownKeys)) {
+        Logger::error("加载配置文件 " + path_ + " 失败: " + error +
+                      (initial ? "" : "，继续使用当前配置"), "config");
+        return false;
+    }
+    for (const auto& key : unknownKeys) {
+        Logger::warn("忽略未知的配置项: " + key, "config");
+    }
+    lastContent_ = std::move(content);
+
+    auto snapshot = std::make_shared<const ServerConfig>(std::move(next));
+    auto previous = current_.exchange(snapshot, std::memory_order_acq_rel);
+    if (initial) {
+        return true;
+    }
+
+    for (const auto& key : restartRequiredChanges(*previous, *snapshot)) {
+        Logger::warn("配置项 " + key + " 的修改需要重启服务器才能生效", "config");
+    }
+    for (const auto& callback : callbacks_) {
+        callback(*previous, *snapshot);
+    }
+    Logger::info("配置已重新加载", "config");
+    return true;
+}
+
+bool ConfigManager::startWatching() {
+    if (watcher_.joinable()) return true;
+
+    // 监视所在目录：编辑器保存时常常先写临时文件再重命名
+    HANDLE change = FindFirstChangeNotificationA(directoryOf(path_).c_str(), FALSE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+    if (change == INVALID_HANDLE_VALUE) {
+        Logger::error("无法监视配置文件目录: " + std::to_string(GetLastError()), "config");
+        return false;
+    }
+
+    stopEvent_ = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (stopEvent_ == NULL) {
+        FindCloseChangeNotification(change);
+        return false;
+    }
+
+    watcher_ = std::thread([this, change]() { watchLoop(change); });
+    return true;
+}
+
+void ConfigManager::stopWatching() {
+    if (!watcher_.joinable()) return;
+
+    SetEvent(stopEvent_);
+    watcher_.join();
+    CloseHandle(stopEvent_);
+    stopEvent_ = NULL;
+}
+
+void ConfigManager::watchLoop(HANDLE change) {
+    HANDLE handles[2] = { stopEvent_, change };
+
+    while (true) {
+        DWORD result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+        if (result != WAIT_OBJECT_0 + 1) break;
+
+        // 一次保存通常触发多次通知，等待写入结束后只加载一次
+        if (WaitForSingleObject(stopEvent_, kDebounceMs) == WAIT_OBJECT_0) break;
+        if (!FindNextChangeNotification(change)) {
+            Logger::error("监视配置文件失败: " + std::to_string(GetLastError()), "config");
+            break;
+        }
+        reload();
+    }
+
+    FindCloseChangeNotification(change);
+}
@@ -0,0 +1,208 @@
+#include "crypto.h"
+#include "id_generator.h"
+#include "utils.h"
+#include <windows.h>
+#include <bcrypt.h>
+#include <charconv>
+#include <cstring>
+#include <vector>
+
+namespace {
+    const char kPasswordScheme[] = "pbkdf2-sha256";
+    const unsigned long long kIterations = 100000;
+    const size_t kSaltLength = 16;
+    const size_t kHashLength = 32;
+
+    bool pbkdf2Sha256(std::string_view password, const uint8_t* salt, size_t saltLength,
+                      unsigned long long iterations, uint8_t* out, size_t outLength) {
+        BCRYPT_ALG_HANDLE algorithm = nullptr;
+        if (!BCRYPT_SUCCESS(BCryptOpenAlgorithmProvider(&algorithm, BCRYPT_SHA256_ALGORITHM, nullptr,
+                                                        BCRYPT_ALG_HANDLE_HMAC_FLAG))) {
+            return false;
+        }
+
+        NTSTATUS status = BCryptDeriveKeyPBKDF2(algorithm,
+            reinterpret_cast<PUCHAR>(const_cast<char*>(password.data())), static_cast<ULONG>(password.size()),
+            const_cast<PUCHAR>(salt), static_cast<ULONG>(saltLength), iterations,
+            out, static_cast<ULONG>(outLength), 0);
+        BCryptCloseAlgorithmProvider(algorithm, 0);
+        return BCRYPT_SUCCESS(status);
+    }
+
+    // SHA-256（FIPS 180-4）的轮常数
+    const uint32_t kSha256Rounds[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    inline uint32_t rotateRight(uint32_t value, int bits) {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    // 压缩一个64字节的块
+    void sha256Block(uint32_t state[8], const uint8_t* block) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (uint32_t(block[4 * i]) << 24) | (uint32_t(block[4 * i + 1]) << 16) |
+                   (uint32_t(block[4 * i + 2]) << 8) | uint32_t(block[4 * i + 3]);
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+            uint32_t choose = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + choose + kSha256Rounds[i] + w[i];
+            uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+            uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + majority;
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+    bool decodeHex(std::string_view text, std::vector<uint8_t>& out) {
+        if (text.size() % 2 != 0) return false;
+
+        out.resize(text.size() / 2);
+        for (size_t i = 0; i < out.size(); ++i) {
+            auto result = std::from_chars(text.data() + 2 * i, text.data() + 2 * i + 2, out[i], 16);
+            if (result.ec != std::errc() || result.ptr != text.data() + 2 * i + 2) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+namespace Crypto {
+
+bool randomBytes(uint8_t* data, size_t length) {
+    return BCRYPT_SUCCESS(BCryptGenRandom(nullptr, data, static_cast<ULONG>(length),
+                                          BCRYPT_USE_SYSTEM_PREFERRED_RNG));
+}
+
+bool sha1(std::string_view data, uint8_t digest[20]) {
+    BCRYPT_ALG_HANDLE algorithm = nullptr;
+    if (!BCRYPT_SUCCESS(BCryptOpenAlgorithmProvider(&algorithm, BCRYPT_SHA1_ALGORITHM, nullptr, 0))) {
+        return false;
+    }
+
+    NTSTATUS status = BCryptHash(algorithm, nullptr, 0,
+        reinterpret_cast<PUCHAR>(const_cast<char*>(data.data())), static_cast<ULONG>(data.size()), digest, 20);
+    BCryptCloseAlgorithmProvider(algorithm, 0);
+    return BCRYPT_SUCCESS(status);
+}
+
+bool sha256(std::string_view data, uint8_t digest[32]) {
+    // 每个带API密钥的请求都要计算，在进程内完成，不经过CNG的算法提供程序和对象分配；
+    // API密钥只有51字节，加上填充正好一个块
+    uint32_t state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    const uint8_t* input = reinterpret_cast<const uint8_t*>(data.data());
+    size_t remaining = data.size();
+    while (remaining >= 64) {
+        sha256Block(state, input);
+        input += 64;
+        remaining -= 64;
+    }
+
+    // 末尾的数据、0x80和以位计的长度（大端），放不下长度时多一个块
+    uint8_t tail[128] = {};
+    std::memcpy(tail, input, remaining);
+    tail[remaining] = 0x80;
+    size_t tailLength = remaining < 56 ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+    for (int i = 0; i < 8; ++i) {
+        tail[tailLength - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    for (size_t offset = 0; offset < tailLength; offset += 64) {
+        sha256Block(state, tail + offset);
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        digest[4 * i] = static_cast<uint8_t>(state[i] >> 24);
+        digest[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[4 * i + 3] = static_cast<uint8_t>(state[i]);
+    }
+    return true;
+}
+
+std::string hashPassword(std::string_view password) {
+    uint8_t salt[kSaltLength];
+    uint8_t hash[kHashLength];
+    if (!randomBytes(salt, sizeof(salt)) ||
+        !pbkdf2Sha256(password, salt, sizeof(salt), kIterations, hash, sizeof(hash))) {
+        return "";
+    }
+
+    std::string result = kPasswordScheme;
+    result += '$';
+    result += std::to_string(kIterations);
+    result += '$';
+    size_t offset = result.size();
+    result.resize(offset + 2 * kSaltLength + 1 + 2 * kHashLength);
+    IdGenerator::writeHex(salt, kSaltLength, &result[offset]);
+    result[offset + 2 * kSaltLength] = '$';
+    IdGenerator::writeHex(hash, kHashLength, &result[offset + 2 * kSaltLength + 1]);
+    return result;
+}
+
+bool verifyPassword(std::string_view password, std::string_view hash) {
+    // scheme$iterations$salt$hash
+    std::string_view parts[4];
+    size_t count = 0;
+    for (std::string_view part : Utils::splitView(hash, '$', false)) {
+        if (count == 4) return false;
+        parts[count++] = part;
+    }
+    if (count != 4 || parts[0] != kPasswordScheme) return false;
+
+    unsigned long long iterations = 0;
+    auto parsed = std::from_chars(parts[1].data(), parts[1].data() + parts[1].size(), iterations);
+    if (parsed.ec != std::errc() || parsed.ptr != parts[1].data() + parts[1].size() || iterations == 0) {
+        return false;
+    }
+
+    std::vector<uint8_t> salt;
+    std::vector<uint8_t> expected;
+    if (!decodeHex(parts[2], salt) || !decodeHex(parts[3], expected) || expected.empty()) {
+        return false;
+    }
+
+    std::vector<uint8_t> actual(expected.size());
+    if (!pbkdf2Sha256(password, salt.data(), salt.size(), iterations, actual.data(), actual.size())) {
+        return false;
+    }
+
+    uint8_t difference = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        difference |= static_cast<uint8_t>(expected[i] ^ actual[i]);
+    }
+    return difference == 0;
+}
+
+} // namespace Crypto
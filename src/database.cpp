@@ -1,10 +1,39 @@
 #include "database.h"
+#include "logger.h"
+#include "tracing.h"
 #include <sqlite3.h>
 #include <iostream>
 #include <sstream>
+#include <cctype>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+    // SQL以keywords之一开头（不区分大小写）
+    bool startsWithKeyword(const char* sql, std::initializer_list<const char*> keywords) {
+        while (*sql && std::isspace(static_cast<unsigned char>(*sql))) ++sql;
+        for (const char* keyword : keywords) {
+            size_t length = std::strlen(keyword);
+            size_t i = 0;
+            while (i < length && sql[i] && std::toupper(static_cast<unsigned char>(sql[i])) == keyword[i]) ++i;
+            if (i == length && !std::isalnum(static_cast<unsigned char>(sql[i]))) return true;
+        }
+        return false;
+    }
+    
+    // INSERT、UPDATE、DELETE、REPLACE 之后 sqlite3_changes() 才是这条语句修改的行数
+    bool isDataChange(const char* sql) {
+        return startsWithKeyword(sql, {"INSERT", "UPDATE", "DELETE", "REPLACE"});
+    }
+    
+    // 有查询计划的语句
+    bool isExplainable(const char* sql) {
+        return startsWithKeyword(sql, {"SELECT", "WITH", "VALUES", "INSERT", "UPDATE", "DELETE", "REPLACE"});
+    }
+}
 
 Database::Database(const std::string& dbPath) 
-    : dbPath_(dbPath), db_(nullptr), connected_(false) {}
+    : dbPath_(dbPath), db_(nullptr), connected_(false), lastErrorCode_(0), rowCache_(kDefaultRowCacheBytes) {}
 
 Database::~Database() {
     disconnect();
@@ -15,23 +44,181 @@ bool Database::connect() {
     
     int result = sqlite3_open(dbPath_.c_str(), &db_);
     if (result != SQLITE_OK) {
-        setLastError("无法打开数据库: " + std::string(sqlite3_errmsg(db_)));
+        setLastError("无法打开数据库: " + std::string(sqlite3_errmsg(db_)), result);
         sqlite3_close(db_);
         db_ = nullptr;
         return false;
     }
     
+    // 行缓存的失效来自本连接上的每一次写入
+    sqlite3_update_hook(db_, &Database::onRowChanged, this);
+    sqlite3_commit_hook(db_, &Database::onCommit, this);
+    sqlite3_rollback_hook(db_, &Database::onRollback, this);
+    
+    // 语句级的性能分析
+    sqlite3_trace_v2(db_, SQLITE_TRACE_STMT | SQLITE_TRACE_ROW | SQLITE_TRACE_PROFILE, &Database::onTrace, this);
+    
     connected_ = true;
     std::cout << "数据库连接成功: " << dbPath_ << std::endl;
     return true;
 }
 
 void Database::disconnect() {
+    clearStatementCache();
+    
     if (db_) {
         sqlite3_close(db_);
         db_ = nullptr;
     }
     connected_ = false;
+    
+    // 重新连接后可能读到外部修改过的数据
+    changedRows_.clear();
+    transactionEnded_ = false;
+    rowCache_.clear();
+}
+
+bool Database::inTransaction() const {
+    return connected_ && !sqlite3_get_autocommit(db_);
+}
+
+void Database::onRowChanged(void* context, int, const char*, const char* table, long long rowid) {
+    // 立即失效，其他线程不会在提交前读到旧行；事务中的填充可能晚于这里，提交时再失效一次
+    auto* database = static_cast<Database*>(context);
+    database->rowCache_.invalidate(table, rowid);
+    if (!sqlite3_get_autocommit(database->db_)) {
+        database->changedRows_.emplace_back(table, rowid);
+    }
+    for (const auto& [name, listener] : database->rowListeners_) {
+        if (name == table) {
+            listener(rowid);
+        }
+    }
+}
+
+void Database::addRowListener(const std::string& table, RowListener listener) {
+    rowListeners_.emplace_back(table, std::move(listener));
+}
+
+void Database::addCommitListener(CommitListener listener) {
+    commitListeners_.push_back(std::move(listener));
+}
+
+int Database::onCommit(void* context) {
+    auto* database = static_cast<Database*>(context);
+    database->flushChangedRows();
+    database->transactionEnded_ = true;
+    return 0;
+}
+
+void Database::onRollback(void* context) {
+    auto* database = static_cast<Database*>(context);
+    database->flushChangedRows();
+    database->transactionEnded_ = true;
+}
+
+void Database::afterStatement() {
+    if (profiler_.planPending()) {
+        capturePlans();
+    }
+    
+    // 钩子里不能使用连接，监听在语句结束后调用；监听自己执行的读语句不会再次触发
+    if (transactionEnded_ && sqlite3_get_autocommit(db_)) {
+        transactionEnded_ = false;
+        for (const auto& listener : commitListeners_) {
+            listener();
+        }
+    }
+}
+
+int Database::onTrace(unsigned type, void* context, void* statement, void* detail) {
+    auto* database = static_cast<Database*>(context);
+    auto* stmt = static_cast<sqlite3_stmt*>(statement);
+    if (type == SQLITE_TRACE_ROW) {
+        database->profiler_.countRow(stmt);
+        return 0;
+    }
+    
+    // EXPLAIN QUERY PLAN 是分析器自己执行的
+    const char* sql = sqlite3_sql(stmt);
+    if (!sql || sqlite3_stmt_isexplain(stmt)) {
+        return 0;
+    }
+    
+    // SQLite自带的耗时来自系统的挂钟时间，Windows上只有毫秒级的精度，改用单调时钟从第一次step开始计时
+    if (type == SQLITE_TRACE_STMT) {
+        database->profiler_.statementStarted(stmt, Tracing::now());
+        return 0;
+    }
+    if (type != SQLITE_TRACE_PROFILE) {
+        return 0;
+    }
+    
+    StatementProfile profile;
+    int64_t started = 0;
+    int64_t now = Tracing::now();
+    if (database->profiler_.takeStatement(stmt, started, profile.rows)) {
+        profile.elapsedNs = static_cast<uint64_t>(now - started);
+    } else {
+        profile.elapsedNs = static_cast<uint64_t>(*static_cast<sqlite3_int64*>(detail));
+    }
+    profile.explainable = isExplainable(sql);
+    if (profile.rows == 0 && !sqlite3_stmt_readonly(stmt) && isDataChange(sql)) {
+        profile.rows = static_cast<uint64_t>(sqlite3_changes(database->db_));
+    }
+    // 计数器读取后清零，缓存的语句下次执行重新计数
+    profile.fullScanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+    profile.sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+    profile.autoIndexes = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+    database->profiler_.record(sql, profile);
+    
+    // 协程处理器 co_await 的数据库任务所属的请求被追踪时，语句也记入追踪
+    if (uint64_t traceId = Tracing::current()) {
+        Tracing::record(traceId, "sql", now - static_cast<int64_t>(profile.elapsedNs), now, sql);
+    }
+    return 0;
+}
+
+void Database::capturePlans() {
+    if (!connected_) return;
+    
+    for (auto& pending : profiler_.takePendingPlans()) {
+        std::string plan;
+        sqlite3_stmt* stmt = nullptr;
+        std::string explain = "EXPLAIN QUERY PLAN " + pending.second;
+        int result = sqlite3_prepare_v2(db_, explain.c_str(), -1, &stmt, nullptr);
+        if (result != SQLITE_OK) {
+            // 不覆盖调用方的错误信息
+            plan = "(无法获取执行计划: " + std::string(sqlite3_errmsg(db_)) + ")";
+        } else {
+            // 每行为 (id, parent, notused, detail)，按parent的层级缩进
+            std::unordered_map<int, int> depth;
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                int id = sqlite3_column_int(stmt, 0);
+                int parent = sqlite3_column_int(stmt, 1);
+                auto it = depth.find(parent);
+                int level = it == depth.end() ? 0 : it->second + 1;
+                depth[id] = level;
+                
+                const unsigned char* text = sqlite3_column_text(stmt, 3);
+                if (!plan.empty()) plan += '\n';
+                plan.append(level * 2, ' ');
+                plan += text ? reinterpret_cast<const char*>(text) : "";
+            }
+            sqlite3_finalize(stmt);
+        }
+        
+        Logger::warn("慢查询（超过 " + std::to_string(profiler_.slowThresholdMs()) + " ms）: " + pending.first +
+                     (plan.empty() ? "" : "\n" + plan), "database");
+        profiler_.setPlan(pending.first, std::move(plan));
+    }
+}
+
+void Database::flushChangedRows() {
+    for (const auto& row : changedRows_) {
+        rowCache_.invalidate(row.first, row.second);
+    }
+    changedRows_.clear();
 }
 
 bool Database::execute(const std::string& sql) {
@@ -42,9 +229,10 @@ bool Database::execute(const std::string& sql) {
     
     char* errorMsg = nullptr;
     int result = sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &errorMsg);
+    afterStatement();
     
     if (result != SQLITE_OK) {
-        setLastError("SQL执行失败: " + std::string(errorMsg));
+        setLastError("SQL执行失败: " + std::string(errorMsg), result);
         sqlite3_free(errorMsg);
         return false;
     }
@@ -84,6 +272,7 @@ ResultSet Database::query(const std::string& sql) {
     }
     
     sqlite3_finalize(stmt);
+    afterStatement();
     return results;
 }
 
@@ -107,6 +296,150 @@ int Database::remove(const std::string& sql) {
     return update(sql);
 }
 
+ResultSet Database::query(const std::string& sql, const std::vector<DbValue>& params) {
+    ResultSet results;
+    std::vector<std::string> columnNames;
+    
+    forEachRow(sql, params, [&](const DbRow& row) {
+        if (columnNames.empty()) {
+            for (int i = 0; i < row.columnCount(); ++i) {
+                columnNames.push_back(getColumnName(row.stmt_, i));
+            }
+        }
+        
+        RowData data;
+        for (int i = 0; i < row.columnCount(); ++i) {
+            data[columnNames[i]] = std::string(row.getText(i));
+        }
+        results.push_back(std::move(data));
+        return true;
+    });
+    
+    return results;
+}
+
+bool Database::forEachRow(const std::string& sql, const std::vector<DbValue>& params,
+                          const std::function<bool(const DbRow&)>& callback) {
+    if (!connected_) {
+        setLastError("数据库未连接");
+        return false;
+    }
+    
+    bool cached = false;
+    sqlite3_stmt* stmt = acquireStatement(sql, params, cached);
+    if (!stmt) {
+        return false;
+    }
+    
+    DbRow row(stmt);
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (!callback(row)) {
+            result = SQLITE_DONE;
+            break;
+        }
+    }
+    
+    bool success = result == SQLITE_DONE;
+    if (!success) {
+        setLastError("SQL执行失败: " + std::string(sqlite3_errmsg(db_)), result);
+    }
+    
+    releaseStatement(stmt, cached);
+    return success;
+}
+
+long long Database::insert(const std::string& sql, const std::vector<DbValue>& params) {
+    if (!executeParameterized(sql, params)) {
+        return -1;
+    }
+    
+    return sqlite3_last_insert_rowid(db_);
+}
+
+int Database::update(const std::string& sql, const std::vector<DbValue>& params) {
+    if (!executeParameterized(sql, params)) {
+        return -1;
+    }
+    
+    return sqlite3_changes(db_);
+}
+
+bool Database::executeParameterized(const std::string& sql, const std::vector<DbValue>& params) {
+    if (!connected_) {
+        setLastError("数据库未连接");
+        return false;
+    }
+    
+    bool cached = false;
+    sqlite3_stmt* stmt = acquireStatement(sql, params, cached);
+    if (!stmt) {
+        return false;
+    }
+    
+    // 写语句可能带有RETURNING，读完所有行
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {}
+    
+    bool success = result == SQLITE_DONE;
+    if (!success) {
+        setLastError("SQL执行失败: " + std::string(sqlite3_errmsg(db_)), result);
+    }
+    
+    releaseStatement(stmt, cached);
+    return success;
+}
+
+sqlite3_stmt* Database::acquireStatement(const std::string& sql, const std::vector<DbValue>& params, bool& cached) {
+    sqlite3_stmt* stmt = nullptr;
+    cached = false;
+    
+    auto it = statements_.find(sql);
+    if (it != statements_.end() && !sqlite3_stmt_busy(it->second)) {
+        stmt = it->second;
+        cached = true;
+    } else {
+        // 长期复用的语句告诉SQLite不要从临时内存池分配
+        unsigned int flags = it == statements_.end() ? SQLITE_PREPARE_PERSISTENT : 0;
+        int result = sqlite3_prepare_v3(db_, sql.c_str(), -1, flags, &stmt, nullptr);
+        if (result != SQLITE_OK) {
+            setLastError("SQL准备失败: " + std::string(sqlite3_errmsg(db_)), result);
+            return nullptr;
+        }
+        
+        if (it == statements_.end()) {
+            statements_.emplace(sql, stmt);
+            cached = true;
+        }
+    }
+    
+    if (!bindParameters(stmt, params)) {
+        releaseStatement(stmt, cached);
+        return nullptr;
+    }
+    
+    return stmt;
+}
+
+void Database::clearStatementCache() {
+    for (auto& entry : statements_) {
+        sqlite3_finalize(entry.second);
+    }
+    statements_.clear();
+}
+
+void Database::releaseStatement(sqlite3_stmt* stmt, bool cached) {
+    if (cached) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    } else {
+        sqlite3_finalize(stmt);
+    }
+    
+    // 慢语句的执行计划和提交监听在语句结束之后处理
+    afterStatement();
+}
+
 bool Database::beginTransaction() {
     return execute("BEGIN TRANSACTION");
 }
@@ -119,17 +452,19 @@ bool Database::rollbackTransaction() {
     return execute("ROLLBACK");
 }
 
-void Database::setLastError(const std::string& error) {
+void Database::setLastError(const std::string& error, int code) {
     lastError_ = error;
+    lastErrorCode_ = code;
     std::cerr << "数据库错误: " << error << std::endl;
 }
 
 bool Database::executeStatement(const std::string& sql) {
     char* errorMsg = nullptr;
     int result = sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &errorMsg);
+    afterStatement();
     
     if (result != SQLITE_OK) {
-        setLastError("SQL执行失败: " + std::string(errorMsg));
+        setLastError("SQL执行失败: " + std::string(errorMsg), result);
         sqlite3_free(errorMsg);
         return false;
     }
@@ -142,18 +477,33 @@ sqlite3_stmt* Database::prepareStatement(const std::string& sql) {
     int result = sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr);
     
     if (result != SQLITE_OK) {
-        setLastError("SQL准备失败: " + std::string(sqlite3_errmsg(db_)));
+        setLastError("SQL准备失败: " + std::string(sqlite3_errmsg(db_)), result);
         return nullptr;
     }
     
     return stmt;
 }
 
-bool Database::bindParameters(sqlite3_stmt* stmt, const std::vector<std::string>& params) {
+bool Database::bindParameters(sqlite3_stmt* stmt, const std::vector<DbValue>& params) {
     for (size_t i = 0; i < params.size(); ++i) {
-        int result = sqlite3_bind_text(stmt, i + 1, params[i].c_str(), -1, SQLITE_TRANSIENT);
+        int index = static_cast<int>(i + 1);
+        const DbValue& param = params[i];
+        
+        int result;
+        if (std::holds_alternative<long long>(param)) {
+            result = sqlite3_bind_int64(stmt, index, std::get<long long>(param));
+        } else if (std::holds_alternative<double>(param)) {
+            result = sqlite3_bind_double(stmt, index, std::get<double>(param));
+        } else if (std::holds_alternative<std::string>(param)) {
+            // 参数在语句执行完之前一直有效，不需要SQLite复制
+            const std::string& text = std::get<std::string>(param);
+            result = sqlite3_bind_text(stmt, index, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+        } else {
+            result = sqlite3_bind_null(stmt, index);
+        }
+        
         if (result != SQLITE_OK) {
-            setLastError("参数绑定失败: " + std::string(sqlite3_errmsg(db_)));
+            setLastError("参数绑定失败: " + std::string(sqlite3_errmsg(db_)), result);
             return false;
         }
     }
@@ -169,6 +519,29 @@ std::string Database::getColumnValue(sqlite3_stmt* stmt, int column) {
     return value ? reinterpret_cast<const char*>(value) : "";
 }
 
+// DbRow 方法实现
+int DbRow::columnCount() const {
+    return sqlite3_column_count(stmt_);
+}
+
+bool DbRow::isNull(int column) const {
+    return sqlite3_column_type(stmt_, column) == SQLITE_NULL;
+}
+
+long long DbRow::getInt(int column) const {
+    return sqlite3_column_int64(stmt_, column);
+}
+
+double DbRow::getDouble(int column) const {
+    return sqlite3_column_double(stmt_, column);
+}
+
+std::string_view DbRow::getText(int column) const {
+    const unsigned char* text = sqlite3_column_text(stmt_, column);
+    if (!text) return std::string_view();
+    return std::string_view(reinterpret_cast<const char*>(text), sqlite3_column_bytes(stmt_, column));
+}
+
 std::string Database::getColumnName(sqlite3_stmt* stmt, int column) {
     const char* name = sqlite3_column_name(stmt, column);
     return name ? name : "";
@@ -179,6 +552,20 @@ bool Database::initializeTables() {
         return false;
     }
     
+    // 删除表后空闲页留在文件中，增量清理模式下可以分批归还（见 ApiLogWriter::maintain）
+    // 已有的数据库需要一次VACUUM才能切换模式
+    long long autoVacuum = 0;
+    forEachRow("PRAGMA auto_vacuum", {}, [&](const DbRow& row) {
+        autoVacuum = row.getInt(0);
+        return false;
+    });
+    if (autoVacuum != 2) {
+        std::cout << "正在切换数据库为增量清理模式..." << std::endl;
+        if (!execute("PRAGMA auto_vacuum = INCREMENTAL") || !execute("VACUUM")) {
+            return false;
+        }
+    }
+    
     // 创建用户表
     std::string createUsersTable = R"(
         CREATE TABLE IF NOT EXISTS users (
@@ -195,21 +582,54 @@ bool Database::initializeTables() {
         return false;
     }
     
-    // 创建API记录表
-    std::string createApiLogsTable = R"(
-        CREATE TABLE IF NOT EXISTS api_logs (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
+    // 覆盖列表查询投影的索引，按id分页时不需要读取包含密码哈希的表行
+    std::string createUsersListIndex = R"(
+        CREATE INDEX IF NOT EXISTS idx_users_list ON users (id, username, email, created_at)
+    )";
+    
+    if (!execute(createUsersListIndex)) {
+        return false;
+    }
+    
+    // API记录按天分区，分区表和 api_logs 视图由 ApiLogWriter::open 创建
+    
+    // 访问日志按分钟、小时、天汇总，由 ApiLogWriter 在写入日志的同一个事务中维护
+    // sketch 为 LatencySketch 序列化后的延迟分布（微秒）
+    for (const char* table : {"api_stats_minute", "api_stats_hour", "api_stats_day"}) {
+        std::string createRollupTable = std::string("CREATE TABLE IF NOT EXISTS ") + table + R"( (
+            bucket INTEGER NOT NULL,
             method TEXT NOT NULL,
-            path TEXT NOT NULL,
+            route TEXT NOT NULL,
             status_code INTEGER NOT NULL,
-            response_time INTEGER,
-            ip_address TEXT,
-            user_agent TEXT,
-            created_at DATETIME DEFAULT CURRENT_TIMESTAMP
+            count INTEGER NOT NULL,
+            total_us INTEGER NOT NULL,
+            min_us INTEGER NOT NULL,
+            max_us INTEGER NOT NULL,
+            sketch TEXT NOT NULL,
+            PRIMARY KEY (bucket, method, route, status_code)
+        ) WITHOUT ROWID)";
+        
+        if (!execute(createRollupTable)) {
+            return false;
+        }
+    }
+    
+    // API密钥只保存SHA-256摘要（十六进制），scopes为逗号分隔的作用域，expires_at为Unix时间（秒）
+    // 吊销的密钥保留记录，revoked_at不为NULL
+    std::string createApiKeysTable = R"(
+        CREATE TABLE IF NOT EXISTS api_keys (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            name TEXT NOT NULL,
+            prefix TEXT NOT NULL,
+            key_hash TEXT UNIQUE NOT NULL,
+            scopes TEXT NOT NULL,
+            created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
+            expires_at INTEGER,
+            revoked_at DATETIME
         )
     )";
     
-    if (!execute(createApiLogsTable)) {
+    if (!execute(createApiKeysTable)) {
         return false;
     }
     
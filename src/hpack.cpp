@@ -0,0 +1,499 @@
+#include "hpack.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+    struct StaticEntry {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    // RFC 7541 附录A，索引从1开始
+    const StaticEntry kStaticTable[] = {
+        {":authority", ""},
+        {":method", "GET"},
+        {":method", "POST"},
+        {":path", "/"},
+        {":path", "/index.html"},
+        {":scheme", "http"},
+        {":scheme", "https"},
+        {":status", "200"},
+        {":status", "204"},
+        {":status", "206"},
+        {":status", "304"},
+        {":status", "400"},
+        {":status", "404"},
+        {":status", "500"},
+        {"accept-charset", ""},
+        {"accept-encoding", "gzip, deflate"},
+        {"accept-language", ""},
+        {"accept-ranges", ""},
+        {"accept", ""},
+        {"access-control-allow-origin", ""},
+        {"age", ""},
+        {"allow", ""},
+        {"authorization", ""},
+        {"cache-control", ""},
+        {"content-disposition", ""},
+        {"content-encoding", ""},
+        {"content-language", ""},
+        {"content-length", ""},
+        {"content-location", ""},
+        {"content-range", ""},
+        {"content-type", ""},
+        {"cookie", ""},
+        {"date", ""},
+        {"etag", ""},
+        {"expect", ""},
+        {"expires", ""},
+        {"from", ""},
+        {"host", ""},
+        {"if-match", ""},
+        {"if-modified-since", ""},
+        {"if-none-match", ""},
+        {"if-range", ""},
+        {"if-unmodified-since", ""},
+        {"last-modified", ""},
+        {"link", ""},
+        {"location", ""},
+        {"max-forwards", ""},
+        {"proxy-authenticate", ""},
+        {"proxy-authorization", ""},
+        {"range", ""},
+        {"referer", ""},
+        {"refresh", ""},
+        {"retry-after", ""},
+        {"server", ""},
+        {"set-cookie", ""},
+        {"strict-transport-security", ""},
+        {"transfer-encoding", ""},
+        {"user-agent", ""},
+        {"vary", ""},
+        {"via", ""},
+        {"www-authenticate", ""}
+    };
+    const size_t kStaticCount = sizeof(kStaticTable) / sizeof(kStaticTable[0]);
+
+    // RFC 7541 附录B，按符号0-255和EOS（256）排列，码字右对齐
+    const uint32_t kHuffmanCodes[257] = {
+        0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+        0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+        0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+        0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+        0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+        0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+        0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+        0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+        0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+        0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+        0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+        0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+        0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+        0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+        0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+        0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+        0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+        0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+        0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+        0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+        0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+        0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+        0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+        0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+        0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+        0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+        0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+        0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+        0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+        0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+        0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+        0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+        0x3fffffff
+    };
+
+    const uint8_t kHuffmanLengths[257] = {
+        13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+        28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+        6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+        5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+        13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+        7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+        15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+        6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+        20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+        24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+        22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+        21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+        26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+        19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+        20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+        26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+        30
+    };
+
+    const int kMaxCodeLength = 30;
+    const uint16_t kEos = 256;
+
+    // 码表是规范Huffman码：同一长度的码字按符号顺序连续递增，各长度的码字左对齐后首尾相接。
+    // 解码时取接下来的32位左对齐，第一个满足 window < limit[len] 的len就是码长，不需要逐位遍历码树
+    struct HuffmanDecodeTable {
+        uint64_t limit[kMaxCodeLength + 1] = {};   // 长度不超过len的码字左对齐后的上界（不含）
+        uint32_t first[kMaxCodeLength + 1] = {};   // 长度为len的第一个码字
+        uint16_t offset[kMaxCodeLength + 1] = {};  // 长度为len的第一个符号在symbols中的位置
+        uint16_t symbols[257] = {};                // 按 (码长, 符号) 排序
+        int minLength = kMaxCodeLength;
+
+        HuffmanDecodeTable() {
+            uint16_t count[kMaxCodeLength + 1] = {};
+            for (int symbol = 0; symbol < 257; ++symbol) {
+                ++count[kHuffmanLengths[symbol]];
+                minLength = std::min(minLength, static_cast<int>(kHuffmanLengths[symbol]));
+            }
+
+            uint16_t next[kMaxCodeLength + 1] = {};
+            uint16_t position = 0;
+            for (int len = 1; len <= kMaxCodeLength; ++len) {
+                offset[len] = next[len] = position;
+                position += count[len];
+            }
+            for (int symbol = 0; symbol < 257; ++symbol) {
+                symbols[next[kHuffmanLengths[symbol]]++] = static_cast<uint16_t>(symbol);
+            }
+
+            for (int len = 1; len <= kMaxCodeLength; ++len) {
+                if (count[len] == 0) {
+                    limit[len] = limit[len - 1];
+                    continue;
+                }
+                first[len] = kHuffmanCodes[symbols[offset[len]]];
+                limit[len] = (static_cast<uint64_t>(first[len]) + count[len]) << (32 - len);
+            }
+        }
+    };
+
+    const HuffmanDecodeTable& decodeTable() {
+        static const HuffmanDecodeTable table;
+        return table;
+    }
+
+    bool decodeString(std::string_view data, size_t& pos, std::string& out) {
+        if (pos >= data.size()) return false;
+        bool huffman = (static_cast<uint8_t>(data[pos]) & 0x80) != 0;
+
+        uint64_t length = 0;
+        if (!Hpack::decodeInteger(data, pos, 7, length) || length > data.size() - pos) {
+            return false;
+        }
+        std::string_view raw = data.substr(pos, static_cast<size_t>(length));
+        pos += static_cast<size_t>(length);
+
+        if (huffman) {
+            out.clear();
+            return Hpack::huffmanDecode(raw, out);
+        }
+        out.assign(raw);
+        return true;
+    }
+}
+
+// HpackTable
+void HpackTable::add(std::string name, std::string value) {
+    size_t size = name.size() + value.size() + kEntryOverhead;
+
+    // 比整张表还大的条目使表清空，本身不加入
+    if (size > capacity_) {
+        entries_.clear();
+        size_ = 0;
+        return;
+    }
+
+    evict(capacity_ - size);
+    size_ += size;
+    entries_.push_front(HeaderField{std::move(name), std::move(value)});
+}
+
+void HpackTable::setCapacity(size_t capacity) {
+    capacity_ = capacity;
+    evict(capacity);
+}
+
+void HpackTable::evict(size_t limit) {
+    while (size_ > limit) {
+        const HeaderField& oldest = entries_.back();
+        size_ -= oldest.name.size() + oldest.value.size() + kEntryOverhead;
+        entries_.pop_back();
+    }
+}
+
+// HpackDecoder
+bool HpackDecoder::lookup(uint64_t index, std::string_view& name, std::string_view& value) const {
+    if (index == 0) return false;
+
+    if (index <= kStaticCount) {
+        name = kStaticTable[index - 1].name;
+        value = kStaticTable[index - 1].value;
+        return true;
+    }
+
+    index -= kStaticCount + 1;
+    if (index >= table_.count()) return false;
+    const HeaderField& field = table_.at(static_cast<size_t>(index));
+    name = field.name;
+    value = field.value;
+    return true;
+}
+
+bool HpackDecoder::decode(std::string_view block, std::vector<HeaderField>& headers) {
+    size_t pos = 0;
+    bool fieldSeen = false;
+
+    while (pos < block.size()) {
+        uint8_t first = static_cast<uint8_t>(block[pos]);
+        std::string_view name;
+        std::string_view value;
+
+        // 1xxxxxxx 索引字段
+        if (first & 0x80) {
+            uint64_t index = 0;
+            if (!Hpack::decodeInteger(block, pos, 7, index) || !lookup(index, name, value)) {
+                return false;
+            }
+            headers.push_back(HeaderField{std::string(name), std::string(value)});
+            fieldSeen = true;
+            continue;
+        }
+
+        // 001xxxxx 动态表大小更新，只能出现在头部块开头
+        if ((first & 0xe0) == 0x20) {
+            uint64_t size = 0;
+            if (fieldSeen || !Hpack::decodeInteger(block, pos, 5, size) || size > maxTableSize_) {
+                return false;
+            }
+            table_.setCapacity(static_cast<size_t>(size));
+            continue;
+        }
+
+        // 01xxxxxx 字面量并加入动态表；0000xxxx 不加入；0001xxxx 永不索引
+        bool indexing = (first & 0xc0) == 0x40;
+        uint64_t index = 0;
+        if (!Hpack::decodeInteger(block, pos, indexing ? 6 : 4, index)) {
+            return false;
+        }
+
+        HeaderField field;
+        if (index == 0) {
+            if (!decodeString(block, pos, field.name)) return false;
+        } else {
+            if (!lookup(index, name, value)) return false;
+            field.name.assign(name);
+        }
+        if (!decodeString(block, pos, field.value)) return false;
+
+        if (indexing) {
+            table_.add(field.name, field.value);
+        }
+        headers.push_back(std::move(field));
+        fieldSeen = true;
+    }
+    return true;
+}
+
+// HpackEncoder
+void HpackEncoder::setMaxTableSize(size_t size) {
+    size_t capacity = std::min(size, kDefaultTableSize);
+    minTableSize_ = std::min(minTableSize_, capacity);
+    if (capacity != table_.capacity()) {
+        table_.setCapacity(capacity);
+        tableSizeChanged_ = true;
+    }
+}
+
+void HpackEncoder::beginBlock(std::string& out) {
+    if (!tableSizeChanged_) return;
+
+    // 两个头部块之间多次修改时，先通知其中最小的值，再通知最终的值
+    if (minTableSize_ < table_.capacity()) {
+        Hpack::encodeInteger(minTableSize_, 5, 0x20, out);
+    }
+    Hpack::encodeInteger(table_.capacity(), 5, 0x20, out);
+    tableSizeChanged_ = false;
+    minTableSize_ = table_.capacity();
+}
+
+size_t HpackEncoder::findDynamic(std::string_view name, std::string_view value, bool& exact) const {
+    // 动态表最多约一百个条目，线性查找
+    size_t nameIndex = 0;
+    exact = false;
+    for (size_t i = 0; i < table_.count(); ++i) {
+        const HeaderField& field = table_.at(i);
+        if (field.name != name) continue;
+        if (field.value == value) {
+            exact = true;
+            return kStaticCount + 1 + i;
+        }
+        if (nameIndex == 0) {
+            nameIndex = kStaticCount + 1 + i;
+        }
+    }
+    return nameIndex;
+}
+
+void HpackEncoder::encode(std::string_view name, std::string_view value, std::string& out, bool indexed) {
+    // 先查静态表，完全相同的字段只需一个字节
+    bool exact = false;
+    size_t index = Hpack::findStatic(name, value, exact);
+    if (!exact) {
+        bool dynamicExact = false;
+        size_t dynamicIndex = findDynamic(name, value, dynamicExact);
+        if (dynamicExact || index == 0) {
+            index = dynamicIndex;
+            exact = dynamicExact;
+        }
+    }
+
+    if (exact) {
+        Hpack::encodeInteger(index, 7, 0x80, out);
+        return;
+    }
+
+    Hpack::encodeInteger(index, indexed ? 6 : 4, indexed ? 0x40 : 0x00, out);
+    if (index == 0) {
+        Hpack::encodeString(name, out);
+    }
+    Hpack::encodeString(value, out);
+
+    if (indexed) {
+        table_.add(std::string(name), std::string(value));
+    }
+}
+
+// Hpack
+void Hpack::encodeInteger(uint64_t value, int prefixBits, uint8_t first, std::string& out) {
+    uint64_t max = (uint64_t(1) << prefixBits) - 1;
+    if (value < max) {
+        out.push_back(static_cast<char>(first | value));
+        return;
+    }
+
+    out.push_back(static_cast<char>(first | max));
+    value -= max;
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool Hpack::decodeInteger(std::string_view data, size_t& pos, int prefixBits, uint64_t& value) {
+    if (pos >= data.size()) return false;
+
+    uint64_t max = (uint64_t(1) << prefixBits) - 1;
+    value = static_cast<uint8_t>(data[pos++]) & max;
+    if (value < max) return true;
+
+    // 长度和索引都不会超过32位，更长的编码视为错误
+    for (int shift = 0; shift <= 28 && pos < data.size(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        value += static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+void Hpack::encodeString(std::string_view str, std::string& out) {
+    size_t huffman = huffmanLength(str);
+    if (huffman < str.size()) {
+        encodeInteger(huffman, 7, 0x80, out);
+        huffmanEncode(str, out);
+    } else {
+        encodeInteger(str.size(), 7, 0x00, out);
+        out.append(str);
+    }
+}
+
+size_t Hpack::huffmanLength(std::string_view str) {
+    size_t bits = 0;
+    for (char c : str) {
+        bits += kHuffmanLengths[static_cast<uint8_t>(c)];
+    }
+    return (bits + 7) / 8;
+}
+
+void Hpack::huffmanEncode(std::string_view str, std::string& out) {
+    // 低count位是尚未写出的位，码长不超过30，不会溢出
+    uint64_t bits = 0;
+    int count = 0;
+    for (char c : str) {
+        uint8_t symbol = static_cast<uint8_t>(c);
+        bits = (bits << kHuffmanLengths[symbol]) | kHuffmanCodes[symbol];
+        count += kHuffmanLengths[symbol];
+        while (count >= 8) {
+            count -= 8;
+            out.push_back(static_cast<char>(bits >> count));
+        }
+    }
+
+    // 用EOS的前缀（全1）填充到字节边界
+    if (count > 0) {
+        out.push_back(static_cast<char>((bits << (8 - count)) | (0xff >> count)));
+    }
+}
+
+bool Hpack::huffmanDecode(std::string_view data, std::string& out) {
+    const HuffmanDecodeTable& table = decodeTable();
+
+    // 待解码的位左对齐存放在bits中
+    uint64_t bits = 0;
+    int available = 0;
+    size_t pos = 0;
+
+    while (true) {
+        while (available <= 56 && pos < data.size()) {
+            bits |= static_cast<uint64_t>(static_cast<uint8_t>(data[pos++])) << (56 - available);
+            available += 8;
+        }
+        if (available == 0) return true;
+
+        uint64_t window = bits >> 32;
+        int len = table.minLength;
+        while (window >= table.limit[len]) {
+            ++len;
+        }
+
+        // 剩余的位不足一个码字：只能是不超过7位、全为1的填充
+        if (len > available) {
+            uint64_t padding = ((uint64_t(1) << available) - 1) << (32 - available);
+            return available < 8 && window == padding;
+        }
+
+        uint16_t symbol = table.symbols[table.offset[len] + ((window >> (32 - len)) - table.first[len])];
+        if (symbol == kEos) return false;
+
+        out.push_back(static_cast<char>(symbol));
+        bits <<= len;
+        available -= len;
+    }
+}
+
+size_t Hpack::findStatic(std::string_view name, std::string_view value, bool& exact) {
+    // 名称到第一个索引的映射，同名的条目在静态表中相邻
+    static const std::unordered_map<std::string_view, size_t> byName = []() {
+        std::unordered_map<std::string_view, size_t> map;
+        for (size_t i = 0; i < kStaticCount; ++i) {
+            map.emplace(kStaticTable[i].name, i + 1);
+        }
+        return map;
+    }();
+
+    exact = false;
+    auto it = byName.find(name);
+    if (it == byName.end()) return 0;
+
+    for (size_t index = it->second; index <= kStaticCount && kStaticTable[index - 1].name == name; ++index) {
+        if (kStaticTable[index - 1].value == value) {
+            exact = true;
+            return index;
+        }
+    }
+    return it->second;
+}
@@ -0,0 +1,167 @@
+#include "http.h"
+#include "coarse_clock.h"
+
+// HttpRequest 方法实现
+std::string HttpRequest::getQueryParam(const std::string& key) const {
+    auto it = queryParams.find(key);
+    return (it != queryParams.end()) ? it->second : "";
+}
+
+std::string HttpRequest::getHeader(const std::string& key) const {
+    auto it = headers.find(key);
+    return (it != headers.end()) ? it->second : "";
+}
+
+std::string HttpRequest::getParam(const std::string& key) const {
+    return std::string(paramView(key));
+}
+
+std::string_view HttpRequest::paramView(std::string_view key) const {
+    const MatchedParam* param = findRouteParam(key, true);
+    return param ? std::string_view(path).substr(param->offset, param->length) : std::string_view();
+}
+
+long long HttpRequest::getInt(std::string_view key, long long defaultValue) const {
+    const MatchedParam* param = findRouteParam(key, false);
+    if (!param || param->value.type != ParamType::Int) {
+        return defaultValue;
+    }
+    return param->value.intValue;
+}
+
+double HttpRequest::getDouble(std::string_view key, double defaultValue) const {
+    const MatchedParam* param = findRouteParam(key, false);
+    if (!param) return defaultValue;
+    
+    switch (param->value.type) {
+        case ParamType::Int: return static_cast<double>(param->value.intValue);
+        case ParamType::Double: return param->value.doubleValue;
+        default: return defaultValue;
+    }
+}
+
+const MatchedParam* HttpRequest::findRouteParam(std::string_view key, bool inPath) const {
+    // 参数只有几个，线性查找比map更快
+    for (size_t i = 0; i < routeParamCount; ++i) {
+        if (routeParams[i].name == key && (routeParams[i].inPath || !inPath)) {
+            return &routeParams[i];
+        }
+    }
+    return nullptr;
+}
+
+// HttpResponse 方法实现
+HttpResponse::HttpResponse() : statusCode(200) {
+    headers["Content-Type"] = "text/plain";
+    headers["Server"] = "APIManager/1.0";
+}
+
+HttpResponse& HttpResponse::status(int code) {
+    statusCode = code;
+    return *this;
+}
+
+HttpResponse& HttpResponse::header(const std::string& key, const std::string& value) {
+    headers[key] = value;
+    return *this;
+}
+
+HttpResponse& HttpResponse::json(const std::string& jsonData) {
+    headers["Content-Type"] = "application/json";
+    body = jsonData;
+    return *this;
+}
+
+HttpResponse& HttpResponse::text(const std::string& text) {
+    headers["Content-Type"] = "text/plain";
+    body = text;
+    return *this;
+}
+
+void HttpResponse::appendHead(std::string& out) const {
+    // 状态行
+    const char* statusText;
+    switch (statusCode) {
+        case 200: statusText = "OK"; break;
+        case 201: statusText = "Created"; break;
+        case 204: statusText = "No Content"; break;
+        case 301: statusText = "Moved Permanently"; break;
+        case 302: statusText = "Found"; break;
+        case 304: statusText = "Not Modified"; break;
+        case 400: statusText = "Bad Request"; break;
+        case 401: statusText = "Unauthorized"; break;
+        case 403: statusText = "Forbidden"; break;
+        case 404: statusText = "Not Found"; break;
+        case 405: statusText = "Method Not Allowed"; break;
+        case 408: statusText = "Request Timeout"; break;
+        case 409: statusText = "Conflict"; break;
+        case 411: statusText = "Length Required"; break;
+        case 413: statusText = "Payload Too Large"; break;
+        case 417: statusText = "Expectation Failed"; break;
+        case 426: statusText = "Upgrade Required"; break;
+        case 429: statusText = "Too Many Requests"; break;
+        case 431: statusText = "Request Header Fields Too Large"; break;
+        case 500: statusText = "Internal Server Error"; break;
+        case 502: statusText = "Bad Gateway"; break;
+        case 503: statusText = "Service Unavailable"; break;
+        case 504: statusText = "Gateway Timeout"; break;
+        default: statusText = "Unknown"; break;
+    }
+    
+    out += "HTTP/1.1 ";
+    out += std::to_string(statusCode);
+    out += ' ';
+    out += statusText;
+    out += "\r\n";
+    
+    // 日期由时钟服务预先格式化，处理器设置了Date时以处理器为准
+    if (headers.find("Date") == headers.end()) {
+        out += "Date: ";
+        CoarseClock::appendHttpDate(out);
+        out += "\r\n";
+    }
+    
+    // 头部，值中的换行分隔同名头部的多个值（如多个Set-Cookie）
+    for (const auto& header : headers) {
+        std::string_view value = header.second;
+        while (true) {
+            size_t end = value.find('\n');
+            out += header.first;
+            out += ": ";
+            out += value.substr(0, end);
+            out += "\r\n";
+            if (end == std::string_view::npos) break;
+            value.remove_prefix(end + 1);
+        }
+    }
+}
+
+std::string HttpResponse::toString() const {
+    std::string out;
+    out.reserve(128 + body.size());
+    appendHead(out);
+    
+    // 内容长度（204响应不能携带；处理器自己设置时以处理器为准，如HEAD响应）
+    if (statusCode != 204 && headers.find("Content-Length") == headers.end()) {
+        out += "Content-Length: ";
+        out += std::to_string(body.length());
+        out += "\r\n";
+    }
+    
+    // 空行和正文
+    out += "\r\n";
+    out += body;
+    
+    return out;
+}
+
+std::string HttpResponse::toStreamHead(bool chunked) const {
+    std::string out;
+    out.reserve(128);
+    appendHead(out);
+    if (chunked) {
+        out += "Transfer-Encoding: chunked\r\n";
+    }
+    out += "\r\n";
+    return out;
+}
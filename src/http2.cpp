@@ -0,0 +1,664 @@
+#include "http2.h"
+#include "utils.h"
+#include "coarse_clock.h"
+#include <algorithm>
+#include <charconv>
+
+namespace {
+    const size_t kFrameHeaderSize = 9;
+
+    // 帧类型
+    const uint8_t kData = 0x0;
+    const uint8_t kHeaders = 0x1;
+    const uint8_t kPriority = 0x2;
+    const uint8_t kRstStream = 0x3;
+    const uint8_t kSettings = 0x4;
+    const uint8_t kPushPromise = 0x5;
+    const uint8_t kPing = 0x6;
+    const uint8_t kGoAway = 0x7;
+    const uint8_t kWindowUpdate = 0x8;
+    const uint8_t kContinuation = 0x9;
+
+    // 帧标志
+    const uint8_t kFlagEndStream = 0x1;
+    const uint8_t kFlagAck = 0x1;
+    const uint8_t kFlagEndHeaders = 0x4;
+    const uint8_t kFlagPadded = 0x8;
+    const uint8_t kFlagPriority = 0x20;
+
+    // SETTINGS参数
+    const uint16_t kSettingsHeaderTableSize = 0x1;
+    const uint16_t kSettingsEnablePush = 0x2;
+    const uint16_t kSettingsMaxConcurrentStreams = 0x3;
+    const uint16_t kSettingsInitialWindowSize = 0x4;
+    const uint16_t kSettingsMaxFrameSize = 0x5;
+    const uint16_t kSettingsMaxHeaderListSize = 0x6;
+
+    const int64_t kMaxWindow = 0x7fffffff;
+    const uint32_t kDefaultWindow = 65535;
+
+    uint32_t readUint32(const char* data) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    void appendUint32(std::string& out, uint32_t value) {
+        out.push_back(static_cast<char>(value >> 24));
+        out.push_back(static_cast<char>(value >> 16));
+        out.push_back(static_cast<char>(value >> 8));
+        out.push_back(static_cast<char>(value));
+    }
+
+    void appendSetting(std::string& out, uint16_t id, uint32_t value) {
+        out.push_back(static_cast<char>(id >> 8));
+        out.push_back(static_cast<char>(id));
+        appendUint32(out, value);
+    }
+
+    // 去掉PADDED标志的填充，填充长度超出负载时返回false
+    bool stripPadding(uint8_t flags, std::string_view& payload) {
+        if (!(flags & kFlagPadded)) return true;
+        if (payload.empty()) return false;
+
+        size_t padding = static_cast<uint8_t>(payload[0]);
+        if (padding >= payload.size()) return false;
+        payload = payload.substr(1, payload.size() - 1 - padding);
+        return true;
+    }
+
+    // 逐跳头部只属于HTTP/1.1的一个连接，在HTTP/2中禁止出现
+    bool isConnectionHeader(std::string_view name) {
+        return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+               name == "transfer-encoding" || name == "upgrade";
+    }
+}
+
+Http2Session::Http2Session(size_t maxHeaderListSize, size_t maxBodySize)
+    : maxHeaderListSize_(maxHeaderListSize), maxBodySize_(maxBodySize) {
+    // 服务器前言：SETTINGS，随后把连接的接收窗口从默认的64KB扩大
+    std::string settings;
+    appendSetting(settings, kSettingsMaxConcurrentStreams, kMaxConcurrentStreams);
+    appendSetting(settings, kSettingsInitialWindowSize, kStreamWindow);
+    appendSetting(settings, kSettingsMaxHeaderListSize, static_cast<uint32_t>(maxHeaderListSize_));
+    writeFrameHeader(settings.size(), kSettings, 0, 0);
+    output_ += settings;
+    writeWindowUpdate(0, kConnectionWindow - kDefaultWindow);
+}
+
+bool Http2Session::upgrade(std::string_view settings) {
+    std::string payload;
+    Http2Error error;
+    if (!Utils::base64Decode(settings, payload) || payload.size() % 6 != 0 || !applySettings(payload, error)) {
+        return false;
+    }
+
+    // 升级的请求已经通过HTTP/1.1收齐，流1处于半关闭（远端）状态
+    Stream stream;
+    stream.sendWindow = peerInitialWindow_;
+    stream.remoteClosed = true;
+    streams_.emplace(1, std::move(stream));
+    lastStreamId_ = 1;
+    return true;
+}
+
+bool Http2Session::receive(std::string& inBuffer, std::vector<Http2Request>& requests) {
+    if (failed_) return false;
+
+    size_t pos = 0;
+    if (!prefaceReceived_) {
+        size_t length = std::min(inBuffer.size(), kPreface.size());
+        if (inBuffer.compare(0, length, kPreface.data(), length) != 0) {
+            return connectionError(Http2Error::ProtocolError);
+        }
+        if (length < kPreface.size()) return true;
+        prefaceReceived_ = true;
+        pos = kPreface.size();
+    }
+
+    bool ok = true;
+    while (ok && inBuffer.size() - pos >= kFrameHeaderSize) {
+        const unsigned char* header = reinterpret_cast<const unsigned char*>(inBuffer.data() + pos);
+        size_t length = (size_t(header[0]) << 16) | (size_t(header[1]) << 8) | size_t(header[2]);
+        if (length > kMaxFrameSize) {
+            ok = connectionError(Http2Error::FrameSizeError);
+            break;
+        }
+        if (inBuffer.size() - pos - kFrameHeaderSize < length) break;
+
+        uint8_t type = header[3];
+        uint8_t flags = header[4];
+        uint32_t streamId = readUint32(inBuffer.data() + pos + 5) & 0x7fffffff;
+        std::string_view payload(inBuffer.data() + pos + kFrameHeaderSize, length);
+        pos += kFrameHeaderSize + length;
+
+        ok = handleFrame(type, flags, streamId, payload, requests);
+    }
+
+    inBuffer.erase(0, pos);
+    return ok;
+}
+
+bool Http2Session::handleFrame(uint8_t type, uint8_t flags, uint32_t streamId, std::string_view payload,
+                               std::vector<Http2Request>& requests) {
+    if (headerStreamId_ != 0 && (type != kContinuation || streamId != headerStreamId_)) {
+        return connectionError(Http2Error::ProtocolError);
+    }
+    // 客户端前言之后的第一帧必须是SETTINGS
+    if (!settingsReceived_ && type != kSettings) {
+        return connectionError(Http2Error::ProtocolError);
+    }
+
+    switch (type) {
+        case kData:
+            return onDataFrame(flags, streamId, payload, requests);
+
+        case kHeaders:
+            return onHeadersFrame(flags, streamId, payload, requests);
+
+        case kContinuation:
+            return onContinuationFrame(flags, streamId, payload, requests);
+
+        case kSettings:
+            return onSettingsFrame(flags, streamId, payload);
+
+        case kWindowUpdate:
+            return onWindowUpdateFrame(streamId, payload);
+
+        case kPriority:
+            // 不按优先级调度，只检查格式
+            if (streamId == 0) return connectionError(Http2Error::ProtocolError);
+            if (payload.size() != 5) resetStream(streamId, Http2Error::FrameSizeError);
+            return true;
+
+        case kRstStream:
+            if (payload.size() != 4) return connectionError(Http2Error::FrameSizeError);
+            if (streamId == 0 || streamId > lastStreamId_) return connectionError(Http2Error::ProtocolError);
+            // 处理器仍会结束，其响应被忽略
+            streams_.erase(streamId);
+            return true;
+
+        case kPing:
+            if (payload.size() != 8) return connectionError(Http2Error::FrameSizeError);
+            if (streamId != 0) return connectionError(Http2Error::ProtocolError);
+            if (!(flags & kFlagAck)) {
+                writeFrameHeader(payload.size(), kPing, kFlagAck, 0);
+                output_.append(payload);
+            }
+            return true;
+
+        case kGoAway:
+            if (streamId != 0) return connectionError(Http2Error::ProtocolError);
+            if (payload.size() < 8) return connectionError(Http2Error::FrameSizeError);
+            // 已打开的流照常完成，之后由服务器关闭连接
+            goAwayReceived_ = true;
+            return true;
+
+        case kPushPromise:
+            // 客户端不能推送
+            return connectionError(Http2Error::ProtocolError);
+
+        default:
+            // 忽略未知类型的帧
+            return true;
+    }
+}
+
+bool Http2Session::onDataFrame(uint8_t flags, uint32_t streamId, std::string_view payload,
+                               std::vector<Http2Request>& requests) {
+    if (streamId == 0) return connectionError(Http2Error::ProtocolError);
+
+    // 流量控制按整个负载计算，包括填充
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    if (length > connRecvWindow_) return connectionError(Http2Error::FlowControlError);
+    connRecvWindow_ -= length;
+    connRecvUnacked_ += length;
+
+    if (!stripPadding(flags, payload)) return connectionError(Http2Error::ProtocolError);
+
+    auto it = streams_.find(streamId);
+    if (it == streams_.end()) {
+        if (streamId > lastStreamId_) return connectionError(Http2Error::ProtocolError);
+        // 已经重置的流，对端可能还没收到RST_STREAM，忽略
+    } else if (it->second.remoteClosed) {
+        resetStream(streamId, Http2Error::StreamClosed);
+    } else if (length > it->second.recvWindow) {
+        resetStream(streamId, Http2Error::FlowControlError);
+    } else if (!it->second.responding) {
+        // 已经拒绝的请求（响应正在发送）丢弃剩余的请求体
+        Stream& stream = it->second;
+        stream.recvWindow -= length;
+        stream.request.body.append(payload);
+
+        if (stream.request.body.size() > maxBodySize_) {
+            rejectStream(streamId, 413, "Payload Too Large");
+        } else if (flags & kFlagEndStream) {
+            endOfRequest(it, requests);
+        } else {
+            stream.recvUnacked += length;
+            if (stream.recvUnacked >= kStreamWindow / 2) {
+                writeWindowUpdate(streamId, stream.recvUnacked);
+                stream.recvWindow += stream.recvUnacked;
+                stream.recvUnacked = 0;
+            }
+        }
+    }
+
+    // 连接窗口总是补充，单个流的积压由maxBodySize限制
+    if (connRecvUnacked_ >= kConnectionWindow / 2) {
+        writeWindowUpdate(0, connRecvUnacked_);
+        connRecvWindow_ += connRecvUnacked_;
+        connRecvUnacked_ = 0;
+    }
+    return true;
+}
+
+bool Http2Session::onHeadersFrame(uint8_t flags, uint32_t streamId, std::string_view payload,
+                                  std::vector<Http2Request>& requests) {
+    // 客户端发起的流ID为奇数
+    if (streamId == 0 || streamId % 2 == 0) return connectionError(Http2Error::ProtocolError);
+    if (!stripPadding(flags, payload)) return connectionError(Http2Error::ProtocolError);
+
+    // 优先级字段不使用
+    if (flags & kFlagPriority) {
+        if (payload.size() < 5) return connectionError(Http2Error::FrameSizeError);
+        payload.remove_prefix(5);
+    }
+    if (payload.size() > maxHeaderListSize_) return connectionError(Http2Error::EnhanceYourCalm);
+
+    headerBlock_.assign(payload);
+    headerFlags_ = flags;
+    if (!(flags & kFlagEndHeaders)) {
+        headerStreamId_ = streamId;
+        return true;
+    }
+
+    return onHeaderBlock(streamId, requests);
+}
+
+bool Http2Session::onContinuationFrame(uint8_t flags, uint32_t streamId, std::string_view payload,
+                                       std::vector<Http2Request>& requests) {
+    if (headerStreamId_ == 0) return connectionError(Http2Error::ProtocolError);
+
+    // 头部块必须完整解码才能保持动态表同步，过大的块只能断开连接
+    headerBlock_.append(payload);
+    if (headerBlock_.size() > maxHeaderListSize_) return connectionError(Http2Error::EnhanceYourCalm);
+    if (!(flags & kFlagEndHeaders)) return true;
+
+    headerStreamId_ = 0;
+    return onHeaderBlock(streamId, requests);
+}
+
+bool Http2Session::onHeaderBlock(uint32_t streamId, std::vector<Http2Request>& requests) {
+    std::vector<HeaderField> fields;
+    bool decoded = decoder_.decode(headerBlock_, fields);
+    headerBlock_.clear();
+    if (!decoded) return connectionError(Http2Error::CompressionError);
+
+    bool endStream = (headerFlags_ & kFlagEndStream) != 0;
+
+    // 已打开的流上的第二个头部块是请求尾部，必须结束流；尾部的字段不使用
+    auto it = streams_.find(streamId);
+    if (it != streams_.end()) {
+        if (it->second.remoteClosed) {
+            resetStream(streamId, Http2Error::StreamClosed);
+        } else if (!endStream) {
+            resetStream(streamId, Http2Error::ProtocolError);
+        } else if (!it->second.responding) {
+            endOfRequest(it, requests);
+        }
+        return true;
+    }
+
+    // 新流的ID必须递增，更小的ID属于已经关闭的流
+    if (streamId <= lastStreamId_) return connectionError(Http2Error::StreamClosed);
+    lastStreamId_ = streamId;
+
+    // GOAWAY之后不再处理新的流
+    if (goAwaySent_) return true;
+
+    if (streams_.size() >= kMaxConcurrentStreams) {
+        writeRstStream(streamId, Http2Error::RefusedStream);
+        return true;
+    }
+
+    size_t listSize = 0;
+    for (const HeaderField& field : fields) {
+        listSize += field.name.size() + field.value.size() + HpackTable::kEntryOverhead;
+    }
+
+    Stream stream;
+    stream.sendWindow = peerInitialWindow_;
+    stream.recvWindow = kStreamWindow;
+    if (!buildRequest(fields, stream)) {
+        writeRstStream(streamId, Http2Error::ProtocolError);
+        return true;
+    }
+
+    it = streams_.emplace(streamId, std::move(stream)).first;
+    if (listSize > maxHeaderListSize_) {
+        rejectStream(streamId, 431, "Request Header Fields Too Large");
+    } else if (it->second.expectedLength > static_cast<long long>(maxBodySize_)) {
+        rejectStream(streamId, 413, "Payload Too Large");
+    } else if (endStream) {
+        endOfRequest(it, requests);
+    }
+    return true;
+}
+
+bool Http2Session::buildRequest(std::vector<HeaderField>& fields, Stream& stream) {
+    HttpRequest& request = stream.request;
+    std::string scheme;
+    bool regularSeen = false;
+
+    for (HeaderField& field : fields) {
+        if (field.name.empty()) return false;
+
+        // 伪头部只能出现在普通头部之前，且各出现一次
+        if (field.name[0] == ':') {
+            std::string* target = nullptr;
+            if (field.name == ":method") target = &request.method;
+            else if (field.name == ":path") target = &stream.target;
+            else if (field.name == ":scheme") target = &scheme;
+            else if (field.name == ":authority") target = &request.headers["host"];
+
+            if (regularSeen || !target || !target->empty()) return false;
+            *target = std::move(field.value);
+            continue;
+        }
+        regularSeen = true;
+
+        for (char c : field.name) {
+            if (c >= 'A' && c <= 'Z') return false;
+        }
+        if (isConnectionHeader(field.name)) return false;
+        if (field.name == "te" && field.value != "trailers") return false;
+
+        // 同名的字段合并为一个，cookie按RFC 9113 8.2.3用"; "连接
+        std::string& value = request.headers[field.name];
+        if (value.empty()) {
+            value = std::move(field.value);
+        } else if (field.name != "host") {
+            value += field.name == "cookie" ? "; " : ", ";
+            value += field.value;
+        }
+    }
+
+    // 不支持CONNECT，其他方法必须有这三个伪头部
+    if (request.method.empty() || scheme.empty() || stream.target.empty()) return false;
+    request.version = "HTTP/2.0";
+
+    auto length = request.headers.find("content-length");
+    if (length != request.headers.end()) {
+        const std::string& text = length->second;
+        long long value = 0;
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec != std::errc() || result.ptr != text.data() + text.size() || value < 0) return false;
+        stream.expectedLength = value;
+    }
+    return true;
+}
+
+void Http2Session::endOfRequest(StreamMap::iterator it, std::vector<Http2Request>& requests) {
+    Stream& stream = it->second;
+    stream.remoteClosed = true;
+
+    if (stream.expectedLength >= 0 && stream.request.body.size() != static_cast<size_t>(stream.expectedLength)) {
+        resetStream(it->first, Http2Error::ProtocolError);
+        return;
+    }
+
+    Http2Request ready;
+    ready.streamId = it->first;
+    ready.target = std::move(stream.target);
+    ready.request = std::move(stream.request);
+    requests.push_back(std::move(ready));
+}
+
+void Http2Session::rejectStream(uint32_t streamId, int statusCode, const std::string& message) {
+    HttpResponse response;
+    response.status(statusCode).text(message);
+    respond(streamId, std::move(response));
+}
+
+bool Http2Session::onSettingsFrame(uint8_t flags, uint32_t streamId, std::string_view payload) {
+    if (streamId != 0) return connectionError(Http2Error::ProtocolError);
+    if (flags & kFlagAck) {
+        return payload.empty() ? true : connectionError(Http2Error::FrameSizeError);
+    }
+    if (payload.size() % 6 != 0) return connectionError(Http2Error::FrameSizeError);
+
+    Http2Error error;
+    if (!applySettings(payload, error)) return connectionError(error);
+    settingsReceived_ = true;
+
+    writeFrameHeader(0, kSettings, kFlagAck, 0);
+    // 初始窗口变大时，等待窗口的流可以继续发送
+    flushAll();
+    return true;
+}
+
+bool Http2Session::applySettings(std::string_view payload, Http2Error& error) {
+    for (size_t i = 0; i + 6 <= payload.size(); i += 6) {
+        uint16_t id = static_cast<uint16_t>((static_cast<uint8_t>(payload[i]) << 8) | static_cast<uint8_t>(payload[i + 1]));
+        uint32_t value = readUint32(payload.data() + i + 2);
+
+        switch (id) {
+            case kSettingsHeaderTableSize:
+                encoder_.setMaxTableSize(value);
+                break;
+
+            case kSettingsEnablePush:
+                if (value > 1) {
+                    error = Http2Error::ProtocolError;
+                    return false;
+                }
+                break;
+
+            case kSettingsInitialWindowSize: {
+                if (value > kMaxWindow) {
+                    error = Http2Error::FlowControlError;
+                    return false;
+                }
+                // 新的初始窗口按差值调整所有已打开的流，窗口可以变为负数
+                int64_t delta = static_cast<int64_t>(value) - peerInitialWindow_;
+                peerInitialWindow_ = value;
+                for (auto& entry : streams_) {
+                    entry.second.sendWindow += delta;
+                    if (entry.second.sendWindow > kMaxWindow) {
+                        error = Http2Error::FlowControlError;
+                        return false;
+                    }
+                }
+                break;
+            }
+
+            case kSettingsMaxFrameSize:
+                if (value < 16384 || value > 16777215) {
+                    error = Http2Error::ProtocolError;
+                    return false;
+                }
+                peerMaxFrameSize_ = value;
+                break;
+
+            default:
+                // 服务器不推送，也不限制自己打开的流；未知参数忽略
+                break;
+        }
+    }
+    return true;
+}
+
+bool Http2Session::onWindowUpdateFrame(uint32_t streamId, std::string_view payload) {
+    if (payload.size() != 4) return connectionError(Http2Error::FrameSizeError);
+    uint32_t increment = readUint32(payload.data()) & 0x7fffffff;
+
+    if (streamId == 0) {
+        if (increment == 0) return connectionError(Http2Error::ProtocolError);
+        connSendWindow_ += increment;
+        if (connSendWindow_ > kMaxWindow) return connectionError(Http2Error::FlowControlError);
+        flushAll();
+        return true;
+    }
+
+    auto it = streams_.find(streamId);
+    if (it == streams_.end()) {
+        return streamId > lastStreamId_ ? connectionError(Http2Error::ProtocolError) : true;
+    }
+    if (increment == 0) {
+        resetStream(streamId, Http2Error::ProtocolError);
+        return true;
+    }
+
+    it->second.sendWindow += increment;
+    if (it->second.sendWindow > kMaxWindow) {
+        resetStream(streamId, Http2Error::FlowControlError);
+        return true;
+    }
+    if (it->second.responding) {
+        flushStream(it);
+    }
+    return true;
+}
+
+void Http2Session::respond(uint32_t streamId, HttpResponse response) {
+    auto it = streams_.find(streamId);
+    if (it == streams_.end() || it->second.responding) return;
+    Stream& stream = it->second;
+    stream.responding = true;
+
+    std::string block;
+    encoder_.beginBlock(block);
+    encoder_.encode(":status", std::to_string(response.statusCode), block);
+
+    // 日期每秒变化，不加入动态表
+    if (response.headers.find("Date") == response.headers.end()) {
+        std::string date;
+        CoarseClock::appendHttpDate(date);
+        encoder_.encode("date", date, block, false);
+    }
+
+    std::string name;
+    for (const auto& header : response.headers) {
+        name = header.first;
+        Utils::toLowerInPlace(name);
+        if (isConnectionHeader(name)) continue;
+        std::string_view value = header.second;
+        while (true) {
+            size_t end = value.find('\n');
+            encoder_.encode(name, value.substr(0, end), block, name != "date");
+            if (end == std::string_view::npos) break;
+            value.remove_prefix(end + 1);
+        }
+    }
+    if (response.statusCode != 204 && response.headers.find("Content-Length") == response.headers.end()) {
+        encoder_.encode("content-length", std::to_string(response.body.size()), block, false);
+    }
+
+    bool empty = response.body.empty();
+    writeHeaders(streamId, block, empty);
+
+    stream.body = std::move(response.body);
+    flushStream(it);
+}
+
+Http2Session::StreamMap::iterator Http2Session::flushStream(StreamMap::iterator it) {
+    Stream& stream = it->second;
+    uint32_t streamId = it->first;
+
+    while (stream.bodyOffset < stream.body.size() && stream.sendWindow > 0 && connSendWindow_ > 0) {
+        size_t length = std::min({stream.body.size() - stream.bodyOffset, static_cast<size_t>(stream.sendWindow),
+                                  static_cast<size_t>(connSendWindow_), static_cast<size_t>(peerMaxFrameSize_)});
+        bool last = stream.bodyOffset + length == stream.body.size();
+
+        writeFrameHeader(length, kData, last ? kFlagEndStream : 0, streamId);
+        output_.append(stream.body, stream.bodyOffset, length);
+        stream.bodyOffset += length;
+        stream.sendWindow -= static_cast<int64_t>(length);
+        connSendWindow_ -= static_cast<int64_t>(length);
+    }
+
+    if (stream.bodyOffset < stream.body.size()) {
+        return std::next(it);
+    }
+
+    // 响应已发完；请求体还在发送（请求被提前拒绝）时重置流，让对端停止发送
+    if (!stream.remoteClosed) {
+        writeRstStream(streamId, Http2Error::NoError);
+    }
+    return streams_.erase(it);
+}
+
+void Http2Session::flushAll() {
+    for (auto it = streams_.begin(); it != streams_.end() && connSendWindow_ > 0;) {
+        it = it->second.responding ? flushStream(it) : std::next(it);
+    }
+}
+
+void Http2Session::resetStream(uint32_t streamId, Http2Error error) {
+    writeRstStream(streamId, error);
+    streams_.erase(streamId);
+}
+
+void Http2Session::goAway(Http2Error error) {
+    if (goAwaySent_ && error == Http2Error::NoError) return;
+    goAwaySent_ = true;
+
+    writeFrameHeader(8, kGoAway, 0, 0);
+    appendUint32(output_, lastStreamId_);
+    appendUint32(output_, static_cast<uint32_t>(error));
+}
+
+bool Http2Session::connectionError(Http2Error error) {
+    goAway(error);
+    failed_ = true;
+    return false;
+}
+
+std::string Http2Session::takeOutput() {
+    std::string output;
+    output.swap(output_);
+    return output;
+}
+
+bool Http2Session::handling() const {
+    for (const auto& entry : streams_) {
+        if (entry.second.remoteClosed && !entry.second.responding) return true;
+    }
+    return false;
+}
+
+void Http2Session::writeFrameHeader(size_t length, uint8_t type, uint8_t flags, uint32_t streamId) {
+    char header[kFrameHeaderSize] = {
+        static_cast<char>(length >> 16), static_cast<char>(length >> 8), static_cast<char>(length),
+        static_cast<char>(type), static_cast<char>(flags),
+        static_cast<char>((streamId >> 24) & 0x7f), static_cast<char>(streamId >> 16),
+        static_cast<char>(streamId >> 8), static_cast<char>(streamId)
+    };
+    output_.append(header, kFrameHeaderSize);
+}
+
+void Http2Session::writeHeaders(uint32_t streamId, const std::string& block, bool endStream) {
+    // 超过对端最大帧长度的头部块拆成HEADERS和紧随其后的CONTINUATION
+    size_t offset = 0;
+    bool first = true;
+    do {
+        size_t length = std::min(block.size() - offset, static_cast<size_t>(peerMaxFrameSize_));
+        bool last = offset + length == block.size();
+        uint8_t flags = (last ? kFlagEndHeaders : 0) | (first && endStream ? kFlagEndStream : 0);
+
+        writeFrameHeader(length, first ? kHeaders : kContinuation, flags, streamId);
+        output_.append(block, offset, length);
+        offset += length;
+        first = false;
+    } while (offset < block.size());
+}
+
+void Http2Session::writeRstStream(uint32_t streamId, Http2Error error) {
+    writeFrameHeader(4, kRstStream, 0, streamId);
+    appendUint32(output_, static_cast<uint32_t>(error));
+}
+
+void Http2Session::writeWindowUpdate(uint32_t streamId, uint32_t increment) {
+    writeFrameHeader(4, kWindowUpdate, 0, streamId);
+    appendUint32(output_, increment);
+}
@@ -0,0 +1,97 @@
+#include "http_stream.h"
+#include "http.h"
+#include <algorithm>
+#include <cstdio>
+
+HttpStream::HttpStream(IoBackend& backend, ConnectionPtr conn, size_t contentLength, bool chunked)
+    : backend_(backend), conn_(std::move(conn)), contentLength_(contentLength), chunked_(chunked) {}
+
+bool HttpStream::feed(std::string& inBuffer) {
+    size_t count = std::min(contentLength_ - received_, inBuffer.size());
+    if (count > 0) {
+        buffer_.append(inBuffer, 0, count);
+        inBuffer.erase(0, count);
+        received_ += count;
+        wake(reader_);
+    }
+
+    // 处理器跟不上时停止从socket读取，未读的数据留在内核缓冲区
+    if (!bodyReceived() && buffer_.size() >= kReadAhead) {
+        conn_->readPaused = true;
+    }
+    return bodyReceived();
+}
+
+std::string HttpStream::take() {
+    std::string data;
+    data.swap(buffer_);
+    if (conn_->readPaused && !aborted_) {
+        backend_.resumeRead(conn_);
+    }
+    return data;
+}
+
+void HttpStream::sendContinue() {
+    if (!expectContinue_) return;
+    expectContinue_ = false;
+    
+    // 响应已经开始，或客户端没有等待就开始发送请求体时不再需要100
+    if (received_ == 0 && !started_ && !aborted_) {
+        backend_.send(conn_, kContinueResponse);
+    }
+}
+
+void HttpStream::begin(HttpResponse& response) {
+    if (started_ || aborted_) return;
+    started_ = true;
+
+    if (prepare_) {
+        prepare_(response);
+    }
+    backend_.send(conn_, response.toStreamHead(chunked_));
+}
+
+HttpStream::WriteAwaiter HttpStream::write(std::string data) {
+    if (started_ && !aborted_ && !data.empty()) {
+        if (chunked_) {
+            // 块大小（十六进制）、数据、CRLF
+            char size[24];
+            int length = std::snprintf(size, sizeof(size), "%zx\r\n", data.size());
+            std::string framed;
+            framed.reserve(static_cast<size_t>(length) + data.size() + 2);
+            framed.append(size, static_cast<size_t>(length));
+            framed += data;
+            framed += "\r\n";
+            backend_.send(conn_, std::move(framed));
+        } else {
+            backend_.send(conn_, std::move(data));
+        }
+    }
+    return WriteAwaiter(*this);
+}
+
+bool HttpStream::writable() const {
+    return aborted_ || conn_->closed || backend_.pendingSendBytes(conn_) <= kWriteAhead;
+}
+
+void HttpStream::onSent() {
+    if (writer_ && backend_.pendingSendBytes(conn_) <= kWriteAhead / 2) {
+        wake(writer_);
+    }
+}
+
+void HttpStream::abort() {
+    aborted_ = true;
+    wake(reader_);
+    wake(writer_);
+}
+
+void HttpStream::wake(std::coroutine_handle<>& handle) {
+    if (!handle) return;
+    std::coroutine_handle<> resume = handle;
+    handle = nullptr;
+    backend_.post([resume, traceId = traceId_]() {
+        Tracing::Scope scope(traceId);
+        resume.resume();
+    });
+}
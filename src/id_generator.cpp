@@ -0,0 +1,189 @@
+#include "id_generator.h"
+#include "coarse_clock.h"
+#include <chrono>
+#include <random>
+#include <thread>
+
+namespace {
+    // 编译期生成的 "000102...feff" 查找表，每个字节一次查表写出两个字符
+    constexpr std::array<char, 512> kHexPairs = []() {
+        const char digits[] = "0123456789abcdef";
+        std::array<char, 512> table{};
+        for (int i = 0; i < 256; ++i) {
+            table[2 * i] = digits[i >> 4];
+            table[2 * i + 1] = digits[i & 0x0F];
+        }
+        return table;
+    }();
+
+    // UUIDv7中同一毫秒内的计数器位数（rand_a的12位 + rand_b的高14位）
+    const int kCounterBits = 26;
+
+    uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t splitMix64(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // xoshiro256**，每个线程一份状态
+    class Xoshiro256 {
+    public:
+        Xoshiro256() {
+            // 混合系统熵、时间和线程标识，避免random_device实现较弱时各线程序列相同
+            std::random_device device;
+            uint64_t seed = (static_cast<uint64_t>(device()) << 32) ^ device();
+            seed ^= static_cast<uint64_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+            seed ^= static_cast<uint64_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) << 1;
+            seed ^= reinterpret_cast<uintptr_t>(this);
+            for (auto& word : state_) {
+                word = splitMix64(seed);
+            }
+        }
+
+        uint64_t next() {
+            uint64_t result = rotl(state_[1] * 5, 7) * 9;
+            uint64_t t = state_[1] << 17;
+            state_[2] ^= state_[0];
+            state_[3] ^= state_[1];
+            state_[1] ^= state_[2];
+            state_[0] ^= state_[3];
+            state_[2] ^= t;
+            state_[3] = rotl(state_[3], 45);
+            return result;
+        }
+
+    private:
+        uint64_t state_[4];
+    };
+
+    Xoshiro256& threadRandom() {
+        thread_local Xoshiro256 random;
+        return random;
+    }
+
+    inline void writeByte(uint8_t byte, char* out) {
+        out[0] = kHexPairs[2 * byte];
+        out[1] = kHexPairs[2 * byte + 1];
+    }
+}
+
+void Uuid::format(char* out) const {
+    // 8-4-4-4-12
+    IdGenerator::writeHex(bytes.data(), 4, out);
+    out[8] = '-';
+    IdGenerator::writeHex(bytes.data() + 4, 2, out + 9);
+    out[13] = '-';
+    IdGenerator::writeHex(bytes.data() + 6, 2, out + 14);
+    out[18] = '-';
+    IdGenerator::writeHex(bytes.data() + 8, 2, out + 19);
+    out[23] = '-';
+    IdGenerator::writeHex(bytes.data() + 10, 6, out + 24);
+}
+
+std::string Uuid::toString() const {
+    std::string result(36, '\0');
+    format(&result[0]);
+    return result;
+}
+
+uint64_t IdGenerator::random64() {
+    return threadRandom().next();
+}
+
+uint64_t IdGenerator::randomBelow(uint64_t bound) {
+    if (bound == 0) return 0;
+
+    // 拒绝落在不完整区间内的值，保证均匀分布
+    uint64_t threshold = (0 - bound) % bound;
+    while (true) {
+        uint64_t value = random64();
+        if (value >= threshold) {
+            return value % bound;
+        }
+    }
+}
+
+Uuid IdGenerator::uuidV7() {
+    thread_local uint64_t lastMillis = 0;
+    thread_local uint64_t counter = 0;
+
+    const uint64_t counterLimit = 1ULL << kCounterBits;
+    uint64_t millis = static_cast<uint64_t>(CoarseClock::nowMillis());
+    if (millis > lastMillis) {
+        // 新的一毫秒：计数器从随机值开始，最高位留空以容纳至少2^25次递增
+        lastMillis = millis;
+        counter = random64() & (counterLimit / 2 - 1);
+    } else if (++counter >= counterLimit) {
+        // 计数器用完或时钟回拨时借用下一毫秒，保持单调
+        ++lastMillis;
+        counter = random64() & (counterLimit / 2 - 1);
+    }
+
+    uint64_t random = random64();
+    Uuid uuid;
+    auto& b = uuid.bytes;
+
+    // unix_ts_ms（48位，大端）
+    for (int i = 0; i < 6; ++i) {
+        b[i] = static_cast<uint8_t>(lastMillis >> (40 - 8 * i));
+    }
+
+    // 版本7 + 计数器高12位（rand_a）
+    b[6] = static_cast<uint8_t>(0x70 | ((counter >> 22) & 0x0F));
+    b[7] = static_cast<uint8_t>(counter >> 14);
+
+    // 变体10 + 计数器低14位 + 48位随机数（rand_b）
+    b[8] = static_cast<uint8_t>(0x80 | ((counter >> 8) & 0x3F));
+    b[9] = static_cast<uint8_t>(counter);
+    for (int i = 0; i < 6; ++i) {
+        b[10 + i] = static_cast<uint8_t>(random >> (40 - 8 * i));
+    }
+
+    return uuid;
+}
+
+std::string IdGenerator::uuidV7String() {
+    return uuidV7().toString();
+}
+
+void IdGenerator::writeHex(const uint8_t* data, size_t length, char* out) {
+    for (size_t i = 0; i < length; ++i) {
+        writeByte(data[i], out + 2 * i);
+    }
+}
+
+void IdGenerator::writeHex(uint64_t value, char* out) {
+    for (int i = 0; i < 8; ++i) {
+        writeByte(static_cast<uint8_t>(value >> (56 - 8 * i)), out + 2 * i);
+    }
+}
+
+SnowflakeGenerator::SnowflakeGenerator(unsigned workerId)
+    : workerId_(workerId & kMaxWorkerId), state_(0) {
+}
+
+uint64_t SnowflakeGenerator::next() {
+    long long elapsed = CoarseClock::nowMillis() - kEpochMillis;
+    uint64_t now = elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0;
+
+    uint64_t current = state_.load(std::memory_order_relaxed);
+    uint64_t next;
+    do {
+        uint64_t last = current >> 12;
+        if (now > last) {
+            next = now << 12;
+        } else if ((current & 0xFFF) < 0xFFF) {
+            next = current + 1;
+        } else {
+            // 本毫秒的序号已用完，借用下一毫秒
+            next = (last + 1) << 12;
+        }
+    } while (!state_.compare_exchange_weak(current, next, std::memory_order_relaxed));
+
+    return ((next >> 12) << 22) | (static_cast<uint64_t>(workerId_) << 12) | (next & 0xFFF);
+}
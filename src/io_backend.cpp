@@ -0,0 +1,50 @@
+#include "io_backend.h"
+#include "poll_backend.h"
+#include "iocp_backend.h"
+#include "utils.h"
+#include <iostream>
+
+bool parseIoBackendType(const std::string& name, IoBackendType& type) {
+    std::string_view trimmed = Utils::trimView(name);
+    if (Utils::equalsIgnoreCase(trimmed, "poll")) {
+        type = IoBackendType::Poll;
+        return true;
+    }
+    if (Utils::equalsIgnoreCase(trimmed, "iocp")) {
+        type = IoBackendType::Iocp;
+        return true;
+    }
+    return false;
+}
+
+void IoBackend::postAfter(std::chrono::milliseconds delay, std::function<void()> task) {
+    auto deadline = TimerWheel::Clock::now() + delay;
+    post([this, deadline, task = std::move(task)]() mutable {
+        timers_.add(deadline, std::move(task));
+    });
+}
+
+void IoBackend::refreshWriteDeadline(const ConnectionPtr& conn) {
+    long long timeout = writeTimeoutMs_.load(std::memory_order_relaxed);
+    if (timeout <= 0) {
+        conn->writeTimer.cancel();
+        return;
+    }
+
+    // 定时器嵌在连接中，触发时连接一定还存在
+    Connection* raw = conn.get();
+    timers_.schedule(conn->writeTimer, std::chrono::milliseconds(timeout), [this, raw]() {
+        std::cerr << "发送超时，关闭连接: " << raw->clientIp << std::endl;
+        close(raw->shared_from_this());
+    });
+}
+
+std::unique_ptr<IoBackend> createIoBackend(IoBackendType type, ConnectionHandler& handler) {
+    switch (type) {
+        case IoBackendType::Iocp:
+            return std::make_unique<IocpBackend>(handler);
+        case IoBackendType::Poll:
+        default:
+            return std::make_unique<PollBackend>(handler);
+    }
+}
@@ -0,0 +1,537 @@
+#include "iocp_backend.h"
+#include <iostream>
+#include <ws2tcpip.h>
+
+namespace {
+    // 完成键：socket上的重叠操作 / 跨线程唤醒
+    const ULONG_PTR kSocketKey = 0;
+    const ULONG_PTR kWakeKey = 1;
+
+    // 预先投递的AcceptEx数量
+    const size_t kAcceptBacklog = 16;
+
+    // 每次批量获取的完成通知数量
+    const ULONG kMaxCompletions = 128;
+
+    // 单次WSASend最多合并的缓冲区数量
+    const size_t kMaxSendBuffers = 16;
+
+    // 共享读缓冲区大小
+    const size_t kReadBufferSize = 64 * 1024;
+
+    // 一次读取最多取出的数据量；数据持续到达时也要交回事件循环，让其他连接得到处理、流式请求体的背压生效
+    const size_t kMaxReadPerEvent = 4 * kReadBufferSize;
+
+    // 重新投递AcceptEx失败后的重试间隔
+    const int kAcceptRetryMs = 100;
+}
+
+IocpBackend::IocpBackend(ConnectionHandler& handler)
+    : IoBackend(handler), iocp_(nullptr), listenSocket_(INVALID_SOCKET), stopping_(false),
+      acceptEx_(nullptr), getAcceptExSockaddrs_(nullptr), pendingOperations_(0) {}
+
+IocpBackend::~IocpBackend() {
+    for (auto& slot : acceptSlots_) {
+        if (slot.socket != INVALID_SOCKET) {
+            closesocket(slot.socket);
+        }
+    }
+    if (iocp_) {
+        CloseHandle(iocp_);
+    }
+}
+
+bool IocpBackend::open(SOCKET listenSocket) {
+    listenSocket_ = listenSocket;
+
+    iocp_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+    if (!iocp_) {
+        std::cerr << "创建完成端口失败: " << GetLastError() << std::endl;
+        return false;
+    }
+
+    if (!loadExtensions()) {
+        return false;
+    }
+
+    if (!CreateIoCompletionPort(reinterpret_cast<HANDLE>(listenSocket_), iocp_, kSocketKey, 0)) {
+        std::cerr << "监听socket关联完成端口失败: " << GetLastError() << std::endl;
+        return false;
+    }
+
+    readBuffer_.resize(kReadBufferSize);
+
+    // 槽位地址会交给内核，之后不能再改变容器大小
+    acceptSlots_.resize(kAcceptBacklog);
+    for (auto& slot : acceptSlots_) {
+        slot.socket = INVALID_SOCKET;
+    }
+    for (auto& slot : acceptSlots_) {
+        if (!postAccept(slot)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool IocpBackend::loadExtensions() {
+    DWORD bytes = 0;
+
+    GUID acceptExGuid = WSAID_ACCEPTEX;
+    if (WSAIoctl(listenSocket_, SIO_GET_EXTENSION_FUNCTION_POINTER,
+                 &acceptExGuid, sizeof(acceptExGuid), &acceptEx_, sizeof(acceptEx_),
+                 &bytes, nullptr, nullptr) == SOCKET_ERROR) {
+        std::cerr << "获取AcceptEx失败: " << WSAGetLastError() << std::endl;
+        return false;
+    }
+
+    GUID sockaddrsGuid = WSAID_GETACCEPTEXSOCKADDRS;
+    if (WSAIoctl(listenSocket_, SIO_GET_EXTENSION_FUNCTION_POINTER,
+                 &sockaddrsGuid, sizeof(sockaddrsGuid), &getAcceptExSockaddrs_, sizeof(getAcceptExSockaddrs_),
+                 &bytes, nullptr, nullptr) == SOCKET_ERROR) {
+        std::cerr << "获取GetAcceptExSockaddrs失败: " << WSAGetLastError() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool IocpBackend::postAccept(AcceptSlot& slot) {
+    slot.socket = WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+    if (slot.socket == INVALID_SOCKET) {
+        std::cerr << "创建接受socket失败: " << WSAGetLastError() << std::endl;
+        return false;
+    }
+
+    ZeroMemory(&slot.op.overlapped, sizeof(slot.op.overlapped));
+    slot.op.type = OperationType::Accept;
+    slot.op.owner = &slot;
+
+    // 不等待首包数据，连接建立即完成
+    DWORD bytes = 0;
+    if (!acceptEx_(listenSocket_, slot.socket, slot.addressBuffer, 0,
+                   kAddressLength, kAddressLength, &bytes, &slot.op.overlapped) &&
+        WSAGetLastError() != WSA_IO_PENDING) {
+        std::cerr << "AcceptEx失败: " << WSAGetLastError() << std::endl;
+        closesocket(slot.socket);
+        slot.socket = INVALID_SOCKET;
+        return false;
+    }
+
+    // 监听socket未开启跳过模式，无论是否同步完成都会收到完成通知
+    ++pendingOperations_;
+    return true;
+}
+
+void IocpBackend::onAcceptComplete(AcceptSlot& slot, bool success) {
+    SOCKET clientSocket = slot.socket;
+    slot.socket = INVALID_SOCKET;
+
+    if (stopping_) {
+        if (clientSocket != INVALID_SOCKET) {
+            closesocket(clientSocket);
+        }
+        return;
+    }
+
+    if (!success) {
+        closesocket(clientSocket);
+        repostAccept(slot);
+        return;
+    }
+
+    setsockopt(clientSocket, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT,
+               reinterpret_cast<char*>(&listenSocket_), sizeof(listenSocket_));
+
+    sockaddr* localAddr = nullptr;
+    sockaddr* remoteAddr = nullptr;
+    int localAddrLen = 0;
+    int remoteAddrLen = 0;
+    getAcceptExSockaddrs_(slot.addressBuffer, 0, kAddressLength, kAddressLength,
+                          &localAddr, &localAddrLen, &remoteAddr, &remoteAddrLen);
+
+    if (!CreateIoCompletionPort(reinterpret_cast<HANDLE>(clientSocket), iocp_, kSocketKey, 0)) {
+        std::cerr << "连接关联完成端口失败: " << GetLastError() << std::endl;
+        closesocket(clientSocket);
+        repostAccept(slot);
+        return;
+    }
+
+    auto conn = std::make_shared<IocpConnection>();
+    conn->socket = clientSocket;
+    conn->skipOnSuccess = SetFileCompletionNotificationModes(
+        reinterpret_cast<HANDLE>(clientSocket),
+        FILE_SKIP_COMPLETION_PORT_ON_SUCCESS | FILE_SKIP_SET_EVENT_ON_HANDLE) != FALSE;
+
+    // 零字节读取后使用非阻塞recv取出数据
+    unsigned long nonBlocking = 1;
+    ioctlsocket(clientSocket, FIONBIO, &nonBlocking);
+
+    if (remoteAddr && remoteAddr->sa_family == AF_INET) {
+        char ip[INET_ADDRSTRLEN] = {0};
+        inet_ntop(AF_INET, &reinterpret_cast<sockaddr_in*>(remoteAddr)->sin_addr, ip, sizeof(ip));
+        conn->clientIp = ip;
+    }
+
+    connections_[conn.get()] = conn;
+    handler_.onOpen(conn);
+    startRead(conn);
+
+    repostAccept(slot);
+}
+
+void IocpBackend::repostAccept(AcceptSlot& slot) {
+    if (stopping_ || postAccept(slot)) return;
+
+    // 失败通常是暂时的（socket句柄或非分页内存耗尽），不重试的话可用的接受槽位会越来越少，直到不再接受连接
+    std::cerr << "重新投递AcceptEx失败，" << kAcceptRetryMs << " ms后重试" << std::endl;
+    timers_.add(TimerWheel::Clock::now() + std::chrono::milliseconds(kAcceptRetryMs), [this, &slot]() {
+        repostAccept(slot);
+    });
+}
+
+void IocpBackend::run() {
+    std::vector<OVERLAPPED_ENTRY> entries(kMaxCompletions);
+
+    while (!stopping_) {
+        ULONG count = 0;
+        int timeout = timers_.nextTimeoutMs();
+        if (!GetQueuedCompletionStatusEx(iocp_, entries.data(), kMaxCompletions, &count,
+                                         timeout < 0 ? INFINITE : static_cast<DWORD>(timeout), FALSE)) {
+            DWORD error = GetLastError();
+            if (error != WAIT_TIMEOUT) {
+                std::cerr << "获取完成通知失败: " << error << std::endl;
+                break;
+            }
+            count = 0;
+        }
+
+        for (ULONG i = 0; i < count; ++i) {
+            if (entries[i].lpCompletionKey == kWakeKey) {
+                runPosted();
+                continue;
+            }
+
+            Operation* op = reinterpret_cast<Operation*>(entries[i].lpOverlapped);
+            bool success = entries[i].lpOverlapped->Internal == 0;
+            onCompletion(op, entries[i].dwNumberOfBytesTransferred, success);
+        }
+
+        timers_.runExpired();
+    }
+
+    // 关闭所有连接和挂起的AcceptEx
+    std::vector<std::shared_ptr<IocpConnection>> remaining;
+    for (const auto& entry : connections_) {
+        remaining.push_back(entry.second);
+    }
+    for (const auto& conn : remaining) {
+        close(conn);
+    }
+    for (auto& slot : acceptSlots_) {
+        if (slot.socket != INVALID_SOCKET) {
+            closesocket(slot.socket);
+            slot.socket = INVALID_SOCKET;
+        }
+    }
+
+    // 等待内核取消所有挂起操作，之后才能释放OVERLAPPED
+    while (pendingOperations_ > 0) {
+        ULONG count = 0;
+        if (!GetQueuedCompletionStatusEx(iocp_, entries.data(), kMaxCompletions, &count, 1000, FALSE)) {
+            break;
+        }
+        for (ULONG i = 0; i < count; ++i) {
+            if (entries[i].lpCompletionKey == kWakeKey) continue;
+            Operation* op = reinterpret_cast<Operation*>(entries[i].lpOverlapped);
+            onCompletion(op, entries[i].dwNumberOfBytesTransferred, false);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(postMutex_);
+    posted_.clear();
+}
+
+void IocpBackend::stop() {
+    stopping_ = true;
+    if (iocp_) {
+        PostQueuedCompletionStatus(iocp_, 0, kWakeKey, nullptr);
+    }
+}
+
+void IocpBackend::post(std::function<void()> task) {
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(postMutex_);
+        wasEmpty = posted_.empty();
+        posted_.push_back(std::move(task));
+    }
+    // 队列非空时唤醒包已经在途，无需重复投递
+    if (wasEmpty) {
+        PostQueuedCompletionStatus(iocp_, 0, kWakeKey, nullptr);
+    }
+}
+
+void IocpBackend::runPosted() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(postMutex_);
+        tasks.swap(posted_);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+void IocpBackend::onCompletion(Operation* op, DWORD bytesTransferred, bool success) {
+    --pendingOperations_;
+
+    if (op->type == OperationType::Accept) {
+        onAcceptComplete(*static_cast<AcceptSlot*>(op->owner), success);
+        return;
+    }
+
+    auto it = connections_.find(static_cast<Connection*>(op->owner));
+    if (it == connections_.end()) return;
+    std::shared_ptr<IocpConnection> conn = it->second;
+
+    if (op->type == OperationType::Recv) {
+        conn->recvPending = false;
+    } else {
+        conn->sendPending = false;
+    }
+
+    if (conn->closed) {
+        conn->sending.clear();
+        releaseIfIdle(conn.get());
+        return;
+    }
+
+    if (!success) {
+        close(conn);
+        return;
+    }
+
+    if (op->type == OperationType::Recv) {
+        // 暂停期间完成的零字节读取不取数据，恢复读取时重新投递
+        if (conn->readPaused) return;
+        if (drainSocket(conn)) {
+            startRead(conn);
+        }
+    } else if (finishSend(conn, bytesTransferred)) {
+        startSend(conn);
+    }
+}
+
+void IocpBackend::startRead(const std::shared_ptr<IocpConnection>& conn) {
+    // 数据持续到达时零字节读取会同步完成，循环处理而不是递归
+    while (!conn->closed && !conn->readClosed && !conn->readPaused && !conn->recvPending) {
+        if (!postZeroByteRecv(conn)) return;
+        if (!drainSocket(conn)) return;
+    }
+}
+
+bool IocpBackend::postZeroByteRecv(const std::shared_ptr<IocpConnection>& conn) {
+    WSABUF buffer;
+    buffer.len = 0;
+    buffer.buf = nullptr;
+    DWORD bytes = 0;
+    DWORD flags = 0;
+
+    ZeroMemory(&conn->recvOp.overlapped, sizeof(conn->recvOp.overlapped));
+    conn->recvOp.type = OperationType::Recv;
+    conn->recvOp.owner = conn.get();
+
+    int result = WSARecv(conn->socket, &buffer, 1, &bytes, &flags, &conn->recvOp.overlapped, nullptr);
+    if (result == 0 && conn->skipOnSuccess) {
+        return true;
+    }
+
+    if (result == 0 || WSAGetLastError() == WSA_IO_PENDING) {
+        conn->recvPending = true;
+        ++pendingOperations_;
+        return false;
+    }
+
+    close(conn);
+    return false;
+}
+
+bool IocpBackend::drainSocket(const std::shared_ptr<IocpConnection>& conn) {
+    bool received = false;
+    size_t total = 0;
+
+    while (total < kMaxReadPerEvent) {
+        int bytesReceived = recv(conn->socket, readBuffer_.data(), static_cast<int>(readBuffer_.size()), 0);
+        if (bytesReceived > 0) {
+            conn->inBuffer.append(readBuffer_.data(), bytesReceived);
+            received = true;
+            total += bytesReceived;
+            if (bytesReceived < static_cast<int>(readBuffer_.size())) break;
+            continue;
+        }
+
+        if (bytesReceived == 0) {
+            conn->readClosed = true;
+            break;
+        }
+
+        if (WSAGetLastError() != WSAEWOULDBLOCK) {
+            close(conn);
+            return false;
+        }
+        break;
+    }
+
+    // 对端关闭时也通知，正在接收的流式请求体不会再有数据
+    if (received || conn->readClosed) {
+        handler_.onData(conn);
+    }
+
+    if (conn->closed) return false;
+
+    // 对端关闭后，等待正在处理的请求发送完毕再关闭
+    if (conn->readClosed) {
+        if (!conn->busy && !conn->sendPending && conn->sendQueue.empty()) {
+            close(conn);
+        } else {
+            conn->closeAfterWrite = true;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+void IocpBackend::send(const ConnectionPtr& conn, std::string data) {
+    auto iocpConn = std::static_pointer_cast<IocpConnection>(conn);
+    if (iocpConn->closed) return;
+
+    enqueue(iocpConn, std::move(data));
+}
+
+void IocpBackend::send(const ConnectionPtr& conn, SharedBuffer data) {
+    auto iocpConn = std::static_pointer_cast<IocpConnection>(conn);
+    if (iocpConn->closed) return;
+
+    enqueue(iocpConn, std::move(data));
+}
+
+void IocpBackend::enqueue(const std::shared_ptr<IocpConnection>& conn, SendChunk chunk) {
+    conn->pendingBytes += chunk.size();
+    conn->sendQueue.push_back(std::move(chunk));
+    startSend(conn);
+}
+
+void IocpBackend::startSend(const std::shared_ptr<IocpConnection>& conn) {
+    while (!conn->sendPending && !conn->closed && !conn->sendQueue.empty()) {
+        conn->sending.clear();
+        while (!conn->sendQueue.empty() && conn->sending.size() < kMaxSendBuffers) {
+            conn->sending.push_back(std::move(conn->sendQueue.front()));
+            conn->sendQueue.pop_front();
+        }
+
+        // sending不再变化后才能取缓冲区地址
+        conn->sendBuffers.clear();
+        for (auto& data : conn->sending) {
+            WSABUF buffer;
+            buffer.len = static_cast<ULONG>(data.size());
+            buffer.buf = const_cast<char*>(data.data());
+            conn->sendBuffers.push_back(buffer);
+        }
+
+        ZeroMemory(&conn->sendOp.overlapped, sizeof(conn->sendOp.overlapped));
+        conn->sendOp.type = OperationType::Send;
+        conn->sendOp.owner = conn.get();
+
+        DWORD bytesSent = 0;
+        int result = WSASend(conn->socket, conn->sendBuffers.data(), static_cast<DWORD>(conn->sendBuffers.size()),
+                             &bytesSent, 0, &conn->sendOp.overlapped, nullptr);
+        if (result == 0 && conn->skipOnSuccess) {
+            if (!finishSend(conn, bytesSent)) return;
+            continue;
+        }
+
+        if (result == 0 || WSAGetLastError() == WSA_IO_PENDING) {
+            conn->sendPending = true;
+            ++pendingOperations_;
+            // 每次投递都发生在上一次发送完成之后，即有进展时顺延发送超时
+            refreshWriteDeadline(conn);
+            return;
+        }
+
+        close(conn);
+        return;
+    }
+}
+
+bool IocpBackend::finishSend(const std::shared_ptr<IocpConnection>& conn, DWORD bytesSent) {
+    // 重叠发送通常一次全部完成，部分完成时把剩余数据按顺序放回队列头部
+    conn->pendingBytes -= bytesSent;
+    size_t skip = bytesSent;
+    std::vector<SendChunk> rest;
+    for (auto& data : conn->sending) {
+        if (skip >= data.size()) {
+            skip -= data.size();
+            continue;
+        }
+        data.consume(skip);
+        rest.push_back(std::move(data));
+        skip = 0;
+    }
+    for (auto it = rest.rbegin(); it != rest.rend(); ++it) {
+        conn->sendQueue.push_front(std::move(*it));
+    }
+    conn->sending.clear();
+
+    bool more = !conn->sendQueue.empty();
+    if (!more) {
+        conn->writeTimer.cancel();
+        if (conn->closeAfterWrite) {
+            close(conn);
+            return false;
+        }
+    }
+
+    if (bytesSent > 0) {
+        handler_.onSent(conn);
+    }
+    return more && !conn->closed;
+}
+
+void IocpBackend::resumeRead(const ConnectionPtr& conn) {
+    if (!conn->readPaused) return;
+    conn->readPaused = false;
+
+    // 读取可能同步完成并回调onData，投递到事件循环上执行
+    auto iocpConn = std::static_pointer_cast<IocpConnection>(conn);
+    post([this, iocpConn]() {
+        if (!iocpConn->closed && !iocpConn->readPaused) {
+            startRead(iocpConn);
+        }
+    });
+}
+
+size_t IocpBackend::pendingSendBytes(const ConnectionPtr& conn) const {
+    return static_cast<const IocpConnection&>(*conn).pendingBytes;
+}
+
+void IocpBackend::close(const ConnectionPtr& conn) {
+    if (conn->closed) return;
+
+    // 关闭socket会取消挂起的操作，连接对象要等这些操作完成后才能释放
+    ConnectionPtr keep = conn;
+    keep->closed = true;
+    keep->writeTimer.cancel();
+    closesocket(keep->socket);
+
+    handler_.onClose(keep);
+    releaseIfIdle(static_cast<IocpConnection*>(keep.get()));
+}
+
+void IocpBackend::releaseIfIdle(IocpConnection* conn) {
+    if (conn->closed && !conn->recvPending && !conn->sendPending) {
+        connections_.erase(conn);
+    }
+}
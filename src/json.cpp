@@ -0,0 +1,414 @@
+#include "json.h"
+#include <charconv>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+    // 嵌套层数上限，防止恶意输入耗尽栈空间
+    const int kMaxDepth = 128;
+
+    const JsonValue kNull;
+
+    class Parser {
+    public:
+        explicit Parser(const std::string& text) : text_(text), pos_(0) {}
+
+        bool parseDocument(JsonValue& out, std::string& error) {
+            skipWhitespace();
+            if (!parseValue(out, 0)) {
+                error = error_ + " (位置 " + std::to_string(pos_) + ")";
+                return false;
+            }
+            skipWhitespace();
+            if (pos_ != text_.size()) {
+                error = "多余的字符 (位置 " + std::to_string(pos_) + ")";
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        const std::string& text_;
+        size_t pos_;
+        std::string error_;
+
+        bool fail(const std::string& message) {
+            error_ = message;
+            return false;
+        }
+
+        void skipWhitespace() {
+            while (pos_ < text_.size()) {
+                char c = text_[pos_];
+                if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+                ++pos_;
+            }
+        }
+
+        bool consume(const char* literal) {
+            size_t length = std::char_traits<char>::length(literal);
+            if (text_.compare(pos_, length, literal) != 0) return false;
+            pos_ += length;
+            return true;
+        }
+
+        bool parseValue(JsonValue& out, int depth) {
+            if (depth > kMaxDepth) return fail("嵌套层数过多");
+            if (pos_ >= text_.size()) return fail("意外的输入结束");
+
+            char c = text_[pos_];
+            if (c == '{') return parseObject(out, depth);
+            if (c == '[') return parseArray(out, depth);
+            if (c == '"') {
+                std::string value;
+                if (!parseString(value)) return false;
+                out = JsonValue(std::move(value));
+                return true;
+            }
+            if (c == 't') {
+                if (!consume("true")) return fail("无效的字面量");
+                out = JsonValue(true);
+                return true;
+            }
+            if (c == 'f') {
+                if (!consume("false")) return fail("无效的字面量");
+                out = JsonValue(false);
+                return true;
+            }
+            if (c == 'n') {
+                if (!consume("null")) return fail("无效的字面量");
+                out = JsonValue();
+                return true;
+            }
+            if (c == '-' || (c >= '0' && c <= '9')) return parseNumber(out);
+            return fail(std::string("意外的字符 '") + c + "'");
+        }
+
+        bool parseObject(JsonValue& out, int depth) {
+            ++pos_;   // '{'
+            out = JsonValue::object();
+            skipWhitespace();
+            if (pos_ < text_.size() && text_[pos_] == '}') {
+                ++pos_;
+                return true;
+            }
+
+            while (true) {
+                skipWhitespace();
+                if (pos_ >= text_.size() || text_[pos_] != '"') return fail("对象的键必须是字符串");
+                std::string key;
+                if (!parseString(key)) return false;
+
+                skipWhitespace();
+                if (pos_ >= text_.size() || text_[pos_] != ':') return fail("缺少 ':'");
+                ++pos_;
+                skipWhitespace();
+
+                JsonValue value;
+                if (!parseValue(value, depth + 1)) return false;
+                out.set(key, std::move(value));
+
+                skipWhitespace();
+                if (pos_ >= text_.size()) return fail("对象未结束");
+                if (text_[pos_] == ',') {
+                    ++pos_;
+                    continue;
+                }
+                if (text_[pos_] == '}') {
+                    ++pos_;
+                    return true;
+                }
+                return fail("缺少 ',' 或 '}'");
+            }
+        }
+
+        bool parseArray(JsonValue& out, int depth) {
+            ++pos_;   // '['
+            out = JsonValue::array();
+            skipWhitespace();
+            if (pos_ < text_.size() && text_[pos_] == ']') {
+                ++pos_;
+                return true;
+            }
+
+            while (true) {
+                skipWhitespace();
+                JsonValue value;
+                if (!parseValue(value, depth + 1)) return false;
+                out.push(std::move(value));
+
+                skipWhitespace();
+                if (pos_ >= text_.size()) return fail("数组未结束");
+                if (text_[pos_] == ',') {
+                    ++pos_;
+                    continue;
+                }
+                if (text_[pos_] == ']') {
+                    ++pos_;
+                    return true;
+                }
+                return fail("缺少 ',' 或 ']'");
+            }
+        }
+
+        bool parseHex4(unsigned& code) {
+            if (pos_ + 4 > text_.size()) return fail("无效的\\u转义");
+            code = 0;
+            for (int i = 0; i < 4; ++i) {
+                char c = text_[pos_++];
+                code <<= 4;
+                if (c >= '0' && c <= '9') code |= c - '0';
+                else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+                else return fail("无效的\\u转义");
+            }
+            return true;
+        }
+
+        static void appendUtf8(std::string& out, unsigned code) {
+            if (code < 0x80) {
+                out += static_cast<char>(code);
+            } else if (code < 0x800) {
+                out += static_cast<char>(0xC0 | (code >> 6));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            } else if (code < 0x10000) {
+                out += static_cast<char>(0xE0 | (code >> 12));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            } else {
+                out += static_cast<char>(0xF0 | (code >> 18));
+                out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+
+        bool parseString(std::string& out) {
+            ++pos_;   // '"'
+            while (true) {
+                // 整段复制不需要转义的字符
+                size_t start = pos_;
+                while (pos_ < text_.size() && text_[pos_] != '"' && text_[pos_] != '\\' &&
+                       static_cast<unsigned char>(text_[pos_]) >= 0x20) {
+                    ++pos_;
+                }
+                out.append(text_, start, pos_ - start);
+
+                if (pos_ >= text_.size()) return fail("字符串未结束");
+                char c = text_[pos_++];
+                if (c == '"') return true;
+                if (c != '\\') return fail("字符串中包含控制字符");
+                if (pos_ >= text_.size()) return fail("字符串未结束");
+
+                char escape = text_[pos_++];
+                switch (escape) {
+                    case '"': out += '"'; break;
+                    case '\\': out += '\\'; break;
+                    case '/': out += '/'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'n': out += '\n'; break;
+                    case 'r': out += '\r'; break;
+                    case 't': out += '\t'; break;
+                    case 'u': {
+                        unsigned code;
+                        if (!parseHex4(code)) return false;
+                        // 代理对组合成一个码点
+                        if (code >= 0xD800 && code <= 0xDBFF) {
+                            unsigned low;
+                            if (!consume("\\u") || !parseHex4(low) || low < 0xDC00 || low > 0xDFFF) {
+                                return fail("无效的代理对");
+                            }
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        } else if (code >= 0xDC00 && code <= 0xDFFF) {
+                            return fail("无效的代理对");
+                        }
+                        appendUtf8(out, code);
+                        break;
+                    }
+                    default:
+                        return fail("无效的转义字符");
+                }
+            }
+        }
+
+        bool parseNumber(JsonValue& out) {
+            size_t start = pos_;
+            if (text_[pos_] == '-') ++pos_;
+            if (pos_ >= text_.size() || !std::isdigit(static_cast<unsigned char>(text_[pos_]))) {
+                return fail("无效的数字");
+            }
+            if (text_[pos_] == '0') {
+                ++pos_;
+            } else {
+                while (pos_ < text_.size() && std::isdigit(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+            }
+            if (pos_ < text_.size() && text_[pos_] == '.') {
+                ++pos_;
+                if (pos_ >= text_.size() || !std::isdigit(static_cast<unsigned char>(text_[pos_]))) {
+                    return fail("无效的数字");
+                }
+                while (pos_ < text_.size() && std::isdigit(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+            }
+            if (pos_ < text_.size() && (text_[pos_] == 'e' || text_[pos_] == 'E')) {
+                ++pos_;
+                if (pos_ < text_.size() && (text_[pos_] == '+' || text_[pos_] == '-')) ++pos_;
+                if (pos_ >= text_.size() || !std::isdigit(static_cast<unsigned char>(text_[pos_]))) {
+                    return fail("无效的数字");
+                }
+                while (pos_ < text_.size() && std::isdigit(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+            }
+
+            // from_chars 不受区域设置影响
+            double value = 0;
+            auto result = std::from_chars(text_.data() + start, text_.data() + pos_, value);
+            if (result.ec != std::errc()) return fail("数字超出范围");
+            out = JsonValue(value);
+            return true;
+        }
+    };
+}
+
+bool JsonValue::parse(const std::string& text, JsonValue& out, std::string& error) {
+    Parser parser(text);
+    JsonValue value;
+    if (!parser.parseDocument(value, error)) {
+        return false;
+    }
+    out = std::move(value);
+    return true;
+}
+
+bool JsonValue::asBool(bool defaultValue) const {
+    return type_ == Type::Bool ? bool_ : defaultValue;
+}
+
+double JsonValue::asNumber(double defaultValue) const {
+    return type_ == Type::Number ? number_ : defaultValue;
+}
+
+long long JsonValue::asInt(long long defaultValue) const {
+    if (type_ != Type::Number || !std::isfinite(number_)) return defaultValue;
+    return static_cast<long long>(number_);
+}
+
+std::string JsonValue::asString(const std::string& defaultValue) const {
+    return type_ == Type::String ? string_ : defaultValue;
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const {
+    if (type_ != Type::Object) return kNull;
+    for (const auto& member : object_) {
+        if (member.first == key) return member.second;
+    }
+    return kNull;
+}
+
+bool JsonValue::has(const std::string& key) const {
+    if (type_ != Type::Object) return false;
+    for (const auto& member : object_) {
+        if (member.first == key) return true;
+    }
+    return false;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+    if (type_ != Type::Array || index >= array_.size()) return kNull;
+    return array_[index];
+}
+
+size_t JsonValue::size() const {
+    if (type_ == Type::Array) return array_.size();
+    if (type_ == Type::Object) return object_.size();
+    return 0;
+}
+
+void JsonValue::push(JsonValue value) {
+    if (type_ != Type::Array) {
+        *this = array();
+    }
+    array_.push_back(std::move(value));
+}
+
+void JsonValue::set(const std::string& key, JsonValue value) {
+    if (type_ != Type::Object) {
+        *this = object();
+    }
+    // 重复的键以最后一次为准
+    for (auto& member : object_) {
+        if (member.first == key) {
+            member.second = std::move(value);
+            return;
+        }
+    }
+    object_.emplace_back(key, std::move(value));
+}
+
+std::string JsonValue::dump() const {
+    std::string out;
+    dumpTo(out);
+    return out;
+}
+
+void JsonValue::dumpTo(std::string& out) const {
+    switch (type_) {
+        case Type::Null:
+            out += "null";
+            break;
+        case Type::Bool:
+            out += bool_ ? "true" : "false";
+            break;
+        case Type::Number: {
+            if (!std::isfinite(number_)) {
+                out += "null";
+                break;
+            }
+            char buffer[32];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), number_);
+            out.append(buffer, result.ptr);
+            break;
+        }
+        case Type::String:
+            out += '"';
+            for (char c : string_) {
+                switch (c) {
+                    case '"': out += "\\\""; break;
+                    case '\\': out += "\\\\"; break;
+                    case '\b': out += "\\b"; break;
+                    case '\f': out += "\\f"; break;
+                    case '\n': out += "\\n"; break;
+                    case '\r': out += "\\r"; break;
+                    case '\t': out += "\\t"; break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            char escaped[8];
+                            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                            out += escaped;
+                        } else {
+                            out += c;
+                        }
+                }
+            }
+            out += '"';
+            break;
+        case Type::Array:
+            out += '[';
+            for (size_t i = 0; i < array_.size(); ++i) {
+                if (i > 0) out += ',';
+                array_[i].dumpTo(out);
+            }
+            out += ']';
+            break;
+        case Type::Object:
+            out += '{';
+            for (size_t i = 0; i < object_.size(); ++i) {
+                if (i > 0) out += ',';
+                JsonValue(object_[i].first).dumpTo(out);
+                out += ':';
+                object_[i].second.dumpTo(out);
+            }
+            out += '}';
+            break;
+    }
+}
@@ -0,0 +1,123 @@
+#include "latency_sketch.h"
+#include <cmath>
+#include <charconv>
+#include <algorithm>
+
+namespace {
+    // gamma = (1 + a) / (1 - a)，桶 k 覆盖 (gamma^(k-1), gamma^k]
+    const double kGamma = (1 + LatencySketch::kRelativeAccuracy) / (1 - LatencySketch::kRelativeAccuracy);
+    const double kLogGamma = std::log(kGamma);
+
+    template<typename Number>
+    bool parseNumber(std::string_view text, Number& out) {
+        auto result = std::from_chars(text.data(), text.data() + text.size(), out);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size();
+    }
+}
+
+int LatencySketch::keyFor(double value) {
+    int key = static_cast<int>(std::ceil(std::log(value) / kLogGamma));
+    return std::clamp(key, 0, kMaxKey);
+}
+
+double LatencySketch::valueFor(int key) {
+    // 桶的中点（按相对误差），与桶内任何值的相对误差都不超过kRelativeAccuracy
+    return 2 * std::pow(kGamma, key) / (kGamma + 1);
+}
+
+void LatencySketch::addToBin(int key, uint64_t count) {
+    if (bins_.empty()) {
+        offset_ = key;
+        bins_.assign(1, 0);
+    } else if (key < offset_) {
+        bins_.insert(bins_.begin(), static_cast<size_t>(offset_ - key), 0);
+        offset_ = key;
+    } else if (key >= offset_ + static_cast<int>(bins_.size())) {
+        bins_.resize(static_cast<size_t>(key - offset_ + 1), 0);
+    }
+    bins_[static_cast<size_t>(key - offset_)] += count;
+}
+
+void LatencySketch::add(double value) {
+    ++count_;
+    if (!(value >= 1)) {
+        ++zeroCount_;
+        return;
+    }
+    addToBin(keyFor(value), 1);
+}
+
+void LatencySketch::merge(const LatencySketch& other) {
+    if (other.empty()) return;
+
+    zeroCount_ += other.zeroCount_;
+    count_ += other.count_;
+    if (other.bins_.empty()) return;
+
+    // 先一次扩展到两者的并集，避免逐个桶插入时反复移动
+    addToBin(other.offset_, 0);
+    addToBin(other.offset_ + static_cast<int>(other.bins_.size()) - 1, 0);
+    for (size_t i = 0; i < other.bins_.size(); ++i) {
+        bins_[static_cast<size_t>(other.offset_ - offset_) + i] += other.bins_[i];
+    }
+}
+
+double LatencySketch::quantile(double q) const {
+    if (count_ == 0) return 0;
+
+    q = std::clamp(q, 0.0, 1.0);
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count_ - 1));
+    if (rank < zeroCount_) return 0;
+
+    uint64_t seen = zeroCount_;
+    for (size_t i = 0; i < bins_.size(); ++i) {
+        seen += bins_[i];
+        if (seen > rank) {
+            return valueFor(offset_ + static_cast<int>(i));
+        }
+    }
+    return valueFor(offset_ + static_cast<int>(bins_.size()) - 1);
+}
+
+std::string LatencySketch::serialize() const {
+    std::string text = std::to_string(zeroCount_);
+    text += '|';
+    bool first = true;
+    for (size_t i = 0; i < bins_.size(); ++i) {
+        if (bins_[i] == 0) continue;
+        if (!first) text += ',';
+        first = false;
+        text += std::to_string(offset_ + static_cast<int>(i));
+        text += ':';
+        text += std::to_string(bins_[i]);
+    }
+    return text;
+}
+
+bool LatencySketch::deserialize(std::string_view text, LatencySketch& sketch) {
+    sketch = LatencySketch();
+
+    size_t separator = text.find('|');
+    if (separator == std::string_view::npos || !parseNumber(text.substr(0, separator), sketch.zeroCount_)) {
+        return false;
+    }
+    sketch.count_ = sketch.zeroCount_;
+
+    std::string_view rest = text.substr(separator + 1);
+    while (!rest.empty()) {
+        size_t comma = rest.find(',');
+        std::string_view pair = rest.substr(0, comma);
+        rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+
+        size_t colon = pair.find(':');
+        int key = 0;
+        uint64_t count = 0;
+        if (colon == std::string_view::npos || !parseNumber(pair.substr(0, colon), key) ||
+            !parseNumber(pair.substr(colon + 1), count) || key < 0 || key > kMaxKey) {
+            return false;
+        }
+        sketch.addToBin(key, count);
+        sketch.count_ += count;
+    }
+    return true;
+}
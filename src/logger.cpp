@@ -0,0 +1,66 @@
+#include "logger.h"
+#include "utils.h"
+#include <atomic>
+#include <mutex>
+#include <iostream>
+
+namespace {
+    std::atomic<int> g_level{static_cast<int>(LogLevel::Info)};
+
+    // 多个线程同时输出时保持每行完整
+    std::mutex g_outputMutex;
+}
+
+bool parseLogLevel(const std::string& name, LogLevel& level) {
+    std::string_view trimmed = Utils::trimView(name);
+    if (Utils::equalsIgnoreCase(trimmed, "DEBUG")) {
+        level = LogLevel::Debug;
+    } else if (Utils::equalsIgnoreCase(trimmed, "INFO")) {
+        level = LogLevel::Info;
+    } else if (Utils::equalsIgnoreCase(trimmed, "WARN") || Utils::equalsIgnoreCase(trimmed, "WARNING")) {
+        level = LogLevel::Warn;
+    } else if (Utils::equalsIgnoreCase(trimmed, "ERROR")) {
+        level = LogLevel::Error;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* logLevelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info: return "INFO";
+        case LogLevel::Warn: return "WARN";
+        case LogLevel::Error: return "ERROR";
+    }
+    return "INFO";
+}
+
+namespace Logger {
+
+void setLevel(LogLevel level) {
+    g_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel level() {
+    return static_cast<LogLevel>(g_level.load(std::memory_order_relaxed));
+}
+
+bool enabled(LogLevel level) {
+    return static_cast<int>(level) >= g_level.load(std::memory_order_relaxed);
+}
+
+void log(LogLevel level, const std::string& message, const std::string& source) {
+    if (!enabled(level)) return;
+
+    std::string line = Utils::formatLogMessage(logLevelName(level), message, source);
+    std::lock_guard<std::mutex> lock(g_outputMutex);
+    if (level >= LogLevel::Warn) {
+        std::cerr << line << std::endl;
+    } else {
+        std::cout << line << std::endl;
+    }
+}
+
+}
@@ -1,9 +1,26 @@
 #include <iostream>
 #include <signal.h>
 #include <windows.h>
+#include <conio.h>
 #include "server.h"
 #include "database.h"
 #include "utils.h"
+#include "config.h"
+#include "logger.h"
+#include "coarse_clock.h"
+#include "json.h"
+#include "crypto.h"
+#include "user_repository.h"
+#include "api_keys.h"
+#include "tracing.h"
+#include "router.h"
+#include "test_upstream.h"
+#include <charconv>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdio>
 
 // 全局服务器指针
 ApiServer* g_server = nullptr;
@@ -27,7 +44,7 @@ void showWelcome() {
     std::cout << "=========================================" << std::endl;
     std::cout << "           API管理系统 v1.0.0" << std::endl;
     std::cout << "=========================================" << std::endl;
-    std::cout << "基于C++17 + SQLite3 + Windows Socket" << std::endl;
+    std::cout << "基于C++20 + SQLite3 + Windows Socket" << std::endl;
     std::cout << "轻量级、高性能、易于部署" << std::endl;
     std::cout << "=========================================" << std::endl;
 }
@@ -37,7 +54,9 @@ void showHelp() {
     std::cout << "\n可用命令:" << std::endl;
     std::cout << "  help     - 显示此帮助信息" << std::endl;
     std::cout << "  status   - 显示服务器状态" << std::endl;
-    std::cout << "  routes   - 显示所有路由" << std::endl;
+    std::cout << "  routes   - 显示所有路由及其请求数、错误率和延迟" << std::endl;
+    std::cout << "  top      - 每秒刷新最忙的路由和服务器负载，按任意键退出" << std::endl;
+    std::cout << "  trace    - 请求追踪: trace <N> 每N个请求采样一个, trace off 关闭, trace save <文件> 导出" << std::endl;
     std::cout << "  quit     - 退出程序" << std::endl;
     std::cout << "  clear    - 清屏" << std::endl;
 }
@@ -49,27 +68,260 @@ void showStatus(const ApiServer* server) {
         return;
     }
     
+    ServerLoad load = server->getLoad();
+    RouteMetricsSnapshot unmatched = server->getUnmatchedMetrics().snapshot();
+    uint64_t requests = unmatched.hits;
+    uint64_t serverErrors = unmatched.serverErrors;
+    for (const auto& route : server->getRouter().getRoutes()) {
+        RouteMetricsSnapshot metrics = route.metrics->snapshot();
+        requests += metrics.hits;
+        serverErrors += metrics.serverErrors;
+    }
+    
     std::cout << "\n服务器状态:" << std::endl;
+    std::cout << "  I/O后端: " << server->getIoBackendName() << ", 活动连接: " << load.activeConnections << std::endl;
+    std::cout << "  工作线程: " << load.workerThreads << ", 队列: " << load.workerQueue
+              << "; 数据库执行器队列: " << load.databaseQueue << std::endl;
+    std::cout << "  请求: " << requests << ", 5xx: " << serverErrors << "（输入 routes 查看每条路由，top 查看实时负载）" << std::endl;
     std::cout << "  数据库: " << (server->getDatabase() && server->getDatabase()->isConnected() ? "已连接" : "未连接") << std::endl;
+    if (server->getDatabase()) {
+        RowCacheStats cache = server->getDatabase()->rowCache().stats();
+        uint64_t lookups = cache.hits + cache.misses;
+        std::cout << "  行缓存: " << cache.entries << " 行, " << cache.bytes / 1024 << "/" << cache.capacity / 1024 << " KB"
+                  << ", 命中率 " << (lookups > 0 ? cache.hits * 100 / lookups : 0) << "%"
+                  << " (命中 " << cache.hits << ", 未命中 " << cache.misses
+                  << ", 淘汰 " << cache.evictions << ", 失效 " << cache.invalidations << ")" << std::endl;
+    }
     std::cout << "  时间: " << Utils::getCurrentTimestamp() << std::endl;
 }
 
-// 显示所有路由
+// 字符串在控制台上的显示宽度：中文等宽字符占两列
+size_t displayWidth(const std::string& text) {
+    size_t width = 0;
+    for (size_t i = 0; i < text.size();) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        size_t length = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        width += length >= 3 ? 2 : 1;
+        i += length;
+    }
+    return width;
+}
+
+// 按显示宽度补齐到width列，right为true时右对齐
+std::string column(const std::string& text, size_t width, bool right = false) {
+    size_t used = displayWidth(text);
+    std::string padding(used < width ? width - used : 0, ' ');
+    return right ? padding + text + " " : text + padding + " ";
+}
+
+// 微秒数按量级显示
+std::string formatLatency(double us) {
+    char text[32];
+    if (us < 1000) {
+        std::snprintf(text, sizeof(text), "%.0fus", us);
+    } else if (us < 1000000) {
+        std::snprintf(text, sizeof(text), "%.1fms", us / 1000);
+    } else {
+        std::snprintf(text, sizeof(text), "%.2fs", us / 1000000);
+    }
+    return text;
+}
+
+std::string formatPercent(uint64_t part, uint64_t total) {
+    char text[16];
+    std::snprintf(text, sizeof(text), "%.1f%%", total > 0 ? part * 100.0 / total : 0.0);
+    return text;
+}
+
+// 路由在表格中的名称和类型
+std::string routeKind(const Route& route) {
+    if (!route.websocketChannel.empty()) return "ws";
+    if (route.prefix) return "proxy";
+    if (route.streaming) return "stream";
+    return route.isAsync() ? "async" : "sync";
+}
+
+// 路由表的一行：请求数（或每秒请求数）、错误率和延迟分位数
+void printRouteRow(const std::string& method, const std::string& path, size_t pathWidth, const std::string& kind,
+                   const std::string& hits, const RouteMetricsSnapshot& metrics) {
+    bool any = metrics.hits > 0;
+    std::cout << "  " << column(method, 7) << column(path, pathWidth) << column(kind, 7) << column(hits, 10, true)
+              << column(formatPercent(metrics.clientErrors, metrics.hits), 7, true)
+              << column(formatPercent(metrics.serverErrors, metrics.hits), 7, true)
+              << column(any ? formatLatency(metrics.quantile(0.50)) : "-", 9, true)
+              << column(any ? formatLatency(metrics.quantile(0.99)) : "-", 9, true) << std::endl;
+}
+
+// 路由表的路径列宽度
+size_t routePathWidth(const std::vector<Route>& routes) {
+    size_t width = 12;
+    for (const auto& route : routes) {
+        width = std::max(width, displayWidth(route.path));
+    }
+    return width;
+}
+
+// 显示所有路由：注册的路由和启动以来的请求数、错误率和延迟
 void showRoutes(const ApiServer* server) {
     if (!server) {
         std::cout << "服务器未初始化" << std::endl;
         return;
     }
     
-    // 这里可以通过反射或其他方式获取路由信息
-    std::cout << "\n已注册的路由:" << std::endl;
-    std::cout << "  GET  /                    - 欢迎页面" << std::endl;
-    std::cout << "  GET  /api/users           - 获取用户列表" << std::endl;
-    std::cout << "  POST /api/users           - 创建新用户" << std::endl;
-    std::cout << "  GET  /api/users/:id       - 获取指定用户" << std::endl;
-    std::cout << "  PUT  /api/users/:id       - 更新指定用户" << std::endl;
-    std::cout << "  DELETE /api/users/:id     - 删除指定用户" << std::endl;
-    std::cout << "  GET  /api/status          - 系统状态" << std::endl;
+    const auto& routes = server->getRouter().getRoutes();
+    size_t pathWidth = routePathWidth(routes);
+    std::cout << "\n已注册的路由 (" << routes.size() << "):" << std::endl;
+    std::cout << "  " << column("方法", 7) << column("路径", pathWidth) << column("类型", 7) << column("请求数", 10, true)
+              << column("4xx", 7, true) << column("5xx", 7, true) << column("p50", 9, true) << column("p99", 9, true) << std::endl;
+    for (const auto& route : routes) {
+        RouteMetricsSnapshot metrics = route.metrics->snapshot();
+        printRouteRow(route.method, route.path, pathWidth, routeKind(route), std::to_string(metrics.hits), metrics);
+    }
+    RouteMetricsSnapshot unmatched = server->getUnmatchedMetrics().snapshot();
+    printRouteRow("-", "(未匹配)", pathWidth, "-", std::to_string(unmatched.hits), unmatched);
+    
+    for (const auto& route : routes) {
+        if (!route.coalescer) continue;
+        std::cout << "  请求合并 " << route.method << " " << route.path << ": 执行处理器 " << route.coalescer->flights()
+                  << " 次，合并 " << route.coalescer->coalesced() << " 个请求" << std::endl;
+    }
+}
+
+// 实时视图：每秒刷新最忙的路由和服务器负载，按任意键退出
+// 计数器和队列深度都是不加锁的原子读取，刷新不会和请求竞争
+void showTop(const ApiServer* server) {
+    if (!server) {
+        std::cout << "服务器未初始化" << std::endl;
+        return;
+    }
+    
+    static const size_t kTopRoutes = 15;
+    const auto& routes = server->getRouter().getRoutes();
+    size_t pathWidth = routePathWidth(routes);
+    
+    // 最后一项是未匹配的请求
+    auto snapshotAll = [&]() {
+        std::vector<RouteMetricsSnapshot> snapshots;
+        snapshots.reserve(routes.size() + 1);
+        for (const auto& route : routes) {
+            snapshots.push_back(route.metrics->snapshot());
+        }
+        snapshots.push_back(server->getUnmatchedMetrics().snapshot());
+        return snapshots;
+    };
+    
+    std::vector<RouteMetricsSnapshot> previous = snapshotAll();
+    ServerLoad previousLoad = server->getLoad();
+    auto previousTime = std::chrono::steady_clock::now();
+    std::cout << "\n正在采集，每秒刷新，按任意键退出..." << std::endl;
+    
+    while (true) {
+        for (int i = 0; i < 20; ++i) {
+            if (_kbhit()) {
+                _getch();
+                return;
+            }
+            Sleep(50);
+        }
+        
+        std::vector<RouteMetricsSnapshot> current = snapshotAll();
+        ServerLoad load = server->getLoad();
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - previousTime).count();
+        double elapsedNs = seconds * 1e9;
+        
+        // 本次刷新区间内的增量，按请求数排序
+        std::vector<std::pair<size_t, RouteMetricsSnapshot>> busiest;
+        RouteMetricsSnapshot total;
+        for (size_t i = 0; i < current.size(); ++i) {
+            RouteMetricsSnapshot delta = current[i].since(previous[i]);
+            total.hits += delta.hits;
+            total.clientErrors += delta.clientErrors;
+            total.serverErrors += delta.serverErrors;
+            if (delta.hits > 0) {
+                busiest.emplace_back(i, std::move(delta));
+            }
+        }
+        std::sort(busiest.begin(), busiest.end(), [](const auto& a, const auto& b) { return a.second.hits > b.second.hits; });
+        
+        double workerBusy = load.workerBusyNs - previousLoad.workerBusyNs;
+        double databaseBusy = load.databaseBusyNs - previousLoad.databaseBusyNs;
+        auto share = [](double busy, double capacity) {
+            char text[16];
+            std::snprintf(text, sizeof(text), "%.0f%%", capacity > 0 ? std::min(busy / capacity, 1.0) * 100 : 0.0);
+            return std::string(text);
+        };
+        char rps[32];
+        std::snprintf(rps, sizeof(rps), "%.1f", total.hits / seconds);
+        
+        system("cls");
+        std::cout << "API管理系统 - top    " << Utils::getCurrentTimestamp() << "    按任意键退出" << std::endl;
+        std::cout << "  请求: " << rps << "/s    4xx: " << formatPercent(total.clientErrors, total.hits)
+                  << "    5xx: " << formatPercent(total.serverErrors, total.hits)
+                  << "    活动连接: " << load.activeConnections << std::endl;
+        std::cout << "  工作线程: " << load.workerThreads << "    队列: " << load.workerQueue
+                  << "    繁忙: " << share(workerBusy, elapsedNs * load.workerThreads) << std::endl;
+        std::cout << "  数据库: 队列 " << load.databaseQueue << "    时间占比: " << share(databaseBusy, elapsedNs) << std::endl;
+        std::cout << std::endl;
+        std::cout << "  " << column("方法", 7) << column("路径", pathWidth) << column("类型", 7) << column("请求/秒", 10, true)
+                  << column("4xx", 7, true) << column("5xx", 7, true) << column("p50", 9, true) << column("p99", 9, true) << std::endl;
+        if (busiest.empty()) {
+            std::cout << "  (最近一秒没有请求)" << std::endl;
+        }
+        for (size_t i = 0; i < busiest.size() && i < kTopRoutes; ++i) {
+            const auto& [index, delta] = busiest[i];
+            std::snprintf(rps, sizeof(rps), "%.1f", delta.hits / seconds);
+            if (index < routes.size()) {
+                const Route& route = routes[index];
+                printRouteRow(route.method, route.path, pathWidth, routeKind(route), rps, delta);
+            } else {
+                printRouteRow("-", "(未匹配)", pathWidth, "-", rps, delta);
+            }
+        }
+        
+        previous = std::move(current);
+        previousLoad = load;
+        previousTime = now;
+    }
+}
+
+// 请求追踪命令：无参数时显示状态
+void handleTraceCommand(const std::string& args) {
+    std::string argument = Utils::trim(args);
+    if (argument.empty()) {
+        uint32_t interval = Tracing::sampleInterval();
+        std::cout << "\n请求追踪: " << (interval == 0 ? "已关闭" : "每 " + std::to_string(interval) + " 个请求采样一个")
+                  << "，缓冲区中 " << Tracing::eventCount() << " 个事件" << std::endl;
+        return;
+    }
+    if (argument == "off") {
+        Tracing::setSampleInterval(0);
+        std::cout << "请求追踪已关闭，缓冲区中的事件仍可导出" << std::endl;
+        return;
+    }
+    if (argument == "clear") {
+        Tracing::clear();
+        std::cout << "已清空追踪缓冲区" << std::endl;
+        return;
+    }
+    if (argument.rfind("save ", 0) == 0) {
+        std::string path = Utils::trim(argument.substr(5));
+        std::ofstream file(path, std::ios::binary);
+        if (!file || !(file << Tracing::exportJson())) {
+            std::cout << "无法写入文件: " << path << std::endl;
+            return;
+        }
+        std::cout << "已导出到 " << path << "，可以在 chrome://tracing 或 ui.perfetto.dev 中打开" << std::endl;
+        return;
+    }
+    
+    long long interval = Utils::fromString<long long>(argument);
+    if (interval <= 0 || interval > 1000000) {
+        std::cout << "用法: trace [<N> | off | clear | save <文件>]" << std::endl;
+        return;
+    }
+    Tracing::setSampleInterval(static_cast<uint32_t>(interval));
+    std::cout << "请求追踪已开启，每 " << interval << " 个请求采样一个" << std::endl;
 }
 
 // 处理控制台命令
@@ -88,6 +340,10 @@ void handleConsoleCommands(ApiServer* server) {
             showStatus(server);
         } else if (command == "routes") {
             showRoutes(server);
+        } else if (command == "top") {
+            showTop(server);
+        } else if (command == "trace" || command.rfind("trace ", 0) == 0) {
+            handleTraceCommand(command.substr(5));
         } else if (command == "clear") {
             system("cls");
             showWelcome();
@@ -98,8 +354,558 @@ void handleConsoleCommands(ApiServer* server) {
     }
 }
 
-int main() {
+// 从命令行参数中取出配置文件路径
+std::string parseConfigPath(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--config") {
+            return argv[i + 1];
+        }
+    }
+    return "config.json";
+}
+
+// 从命令行参数中取出要生成的测试用户数量，未指定时返回0
+long long parseSeedCount(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--seed-users") {
+            return Utils::fromString<long long>(argv[i + 1]);
+        }
+    }
+    return 0;
+}
+
+// 生成测试用户，然后测量列表分页在表头、中部和表尾的耗时
+int seedUsers(const std::string& databasePath, long long count) {
+    Database database(databasePath);
+    if (!database.connect() || !database.initializeTables()) {
+        return 1;
+    }
+    
+    UserRepository users(database);
+    auto start = std::chrono::steady_clock::now();
+    long long inserted = users.generate(count);
+    if (inserted < 0) {
+        std::cerr << "生成测试用户失败: " << database.getLastError() << std::endl;
+        return 1;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "已插入 " << inserted << " 个用户，耗时 " << elapsed.count() << " ms" << std::endl;
+    
+    long long maxId = 0;
+    database.forEachRow("SELECT COALESCE(MAX(id), 0) FROM users", {}, [&](const DbRow& row) {
+        maxId = row.getInt(0);
+        return false;
+    });
+    
+    const int kPageSize = 20;
+    const int kRounds = 1000;
+    std::vector<User> page;
+    bool hasMore = false;
+    for (long long afterId : {0LL, maxId / 2, std::max(0LL, maxId - kPageSize)}) {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRounds; ++i) {
+            users.list(afterId, kPageSize, page, hasMore);
+        }
+        auto total = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+        std::cout << "列表分页 after=" << afterId << " limit=" << kPageSize << ": 平均 "
+                  << static_cast<double>(total.count()) / kRounds << " us" << std::endl;
+    }
+    return 0;
+}
+
+// 从命令行参数中取出要创建的API密钥：--create-api-key <名称> [作用域]，作用域默认为admin
+bool parseCreateApiKey(int argc, char* argv[], std::string& name, std::string& scopes) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--create-api-key") {
+            name = argv[i + 1];
+            scopes = i + 2 < argc && argv[i + 2][0] != '-' ? argv[i + 2] : "admin";
+            return true;
+        }
+    }
+    return false;
+}
+
+// 创建API密钥并输出明文，用于在没有任何密钥时创建第一个管理密钥
+// 直接写入数据库文件，服务器正在运行时需要重启才能加载
+int createApiKey(const std::string& databasePath, const std::string& name, const std::string& scopesText) {
+    uint64_t scopes = 0;
+    if (name.empty() || !ApiScope::parse(scopesText, scopes) || scopes == 0) {
+        std::cerr << "无效的API密钥名称或作用域: " << scopesText << std::endl;
+        return 1;
+    }
+    
+    Database database(databasePath);
+    if (!database.connect() || !database.initializeTables()) {
+        return 1;
+    }
+    
+    ApiKey created;
+    std::string key;
+    if (!ApiKeyRepository(database).create(name, scopes, 0, created, key)) {
+        std::cerr << "创建API密钥失败: " << database.getLastError() << std::endl;
+        return 1;
+    }
+    std::cout << "已创建API密钥 " << created.id << " (" << ApiScope::toString(scopes) << ")，只显示这一次:" << std::endl;
+    std::cout << key << std::endl;
+    return 0;
+}
+
+// 从命令行参数中取出测试上游的端口：--test-upstream <端口[,端口...]>，端口无效时ports为空
+bool parseTestUpstreams(int argc, char* argv[], std::vector<int>& ports) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--test-upstream") {
+            for (std::string_view item : Utils::splitView(argv[i + 1], ',')) {
+                int port = 0;
+                item = Utils::trimView(item);
+                auto result = std::from_chars(item.data(), item.data() + item.size(), port);
+                if (result.ec != std::errc() || result.ptr != item.data() + item.size() || port <= 0 || port > 65535) {
+                    ports.clear();
+                    return true;
+                }
+                ports.push_back(port);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// 在本机启动测试上游，用于手工测试反向代理；不加载配置、不启动服务器，按 Ctrl+C 结束
+int runTestUpstreams(const std::vector<int>& ports) {
+    if (ports.empty()) {
+        std::cerr << "无效的测试上游端口，格式为 --test-upstream 9001,9002" << std::endl;
+        return 1;
+    }
+    
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        std::cerr << "Winsock初始化失败" << std::endl;
+        return 1;
+    }
+    
+    std::vector<std::unique_ptr<TestUpstream>> upstreams;
+    for (int port : ports) {
+        auto upstream = std::make_unique<TestUpstream>(port);
+        if (!upstream->open()) {
+            WSACleanup();
+            return 1;
+        }
+        std::cout << "测试上游监听 127.0.0.1:" << port << std::endl;
+        upstreams.push_back(std::move(upstream));
+    }
+    
+    for (size_t i = 1; i < upstreams.size(); ++i) {
+        std::thread([upstream = upstreams[i].get()]() { upstream->run(); }).detach();
+    }
+    upstreams.front()->run();
+    return 0;
+}
+
+// 解析 "1,2,3" 形式的id列表
+bool parseIdList(std::string_view text, std::vector<long long>& ids) {
+    for (std::string_view item : Utils::splitView(text, ',')) {
+        item = Utils::trimView(item);
+        long long id = 0;
+        auto result = std::from_chars(item.data(), item.data() + item.size(), id);
+        if (result.ec != std::errc() || result.ptr != item.data() + item.size()) {
+            return false;
+        }
+        ids.push_back(id);
+    }
+    return !ids.empty() && ids.size() <= UserRepository::kMaxBatchSize;
+}
+
+// 校验用户字段，为空表示不检查（更新时未提供）
+bool validateUserFields(const std::string& username, const std::string& email, const std::string& password,
+                        std::string& error) {
+    if (username.size() > 64) {
+        error = "username must be at most 64 characters";
+    } else if (!email.empty() && (email.size() > 254 || email.find('@') == std::string::npos)) {
+        error = "invalid email";
+    } else if (!password.empty() && password.size() < 8) {
+        error = "password must be at least 8 characters";
+    } else {
+        return true;
+    }
+    return false;
+}
+
+// 批量导入的进度，跨多个批次累计
+struct ImportProgress {
+    long long lines = 0;            // 已处理的行数（包括空行）
+    long long inserted = 0;
+    long long skipped = 0;          // 与已有用户冲突而跳过的行
+    std::string error;              // 非空时导入在下一行（第 lines + 1 行）中止
+};
+
+// 每批累积的请求体字节数，一批在一个事务中插入
+const size_t kImportBatchBytes = 4 * 1024 * 1024;
+
+// 单行的最大长度，超过时中止导入，避免没有换行的请求体占满内存
+const size_t kMaxImportLine = 64 * 1024;
+
+// 每次从数据库读取并发送的用户数
+const int kExportPageSize = 5000;
+
+// 解析一行导入数据，失败时设置error
+bool parseImportLine(const std::string& line, UserImportRow& row, std::string& error) {
+    JsonValue value;
+    if (!JsonValue::parse(line, value, error) || !value.isObject()) {
+        error = "invalid JSON";
+        return false;
+    }
+    
+    const JsonValue& id = value["id"];
+    if (!id.isNull() && (!id.isNumber() || id.asNumber() < 1 || id.asNumber() != static_cast<double>(id.asInt()))) {
+        error = "id must be a positive integer";
+        return false;
+    }
+    row.id = id.asInt();
+    row.username = value["username"].asString();
+    row.email = value["email"].asString();
+    row.passwordHash = value["password_hash"].asString();
+    row.createdAt = value["created_at"].asString();
+    row.updatedAt = value["updated_at"].asString();
+    
+    if (row.username.empty() || row.email.empty()) {
+        error = "username and email are required";
+        return false;
+    }
+    return validateUserFields(row.username, row.email, "", error);
+}
+
+// 取出pending中完整的行解析为用户，未以换行结束的最后一行留在pending中等待下一块，final为true时也一并处理
+// 遇到无效的行时停止并设置progress.error，之前的行仍然放入rows
+void parseImportLines(std::string& pending, bool final, ImportProgress& progress, std::vector<UserImportRow>& rows) {
+    size_t start = 0;
+    std::string line;
+    while (start < pending.size()) {
+        size_t end = pending.find('\n', start);
+        if (end == std::string::npos) {
+            if (!final) break;
+            end = pending.size();
+        }
+        
+        line.assign(pending, start, end - start);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        
+        if (!Utils::trimView(line).empty()) {
+            UserImportRow row;
+            std::string error;
+            if (!parseImportLine(line, row, error)) {
+                progress.error = "line " + std::to_string(progress.lines + 1) + ": " + error;
+                pending.clear();
+                return;
+            }
+            rows.push_back(std::move(row));
+        }
+        ++progress.lines;
+        start = end + 1;
+    }
+    
+    pending.erase(0, std::min(start, pending.size()));
+    if (pending.size() > kMaxImportLine) {
+        progress.error = "line " + std::to_string(progress.lines + 1) + ": longer than " +
+                         std::to_string(kMaxImportLine) + " bytes";
+        pending.clear();
+    }
+}
+
+std::string importResultJson(const ImportProgress& progress) {
+    return "\"lines\": " + std::to_string(progress.lines) +
+           ", \"inserted\": " + std::to_string(progress.inserted) +
+           ", \"skipped\": " + std::to_string(progress.skipped);
+}
+
+// 写操作的结果转换为响应
+void sendUserResult(HttpResponse& res, UserWriteResult result, const User& user, int successStatus) {
+    switch (result) {
+        case UserWriteResult::Ok:
+            res.status(successStatus).json(UserRepository::toJson(user));
+            break;
+        case UserWriteResult::NotFound:
+            res.status(404).json("{\"error\": \"User not found\"}");
+            break;
+        case UserWriteResult::Conflict:
+            res.status(409).json("{\"error\": \"Username or email already exists\"}");
+            break;
+        default:
+            res.status(500).json("{\"error\": \"Database error\"}");
+            break;
+    }
+}
+
+// 用户接口：协程处理器，数据库操作在数据库执行器上运行，密码哈希在工作线程池上计算
+void registerUserRoutes(ApiServer* server) {
+    // 键集分页 ?after=<上一页最后的id>&limit=<数量>，或批量查询 ?ids=1,2,3
+    server->get("/api/users?after<int>&limit<int>&ids", [server](const HttpRequest& req, HttpResponse& res) -> Task {
+        struct Page {
+            bool ok = false;
+            bool hasMore = false;
+            std::vector<User> users;
+        };
+        
+        std::string idList = req.getQueryParam("ids");
+        Page page;
+        if (!idList.empty()) {
+            std::vector<long long> ids;
+            if (!parseIdList(idList, ids)) {
+                res.status(400).json("{\"error\": \"Invalid parameter: ids\"}");
+                co_return;
+            }
+            page = co_await server->onDatabase([ids = std::move(ids)](Database& db) {
+                Page page;
+                page.ok = UserRepository(db).findMany(ids, page.users);
+                return page;
+            });
+        } else {
+            long long afterId = req.getInt("after", 0);
+            int limit = static_cast<int>(std::clamp(req.getInt("limit", 20), 1LL, static_cast<long long>(UserRepository::kMaxPageSize)));
+            page = co_await server->onDatabase([afterId, limit](Database& db) {
+                Page page;
+                page.ok = UserRepository(db).list(afterId, limit, page.users, page.hasMore);
+                return page;
+            });
+        }
+        
+        if (!page.ok) {
+            res.status(500).json("{\"error\": \"Database error\"}");
+            co_return;
+        }
+        
+        std::string json = "{\"users\": [";
+        for (size_t i = 0; i < page.users.size(); ++i) {
+            if (i > 0) json += ", ";
+            json += UserRepository::toJson(page.users[i]);
+        }
+        json += "], \"next_after\": ";
+        json += page.hasMore ? std::to_string(page.users.back().id) : "null";
+        json += "}";
+        res.json(json);
+    });
+    
+    server->post("/api/users", [server](const HttpRequest& req, HttpResponse& res) -> Task {
+        JsonValue body;
+        std::string error;
+        if (!JsonValue::parse(req.body, body, error) || !body.isObject()) {
+            res.status(400).json("{\"error\": \"Invalid JSON body\"}");
+            co_return;
+        }
+        
+        std::string username = body["username"].asString();
+        std::string email = body["email"].asString();
+        std::string password = body["password"].asString();
+        if (username.empty() || email.empty() || password.empty()) {
+            res.status(400).json("{\"error\": \"username, email and password are required\"}");
+            co_return;
+        }
+        if (!validateUserFields(username, email, password, error)) {
+            res.status(400).json("{\"error\": \"" + error + "\"}");
+            co_return;
+        }
+        
+        std::string passwordHash = co_await server->offload([password]() { return Crypto::hashPassword(password); });
+        if (passwordHash.empty()) {
+            res.status(500).json("{\"error\": \"Password hashing failed\"}");
+            co_return;
+        }
+        
+        struct Created {
+            UserWriteResult result = UserWriteResult::Error;
+            User user;
+        };
+        Created created = co_await server->onDatabase([username, email, passwordHash](Database& db) {
+            Created created;
+            created.result = UserRepository(db).create(username, email, passwordHash, created.user);
+            return created;
+        });
+        sendUserResult(res, created.result, created.user, 201);
+    });
+    
+    // :id<int> 在路由匹配时校验，非数字的id直接返回400
+    server->get("/api/users/:id<int>", [server](const HttpRequest& req, HttpResponse& res) -> Task {
+        long long id = req.getInt("id");
+        
+        // 行缓存命中时直接在事件循环上响应，不经过数据库执行器
+        if (auto cached = UserRepository::cachedUser(*server->getDatabase(), id)) {
+            sendUserResult(res, UserWriteResult::Ok, *cached, 200);
+            co_return;
+        }
+        
+        struct Found {
+            bool found = false;
+            User user;
+        };
+        Found result = co_await server->onDatabase([id](Database& db) {
+            Found result;
+            result.found = UserRepository(db).find(id, result.user);
+            return result;
+        });
+        sendUserResult(res, result.found ? UserWriteResult::Ok : UserWriteResult::NotFound, result.user, 200);
+    });
+    
+    // 只修改请求体中提供的字段
+    server->put("/api/users/:id<int>", [server](const HttpRequest& req, HttpResponse& res) -> Task {
+        long long id = req.getInt("id");
+        JsonValue body;
+        std::string error;
+        if (!JsonValue::parse(req.body, body, error) || !body.isObject()) {
+            res.status(400).json("{\"error\": \"Invalid JSON body\"}");
+            co_return;
+        }
+        
+        std::string username = body["username"].asString();
+        std::string email = body["email"].asString();
+        std::string password = body["password"].asString();
+        if (username.empty() && email.empty() && password.empty()) {
+            res.status(400).json("{\"error\": \"Nothing to update\"}");
+            co_return;
+        }
+        if (!validateUserFields(username, email, password, error)) {
+            res.status(400).json("{\"error\": \"" + error + "\"}");
+            co_return;
+        }
+        
+        std::string passwordHash;
+        if (!password.empty()) {
+            passwordHash = co_await server->offload([password]() { return Crypto::hashPassword(password); });
+            if (passwordHash.empty()) {
+                res.status(500).json("{\"error\": \"Password hashing failed\"}");
+                co_return;
+            }
+        }
+        
+        struct Updated {
+            UserWriteResult result = UserWriteResult::Error;
+            User user;
+        };
+        Updated updated = co_await server->onDatabase([id, username, email, passwordHash](Database& db) {
+            Updated updated;
+            updated.result = UserRepository(db).update(id, username, email, passwordHash, updated.user);
+            return updated;
+        });
+        sendUserResult(res, updated.result, updated.user, 200);
+    });
+    
+    server->del("/api/users/:id<int>", [server](const HttpRequest& req, HttpResponse& res) -> Task {
+        long long id = req.getInt("id");
+        UserWriteResult result = co_await server->onDatabase([id](Database& db) {
+            return UserRepository(db).remove(id);
+        });
+        if (result == UserWriteResult::Ok) {
+            res.status(204);
+            res.body.clear();
+            co_return;
+        }
+        sendUserResult(res, result, User(), 204);
+    });
+    
+    // 批量导入：请求体为NDJSON，每行一个用户，格式与导出相同（id、password_hash、created_at、updated_at可选）
+    // 请求体边接收边解析，每 kImportBatchBytes 在一个事务中插入；与已有用户冲突的行跳过。
+    // ?defer_index=1 时导入期间删除列表索引，结束后一次重建。出错时之前的批次已经提交
+    server->post("/api/users/import?defer_index<int>", [server](const HttpRequest& req, HttpResponse& res) -> Task {
+        HttpStream& stream = *req.stream;
+        bool deferIndex = req.getInt("defer_index", 0) != 0;
+        ImportProgress progress;
+        bool dbError = false;
+        
+        dbError = !co_await server->onDatabase([deferIndex](Database& db) {
+            return UserRepository(db).beginBulkLoad(deferIndex);
+        });
+        
+        std::string pending;
+        while (!dbError && progress.error.empty()) {
+            std::string chunk = co_await stream.read();
+            bool final = chunk.empty();
+            if (final && stream.aborted()) break;
+            
+            if (pending.empty()) {
+                pending.swap(chunk);
+            } else {
+                pending += chunk;
+            }
+            if (!final && pending.size() < kImportBatchBytes) continue;
+            
+            // 解析和插入都在数据库执行器上进行，协程挂起期间pending和progress保持有效
+            dbError = !co_await server->onDatabase([&pending, &progress, final](Database& db) {
+                std::vector<UserImportRow> rows;
+                parseImportLines(pending, final, progress, rows);
+                long long inserted = UserRepository(db).importRows(rows);
+                if (inserted < 0) return false;
+                progress.inserted += inserted;
+                progress.skipped += static_cast<long long>(rows.size()) - inserted;
+                return true;
+            });
+            if (final) break;
+        }
+        
+        if (!co_await server->onDatabase([deferIndex](Database& db) { return UserRepository(db).endBulkLoad(deferIndex); })) {
+            dbError = true;
+        }
+        
+        if (dbError) {
+            res.status(500).json("{\"error\": \"Database error\", " + importResultJson(progress) + "}");
+        } else if (!progress.error.empty()) {
+            res.status(400).json("{\"error\": \"" + Utils::escapeJsonString(progress.error) + "\", " +
+                                 importResultJson(progress) + "}");
+        } else {
+            res.json("{" + importResultJson(progress) + "}");
+        }
+    });
+    server->enableStreaming("POST", "/api/users/import?defer_index<int>");
+    
+    // 批量导出：按id顺序分页读取，以NDJSON分块发送，对端接收慢时暂停读取数据库
+    // ?after=<id> 从指定id之后开始；?password_hash=1 包含密码哈希，用于迁移到另一个实例
+    // 每页单独读取，导出期间的写入是否出现取决于它所在的位置
+    server->get("/api/users/export?after<int>&password_hash<int>", [server](const HttpRequest& req, HttpResponse& res) -> Task {
+        HttpStream& stream = *req.stream;
+        long long afterId = req.getInt("after", 0);
+        bool withHash = req.getInt("password_hash", 0) != 0;
+        
+        struct Page {
+            long long lastId = -1;
+            std::string data;
+        };
+        while (true) {
+            Page page = co_await server->onDatabase([afterId, withHash](Database& db) {
+                Page page;
+                page.lastId = UserRepository(db).exportRows(afterId, kExportPageSize, withHash, page.data);
+                return page;
+            });
+            
+            if (page.lastId < 0) {
+                // 已经发出响应头时无法再返回错误，抛出异常由服务器关闭连接，客户端收到不完整的分块
+                if (stream.started()) throw std::runtime_error("导出用户失败");
+                res.status(500).json("{\"error\": \"Database error\"}");
+                co_return;
+            }
+            
+            if (!stream.started()) {
+                res.header("Content-Type", "application/x-ndjson");
+                stream.begin(res);
+            }
+            if (page.data.empty()) break;
+            
+            if (!co_await stream.write(std::move(page.data))) co_return;
+            afterId = page.lastId;
+        }
+    });
+    server->enableStreaming("GET", "/api/users/export?after<int>&password_hash<int>");
+}
+
+int main(int argc, char* argv[]) {
     try {
+        std::string configPath = parseConfigPath(argc, argv);
+        
+        // 时间戳和HTTP Date由时钟服务统一刷新
+        CoarseClock::start();
+        
+        // 启动测试上游后一直运行，在注册Ctrl+C处理之前，Ctrl+C直接结束进程
+        std::vector<int> testPorts;
+        if (parseTestUpstreams(argc, argv, testPorts)) {
+            return runTestUpstreams(testPorts);
+        }
+        
         // 设置控制台
         setConsoleTitle();
         showWelcome();
@@ -108,59 +914,395 @@ int main() {
         SetConsoleCtrlHandler(signalHandler, TRUE);
         
         // 加载配置
-        std::string host = "127.0.0.1";
-        int port = 8080;
+        ConfigManager configManager(configPath);
+        if (!configManager.load()) {
+            return 1;
+        }
+        auto config = configManager.current();
+        Logger::setLevel(config->logLevel);
+        
+        // 创建API密钥后退出
+        std::string keyName;
+        std::string keyScopes;
+        if (parseCreateApiKey(argc, argv, keyName, keyScopes)) {
+            int result = createApiKey(config->database, keyName, keyScopes);
+            CoarseClock::stop();
+            return result;
+        }
         
-        // 检查配置文件
-        if (Utils::fileExists("config.json")) {
-            std::string configContent = Utils::readFile("config.json");
-            auto config = Utils::parseConfigFile(configContent);
-            host = Utils::getConfigValue(config, "host", host);
-            port = Utils::fromString<int>(Utils::getConfigValue(config, "port", "8080"));
+        // 生成测试数据后退出
+        long long seedCount = parseSeedCount(argc, argv);
+        if (seedCount > 0) {
+            int result = seedUsers(config->database, seedCount);
+            CoarseClock::stop();
+            return result;
         }
         
         // 创建服务器
-        g_server = new ApiServer(host, port);
+        g_server = new ApiServer(config->host, config->port);
+        g_server->setDatabasePath(config->database);
+        g_server->setIoBackend(config->ioBackend);
+        if (config->workerThreads > 0) {
+            g_server->setWorkerThreads(config->workerThreads);
+        }
+        g_server->setMaxConnections(config->maxConnections);
+        g_server->setTimeouts(std::chrono::seconds(config->timeout), std::chrono::seconds(config->headerTimeout),
+                              std::chrono::seconds(config->writeTimeout));
+        g_server->setMaxBodySize(config->maxBodyMb * 1024 * 1024);
+        g_server->setCors(config->cors);
+        g_server->getDatabase()->rowCache().setCapacity(config->rowCacheMb * 1024 * 1024);
+        g_server->getApiLog().setRetentionDays(config->logRetentionDays);
+        Tracing::setSampleInterval(config->traceSampleInterval);
+        g_server->getDatabase()->profiler().setSlowThreshold(config->slowQueryMs);
+        g_server->setProxyThreads(config->proxyThreads);
         
         // 注册API路由
         g_server->get("/", [](const HttpRequest& req, HttpResponse& res) {
             res.json("{\"message\": \"欢迎使用API管理系统\", \"version\": \"1.0.0\", \"timestamp\": \"" + Utils::getCurrentTimestamp() + "\"}");
         });
         
-        g_server->get("/api/users", [](const HttpRequest& req, HttpResponse& res) {
-            res.json("{\"users\": [{\"id\": 1, \"name\": \"张三\", \"email\": \"zhangsan@example.com\"}, {\"id\": 2, \"name\": \"李四\", \"email\": \"lisi@example.com\"}]}");
+        registerUserRoutes(g_server);
+        
+        // 协程处理器：数据库查询在数据库执行器上运行，不占用事件循环线程
+        g_server->get("/api/status", [](const HttpRequest& req, HttpResponse& res) -> Task {
+            std::string database = co_await g_server->onDatabase([](Database& db) {
+                return std::string(db.isConnected() ? "connected" : "disconnected");
+            });
+            RowCacheStats cache = g_server->getDatabase()->rowCache().stats();
+            std::string cacheJson = "{\"hits\": " + std::to_string(cache.hits) +
+                                    ", \"misses\": " + std::to_string(cache.misses) +
+                                    ", \"evictions\": " + std::to_string(cache.evictions) +
+                                    ", \"invalidations\": " + std::to_string(cache.invalidations) +
+                                    ", \"entries\": " + std::to_string(cache.entries) +
+                                    ", \"bytes\": " + std::to_string(cache.bytes) +
+                                    ", \"capacity\": " + std::to_string(cache.capacity) + "}";
+            res.json("{\"status\": \"running\", \"uptime\": \"" + Utils::getCurrentTimestamp() + "\", \"version\": \"1.0.0\", \"database\": \"" + database + "\", \"row_cache\": " + cacheJson + "}");
+        });
+        
+        // 请求统计：只读取汇总表，?resolution=minute|hour|day&by=route|status|all&from=&to=（Unix秒）
+        g_server->get("/api/stats?from<int>&to<int>&resolution&by", [](const HttpRequest& req, HttpResponse& res) -> Task {
+            RollupResolution resolution;
+            StatsGroup group;
+            if (!ApiLogWriter::parseResolution(req.getQueryParam("resolution"), resolution)) {
+                res.status(400).json("{\"error\": \"Invalid parameter: resolution\"}");
+                co_return;
+            }
+            if (!ApiLogWriter::parseGroup(req.getQueryParam("by"), group)) {
+                res.status(400).json("{\"error\": \"Invalid parameter: by\"}");
+                co_return;
+            }
+            
+            // 默认为最近60个桶，包括当前未结束的桶
+            long long length = ApiLogWriter::bucketSeconds(resolution);
+            long long now = CoarseClock::nowMillis() / 1000;
+            long long to = req.getInt("to", now - now % length + length);
+            long long from = req.getInt("from", to - 60 * length);
+            if (from >= to || (to - from) / length > ApiLogWriter::kMaxBuckets) {
+                res.status(400).json("{\"error\": \"Invalid time range\"}");
+                co_return;
+            }
+            
+            struct Stats {
+                bool ok = false;
+                std::vector<ApiStatsRow> rows;
+            };
+            Stats stats = co_await g_server->onDatabase([resolution, from, to, group](Database& db) {
+                Stats stats;
+                stats.ok = ApiLogWriter::queryStats(db, resolution, from, to, group, stats.rows);
+                return stats;
+            });
+            if (!stats.ok) {
+                res.status(500).json("{\"error\": \"Database error\"}");
+                co_return;
+            }
+            
+            std::string json = "{\"from\": " + std::to_string(from) + ", \"to\": " + std::to_string(to) +
+                               ", \"bucket_seconds\": " + std::to_string(length) + ", \"buckets\": [";
+            for (size_t i = 0; i < stats.rows.size(); ++i) {
+                if (i > 0) json += ", ";
+                json += ApiLogWriter::toJson(stats.rows[i], group);
+            }
+            json += "]}";
+            res.json(json);
         });
         
-        g_server->post("/api/users", [](const HttpRequest& req, HttpResponse& res) {
-            res.status(201).json("{\"message\": \"用户创建成功\", \"id\": 3, \"timestamp\": \"" + Utils::getCurrentTimestamp() + "\"}");
+        // 日志全文搜索：?q=<FTS5查询>&limit=&before=<上一页的next_before>
+        g_server->get("/api/logs/search?q&limit<int>&before<int>", [](const HttpRequest& req, HttpResponse& res) -> Task {
+            std::string query = req.getQueryParam("q");
+            if (Utils::trimView(query).empty()) {
+                res.status(400).json("{\"error\": \"Missing parameter: q\"}");
+                co_return;
+            }
+            long long before = req.getInt("before", 0);
+            int limit = static_cast<int>(std::clamp(req.getInt("limit", 50), 1LL, static_cast<long long>(ApiLogWriter::kMaxSearchLimit)));
+            
+            struct Found {
+                bool ok = false;
+                bool hasMore = false;
+                std::string error;
+                std::vector<ApiLogRecord> records;
+            };
+            Found found = co_await g_server->onDatabase([query, before, limit](Database& db) {
+                Found found;
+                found.ok = g_server->getApiLog().search(db, query, before, limit, found.records, found.hasMore, found.error);
+                return found;
+            });
+            if (!found.ok) {
+                if (found.error.empty()) {
+                    res.status(500).json("{\"error\": \"Database error\"}");
+                } else {
+                    res.status(400).json("{\"error\": \"" + Utils::escapeJsonString(found.error) + "\"}");
+                }
+                co_return;
+            }
+            
+            std::string json = "{\"logs\": [";
+            for (size_t i = 0; i < found.records.size(); ++i) {
+                if (i > 0) json += ", ";
+                json += ApiLogWriter::toJson(found.records[i]);
+            }
+            json += "], \"next_before\": ";
+            json += found.hasMore ? "\"" + std::to_string(found.records.back().id) + "\"" : "null";
+            json += "}";
+            res.json(json);
         });
         
-        g_server->get("/api/users/:id", [](const HttpRequest& req, HttpResponse& res) {
-            std::string id = req.getParam("id");
-            res.json("{\"id\": " + id + ", \"name\": \"用户" + id + "\", \"email\": \"user" + id + "@example.com\"}");
+        // 请求追踪：导出各线程缓冲区中的阶段事件（Chrome Trace Event格式），?clear=1 导出后清空
+        g_server->get("/api/admin/trace?clear<int>", [](const HttpRequest& req, HttpResponse& res) {
+            res.json(Tracing::exportJson());
+            if (req.getInt("clear", 0) != 0) {
+                Tracing::clear();
+            }
         });
         
-        g_server->put("/api/users/:id", [](const HttpRequest& req, HttpResponse& res) {
-            std::string id = req.getParam("id");
-            res.json("{\"message\": \"用户更新成功\", \"id\": " + id + ", \"timestamp\": \"" + Utils::getCurrentTimestamp() + "\"}");
+        // SQL语句分析：按规范化的语句汇总耗时和行数，慢语句附带执行计划和全表扫描的表
+        // ?sort=total|max|count|rows|scans&limit=
+        g_server->get("/api/admin/queries?sort&limit<int>", [](const HttpRequest& req, HttpResponse& res) -> Task {
+            QuerySort sort;
+            if (!QueryProfiler::parseSort(req.getQueryParam("sort"), sort)) {
+                res.status(400).json("{\"error\": \"Invalid parameter: sort\"}");
+                co_return;
+            }
+            size_t limit = static_cast<size_t>(std::clamp(req.getInt("limit", 50), 1LL, static_cast<long long>(QueryProfiler::kMaxStatements)));
+            
+            struct Report {
+                long long slowQueryMs = 0;
+                std::vector<QueryStats> statements;
+            };
+            Report report = co_await g_server->onDatabase([sort, limit](Database& db) {
+                db.capturePlans();
+                Report report;
+                report.slowQueryMs = db.profiler().slowThresholdMs();
+                report.statements = db.profiler().report(sort, limit);
+                return report;
+            });
+            
+            std::string json = "{\"slow_query_ms\": " + std::to_string(report.slowQueryMs) + ", \"statements\": [";
+            for (size_t i = 0; i < report.statements.size(); ++i) {
+                if (i > 0) json += ", ";
+                json += QueryProfiler::toJson(report.statements[i]);
+            }
+            json += "]}";
+            res.json(json);
         });
         
-        g_server->del("/api/users/:id", [](const HttpRequest& req, HttpResponse& res) {
-            std::string id = req.getParam("id");
-            res.json("{\"message\": \"用户删除成功\", \"id\": " + id + ", \"timestamp\": \"" + Utils::getCurrentTimestamp() + "\"}");
+        g_server->del("/api/admin/queries", [](const HttpRequest&, HttpResponse& res) -> Task {
+            co_await g_server->onDatabase([](Database& db) { db.profiler().reset(); });
+            res.json("{\"message\": \"SQL统计已清空\"}");
         });
         
-        g_server->get("/api/status", [](const HttpRequest& req, HttpResponse& res) {
-            res.json("{\"status\": \"running\", \"uptime\": \"" + Utils::getCurrentTimestamp() + "\", \"version\": \"1.0.0\"}");
+        // 反向代理的上游：进行中的请求、空闲连接、失败次数和摘除状态
+        g_server->get("/api/admin/upstreams", [](const HttpRequest&, HttpResponse& res) {
+            const auto& proxies = g_server->getProxies();
+            std::string json = "{\"proxies\": [";
+            for (size_t i = 0; i < proxies.size(); ++i) {
+                if (i > 0) json += ", ";
+                json += proxies[i]->toJson();
+            }
+            json += "]}";
+            res.json(json);
+        });
+        
+        // API密钥管理；新密钥的明文只在创建的响应中出现一次
+        g_server->get("/api/admin/keys", [](const HttpRequest&, HttpResponse& res) -> Task {
+            struct Listed {
+                bool ok = false;
+                std::vector<ApiKey> keys;
+            };
+            Listed listed = co_await g_server->onDatabase([](Database& db) {
+                Listed listed;
+                listed.ok = ApiKeyRepository(db).list(listed.keys);
+                return listed;
+            });
+            if (!listed.ok) {
+                res.status(500).json("{\"error\": \"Database error\"}");
+                co_return;
+            }
+            
+            std::string json = "{\"keys\": [";
+            for (size_t i = 0; i < listed.keys.size(); ++i) {
+                if (i > 0) json += ", ";
+                json += ApiKeyRepository::toJson(listed.keys[i]);
+            }
+            json += "], \"active\": " + std::to_string(g_server->getApiKeys().size()) + "}";
+            res.json(json);
+        });
+        
+        // {"name": ..., "scopes": "users:read,users:write", "expires_in_days": 90}
+        g_server->post("/api/admin/keys", [](const HttpRequest& req, HttpResponse& res) -> Task {
+            JsonValue body;
+            std::string error;
+            if (!JsonValue::parse(req.body, body, error) || !body.isObject()) {
+                res.status(400).json("{\"error\": \"Invalid JSON body\"}");
+                co_return;
+            }
+            
+            std::string name = body["name"].asString();
+            uint64_t scopes = 0;
+            if (name.empty() || name.size() > 64) {
+                res.status(400).json("{\"error\": \"name is required and must be at most 64 characters\"}");
+                co_return;
+            }
+            if (!ApiScope::parse(body["scopes"].asString(), scopes) || scopes == 0) {
+                res.status(400).json("{\"error\": \"scopes must list users:read, users:write, logs:read, admin or *\"}");
+                co_return;
+            }
+            const JsonValue& days = body["expires_in_days"];
+            long long expiresAt = 0;
+            if (!days.isNull()) {
+                if (!days.isNumber() || days.asInt() < 1 || days.asInt() > 3650) {
+                    res.status(400).json("{\"error\": \"expires_in_days must be between 1 and 3650\"}");
+                    co_return;
+                }
+                expiresAt = CoarseClock::nowMillis() / 1000 + days.asInt() * 86400;
+            }
+            
+            struct Created {
+                bool ok = false;
+                ApiKey key;
+                std::string secret;
+            };
+            Created created = co_await g_server->onDatabase([name, scopes, expiresAt](Database& db) {
+                Created created;
+                created.ok = ApiKeyRepository(db).create(name, scopes, expiresAt, created.key, created.secret);
+                return created;
+            });
+            if (!created.ok) {
+                res.status(500).json("{\"error\": \"Database error\"}");
+                co_return;
+            }
+            
+            std::string json = ApiKeyRepository::toJson(created.key);
+            json.insert(json.size() - 1, ", \"key\": \"" + created.secret + "\"");
+            res.status(201).json(json);
+        });
+        
+        // 吊销立即生效：update_hook 在UPDATE执行时就把密钥移出索引
+        g_server->del("/api/admin/keys/:id<int>", [](const HttpRequest& req, HttpResponse& res) -> Task {
+            long long id = req.getInt("id");
+            struct Revoked {
+                bool ok = false;
+                bool found = false;
+            };
+            Revoked revoked = co_await g_server->onDatabase([id](Database& db) {
+                Revoked revoked;
+                revoked.ok = ApiKeyRepository(db).revoke(id, revoked.found);
+                return revoked;
+            });
+            if (!revoked.ok) {
+                res.status(500).json("{\"error\": \"Database error\"}");
+            } else if (!revoked.found) {
+                res.status(404).json("{\"error\": \"API key not found\"}");
+            } else {
+                res.status(204);
+                res.body.clear();
+            }
+        });
+        
+        // 管理接口可以读取追踪、清空SQL统计和管理密钥，无论是否启用 auth_enabled 都需要admin作用域
+        const std::pair<const char*, const char*> adminRoutes[] = {
+            {"GET", "/api/admin/trace?clear<int>"},
+            {"GET", "/api/admin/queries?sort&limit<int>"},
+            {"DELETE", "/api/admin/queries"},
+            {"GET", "/api/admin/upstreams"},
+            {"GET", "/api/admin/keys"},
+            {"POST", "/api/admin/keys"},
+            {"DELETE", "/api/admin/keys/:id<int>"},
+        };
+        for (const auto& [method, path] : adminRoutes) g_server->requireApiKey(method, path, ApiScope::Admin);
+        
+        // 实时日志和指标：WebSocket订阅者收到每个请求的访问记录和每秒的指标，取代轮询 /api/status
+        g_server->websocket("/api/live", "live");
+        g_server->setLiveChannel("live");
+        
+        // 写操作按客户端IP限流，多个路由共享同一组令牌桶
+        auto writeLimiter = g_server->rateLimit("POST", "/api/users", config->writeLimit);
+        g_server->rateLimit("PUT", "/api/users/:id<int>", writeLimiter);
+        g_server->rateLimit("DELETE", "/api/users/:id<int>", writeLimiter);
+        
+        // 启用API密钥时，用户接口按读写区分作用域，统计和日志接口需要logs:read
+        if (config->authEnabled) {
+            const std::pair<const char*, const char*> userReads[] = {
+                {"GET", "/api/users?after<int>&limit<int>&ids"},
+                {"GET", "/api/users/:id<int>"},
+                {"GET", "/api/users/export?after<int>&password_hash<int>"},
+            };
+            const std::pair<const char*, const char*> userWrites[] = {
+                {"POST", "/api/users"},
+                {"PUT", "/api/users/:id<int>"},
+                {"DELETE", "/api/users/:id<int>"},
+                {"POST", "/api/users/import?defer_index<int>"},
+            };
+            const std::pair<const char*, const char*> logReads[] = {
+                {"GET", "/api/stats?from<int>&to<int>&resolution&by"},
+                {"GET", "/api/logs/search?q&limit<int>&before<int>"},
+                {"GET", "/api/live"},
+            };
+            for (const auto& [method, path] : userReads) g_server->requireApiKey(method, path, ApiScope::UsersRead);
+            for (const auto& [method, path] : userWrites) g_server->requireApiKey(method, path, ApiScope::UsersWrite);
+            for (const auto& [method, path] : logReads) g_server->requireApiKey(method, path, ApiScope::LogsRead);
+        }
+        
+        // 同一个用户被大量并发读取（如缓存失效时）只查询一次数据库，同时到达的请求共享结果
+        g_server->coalesce("/api/users/:id<int>");
+        
+        // 反向代理在本地路由之后注册，前缀下已有的本地路由优先匹配
+        for (const auto& proxy : config->proxies) {
+            g_server->proxy(proxy);
+        }
+        
+        // 配置文件修改后立即应用可在运行中调整的参数
+        configManager.onReload([writeLimiter](const ServerConfig& previous, const ServerConfig& current) {
+            Logger::setLevel(current.logLevel);
+            if (current.workerThreads != previous.workerThreads && current.workerThreads > 0) {
+                g_server->setWorkerThreads(current.workerThreads);
+            }
+            g_server->setMaxConnections(current.maxConnections);
+            g_server->setTimeouts(std::chrono::seconds(current.timeout), std::chrono::seconds(current.headerTimeout),
+                                  std::chrono::seconds(current.writeTimeout));
+            g_server->setMaxBodySize(current.maxBodyMb * 1024 * 1024);
+            g_server->getDatabase()->rowCache().setCapacity(current.rowCacheMb * 1024 * 1024);
+            g_server->getApiLog().setRetentionDays(current.logRetentionDays);
+            if (current.traceSampleInterval != previous.traceSampleInterval) {
+                Tracing::setSampleInterval(current.traceSampleInterval);
+            }
+            if (current.slowQueryMs != previous.slowQueryMs) {
+                g_server->getDatabase()->profiler().setSlowThreshold(current.slowQueryMs);
+            }
+            if (current.proxyThreads != previous.proxyThreads) {
+                g_server->setProxyThreads(current.proxyThreads);
+            }
+            writeLimiter->reconfigure(current.writeLimit.requestsPerSecond, current.writeLimit.burst);
         });
+        configManager.startWatching();
         
         // 启动服务器
         std::cout << "\n正在启动API服务器..." << std::endl;
-        std::cout << "服务器地址: http://" << host << ":" << port << std::endl;
+        std::cout << "服务器地址: http://" << config->host << ":" << config->port << std::endl;
         std::cout << "按 Ctrl+C 停止服务器" << std::endl;
         
         // 在新线程中启动服务器
-        std::thread serverThread([g_server]() {
+        std::thread serverThread([]() {
             g_server->start();
         });
         
@@ -168,10 +1310,12 @@ int main() {
         handleConsoleCommands(g_server);
         
         // 停止服务器
+        configManager.stopWatching();
         g_server->stop();
         serverThread.join();
         
         delete g_server;
+        CoarseClock::stop();
         std::cout << "\n服务器已关闭，再见！" << std::endl;
         
     } catch (const std::exception& e) {
@@ -0,0 +1,51 @@
+#include "middleware.h"
+#include "utils.h"
+
+Cors::Cors(const CorsConfig& config) : config_(config), anyOrigin_(false) {
+    for (std::string_view origin : Utils::splitView(config_.origin, ',')) {
+        std::string_view trimmed = Utils::trimView(origin);
+        if (trimmed == "*") {
+            anyOrigin_ = true;
+        } else if (!trimmed.empty()) {
+            origins_.emplace_back(trimmed);
+        }
+    }
+}
+
+bool Cors::isPreflight(const HttpRequest& request) const {
+    return request.method == "OPTIONS" && !request.getHeader("access-control-request-method").empty();
+}
+
+void Cors::preflight(const HttpRequest& request, HttpResponse& response) const {
+    response.status(204);
+    response.body.clear();
+    apply(request, response);
+    response.header("Access-Control-Allow-Methods", config_.methods);
+    response.header("Access-Control-Allow-Headers", config_.headers);
+    response.header("Access-Control-Max-Age", std::to_string(config_.maxAge));
+}
+
+void Cors::apply(const HttpRequest& request, HttpResponse& response) const {
+    std::string origin = allowedOrigin(request);
+    if (origin.empty()) return;
+
+    response.header("Access-Control-Allow-Origin", origin);
+    if (origin != "*") {
+        // 按请求回显源时，缓存必须区分不同的源
+        response.header("Vary", "Origin");
+    }
+}
+
+bool Cors::allowsOrigin(const HttpRequest& request) const {
+    return request.getHeader("origin").empty() || !allowedOrigin(request).empty();
+}
+
+std::string Cors::allowedOrigin(const HttpRequest& request) const {
+    if (anyOrigin_) return "*";
+
+    std::string origin = request.getHeader("origin");
+    for (const auto& allowed : origins_) {
+        if (allowed == origin) return origin;
+    }
+    return "";
+}
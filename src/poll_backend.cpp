@@ -0,0 +1,347 @@
+#include "poll_backend.h"
+#include <iostream>
+#include <ws2tcpip.h>
+
+namespace {
+    // 共享读缓冲区大小
+    const size_t kReadBufferSize = 64 * 1024;
+
+    // 一次读取最多取出的数据量；数据持续到达时也要交回事件循环，让其他连接得到处理、流式请求体的背压生效
+    const size_t kMaxReadPerEvent = 4 * kReadBufferSize;
+}
+
+PollBackend::PollBackend(ConnectionHandler& handler)
+    : IoBackend(handler), listenSocket_(INVALID_SOCKET), wakeSocket_(INVALID_SOCKET), stopping_(false) {}
+
+PollBackend::~PollBackend() {
+    if (wakeSocket_ != INVALID_SOCKET) {
+        closesocket(wakeSocket_);
+    }
+}
+
+bool PollBackend::open(SOCKET listenSocket) {
+    listenSocket_ = listenSocket;
+
+    unsigned long nonBlocking = 1;
+    if (ioctlsocket(listenSocket_, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+        std::cerr << "设置非阻塞模式失败: " << WSAGetLastError() << std::endl;
+        return false;
+    }
+
+    if (!createWakeSocket()) {
+        return false;
+    }
+
+    readBuffer_.resize(kReadBufferSize);
+    return true;
+}
+
+bool PollBackend::createWakeSocket() {
+    wakeSocket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (wakeSocket_ == INVALID_SOCKET) {
+        std::cerr << "创建唤醒socket失败: " << WSAGetLastError() << std::endl;
+        return false;
+    }
+
+    // 绑定到本地回环地址的随机端口，并连接到自身
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    int addrLen = sizeof(addr);
+
+    if (bind(wakeSocket_, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        getsockname(wakeSocket_, (sockaddr*)&addr, &addrLen) == SOCKET_ERROR ||
+        connect(wakeSocket_, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        std::cerr << "初始化唤醒socket失败: " << WSAGetLastError() << std::endl;
+        closesocket(wakeSocket_);
+        wakeSocket_ = INVALID_SOCKET;
+        return false;
+    }
+
+    unsigned long nonBlocking = 1;
+    ioctlsocket(wakeSocket_, FIONBIO, &nonBlocking);
+    return true;
+}
+
+void PollBackend::wakeup() {
+    if (wakeSocket_ != INVALID_SOCKET) {
+        char byte = 0;
+        ::send(wakeSocket_, &byte, 1, 0);
+    }
+}
+
+void PollBackend::run() {
+    while (!stopping_) {
+        // 重建轮询集合：监听socket、唤醒socket、所有连接
+        pollFds_.clear();
+
+        WSAPOLLFD listenFd;
+        listenFd.fd = listenSocket_;
+        listenFd.events = POLLRDNORM;
+        listenFd.revents = 0;
+        pollFds_.push_back(listenFd);
+
+        WSAPOLLFD wakeFd;
+        wakeFd.fd = wakeSocket_;
+        wakeFd.events = POLLRDNORM;
+        wakeFd.revents = 0;
+        pollFds_.push_back(wakeFd);
+
+        for (const auto& entry : connections_) {
+            WSAPOLLFD fd;
+            fd.fd = entry.first;
+            fd.events = 0;
+            fd.revents = 0;
+            if (!entry.second->readClosed && !entry.second->readPaused) fd.events |= POLLRDNORM;
+            if (!entry.second->outQueue.empty()) fd.events |= POLLWRNORM;
+            // 暂停读取且没有待发送数据时不加入轮询，否则对端关闭产生的POLLHUP会让WSAPoll立即返回
+            if (fd.events == 0 && entry.second->readPaused) continue;
+            pollFds_.push_back(fd);
+        }
+
+        int ready = WSAPoll(pollFds_.data(), static_cast<ULONG>(pollFds_.size()), timers_.nextTimeoutMs());
+        if (ready == SOCKET_ERROR) {
+            std::cerr << "WSAPoll失败: " << WSAGetLastError() << std::endl;
+            break;
+        }
+
+        // 处理连接事件
+        for (size_t i = 2; i < pollFds_.size(); ++i) {
+            short revents = pollFds_[i].revents;
+            if (revents == 0) continue;
+
+            auto it = connections_.find(pollFds_[i].fd);
+            if (it == connections_.end()) continue;
+            auto conn = it->second;
+
+            if (revents & (POLLERR | POLLNVAL)) {
+                close(conn);
+                continue;
+            }
+            if ((revents & (POLLRDNORM | POLLHUP)) && !conn->readPaused) {
+                readConnection(conn);
+            }
+            if (!conn->closed && (revents & POLLWRNORM)) {
+                flushConnection(conn);
+            }
+        }
+
+        // 接受新连接
+        if (pollFds_[0].revents) {
+            acceptConnections();
+        }
+
+        // 清空唤醒socket
+        if (pollFds_[1].revents) {
+            char drain[64];
+            while (recv(wakeSocket_, drain, sizeof(drain), 0) > 0) {}
+        }
+
+        runPosted();
+        timers_.runExpired();
+    }
+
+    // 关闭所有剩余连接
+    std::vector<std::shared_ptr<PollConnection>> remaining;
+    for (const auto& entry : connections_) {
+        remaining.push_back(entry.second);
+    }
+    for (const auto& conn : remaining) {
+        close(conn);
+    }
+}
+
+void PollBackend::stop() {
+    stopping_ = true;
+    wakeup();
+}
+
+void PollBackend::post(std::function<void()> task) {
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(postMutex_);
+        wasEmpty = posted_.empty();
+        posted_.push_back(std::move(task));
+    }
+    // 队列非空时事件循环已被唤醒，无需重复唤醒
+    if (wasEmpty) {
+        wakeup();
+    }
+}
+
+void PollBackend::runPosted() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(postMutex_);
+        tasks.swap(posted_);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+void PollBackend::acceptConnections() {
+    while (true) {
+        sockaddr_in clientAddr;
+        int clientAddrLen = sizeof(clientAddr);
+
+        SOCKET clientSocket = accept(listenSocket_, (sockaddr*)&clientAddr, &clientAddrLen);
+        if (clientSocket == INVALID_SOCKET) {
+            int error = WSAGetLastError();
+            if (error != WSAEWOULDBLOCK) {
+                std::cerr << "接受连接失败: " << error << std::endl;
+            }
+            return;
+        }
+
+        unsigned long nonBlocking = 1;
+        ioctlsocket(clientSocket, FIONBIO, &nonBlocking);
+
+        auto conn = std::make_shared<PollConnection>();
+        conn->socket = clientSocket;
+
+        char ip[INET_ADDRSTRLEN] = {0};
+        inet_ntop(AF_INET, &clientAddr.sin_addr, ip, sizeof(ip));
+        conn->clientIp = ip;
+
+        connections_[clientSocket] = conn;
+        handler_.onOpen(conn);
+    }
+}
+
+void PollBackend::readConnection(const std::shared_ptr<PollConnection>& conn) {
+    bool received = false;
+    size_t total = 0;
+
+    while (total < kMaxReadPerEvent) {
+        int bytesReceived = recv(conn->socket, readBuffer_.data(), static_cast<int>(readBuffer_.size()), 0);
+        if (bytesReceived > 0) {
+            conn->inBuffer.append(readBuffer_.data(), bytesReceived);
+            received = true;
+            total += bytesReceived;
+            // 未读满缓冲区说明内核中已没有更多数据，省去一次必然失败的recv
+            if (bytesReceived < static_cast<int>(readBuffer_.size())) break;
+            continue;
+        }
+
+        if (bytesReceived == 0) {
+            conn->readClosed = true;
+            break;
+        }
+
+        if (WSAGetLastError() != WSAEWOULDBLOCK) {
+            close(conn);
+            return;
+        }
+        break;
+    }
+
+    // 对端关闭时也通知，正在接收的流式请求体不会再有数据
+    if (received || conn->readClosed) {
+        handler_.onData(conn);
+    }
+
+    // 对端关闭后，等待正在处理的请求发送完毕再关闭
+    if (!conn->closed && conn->readClosed) {
+        if (!conn->busy && conn->outQueue.empty()) {
+            close(conn);
+        } else {
+            conn->closeAfterWrite = true;
+        }
+    }
+}
+
+void PollBackend::flushConnection(const std::shared_ptr<PollConnection>& conn) {
+    bool progressed = false;
+
+    while (!conn->outQueue.empty()) {
+        SendChunk& chunk = conn->outQueue.front();
+        int bytesSent = ::send(conn->socket, chunk.data(), static_cast<int>(chunk.size()), 0);
+        if (bytesSent > 0) {
+            conn->outBytes -= bytesSent;
+            if (static_cast<size_t>(bytesSent) == chunk.size()) {
+                conn->outQueue.pop_front();
+            } else {
+                chunk.consume(bytesSent);
+            }
+            progressed = true;
+            continue;
+        }
+
+        if (WSAGetLastError() != WSAEWOULDBLOCK) {
+            close(conn);
+            return;
+        }
+
+        // 对端接收缓慢：只在有进展时顺延发送超时
+        if (progressed || !conn->writeTimer.active()) {
+            refreshWriteDeadline(conn);
+        }
+        if (progressed) {
+            handler_.onSent(conn);
+        }
+        return;
+    }
+
+    conn->writeTimer.cancel();
+    if (conn->closeAfterWrite) {
+        close(conn);
+        return;
+    }
+    if (progressed) {
+        handler_.onSent(conn);
+    }
+}
+
+void PollBackend::send(const ConnectionPtr& conn, std::string data) {
+    auto pollConn = std::static_pointer_cast<PollConnection>(conn);
+    if (pollConn->closed) return;
+
+    // 积压的独占数据合并为一块，减少send调用
+    if (!pollConn->outQueue.empty() && pollConn->outQueue.back().append(data)) {
+        pollConn->outBytes += data.size();
+        flushConnection(pollConn);
+        return;
+    }
+    enqueue(pollConn, std::move(data));
+}
+
+void PollBackend::send(const ConnectionPtr& conn, SharedBuffer data) {
+    auto pollConn = std::static_pointer_cast<PollConnection>(conn);
+    if (pollConn->closed) return;
+
+    enqueue(pollConn, std::move(data));
+}
+
+void PollBackend::enqueue(const std::shared_ptr<PollConnection>& conn, SendChunk chunk) {
+    if (chunk.size() > 0) {
+        conn->outBytes += chunk.size();
+        conn->outQueue.push_back(std::move(chunk));
+    }
+
+    // 先尝试直接发送，发送不完的部分等待POLLWRNORM
+    flushConnection(conn);
+}
+
+void PollBackend::resumeRead(const ConnectionPtr& conn) {
+    // 下一轮重建轮询集合时重新关注可读事件
+    conn->readPaused = false;
+}
+
+size_t PollBackend::pendingSendBytes(const ConnectionPtr& conn) const {
+    return static_cast<const PollConnection&>(*conn).outBytes;
+}
+
+void PollBackend::close(const ConnectionPtr& conn) {
+    if (conn->closed) return;
+
+    // 持有引用，避免从表中移除后连接被释放
+    ConnectionPtr keep = conn;
+    keep->closed = true;
+    keep->writeTimer.cancel();
+    closesocket(keep->socket);
+    connections_.erase(keep->socket);
+
+    handler_.onClose(keep);
+}
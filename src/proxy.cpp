@@ -0,0 +1,831 @@
+#include "proxy.h"
+#include "http_stream.h"
+#include "id_generator.h"
+#include "logger.h"
+#include "utils.h"
+#include <ws2tcpip.h>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    const size_t kMaxHeadSize = 64 * 1024;      // 上游响应头的上限
+    const size_t kMaxChunkLine = 1024;          // 分块大小行和尾部字段的上限
+    const size_t kReadSize = 64 * 1024;
+
+    // 逐跳的头部只在一跳之间有效，不转发（Connection中列出的头部同样处理）
+    bool isHopByHop(std::string_view name) {
+        static const char* const kHopByHop[] = {
+            "connection", "keep-alive", "proxy-connection", "te", "trailer", "transfer-encoding", "upgrade"
+        };
+        for (const char* header : kHopByHop) {
+            if (Utils::equalsIgnoreCase(name, header)) return true;
+        }
+        return false;
+    }
+
+    bool listedIn(std::string_view connection, std::string_view name) {
+        for (std::string_view token : Utils::splitView(connection, ',')) {
+            if (Utils::equalsIgnoreCase(Utils::trimView(token), name)) return true;
+        }
+        return false;
+    }
+
+    // 重试时可能被执行两次的请求必须是幂等的
+    bool isIdempotent(const std::string& method) {
+        return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "PUT" || method == "DELETE";
+    }
+
+    int64_t steadyNanoseconds(std::chrono::steady_clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+}
+
+bool parseProxyBalance(const std::string& name, ProxyBalance& balance) {
+    if (name == "least_outstanding") {
+        balance = ProxyBalance::LeastOutstanding;
+    } else if (name == "p2c") {
+        balance = ProxyBalance::PowerOfTwo;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* proxyBalanceName(ProxyBalance balance) {
+    return balance == ProxyBalance::PowerOfTwo ? "p2c" : "least_outstanding";
+}
+
+// ---------------------------------------------------------------------------
+// UpstreamConnection
+
+UpstreamConnection::UpstreamConnection(SOCKET socket) : socket_(socket) {}
+
+UpstreamConnection::~UpstreamConnection() {
+    closesocket(socket_);
+}
+
+std::unique_ptr<UpstreamConnection> UpstreamConnection::connect(const std::string& host, int port, int timeoutMs,
+                                                                ProxyError& error) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0 || !result) {
+        error.message = "无法解析上游地址: " + host;
+        return nullptr;
+    }
+    sockaddr_in address;
+    std::memcpy(&address, result->ai_addr, sizeof(address));
+    freeaddrinfo(result);
+
+    SOCKET socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (socket == INVALID_SOCKET) {
+        error.message = "创建socket失败: " + std::to_string(WSAGetLastError());
+        return nullptr;
+    }
+    auto connection = std::make_unique<UpstreamConnection>(socket);
+
+    unsigned long nonBlocking = 1;
+    ioctlsocket(socket, FIONBIO, &nonBlocking);
+    int noDelay = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+    if (::connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR) {
+        int code = WSAGetLastError();
+        if (code != WSAEWOULDBLOCK && code != WSAEINPROGRESS) {
+            error.message = "连接上游失败: " + std::to_string(code);
+            return nullptr;
+        }
+
+        // 连接失败在Windows上报告为异常集合，其他平台为可写且SO_ERROR非0
+        fd_set writable;
+        fd_set failed;
+        FD_ZERO(&writable);
+        FD_ZERO(&failed);
+        FD_SET(socket, &writable);
+        FD_SET(socket, &failed);
+        timeval timeout;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_usec = (timeoutMs % 1000) * 1000;
+        int ready = select(static_cast<int>(socket) + 1, nullptr, &writable, &failed, &timeout);
+        if (ready == 0) {
+            error.message = "连接上游超时";
+            error.timeout = true;
+            return nullptr;
+        }
+        int socketError = 0;
+        int length = sizeof(socketError);
+        if (ready < 0 || FD_ISSET(socket, &failed) ||
+            getsockopt(socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&socketError), &length) == SOCKET_ERROR ||
+            socketError != 0) {
+            error.message = "连接上游失败: " + std::to_string(socketError != 0 ? socketError : WSAGetLastError());
+            return nullptr;
+        }
+    }
+    return connection;
+}
+
+bool UpstreamConnection::wait(short events, int timeoutMs, ProxyError& error) const {
+    WSAPOLLFD fd = {};
+    fd.fd = socket_;
+    fd.events = events;
+    int ready = WSAPoll(&fd, 1, timeoutMs);
+    if (ready == 0) {
+        error.message = "等待上游超时";
+        error.timeout = true;
+        return false;
+    }
+    if (ready < 0) {
+        error.message = "WSAPoll失败: " + std::to_string(WSAGetLastError());
+        return false;
+    }
+    // 挂断和错误留给接下来的send/recv报告具体原因
+    return true;
+}
+
+bool UpstreamConnection::fill(int timeoutMs, ProxyError& error) {
+    if (!wait(POLLRDNORM, timeoutMs, error)) return false;
+
+    size_t size = buffer_.size();
+    buffer_.resize(size + kReadSize);
+    int received = recv(socket_, &buffer_[size], static_cast<int>(kReadSize), 0);
+    if (received > 0) {
+        buffer_.resize(size + static_cast<size_t>(received));
+        received_ = true;
+        return true;
+    }
+    buffer_.resize(size);
+    if (received == 0) return false;
+
+    int code = WSAGetLastError();
+    if (code == WSAEWOULDBLOCK) return true;
+    error.message = "读取上游失败: " + std::to_string(code);
+    return false;
+}
+
+bool UpstreamConnection::send(std::string_view data, int timeoutMs, ProxyError& error) {
+    while (!data.empty()) {
+        int length = static_cast<int>(std::min<size_t>(data.size(), 1 << 30));
+        int sent = ::send(socket_, data.data(), length, 0);
+        if (sent > 0) {
+            data.remove_prefix(static_cast<size_t>(sent));
+            continue;
+        }
+        int code = WSAGetLastError();
+        if (code == WSAEWOULDBLOCK) {
+            if (!wait(POLLWRNORM, timeoutMs, error)) return false;
+            continue;
+        }
+        error.message = "发送到上游失败: " + std::to_string(code);
+        return false;
+    }
+    return true;
+}
+
+bool UpstreamConnection::readHead(bool headRequest, int timeoutMs, UpstreamResponse& response, ProxyError& error) {
+    bool http11 = false;
+    while (true) {
+        size_t end = buffer_.find("\r\n\r\n");
+        if (end == std::string::npos) {
+            if (buffer_.size() > kMaxHeadSize) {
+                error.message = "上游的响应头过大";
+                return false;
+            }
+            if (!fill(timeoutMs, error)) {
+                if (error.empty()) error.message = "上游在响应之前关闭了连接";
+                return false;
+            }
+            continue;
+        }
+
+        // 状态行：HTTP/1.x 200 OK
+        std::string_view head(buffer_.data(), end);
+        size_t lineEnd = head.find("\r\n");
+        std::string_view statusLine = head.substr(0, lineEnd);
+        int statusCode = 0;
+        if (statusLine.size() < 12 || statusLine.substr(0, 7) != "HTTP/1." ||
+            std::from_chars(statusLine.data() + 9, statusLine.data() + 12, statusCode).ptr != statusLine.data() + 12) {
+            error.message = "上游的状态行无效";
+            return false;
+        }
+        http11 = statusLine[7] == '1';
+
+        response.statusCode = statusCode;
+        response.headers.clear();
+        std::string_view fields = lineEnd == std::string_view::npos ? std::string_view() : head.substr(lineEnd + 2);
+        for (std::string_view line : Utils::splitView(fields, '\n')) {
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos || colon == 0) continue;
+            response.headers.emplace_back(std::string(Utils::trimView(line.substr(0, colon))),
+                                          std::string(Utils::trimView(line.substr(colon + 1))));
+        }
+        buffer_.erase(0, end + 4);
+
+        // 1xx是中间响应，之后还有最终响应；请求中的Expect已去掉，101表示上游试图升级协议
+        if (statusCode >= 100 && statusCode < 200) {
+            if (statusCode == 101) {
+                error.message = "上游切换了协议";
+                return false;
+            }
+            continue;
+        }
+        break;
+    }
+
+    // HTTP/1.1默认保持连接，Connection: close时不复用；HTTP/1.0的连接不复用
+    keepAlive_ = http11;
+    bool chunked = false;
+    bool hasLength = false;
+    uint64_t length = 0;
+    for (const auto& [name, value] : response.headers) {
+        if (Utils::equalsIgnoreCase(name, "connection")) {
+            if (listedIn(value, "close")) keepAlive_ = false;
+        } else if (Utils::equalsIgnoreCase(name, "transfer-encoding")) {
+            chunked = listedIn(value, "chunked");
+        } else if (Utils::equalsIgnoreCase(name, "content-length")) {
+            if (std::from_chars(value.data(), value.data() + value.size(), length).ptr != value.data() + value.size()) {
+                error.message = "上游的Content-Length无效";
+                return false;
+            }
+            hasLength = true;
+        }
+    }
+
+    // 正文的长度：HEAD、204和304没有正文，之后依次是分块编码、Content-Length和读到连接关闭
+    if (headRequest || response.statusCode == 204 || response.statusCode == 304) {
+        mode_ = BodyMode::None;
+    } else if (chunked) {
+        mode_ = BodyMode::Chunked;
+        chunkState_ = ChunkState::Size;
+    } else if (hasLength) {
+        mode_ = BodyMode::Length;
+        remaining_ = length;
+    } else {
+        mode_ = BodyMode::UntilClose;
+        keepAlive_ = false;
+    }
+    complete_ = mode_ == BodyMode::None || (mode_ == BodyMode::Length && remaining_ == 0);
+    return true;
+}
+
+bool UpstreamConnection::decode(size_t limit, std::string& chunk, ProxyError& error) {
+    switch (mode_) {
+        case BodyMode::None:
+            complete_ = true;
+            return true;
+
+        case BodyMode::Length:
+        case BodyMode::UntilClose: {
+            if (buffer_.empty()) return false;
+            size_t count = std::min(buffer_.size(), limit);
+            if (mode_ == BodyMode::Length) {
+                count = static_cast<size_t>(std::min<uint64_t>(count, remaining_));
+                remaining_ -= count;
+                complete_ = remaining_ == 0;
+            }
+            chunk.append(buffer_, 0, count);
+            buffer_.erase(0, count);
+            return true;
+        }
+
+        case BodyMode::Chunked:
+            break;
+    }
+
+    switch (chunkState_) {
+        case ChunkState::Size: {
+            // 块大小（十六进制），可能带有 ;扩展
+            size_t end = buffer_.find("\r\n");
+            if (end == std::string::npos) {
+                if (buffer_.size() > kMaxChunkLine) error.message = "上游的分块编码无效";
+                return false;
+            }
+            std::string_view line(buffer_.data(), end);
+            line = Utils::trimView(line.substr(0, line.find(';')));
+            uint64_t size = 0;
+            auto parsed = std::from_chars(line.data(), line.data() + line.size(), size, 16);
+            if (line.empty() || parsed.ec != std::errc() || parsed.ptr != line.data() + line.size()) {
+                error.message = "上游的分块编码无效";
+                return false;
+            }
+            buffer_.erase(0, end + 2);
+            if (size == 0) {
+                chunkState_ = ChunkState::Trailer;
+            } else {
+                remaining_ = size;
+                chunkState_ = ChunkState::Data;
+            }
+            return true;
+        }
+
+        case ChunkState::Data: {
+            if (buffer_.empty()) return false;
+            size_t count = static_cast<size_t>(std::min<uint64_t>(std::min(buffer_.size(), limit), remaining_));
+            chunk.append(buffer_, 0, count);
+            buffer_.erase(0, count);
+            remaining_ -= count;
+            if (remaining_ == 0) chunkState_ = ChunkState::DataEnd;
+            return true;
+        }
+
+        case ChunkState::DataEnd:
+            if (buffer_.size() < 2) return false;
+            if (buffer_.compare(0, 2, "\r\n") != 0) {
+                error.message = "上游的分块编码无效";
+                return false;
+            }
+            buffer_.erase(0, 2);
+            chunkState_ = ChunkState::Size;
+            return true;
+
+        case ChunkState::Trailer: {
+            // 尾部字段不转发，空行结束正文
+            size_t end = buffer_.find("\r\n");
+            if (end == std::string::npos) {
+                if (buffer_.size() > kMaxChunkLine) error.message = "上游的分块编码无效";
+                return false;
+            }
+            buffer_.erase(0, end + 2);
+            if (end == 0) complete_ = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UpstreamConnection::readBody(size_t maxBytes, int timeoutMs, std::string& chunk, bool& done, ProxyError& error) {
+    chunk.clear();
+    while (!complete_ && chunk.size() < maxBytes) {
+        if (decode(maxBytes - chunk.size(), chunk, error)) continue;
+        if (!error.empty()) return false;
+
+        // 已有数据时先交出去，不为凑满一段而等待上游
+        if (!chunk.empty()) break;
+        if (!fill(timeoutMs, error)) {
+            if (!error.empty()) return false;
+            if (mode_ != BodyMode::UntilClose) {
+                error.message = "上游在响应结束之前关闭了连接";
+                return false;
+            }
+            complete_ = true;
+        }
+    }
+    done = complete_;
+    return true;
+}
+
+bool UpstreamConnection::stale() const {
+    // 空闲的连接不应该可读：可读说明上游关闭了连接或发来了不属于任何请求的数据
+    WSAPOLLFD fd = {};
+    fd.fd = socket_;
+    fd.events = POLLRDNORM;
+    return WSAPoll(&fd, 1, 0) != 0;
+}
+
+void UpstreamConnection::resetForReuse() {
+    mode_ = BodyMode::None;
+    chunkState_ = ChunkState::Size;
+    remaining_ = 0;
+    complete_ = false;
+    keepAlive_ = false;
+    received_ = false;
+    idleSince_ = std::chrono::steady_clock::now();
+}
+
+// ---------------------------------------------------------------------------
+// Upstream
+
+Upstream::Upstream(std::string host, int port, const ProxyConfig& config)
+    : host_(std::move(host)), port_(port), name_(host_ + ":" + std::to_string(port)), config_(config) {}
+
+bool Upstream::available(std::chrono::steady_clock::time_point now) const {
+    int64_t until = ejectedUntil_.load(std::memory_order_relaxed);
+    return until == 0 || steadyNanoseconds(now) >= until;
+}
+
+void Upstream::begin() {
+    outstanding_.fetch_add(1, std::memory_order_relaxed);
+    requests_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Upstream::reportSuccess() {
+    int ejections;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (consecutiveFailures_ == 0 && ejections_ == 0) return;
+        consecutiveFailures_ = 0;
+        ejections = ejections_;
+        ejections_ = 0;
+    }
+    ejectedUntil_.store(0, std::memory_order_relaxed);
+    if (ejections > 0) {
+        Logger::info("上游已恢复: " + name_, "proxy");
+    }
+}
+
+void Upstream::reportFailure(const std::string& reason) {
+    failures_.fetch_add(1, std::memory_order_relaxed);
+
+    std::vector<std::unique_ptr<UpstreamConnection>> dropped;
+    int seconds = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (++consecutiveFailures_ < config_.maxFails) return;
+
+        // 摘除时间随连续摘除的次数加倍；到期后处于半开状态，下一次失败立即再次摘除
+        long long duration = static_cast<long long>(config_.ejectSeconds) << std::min(ejections_, 16);
+        seconds = static_cast<int>(std::min<long long>(duration, kMaxEjectSeconds));
+        ++ejections_;
+        consecutiveFailures_ = config_.maxFails - 1;
+        auto until = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+        ejectedUntil_.store(steadyNanoseconds(until), std::memory_order_relaxed);
+
+        // 上游出了问题，空闲连接多半也不可用了
+        dropped.swap(idle_);
+    }
+    Logger::warn("上游被摘除 " + std::to_string(seconds) + " 秒: " + name_ + "（" + reason + "）",
+                               "proxy");
+}
+
+std::unique_ptr<UpstreamConnection> Upstream::acquire(bool& reused, ProxyError& error) {
+    // 最近归还的连接最可能仍然有效（后进先出），检查在锁外进行
+    auto now = std::chrono::steady_clock::now();
+    while (true) {
+        std::unique_ptr<UpstreamConnection> connection;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (idle_.empty()) break;
+            connection = std::move(idle_.back());
+            idle_.pop_back();
+        }
+        if (now - connection->idleSince() < kMaxIdleTime && !connection->stale()) {
+            reused = true;
+            return connection;
+        }
+    }
+
+    reused = false;
+    return UpstreamConnection::connect(host_, port_, config_.connectTimeoutMs, error);
+}
+
+void Upstream::release(std::unique_ptr<UpstreamConnection> connection) {
+    if (!connection || !connection->reusable()) return;
+    connection->resetForReuse();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_.size() < config_.maxIdle) {
+        idle_.push_back(std::move(connection));
+    }
+}
+
+std::string Upstream::toJson() const {
+    auto now = std::chrono::steady_clock::now();
+    int64_t until = ejectedUntil_.load(std::memory_order_relaxed);
+    int64_t remainingMs = std::max<int64_t>(0, (until - steadyNanoseconds(now)) / 1000000);
+    size_t idle;
+    int consecutiveFailures;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle = idle_.size();
+        consecutiveFailures = consecutiveFailures_;
+    }
+
+    std::string json = "{";
+    json += "\"address\": \"" + name_ + "\", ";
+    json += "\"outstanding\": " + std::to_string(outstanding()) + ", ";
+    json += "\"idle_connections\": " + std::to_string(idle) + ", ";
+    json += "\"requests\": " + std::to_string(requests_.load(std::memory_order_relaxed)) + ", ";
+    json += "\"failures\": " + std::to_string(failures_.load(std::memory_order_relaxed)) + ", ";
+    json += "\"consecutive_failures\": " + std::to_string(consecutiveFailures) + ", ";
+    json += "\"ejected\": " + std::string(until != 0 && remainingMs > 0 ? "true" : "false") + ", ";
+    json += "\"ejected_ms\": " + std::to_string(until != 0 ? remainingMs : 0);
+    json += "}";
+    return json;
+}
+
+// ---------------------------------------------------------------------------
+// ReverseProxy
+
+ReverseProxy::ReverseProxy(ProxyConfig config) : config_(std::move(config)) {
+    for (const std::string& address : config_.upstreams) {
+        std::string host;
+        int port = 0;
+        if (parseAddress(address, host, port)) {
+            upstreams_.push_back(std::make_unique<Upstream>(std::move(host), port, config_));
+        }
+    }
+}
+
+bool ReverseProxy::parseAddress(const std::string& text, std::string& host, int& port) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == text.size()) return false;
+    const char* begin = text.data() + colon + 1;
+    const char* end = text.data() + text.size();
+    int value = 0;
+    auto parsed = std::from_chars(begin, end, value);
+    if (parsed.ec != std::errc() || parsed.ptr != end || value < 1 || value > 65535) return false;
+    host = text.substr(0, colon);
+    port = value;
+    return true;
+}
+
+bool ReverseProxy::validate(const ProxyConfig& config, std::string& error) {
+    if (config.prefix.empty() || config.prefix[0] != '/' || config.prefix.find_first_of(":?") != std::string::npos) {
+        error = "前缀必须以 / 开头，且不能包含参数: " + config.prefix;
+        return false;
+    }
+    if (config.upstreams.empty()) {
+        error = "没有上游: " + config.prefix;
+        return false;
+    }
+    for (const std::string& address : config.upstreams) {
+        std::string host;
+        int port = 0;
+        if (!parseAddress(address, host, port)) {
+            error = "上游地址应为 host:port: " + address;
+            return false;
+        }
+    }
+    if (config.connectTimeoutMs <= 0 || config.timeoutMs <= 0 || config.maxFails <= 0 || config.ejectSeconds <= 0) {
+        error = "超时、失败次数和摘除时间必须大于0: " + config.prefix;
+        return false;
+    }
+    return true;
+}
+
+Upstream* ReverseProxy::pick() {
+    auto now = std::chrono::steady_clock::now();
+    size_t count = upstreams_.size();
+
+    if (config_.balance == ProxyBalance::PowerOfTwo) {
+        std::vector<Upstream*> candidates;
+        candidates.reserve(count);
+        for (const auto& upstream : upstreams_) {
+            if (upstream->available(now)) candidates.push_back(upstream.get());
+        }
+        if (candidates.empty()) return nullptr;
+        if (candidates.size() == 1) return candidates[0];
+
+        // 随机取两个不同的上游，比较进行中的请求数
+        size_t first = static_cast<size_t>(IdGenerator::randomBelow(candidates.size()));
+        size_t second = static_cast<size_t>(IdGenerator::randomBelow(candidates.size() - 1));
+        if (second >= first) ++second;
+        Upstream* a = candidates[first];
+        Upstream* b = candidates[second];
+        return b->outstanding() < a->outstanding() ? b : a;
+    }
+
+    // 从上次选中的下一个开始扫描，请求数相同的上游轮流被选中
+    Upstream* best = nullptr;
+    size_t bestIndex = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t index = (next_ + i) % count;
+        Upstream* upstream = upstreams_[index].get();
+        if (!upstream->available(now)) continue;
+        if (!best || upstream->outstanding() < best->outstanding()) {
+            best = upstream;
+            bestIndex = index;
+        }
+    }
+    if (best) next_ = bestIndex + 1;
+    return best;
+}
+
+std::string ReverseProxy::requestHead(const HttpRequest& request, size_t contentLength, const std::string& host) const {
+    // 去掉前缀时按路径段计数，/svc 的前缀匹配 /svc/users 和 /svc//users
+    std::string_view path = request.path;
+    std::string_view prefix;
+    if (config_.stripPrefix) {
+        size_t segments = 0;
+        for (std::string_view segment : Utils::splitView(config_.prefix, '/')) {
+            (void)segment;
+            ++segments;
+        }
+        size_t position = 0;
+        for (size_t i = 0; i < segments; ++i) {
+            while (position < path.size() && path[position] == '/') ++position;
+            size_t end = path.find('/', position);
+            position = end == std::string_view::npos ? path.size() : end;
+        }
+        prefix = path.substr(0, position);
+        path.remove_prefix(position);
+        if (path.empty()) path = "/";
+    }
+
+    std::string head;
+    head.reserve(512);
+    head += request.method;
+    head += ' ';
+    head += path;
+    if (!request.query.empty()) {
+        head += '?';
+        head += request.query;
+    }
+    head += " HTTP/1.1\r\n";
+
+    // 客户端的头部去掉逐跳的头部；请求体的长度和X-Forwarded-For由代理重新生成，Expect在这一跳已经处理
+    std::string connection = request.getHeader("connection");
+    bool hasHost = false;
+    for (const auto& [name, value] : request.headers) {
+        if (isHopByHop(name) || name == "content-length" || name == "expect" || name == "x-forwarded-for" ||
+            listedIn(connection, name)) {
+            continue;
+        }
+        if (name == "host") hasHost = true;
+        head += name;
+        head += ": ";
+        head += value;
+        head += "\r\n";
+    }
+    if (!hasHost) {
+        head += "Host: " + host + "\r\n";
+    }
+
+    std::string forwardedFor = request.getHeader("x-forwarded-for");
+    head += "X-Forwarded-For: ";
+    if (!forwardedFor.empty()) {
+        head += forwardedFor;
+        head += ", ";
+    }
+    head += request.clientIp;
+    head += "\r\nX-Forwarded-Proto: http\r\n";
+    if (config_.stripPrefix) {
+        head += "X-Forwarded-Prefix: ";
+        head += prefix;
+        head += "\r\n";
+    }
+    if (contentLength > 0 || request.method == "POST" || request.method == "PUT" || request.method == "PATCH") {
+        head += "Content-Length: " + std::to_string(contentLength) + "\r\n";
+    }
+    head += "\r\n";
+    return head;
+}
+
+Task ReverseProxy::forward(const HttpRequest& request, HttpResponse& response, ThreadPool& pool, IoBackend& loop) {
+    HttpStream& stream = *request.stream;
+    Upstream* upstream = pick();
+    if (!upstream) {
+        response.status(503).json("{\"error\": \"No healthy upstream\"}");
+        co_return;
+    }
+
+    // 进行中的请求数在协程结束时减少，包括异常退出
+    upstream->begin();
+    struct Outstanding {
+        Upstream* upstream;
+        ~Outstanding() { upstream->end(); }
+    } outstanding{upstream};
+
+    const int timeoutMs = config_.timeoutMs;
+    const bool headRequest = request.method == "HEAD";
+    const size_t contentLength = stream.contentLength();
+
+    // 请求头和第一块请求体合并发送；小请求体通常已随请求头一起到达
+    std::string pending = requestHead(request, contentLength, upstream->name());
+    size_t bodySent = 0;
+    if (contentLength > 0) {
+        std::string first = co_await stream.read();
+        if (first.empty()) co_return;       // 客户端已断开
+        bodySent = first.size();
+        pending += first;
+    }
+    const bool wholeRequest = bodySent == contentLength;
+
+    struct Exchange {
+        std::unique_ptr<UpstreamConnection> connection;
+        UpstreamResponse head;
+        std::string chunk;
+        bool done = false;
+        ProxyError error;
+    } exchange;
+
+    // 取得连接并发送；请求已完整发出时接着读取响应头和第一段正文，整个往返只占用一次代理线程
+    auto start = [&]() -> bool {
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            bool reused = false;
+            exchange.error = ProxyError();
+            exchange.connection = upstream->acquire(reused, exchange.error);
+            if (!exchange.connection) return false;
+
+            bool ok = exchange.connection->send(pending, timeoutMs, exchange.error);
+            if (ok && wholeRequest) {
+                ok = exchange.connection->readHead(headRequest, timeoutMs, exchange.head, exchange.error) &&
+                     exchange.connection->readBody(kBodyChunk, timeoutMs, exchange.chunk, exchange.done, exchange.error);
+            }
+            if (ok) return true;
+
+            // 复用的连接在收到任何响应之前失败，多半是上游已经关闭了这条空闲连接，换新连接重试一次；
+            // 只重试幂等且已完整发出的请求
+            if (!reused || !wholeRequest || exchange.error.timeout || !exchange.connection->receivedNothing() ||
+                !isIdempotent(request.method)) {
+                return false;
+            }
+            exchange.connection.reset();
+        }
+        return false;
+    };
+    ExecutorAwaiter<bool> starting(pool, loop, start, "proxy");
+    bool ok = co_await starting;
+    pending.clear();
+
+    // 其余的请求体边收边转发
+    while (ok && bodySent < contentLength) {
+        std::string chunk = co_await stream.read();
+        if (chunk.empty()) co_return;       // 客户端已断开，上游连接不再复用
+        bodySent += chunk.size();
+        bool last = bodySent == contentLength;
+        auto forwardChunk = [&, chunk = std::move(chunk)]() -> bool {
+            UpstreamConnection& connection = *exchange.connection;
+            return connection.send(chunk, timeoutMs, exchange.error) &&
+                   (!last || (connection.readHead(headRequest, timeoutMs, exchange.head, exchange.error) &&
+                              connection.readBody(kBodyChunk, timeoutMs, exchange.chunk, exchange.done, exchange.error)));
+        };
+        ExecutorAwaiter<bool> forwarding(pool, loop, forwardChunk, "proxy");
+        ok = co_await forwarding;
+    }
+
+    if (!ok) {
+        upstream->reportFailure(exchange.error.message);
+        Logger::warn("转发到 " + upstream->name() + " 失败: " + exchange.error.message, "proxy");
+        if (exchange.error.timeout) {
+            response.status(504).json("{\"error\": \"Upstream timed out\"}");
+        } else {
+            response.status(502).json("{\"error\": \"Bad gateway\"}");
+        }
+        co_return;
+    }
+
+    // 5xx说明上游本身出了问题，计入被动健康检查
+    if (exchange.head.statusCode >= 500) {
+        upstream->reportFailure("HTTP " + std::to_string(exchange.head.statusCode));
+    } else {
+        upstream->reportSuccess();
+    }
+
+    // 上游的头部去掉逐跳的头部；同名头部（如多个Set-Cookie）用换行连接
+    response.status(exchange.head.statusCode);
+    response.headers.clear();
+    std::string connection;
+    for (const auto& [name, value] : exchange.head.headers) {
+        if (Utils::equalsIgnoreCase(name, "connection")) connection = value;
+    }
+    bool bodyless = headRequest || exchange.head.statusCode == 204 || exchange.head.statusCode == 304;
+    for (const auto& [name, value] : exchange.head.headers) {
+        if (isHopByHop(name) || listedIn(connection, name)) continue;
+        if (Utils::equalsIgnoreCase(name, "content-length")) {
+            // HEAD和304的Content-Length描述的是没有发送的正文，原样转发；其他响应由服务器重新计算或改用分块编码
+            if (bodyless) response.headers["Content-Length"] = value;
+            continue;
+        }
+        auto [it, inserted] = response.headers.try_emplace(name, value);
+        if (!inserted) {
+            it->second += '\n';
+            it->second += value;
+        }
+    }
+
+    // 第一次读取已拿到完整正文：作为普通响应发送，带Content-Length，不需要分块编码
+    if (exchange.done) {
+        response.body = std::move(exchange.chunk);
+        upstream->release(std::move(exchange.connection));
+        co_return;
+    }
+
+    // 大的或还在生成的正文边收边转发，客户端接收慢时write挂起，不再读取上游
+    stream.begin(response);
+    while (true) {
+        if (!exchange.chunk.empty() && !co_await stream.write(std::move(exchange.chunk))) {
+            co_return;                      // 客户端已断开，关闭上游连接
+        }
+        if (exchange.done) break;
+
+        auto readNext = [&]() -> bool {
+            return exchange.connection->readBody(kBodyChunk, timeoutMs, exchange.chunk, exchange.done, exchange.error);
+        };
+        ExecutorAwaiter<bool> reading(pool, loop, readNext, "proxy");
+        if (!co_await reading) {
+            // 响应头已经发出，只能关闭客户端连接让它知道正文不完整
+            upstream->reportFailure(exchange.error.message);
+            throw std::runtime_error("上游响应中断: " + upstream->name() + ": " + exchange.error.message);
+        }
+    }
+    upstream->release(std::move(exchange.connection));
+}
+
+std::string ReverseProxy::toJson() const {
+    std::string json = "{";
+    json += "\"prefix\": \"" + config_.prefix + "\", ";
+    json += "\"balance\": \"" + std::string(proxyBalanceName(config_.balance)) + "\", ";
+    json += "\"strip_prefix\": " + std::string(config_.stripPrefix ? "true" : "false") + ", ";
+    json += "\"upstreams\": [";
+    for (size_t i = 0; i < upstreams_.size(); ++i) {
+        if (i > 0) json += ", ";
+        json += upstreams_[i]->toJson();
+    }
+    json += "]}";
+    return json;
+}
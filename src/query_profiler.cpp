@@ -0,0 +1,343 @@
+#include "query_profiler.h"
+#include "utils.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+namespace {
+    bool isIdentifierChar(unsigned char c) {
+        return std::isalnum(c) || c == '_' || c == '$' || c >= 0x80;
+    }
+
+    bool endsWith(const std::string& text, std::string_view suffix) {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // 跳过以quote开始的字符串或带引号的标识符，两个连续的引号表示引号本身；返回结束引号之后的位置
+    size_t skipQuoted(std::string_view sql, size_t i, char close) {
+        ++i;
+        while (i < sql.size()) {
+            if (sql[i] == close) {
+                if (close != ']' && i + 1 < sql.size() && sql[i + 1] == close) {
+                    i += 2;
+                    continue;
+                }
+                return i + 1;
+            }
+            ++i;
+        }
+        return i;
+    }
+}
+
+std::string QueryProfiler::normalize(std::string_view sql) {
+    std::string out;
+    out.reserve(sql.size());
+    bool space = false;
+
+    auto emit = [&](std::string_view token) {
+        if (space && !out.empty()) out += ' ';
+        space = false;
+        out += token;
+    };
+
+    // 参数和字面量都写作?；逗号分隔的参数列表只保留 "?, ..."，IN列表的长度不同也归为同一条语句
+    auto emitParameter = [&]() {
+        emit("?");
+        if (endsWith(out, "..., ?")) {
+            out.resize(out.size() - 3);
+        } else if (endsWith(out, "?, ?")) {
+            out.replace(out.size() - 1, 1, "...");
+        }
+    };
+
+    size_t i = 0;
+    while (i < sql.size()) {
+        unsigned char c = static_cast<unsigned char>(sql[i]);
+        char next = i + 1 < sql.size() ? sql[i + 1] : '\0';
+
+        if (std::isspace(c)) {
+            space = true;
+            ++i;
+        } else if (c == '-' && next == '-') {
+            size_t end = sql.find('\n', i);
+            i = end == std::string_view::npos ? sql.size() : end;
+            space = true;
+        } else if (c == '/' && next == '*') {
+            size_t end = sql.find("*/", i + 2);
+            i = end == std::string_view::npos ? sql.size() : end + 2;
+            space = true;
+        } else if (c == '\'') {
+            i = skipQuoted(sql, i, '\'');
+            emitParameter();
+        } else if (c == '"' || c == '`' || c == '[') {
+            size_t end = skipQuoted(sql, i, c == '[' ? ']' : static_cast<char>(c));
+            emit(sql.substr(i, end - i));
+            i = end;
+        } else if (std::isdigit(c) || (c == '.' && std::isdigit(static_cast<unsigned char>(next)))) {
+            // 数字字面量，包括小数、指数和十六进制
+            size_t start = i++;
+            while (i < sql.size()) {
+                char d = sql[i];
+                char previous = sql[i - 1];
+                bool exponentSign = (d == '+' || d == '-') && (previous == 'e' || previous == 'E') &&
+                                    !(sql.size() > start + 1 && (sql[start + 1] == 'x' || sql[start + 1] == 'X'));
+                if (!isIdentifierChar(static_cast<unsigned char>(d)) && d != '.' && !exponentSign) break;
+                ++i;
+            }
+            emitParameter();
+        } else if (c == '?' || ((c == ':' || c == '@' || c == '$') && isIdentifierChar(static_cast<unsigned char>(next)))) {
+            // 参数占位符：?、?NNN、:name、@name、$name
+            ++i;
+            while (i < sql.size() && isIdentifierChar(static_cast<unsigned char>(sql[i]))) ++i;
+            emitParameter();
+        } else if (isIdentifierChar(c)) {
+            size_t start = i;
+            while (i < sql.size() && isIdentifierChar(static_cast<unsigned char>(sql[i]))) ++i;
+
+            // X'...' 是BLOB字面量
+            if (i - start == 1 && (c == 'x' || c == 'X') && i < sql.size() && sql[i] == '\'') {
+                i = skipQuoted(sql, i, '\'');
+                emitParameter();
+            } else {
+                emit(sql.substr(start, i - start));
+            }
+        } else if (c == ',') {
+            // 逗号前不留空白，逗号后统一一个空格
+            out += ',';
+            space = true;
+            ++i;
+        } else if (c == ';' && i + 1 >= sql.size()) {
+            ++i;
+        } else {
+            emit(sql.substr(i, 1));
+            ++i;
+        }
+    }
+    return out;
+}
+
+std::vector<std::string> QueryProfiler::findFullScans(std::string_view plan) {
+    // CTE的名称，扫描它们是读取子查询的结果
+    std::vector<std::string_view> derived;
+    size_t start = 0;
+    while (start < plan.size()) {
+        size_t end = plan.find('\n', start);
+        if (end == std::string_view::npos) end = plan.size();
+        std::string_view line = Utils::trimView(plan.substr(start, end - start));
+        start = end + 1;
+        for (std::string_view prefix : {"CO-ROUTINE ", "MATERIALIZE "}) {
+            if (line.substr(0, prefix.size()) == prefix) {
+                std::string_view name = line.substr(prefix.size());
+                derived.push_back(name.substr(0, name.find(' ')));
+            }
+        }
+    }
+    
+    std::vector<std::string> tables;
+    start = 0;
+    while (start < plan.size()) {
+        size_t end = plan.find('\n', start);
+        if (end == std::string_view::npos) end = plan.size();
+        std::string_view line = Utils::trimView(plan.substr(start, end - start));
+        start = end + 1;
+
+        if (line.substr(0, 5) != "SCAN ") continue;
+        // 按索引扫描、虚拟表（如FTS5）、子查询和常量行不是全表扫描
+        if (line.find(" USING ") != std::string_view::npos || line.find("VIRTUAL TABLE") != std::string_view::npos ||
+            line.find("SUBQUERY") != std::string_view::npos || line.find("CO-ROUTINE") != std::string_view::npos ||
+            line.find("CONSTANT ROW") != std::string_view::npos) {
+            continue;
+        }
+
+        std::string_view rest = line.substr(5);
+        if (rest.substr(0, 6) == "TABLE ") rest.remove_prefix(6);
+        std::string_view table = rest.substr(0, rest.find(' '));
+        if (table.empty() || table.front() == '(' ||
+            std::find(derived.begin(), derived.end(), table) != derived.end()) {
+            continue;
+        }
+        if (std::find(tables.begin(), tables.end(), table) == tables.end()) {
+            tables.emplace_back(table);
+        }
+    }
+    return tables;
+}
+
+QueryStats& QueryProfiler::statsFor(std::string_view sql) {
+    auto raw = rawSql_.find(sql);
+    if (raw != rawSql_.end()) {
+        return *raw->second;
+    }
+
+    if (rawSql_.size() >= kMaxRawSql) {
+        rawSql_.clear();
+    }
+
+    std::string key = normalize(sql);
+    auto it = stats_.find(key);
+    if (it == stats_.end()) {
+        if (stats_.size() >= kMaxStatements) {
+            key = kOverflowSql;
+            it = stats_.find(key);
+        }
+        if (it == stats_.end()) {
+            it = stats_.emplace(key, QueryStats()).first;
+            it->second.sql = key;
+        }
+    }
+
+    rawSql_.emplace(std::string(sql), &it->second);
+    return it->second;
+}
+
+void QueryProfiler::record(std::string_view sql, const StatementProfile& profile) {
+    QueryStats& stats = statsFor(sql);
+    uint64_t elapsedUs = profile.elapsedNs / 1000;
+    ++stats.count;
+    stats.totalUs += elapsedUs;
+    stats.maxUs = std::max(stats.maxUs, elapsedUs);
+    stats.rows += profile.rows;
+    stats.fullScanSteps += profile.fullScanSteps;
+    stats.sorts += profile.sorts;
+    stats.autoIndexes += profile.autoIndexes;
+    stats.latency.add(static_cast<double>(profile.elapsedNs) / 1000);
+
+    long long threshold = slowThresholdUs_.load(std::memory_order_relaxed);
+    if (threshold > 0 && elapsedUs >= static_cast<uint64_t>(threshold)) {
+        ++stats.slowCount;
+        // 每条语句只捕获一次执行计划
+        if (profile.explainable && !stats.planCaptured && stats.sql != kOverflowSql) {
+            stats.planCaptured = true;
+            pendingPlans_.emplace_back(stats.sql, std::string(sql));
+        }
+    }
+}
+
+QueryProfiler::ActiveStatement* QueryProfiler::findActive(const void* statement) {
+    // 最近开始的语句最可能是正在返回行的那一条
+    for (size_t i = active_.size(); i > 0; --i) {
+        if (active_[i - 1].statement == statement) {
+            return &active_[i - 1];
+        }
+    }
+    return nullptr;
+}
+
+void QueryProfiler::statementStarted(const void* statement, int64_t now) {
+    // 触发器的子程序开始时也会收到，保留语句本身的开始时间
+    if (findActive(statement)) return;
+
+    // 没有执行完就被释放的语句收不到PROFILE，留下的记录在这里丢弃
+    if (active_.size() >= 16) {
+        active_.clear();
+    }
+    active_.push_back({statement, now, 0});
+}
+
+void QueryProfiler::countRow(const void* statement) {
+    if (ActiveStatement* active = findActive(statement)) {
+        ++active->rows;
+    }
+}
+
+bool QueryProfiler::takeStatement(const void* statement, int64_t& started, uint64_t& rows) {
+    ActiveStatement* active = findActive(statement);
+    if (!active) return false;
+    started = active->started;
+    rows = active->rows;
+    *active = active_.back();
+    active_.pop_back();
+    return true;
+}
+
+std::vector<std::pair<std::string, std::string>> QueryProfiler::takePendingPlans() {
+    std::vector<std::pair<std::string, std::string>> pending;
+    pending.swap(pendingPlans_);
+    return pending;
+}
+
+void QueryProfiler::setPlan(const std::string& sql, std::string plan) {
+    auto it = stats_.find(sql);
+    if (it == stats_.end()) return;
+    it->second.scannedTables = findFullScans(plan);
+    it->second.plan = std::move(plan);
+}
+
+std::vector<QueryStats> QueryProfiler::report(QuerySort sort, size_t limit) const {
+    std::vector<const QueryStats*> sorted;
+    sorted.reserve(stats_.size());
+    for (const auto& entry : stats_) {
+        sorted.push_back(&entry.second);
+    }
+
+    auto key = [sort](const QueryStats* stats) -> uint64_t {
+        switch (sort) {
+            case QuerySort::Max: return stats->maxUs;
+            case QuerySort::Count: return stats->count;
+            case QuerySort::Rows: return stats->rows;
+            case QuerySort::Scans: return stats->fullScanSteps;
+            default: return stats->totalUs;
+        }
+    };
+    size_t count = std::min(limit, sorted.size());
+    std::partial_sort(sorted.begin(), sorted.begin() + count, sorted.end(),
+                      [&key](const QueryStats* a, const QueryStats* b) { return key(a) > key(b); });
+
+    std::vector<QueryStats> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.push_back(*sorted[i]);
+    }
+    return result;
+}
+
+void QueryProfiler::reset() {
+    stats_.clear();
+    rawSql_.clear();
+    pendingPlans_.clear();
+}
+
+bool QueryProfiler::parseSort(const std::string& text, QuerySort& sort) {
+    if (text.empty() || text == "total") {
+        sort = QuerySort::Total;
+    } else if (text == "max") {
+        sort = QuerySort::Max;
+    } else if (text == "count") {
+        sort = QuerySort::Count;
+    } else if (text == "rows") {
+        sort = QuerySort::Rows;
+    } else if (text == "scans") {
+        sort = QuerySort::Scans;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string QueryProfiler::toJson(const QueryStats& stats) {
+    uint64_t average = stats.count > 0 ? stats.totalUs / stats.count : 0;
+    std::string json = "{\"sql\": \"" + Utils::escapeJsonString(stats.sql) +
+                       "\", \"count\": " + std::to_string(stats.count) +
+                       ", \"total_us\": " + std::to_string(stats.totalUs) +
+                       ", \"avg_us\": " + std::to_string(average) +
+                       ", \"max_us\": " + std::to_string(stats.maxUs) +
+                       ", \"p50_us\": " + std::to_string(std::llround(stats.latency.quantile(0.50))) +
+                       ", \"p95_us\": " + std::to_string(std::llround(stats.latency.quantile(0.95))) +
+                       ", \"p99_us\": " + std::to_string(std::llround(stats.latency.quantile(0.99))) +
+                       ", \"rows\": " + std::to_string(stats.rows) +
+                       ", \"slow\": " + std::to_string(stats.slowCount) +
+                       ", \"full_scan_steps\": " + std::to_string(stats.fullScanSteps) +
+                       ", \"sorts\": " + std::to_string(stats.sorts) +
+                       ", \"auto_index_rows\": " + std::to_string(stats.autoIndexes) +
+                       ", \"full_scan\": " + (stats.scannedTables.empty() ? "false" : "true") +
+                       ", \"scanned_tables\": [";
+    for (size_t i = 0; i < stats.scannedTables.size(); ++i) {
+        if (i > 0) json += ", ";
+        json += "\"" + Utils::escapeJsonString(stats.scannedTables[i]) + "\"";
+    }
+    json += "], \"plan\": ";
+    json += stats.planCaptured && !stats.plan.empty() ? "\"" + Utils::escapeJsonString(stats.plan) + "\"" : "null";
+    json += "}";
+    return json;
+}
@@ -0,0 +1,109 @@
+#include "rate_limiter.h"
+#include <algorithm>
+#include <mutex>
+
+namespace {
+    // 每检查多少次清理一个分片
+    const unsigned long long kEvictEvery = 4096;
+}
+
+RateLimiter::RateLimiter(const RateLimitConfig& config) : config_(config), checks_(0) {
+    reconfigure(config_.requestsPerSecond, config_.burst);
+    idleNanos_ = std::chrono::duration_cast<std::chrono::nanoseconds>(config_.idleTimeout).count();
+}
+
+void RateLimiter::reconfigure(double requestsPerSecond, double burst) {
+    double rate = requestsPerSecond > 0 ? requestsPerSecond : 1.0;
+    if (burst < 1) burst = 1.0;
+
+    long long interval = static_cast<long long>(1e9 / rate);
+    requestsPerSecond_.store(rate, std::memory_order_relaxed);
+    burst_.store(burst, std::memory_order_relaxed);
+    interval_.store(interval, std::memory_order_relaxed);
+    tolerance_.store(static_cast<long long>(interval * burst), std::memory_order_relaxed);
+}
+
+RateLimitConfig RateLimiter::config() const {
+    RateLimitConfig config = config_;
+    config.requestsPerSecond = requestsPerSecond_.load(std::memory_order_relaxed);
+    config.burst = burst_.load(std::memory_order_relaxed);
+    return config;
+}
+
+long long RateLimiter::nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool RateLimiter::tryAcquire(std::string_view clientKey, std::chrono::nanoseconds& retryAfter) {
+    long long now = nowNanos();
+
+    if (config_.scope == RateLimitScope::Route) {
+        return acquire(routeBucket_, now, retryAfter);
+    }
+
+    // 摊还清理：每隔一定次数轮流清理一个分片
+    unsigned long long count = checks_.fetch_add(1, std::memory_order_relaxed);
+    if (count % kEvictEvery == 0) {
+        evictIdle(shards_[(count / kEvictEvery) % kShardCount], now);
+    }
+
+    Shard& shard = shards_[KeyHash()(clientKey) % kShardCount];
+
+    // 已有令牌桶只需读锁
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.buckets.find(clientKey);
+        if (it != shard.buckets.end()) {
+            return acquire(it->second, now, retryAfter);
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.buckets.try_emplace(std::string(clientKey)).first;
+    return acquire(it->second, now, retryAfter);
+}
+
+bool RateLimiter::acquire(Bucket& bucket, long long now, std::chrono::nanoseconds& retryAfter) {
+    long long arrival = bucket.arrivalTime.load(std::memory_order_relaxed);
+    // 两个参数分别读取，重新配置期间个别请求可能按新旧混合的参数检查，不影响正确性
+    long long interval = interval_.load(std::memory_order_relaxed);
+    long long tolerance = tolerance_.load(std::memory_order_relaxed);
+
+    while (true) {
+        // 理论到达时间超前当前时间的部分即已消耗的令牌，超过容量则拒绝
+        long long next = std::max(arrival, now) + interval;
+        long long wait = next - now - tolerance;
+        if (wait > 0) {
+            retryAfter = std::chrono::nanoseconds(wait);
+            return false;
+        }
+
+        if (bucket.arrivalTime.compare_exchange_weak(arrival, next, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void RateLimiter::evictIdle(Shard& shard, long long now) {
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+        // 理论到达时间早于当前时间说明令牌桶已满，再空闲一段时间后移除
+        if (now - it->second.arrivalTime.load(std::memory_order_relaxed) > idleNanos_) {
+            it = shard.buckets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+size_t RateLimiter::bucketCount() const {
+    if (config_.scope == RateLimitScope::Route) return 1;
+
+    size_t count = 0;
+    for (const auto& shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        count += shard.buckets.size();
+    }
+    return count;
+}
@@ -0,0 +1,84 @@
+#include "route_metrics.h"
+#include <bit>
+#include <cmath>
+
+int RouteMetricsSnapshot::bucketFor(uint64_t us) {
+    // 小于kSubBuckets的值每个值一个桶，之后每个2的幂按最高的几位再分kSubBuckets个桶
+    if (us < static_cast<uint64_t>(kSubBuckets)) {
+        return static_cast<int>(us);
+    }
+    int exponent = static_cast<int>(std::bit_width(us)) - 1;
+    int bucket = (exponent - 2) * kSubBuckets + static_cast<int>((us >> (exponent - 3)) & (kSubBuckets - 1));
+    return bucket < kBuckets ? bucket : kBuckets - 1;
+}
+
+double RouteMetricsSnapshot::valueFor(int bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    int exponent = bucket / kSubBuckets + 2;
+    int sub = bucket % kSubBuckets;
+    double width = std::ldexp(1.0, exponent - 3);
+    return (kSubBuckets + sub) * width + width / 2;
+}
+
+double RouteMetricsSnapshot::quantile(double q) const {
+    uint64_t count = 0;
+    for (uint64_t value : buckets) count += value;
+    if (count == 0) return 0;
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(count)));
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return valueFor(i);
+    }
+    return valueFor(kBuckets - 1);
+}
+
+RouteMetricsSnapshot RouteMetricsSnapshot::since(const RouteMetricsSnapshot& earlier) const {
+    // 分片不是同时读取的，个别计数器可能比上一次读取时还小，按0处理
+    auto delta = [](uint64_t now, uint64_t before) { return now > before ? now - before : 0; };
+    RouteMetricsSnapshot result;
+    result.hits = delta(hits, earlier.hits);
+    result.clientErrors = delta(clientErrors, earlier.clientErrors);
+    result.serverErrors = delta(serverErrors, earlier.serverErrors);
+    result.totalUs = delta(totalUs, earlier.totalUs);
+    for (int i = 0; i < kBuckets; ++i) {
+        result.buckets[i] = delta(buckets[i], earlier.buckets[i]);
+    }
+    return result;
+}
+
+size_t RouteMetrics::shardIndex() {
+    static std::atomic<size_t> nextShard{0};
+    thread_local size_t index = nextShard.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return index;
+}
+
+void RouteMetrics::record(int statusCode, uint64_t latencyUs) {
+    Shard& shard = shards_[shardIndex()];
+    shard.hits.fetch_add(1, std::memory_order_relaxed);
+    if (statusCode >= 500) {
+        shard.serverErrors.fetch_add(1, std::memory_order_relaxed);
+    } else if (statusCode >= 400) {
+        shard.clientErrors.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.totalUs.fetch_add(latencyUs, std::memory_order_relaxed);
+    shard.buckets[RouteMetricsSnapshot::bucketFor(latencyUs)].fetch_add(1, std::memory_order_relaxed);
+}
+
+RouteMetricsSnapshot RouteMetrics::snapshot() const {
+    RouteMetricsSnapshot result;
+    for (const Shard& shard : shards_) {
+        result.hits += shard.hits.load(std::memory_order_relaxed);
+        result.clientErrors += shard.clientErrors.load(std::memory_order_relaxed);
+        result.serverErrors += shard.serverErrors.load(std::memory_order_relaxed);
+        result.totalUs += shard.totalUs.load(std::memory_order_relaxed);
+        for (int i = 0; i < RouteMetricsSnapshot::kBuckets; ++i) {
+            result.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
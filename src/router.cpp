@@ -1,21 +1,104 @@
 #include "router.h"
+#include "server.h"
 #include "utils.h"
 #include <iostream>
 #include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <array>
+
+namespace {
+    // 解析参数声明 "name" 或 "name<type>"
+    bool parseParamDecl(std::string_view text, RouteParam& param) {
+        size_t open = text.find('<');
+        std::string_view name = text.substr(0, open);
+        if (name.empty()) return false;
+        
+        param.name = std::string(name);
+        param.type = ParamType::String;
+        if (open == std::string_view::npos) return true;
+        
+        if (text.back() != '>') return false;
+        std::string_view type = text.substr(open + 1, text.size() - open - 2);
+        if (type == "int") {
+            param.type = ParamType::Int;
+        } else if (type == "double") {
+            param.type = ParamType::Double;
+        } else if (type != "str") {
+            return false;
+        }
+        return true;
+    }
+    
+    // 按声明的类型解析参数，整个字符串都必须是合法的值
+    bool parseParamValue(std::string_view text, ParamType type, ParamValue& value) {
+        value.type = type;
+        const char* end = text.data() + text.size();
+        switch (type) {
+            case ParamType::Int: {
+                auto result = std::from_chars(text.data(), end, value.intValue);
+                return result.ec == std::errc() && result.ptr == end;
+            }
+            case ParamType::Double: {
+                auto result = std::from_chars(text.data(), end, value.doubleValue);
+                return result.ec == std::errc() && result.ptr == end && std::isfinite(value.doubleValue);
+            }
+            default:
+                return true;
+        }
+    }
+}
 
 // Route 构造函数
 Route::Route(const std::string& method, const std::string& path, 
              std::function<void(const HttpRequest&, HttpResponse&)> handler)
-    : method(method), path(path), handler(handler) {
+    : method(method), path(path), handler(handler), metrics(std::make_shared<RouteMetrics>()) {
+    compilePattern();
+}
+
+Route::Route(const std::string& method, const std::string& path, AsyncHandler asyncHandler)
+    : method(method), path(path), asyncHandler(asyncHandler), metrics(std::make_shared<RouteMetrics>()) {
+    compilePattern();
+}
+
+void Route::compilePattern() {
+    std::string_view pattern = path;
+    size_t queryPos = pattern.find('?');
+    std::string_view pathPart = pattern.substr(0, queryPos);
+    std::string_view queryPart = queryPos == std::string_view::npos ? std::string_view() : pattern.substr(queryPos + 1);
     
-    // 将路径转换为正则表达式模式
-    pattern = pathToRegex(path, paramNames);
-    try {
-        pathRegex = std::regex(pattern);
-    } catch (const std::regex_error& e) {
-        std::cerr << "正则表达式编译失败: " << e.what() << std::endl;
-        // 使用简单的字符串匹配作为后备
-        pattern = path;
+    for (std::string_view text : Utils::splitView(pathPart, '/', false)) {
+        RouteSegment segment;
+        size_t colonPos = text.find(':');
+        segment.literal = std::string(text.substr(0, colonPos));
+        
+        if (colonPos != std::string_view::npos) {
+            RouteParam param;
+            if (!parseParamDecl(text.substr(colonPos + 1), param)) {
+                std::cerr << "路由模式无效: " << path << std::endl;
+                valid = false;
+                return;
+            }
+            segment.param = static_cast<int>(params.size());
+            params.push_back(std::move(param));
+        }
+        segments.push_back(std::move(segment));
+    }
+    
+    for (std::string_view text : Utils::splitView(queryPart, '&')) {
+        RouteParam param;
+        if (!parseParamDecl(text, param)) {
+            std::cerr << "路由模式无效: " << path << std::endl;
+            valid = false;
+            return;
+        }
+        queryParams.push_back(std::move(param));
+    }
+    
+    // 匹配结果保存在请求的定长数组中，路径参数在前，查询参数在后
+    if (params.size() + queryParams.size() > HttpRequest::kMaxRouteParams) {
+        std::cerr << "路由参数超过" << HttpRequest::kMaxRouteParams << "个: " << path << std::endl;
+        valid = false;
     }
 }
 
@@ -30,104 +113,191 @@ void Router::addRoute(const std::string& method, const std::string& path,
     std::cout << "注册路由: " << method << " " << path << std::endl;
 }
 
-bool Router::route(const std::string& method, const std::string& path, 
-                   HttpRequest& request, HttpResponse& response) {
+void Router::addRoute(const std::string& method, const std::string& path, AsyncHandler handler) {
+    routes_.emplace_back(method, path, handler);
+    std::cout << "注册协程路由: " << method << " " << path << std::endl;
+}
+
+const Route* Router::match(const std::string& method, const std::string& path, HttpRequest& request,
+                           std::string* invalidParam) {
+    std::string firstInvalid;
     
-    // 查找匹配的路由
+    // 查找匹配的路由，类型不符的路由跳过，继续尝试后面的路由
     for (const auto& route : routes_) {
-        if (route.method == method && matchPath(path, route)) {
-            // 提取路径参数
-            extractParams(path, route, request.params);
-            
-            // 调用处理器
-            try {
-                route.handler(request, response);
-                return true;
-            } catch (const std::exception& e) {
-                std::cerr << "路由处理器异常: " << e.what() << std::endl;
-                response.status(500).text("Internal Server Error");
-                return true;
-            }
+        if (route.method != method && route.method != "*") continue;
+        
+        std::string invalid;
+        if (matchPath(path, route, request, invalid)) {
+            return &route;
+        }
+        if (firstInvalid.empty()) {
+            firstInvalid = std::move(invalid);
         }
     }
     
-    return false;
+    if (invalidParam) {
+        *invalidParam = std::move(firstInvalid);
+    }
+    return nullptr;
 }
 
-std::string Router::pathToRegex(const std::string& path, std::vector<std::string>& paramNames) {
-    std::string regex = "^";
-    std::string currentParam = "";
-    bool inParam = false;
-    
-    for (size_t i = 0; i < path.length(); ++i) {
-        char c = path[i];
-        
-        if (c == ':') {
-            inParam = true;
-            currentParam = "";
-        } else if (inParam && (c == '/' || c == '?' || c == '#' || c == '&')) {
-            // 参数结束
-            if (!currentParam.empty()) {
-                paramNames.push_back(currentParam);
-                regex += "([^/]+)";
-            }
-            inParam = false;
-            regex += std::string(1, c);
-        } else if (inParam) {
-            currentParam += c;
-        } else {
-            // 转义特殊字符
-            if (c == '.' || c == '^' || c == '$' || c == '*' || c == '+' || c == '?' || c == '(' || c == ')' || c == '[' || c == ']' || c == '{' || c == '}' || c == '\\' || c == '|') {
-                regex += "\\";
-            }
-            regex += c;
+bool Router::setRateLimiter(const std::string& method, const std::string& path, std::shared_ptr<RateLimiter> limiter) {
+    for (auto& route : routes_) {
+        if (route.method == method && route.path == path) {
+            route.rateLimiter = limiter;
+            return true;
         }
     }
     
-    // 处理最后一个参数
-    if (inParam && !currentParam.empty()) {
-        paramNames.push_back(currentParam);
-        regex += "([^/]+)";
+    std::cerr << "限流器设置失败，路由不存在: " << method << " " << path << std::endl;
+    return false;
+}
+
+bool Router::setRequiredScopes(const std::string& method, const std::string& path, uint64_t scopes) {
+    for (auto& route : routes_) {
+        if (route.method == method && route.path == path) {
+            route.requiredScopes = scopes;
+            return true;
+        }
     }
     
-    regex += "$";
-    return regex;
+    std::cerr << "API密钥设置失败，路由不存在: " << method << " " << path << std::endl;
+    return false;
 }
 
-bool Router::extractParams(const std::string& path, const Route& route, 
-                          std::map<std::string, std::string>& params) {
+bool Router::setCoalescer(const std::string& path, std::shared_ptr<RequestCoalescer> coalescer) {
+    for (auto& route : routes_) {
+        if (route.method == "GET" && route.path == path) {
+            // 流式响应边生成边发送，无法复制给其他请求
+            if (route.streaming || !route.websocketChannel.empty()) {
+                std::cerr << "流式路由和WebSocket端点不能合并请求: GET " << path << std::endl;
+                return false;
+            }
+            route.coalescer = std::move(coalescer);
+            return true;
+        }
+    }
     
-    if (route.paramNames.empty()) {
-        return true;
+    std::cerr << "请求合并设置失败，路由不存在: GET " << path << std::endl;
+    return false;
+}
+
+bool Router::setStreaming(const std::string& method, const std::string& path, size_t maxBodySize) {
+    for (auto& route : routes_) {
+        if (route.method == method && route.path == path) {
+            if (!route.isAsync()) {
+                std::cerr << "流式路由必须使用协程处理器: " << method << " " << path << std::endl;
+                return false;
+            }
+            route.streaming = true;
+            route.maxBodySize = maxBodySize;
+            return true;
+        }
     }
     
-    try {
-        std::smatch matches;
-        if (std::regex_match(path, matches, route.pathRegex)) {
-            // matches[0] 是整个匹配的字符串，matches[1] 开始是捕获组
-            for (size_t i = 0; i < route.paramNames.size() && i + 1 < matches.size(); ++i) {
-                params[route.paramNames[i]] = matches[i + 1].str();
+    std::cerr << "流式路由设置失败，路由不存在: " << method << " " << path << std::endl;
+    return false;
+}
+
+bool Router::setPrefix(const std::string& method, const std::string& path) {
+    for (auto& route : routes_) {
+        if (route.method == method && route.path == path) {
+            // 末尾的'/'不算一段，"/" 匹配所有路径
+            if (route.segments.size() > 0 && route.segments.back().param < 0 && route.segments.back().literal.empty()) {
+                route.segments.pop_back();
             }
+            route.prefix = true;
             return true;
         }
-    } catch (const std::regex_error& e) {
-        std::cerr << "正则表达式匹配失败: " << e.what() << std::endl;
-        return false;
     }
     
+    std::cerr << "前缀路由设置失败，路由不存在: " << method << " " << path << std::endl;
     return false;
 }
 
-bool Router::matchPath(const std::string& path, const Route& route) {
-    // 如果正则表达式编译失败，使用简单的字符串匹配
-    if (route.pattern == route.path) {
-        return path == route.path;
+bool Router::setWebSocket(const std::string& path, const std::string& channel) {
+    for (auto& route : routes_) {
+        if (route.method == "GET" && route.path == path) {
+            route.websocketChannel = channel;
+            return true;
+        }
     }
     
+    std::cerr << "WebSocket端点设置失败，路由不存在: GET " << path << std::endl;
+    return false;
+}
+
+void Router::invoke(const Route& route, HttpRequest& request, HttpResponse& response) {
+    // 调用处理器
     try {
-        return std::regex_match(path, route.pathRegex);
-    } catch (const std::regex_error& e) {
-        std::cerr << "路径匹配失败: " << e.what() << std::endl;
+        route.handler(request, response);
+    } catch (const std::exception& e) {
+        std::cerr << "路由处理器异常: " << e.what() << std::endl;
+        response.status(500).text("Internal Server Error");
+    }
+}
+
+bool Router::matchPath(std::string_view path, const Route& route, HttpRequest& request,
+                       std::string& invalidParam) const {
+    if (!route.valid) return false;
+    
+    // 解析的结果先放在这里，按segment->param排列，查询参数排在路径参数之后；匹配成功后整体复制到请求中
+    std::array<MatchedParam, HttpRequest::kMaxRouteParams> matched;
+    
+    // 逐段比较，段数必须相同；前缀路由只比较模式中的段
+    auto segment = route.segments.begin();
+    std::string_view badParam;
+    for (std::string_view text : Utils::splitView(path, '/', false)) {
+        if (segment == route.segments.end()) {
+            if (route.prefix) break;
+            return false;
+        }
+        
+        if (segment->param < 0) {
+            if (text != segment->literal) return false;
+        } else {
+            // 参数至少占一个字符
+            if (text.size() <= segment->literal.size() || !Utils::startsWith(text, segment->literal)) {
+                return false;
+            }
+            const RouteParam& param = route.params[segment->param];
+            std::string_view value = text.substr(segment->literal.size());
+            MatchedParam& slot = matched[segment->param];
+            slot.name = param.name;
+            slot.offset = static_cast<uint32_t>(value.data() - path.data());
+            slot.length = static_cast<uint32_t>(value.size());
+            slot.inPath = true;
+            if (badParam.empty() && !parseParamValue(value, param.type, slot.value)) {
+                badParam = param.name;
+            }
+        }
+        ++segment;
+    }
+    if (segment != route.segments.end()) return false;
+    
+    // 路径结构相符，再检查参数类型
+    size_t count = route.params.size();
+    if (badParam.empty()) {
+        for (const auto& param : route.queryParams) {
+            if (param.type == ParamType::String) continue;
+            
+            auto it = request.queryParams.find(param.name);
+            if (it == request.queryParams.end()) continue;
+            MatchedParam& slot = matched[count++];
+            slot.name = param.name;
+            if (!parseParamValue(it->second, param.type, slot.value)) {
+                badParam = param.name;
+                break;
+            }
+        }
+    }
+    
+    if (!badParam.empty()) {
+        invalidParam = std::string(badParam);
         return false;
     }
+    
+    std::copy(matched.begin(), matched.begin() + count, request.routeParams.begin());
+    request.routeParamCount = count;
+    return true;
 }
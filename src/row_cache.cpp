@@ -0,0 +1,119 @@
+#include "row_cache.h"
+#include <functional>
+
+size_t RowCache::KeyHash::operator()(const KeyView& key) const {
+    size_t hash = std::hash<std::string_view>()(key.table);
+    // 混合rowid，连续的id分散到不同分片和桶
+    uint64_t mixed = static_cast<uint64_t>(key.rowid) * 0x9E3779B97F4A7C15ULL;
+    return hash ^ static_cast<size_t>(mixed ^ (mixed >> 29));
+}
+
+RowCache::RowCache(size_t capacityBytes) : capacity_(capacityBytes) {
+}
+
+RowCache::Shard& RowCache::shardFor(const KeyView& key) {
+    size_t hash = KeyHash()(key);
+    return shards_[(hash >> 7) % kShards];
+}
+
+std::shared_ptr<const void> RowCache::find(std::string_view table, long long rowid, std::type_index type) {
+    KeyView key{table, rowid};
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end() || it->second->type != type) {
+        ++shard.misses;
+        return nullptr;
+    }
+
+    // 移到表头
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    ++shard.hits;
+    return it->second->value;
+}
+
+void RowCache::store(std::string_view table, long long rowid, std::type_index type,
+                     std::shared_ptr<const void> value, size_t bytes) {
+    size_t limit = capacity_.load(std::memory_order_relaxed) / kShards;
+    size_t total = bytes + kEntryOverhead + table.size();
+    if (total > limit) return;
+
+    KeyView key{table, rowid};
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        Entry& entry = *it->second;
+        shard.bytes -= entry.bytes;
+        entry.type = type;
+        entry.value = std::move(value);
+        entry.bytes = total;
+        shard.bytes += total;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    } else {
+        shard.lru.push_front(Entry{Key{std::string(table), rowid}, type, std::move(value), total});
+        shard.index.emplace(shard.lru.front().key, shard.lru.begin());
+        shard.bytes += total;
+    }
+
+    evict(shard, limit);
+}
+
+void RowCache::invalidate(std::string_view table, long long rowid) {
+    KeyView key{table, rowid};
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) return;
+
+    shard.bytes -= it->second->bytes;
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+    ++shard.invalidations;
+}
+
+void RowCache::clear() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.invalidations += shard.index.size();
+        shard.index.clear();
+        shard.lru.clear();
+        shard.bytes = 0;
+    }
+}
+
+void RowCache::setCapacity(size_t capacityBytes) {
+    capacity_.store(capacityBytes, std::memory_order_relaxed);
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        evict(shard, capacityBytes / kShards);
+    }
+}
+
+void RowCache::evict(Shard& shard, size_t limit) {
+    while (shard.bytes > limit && !shard.lru.empty()) {
+        Entry& entry = shard.lru.back();
+        shard.bytes -= entry.bytes;
+        shard.index.erase(entry.key);
+        shard.lru.pop_back();
+        ++shard.evictions;
+    }
+}
+
+RowCacheStats RowCache::stats() const {
+    RowCacheStats stats;
+    stats.capacity = capacity_.load(std::memory_order_relaxed);
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.invalidations += shard.invalidations;
+        stats.entries += shard.index.size();
+        stats.bytes += shard.bytes;
+    }
+    return stats;
+}
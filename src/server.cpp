@@ -1,88 +1,26 @@
 #include "server.h"
 #include "utils.h"
+#include "coarse_clock.h"
 #include <iostream>
 #include <sstream>
 #include <algorithm>
 
-// HttpRequest 方法实现
-std::string HttpRequest::getQueryParam(const std::string& key) const {
-    auto it = headers.find(key);
-    return (it != headers.end()) ? it->second : "";
-}
-
-std::string HttpRequest::getHeader(const std::string& key) const {
-    auto it = headers.find(key);
-    return (it != headers.end()) ? it->second : "";
-}
-
-std::string HttpRequest::getParam(const std::string& key) const {
-    auto it = params.find(key);
-    return (it != params.end()) ? it->second : "";
-}
-
-// HttpResponse 方法实现
-HttpResponse::HttpResponse() : statusCode(200) {
-    headers["Content-Type"] = "text/plain";
-    headers["Server"] = "APIManager/1.0";
-}
-
-HttpResponse& HttpResponse::status(int code) {
-    statusCode = code;
-    return *this;
-}
-
-HttpResponse& HttpResponse::header(const std::string& key, const std::string& value) {
-    headers[key] = value;
-    return *this;
-}
-
-HttpResponse& HttpResponse::json(const std::string& jsonData) {
-    headers["Content-Type"] = "application/json";
-    body = jsonData;
-    return *this;
-}
-
-HttpResponse& HttpResponse::text(const std::string& text) {
-    headers["Content-Type"] = "text/plain";
-    body = text;
-    return *this;
-}
-
-std::string HttpResponse::toString() const {
-    std::ostringstream oss;
-    
-    // 状态行
-    std::string statusText;
-    switch (statusCode) {
-        case 200: statusText = "OK"; break;
-        case 201: statusText = "Created"; break;
-        case 400: statusText = "Bad Request"; break;
-        case 404: statusText = "Not Found"; break;
-        case 500: statusText = "Internal Server Error"; break;
-        default: statusText = "Unknown"; break;
-    }
-    
-    oss << "HTTP/1.1 " << statusCode << " " << statusText << "\r\n";
-    
-    // 头部
-    for (const auto& header : headers) {
-        oss << header.first << ": " << header.second << "\r\n";
-    }
-    
-    // 内容长度
-    oss << "Content-Length: " << body.length() << "\r\n";
-    
-    // 空行和正文
-    oss << "\r\n" << body;
-    
-    return oss.str();
+// ApiServer 方法实现
+namespace {
+    // 请求头最大长度
+    const size_t kMaxHeaderSize = 64 * 1024;
 }
 
-// ApiServer 方法实现
 ApiServer::ApiServer(const std::string& host, int port) 
-    : host_(host), port_(port), running_(false), serverSocket_(INVALID_SOCKET) {
+    : host_(host), port_(port), running_(false), serverSocket_(INVALID_SOCKET),
+      backendType_(IoBackendType::Iocp), workerThreads_(std::max(2u, std::thread::hardware_concurrency())),
+      maxConnections_(0), idleTimeoutMs_(30000), headerTimeoutMs_(10000), writeTimeoutMs_(30000),
+      maxBodySize_(8 * 1024 * 1024), proxyThreads_(16), activeConnections_(0) {
     router_ = std::make_unique<Router>();
     database_ = std::make_unique<Database>("api_manager.db");
+    apiLog_ = std::make_unique<ApiLogWriter>();
+    apiKeys_ = std::make_unique<ApiKeyIndex>();
+    hub_ = std::make_unique<WebSocketHub>();
 }
 
 ApiServer::~ApiServer() {
@@ -140,6 +78,26 @@ bool ApiServer::createSocket() {
     return true;
 }
 
+bool ApiServer::createBackend() {
+    backend_ = createIoBackend(backendType_, *this);
+    if (backend_->open(serverSocket_)) {
+        backend_->setWriteTimeout(std::chrono::milliseconds(writeTimeoutMs_.load()));
+        return true;
+    }
+
+    if (backendType_ != IoBackendType::Poll) {
+        std::cout << "警告: I/O后端 " << backend_->name() << " 不可用，回退到 poll" << std::endl;
+        backend_ = createIoBackend(IoBackendType::Poll, *this);
+        if (backend_->open(serverSocket_)) {
+            backend_->setWriteTimeout(std::chrono::milliseconds(writeTimeoutMs_.load()));
+            return true;
+        }
+    }
+
+    backend_.reset();
+    return false;
+}
+
 void ApiServer::start() {
     if (running_) return;
     
@@ -160,68 +118,889 @@ void ApiServer::start() {
     } else {
         std::cout << "数据库连接成功" << std::endl;
         database_->initializeTables();
+        apiLog_->open(*database_, CoarseClock::nowMillis() / 1000);
+        apiKeys_->attach(*database_);
+    }
+    
+    // 创建I/O后端
+    if (!createBackend()) {
+        closesocket(serverSocket_);
+        serverSocket_ = INVALID_SOCKET;
+        cleanupWinsock();
+        throw std::runtime_error("I/O后端初始化失败");
+    }
+    
+    workers_ = std::make_unique<ThreadPool>(workerThreads_);
+    // 单个SQLite连接，数据库调用串行执行
+    dbExecutor_ = std::make_unique<ThreadPool>(1, "database");
+    if (!proxies_.empty()) {
+        proxyPool_ = std::make_unique<ThreadPool>(proxyThreads_, "proxy");
     }
     
     running_ = true;
-    std::cout << "服务器启动成功，监听地址: " << host_ << ":" << port_ << std::endl;
+    std::cout << "服务器启动成功，监听地址: " << host_ << ":" << port_
+              << "，I/O后端: " << backend_->name() << std::endl;
+    
+    if (!liveChannel_.empty()) {
+        scheduleLiveMetrics();
+    }
     
-    // 服务器主循环
-    serverLoop();
+    // 事件循环，直到stop()被调用
+    Tracing::setThreadName("event-loop");
+    backend_->run();
+    running_ = false;
+    
+    // 等待工作线程退出后再释放socket
+    workers_->shutdown();
+    dbExecutor_->shutdown();
+    if (proxyPool_) {
+        proxyPool_->shutdown();
+    }
+    
+    // 执行器已停止，在这里写入剩余的访问日志
+    apiLog_->flush(*database_);
+    closesocket(serverSocket_);
+    serverSocket_ = INVALID_SOCKET;
+    cleanupWinsock();
 }
 
 void ApiServer::stop() {
-    running_ = false;
-    if (serverSocket_ != INVALID_SOCKET) {
-        closesocket(serverSocket_);
-        serverSocket_ = INVALID_SOCKET;
+    // running_在backend_创建之后才置位，读到true时backend_一定可用
+    if (running_.exchange(false) && backend_) {
+        backend_->stop();
     }
-    cleanupWinsock();
 }
 
-void ApiServer::serverLoop() {
-    while (running_) {
-        sockaddr_in clientAddr;
-        int clientAddrLen = sizeof(clientAddr);
+void ApiServer::setWorkerThreads(size_t count) {
+    workerThreads_ = count;
+    // running_在workers_创建之后才置位
+    if (running_) {
+        workers_->resize(count);
+    }
+}
+
+void ApiServer::setProxyThreads(size_t count) {
+    proxyThreads_ = count;
+    if (running_ && proxyPool_) {
+        proxyPool_->resize(count);
+    }
+}
+
+void ApiServer::setTimeouts(std::chrono::seconds idle, std::chrono::seconds header, std::chrono::seconds write) {
+    idleTimeoutMs_ = std::chrono::duration_cast<std::chrono::milliseconds>(idle).count();
+    headerTimeoutMs_ = std::chrono::duration_cast<std::chrono::milliseconds>(header).count();
+    writeTimeoutMs_ = std::chrono::duration_cast<std::chrono::milliseconds>(write).count();
+    // 已启动的定时器按原来的期限触发，新的超时从下一次启动开始生效
+    if (running_) {
+        backend_->setWriteTimeout(std::chrono::milliseconds(writeTimeoutMs_.load()));
+    }
+}
+
+void ApiServer::onOpen(const ConnectionPtr& conn) {
+    int active = ++activeConnections_;
+    int limit = maxConnections_;
+    if (limit > 0 && active > limit) {
+        // 不再解析这个连接上的请求
+        conn->busy = true;
+        rejectRequest(conn, 503, "Service Unavailable");
+        return;
+    }
+    
+    // 建立连接后必须在期限内发来完整的请求头
+    armReadTimer(conn, headerTimeoutMs_);
+    conn->headerDeadline = true;
+}
+
+void ApiServer::onData(const ConnectionPtr& conn) {
+    // 响应同步完成时会重新进入onData，交给外层循环继续处理，避免递归
+    if (conn->parsing) return;
+    
+    if (conn->http2) {
+        onHttp2Data(conn);
+        return;
+    }
+    if (conn->websocket) {
+        onWebSocketData(conn);
+        return;
+    }
+    
+    // 流式请求体直接交给处理器，不等待完整的请求
+    if (conn->stream && !conn->stream->bodyReceived()) {
+        // 对端在请求体发完之前关闭，关闭连接让处理器的read()结束
+        if (!conn->stream->feed(conn->inBuffer) && conn->readClosed) {
+            backend_->close(conn);
+            return;
+        }
+    }
+    
+    // 追踪：记下请求的第一个字节到达的时间
+    if (Tracing::enabled() && conn->requestStart == 0 && !conn->inBuffer.empty()) {
+        conn->requestStart = Tracing::now();
+    }
+    
+    // 同一连接上的请求按顺序处理，上一个响应交回之前不解析下一个
+    conn->parsing = true;
+    while (!conn->busy && !conn->closed && !conn->http2 && !conn->websocket && processRequest(conn)) {}
+    conn->parsing = false;
+    
+    // 刚刚切换到HTTP/2或WebSocket，缓冲区中剩余的数据属于新协议
+    if (conn->http2 && !conn->closed) {
+        onHttp2Data(conn);
+        return;
+    }
+    if (conn->websocket && !conn->closed) {
+        onWebSocketData(conn);
+        return;
+    }
+    
+    updateReadDeadline(conn);
+}
+
+void ApiServer::onHttp2Data(const ConnectionPtr& conn) {
+    std::vector<Http2Request> requests;
+    bool ok = conn->http2->receive(conn->inBuffer, requests);
+    if (ok) {
+        for (Http2Request& ready : requests) {
+            dispatchHttp2(conn, std::move(ready));
+        }
+    }
+    if (conn->closed) return;
+    
+    flushHttp2(conn, !ok);
+    updateReadDeadline(conn);
+}
+
+void ApiServer::flushHttp2(const ConnectionPtr& conn, bool close) {
+    if (conn->closed) return;
+    Http2Session& session = *conn->http2;
+    
+    // 多个流并发处理，busy表示有处理器尚未响应；对端关闭写方向后等它们都响应完再关闭
+    conn->busy = session.handling();
+    conn->closeAfterWrite = close || session.finished() || (conn->readClosed && !conn->busy);
+    
+    std::string output = session.takeOutput();
+    if (!output.empty()) {
+        backend_->send(conn, std::move(output));
+    } else if (conn->closeAfterWrite && backend_->pendingSendBytes(conn) == 0) {
+        backend_->close(conn);
+    }
+}
+
+void ApiServer::updateReadDeadline(const ConnectionPtr& conn) {
+    if (conn->closed) return;
+    
+    // HTTP/2连接：有请求在处理时不限时，否则按空闲超时计时，收到任何帧都重新计时
+    if (conn->http2) {
+        armReadTimer(conn, conn->busy ? 0 : idleTimeoutMs_.load());
+        conn->headerDeadline = false;
+        return;
+    }
+    
+    // WebSocket连接：空闲超时后发送ping，再过一个超时仍没有收到任何帧时关闭
+    if (conn->websocket) {
+        armReadTimer(conn, idleTimeoutMs_);
+        conn->headerDeadline = false;
+        return;
+    }
+    
+    // 请求处理期间不限时，响应发出后重新计时；流式请求体在两次数据之间仍按空闲超时计时，暂停读取时除外
+    if (conn->busy) {
+        if (conn->stream && !conn->stream->bodyReceived() && !conn->readPaused) {
+            armReadTimer(conn, idleTimeoutMs_);
+        } else {
+            conn->readTimer.cancel();
+        }
+        conn->headerDeadline = false;
+        return;
+    }
+    
+    // 请求头的期限从第一个字节开始计算，缓慢发送的客户端不能一直顺延
+    if (!conn->inBuffer.empty() && conn->inBuffer.find("\r\n\r\n") == std::string::npos) {
+        if (!conn->headerDeadline || !conn->readTimer.active()) {
+            armReadTimer(conn, headerTimeoutMs_);
+            conn->headerDeadline = true;
+        }
+        return;
+    }
+    
+    // 空闲的保持连接，或正在接收请求体：每次收到数据都重新计时
+    armReadTimer(conn, idleTimeoutMs_);
+    conn->headerDeadline = false;
+}
+
+void ApiServer::armReadTimer(const ConnectionPtr& conn, long long timeoutMs) {
+    if (timeoutMs <= 0) {
+        conn->readTimer.cancel();
+        return;
+    }
+    
+    // 定时器嵌在连接中，触发时连接一定还存在
+    Connection* raw = conn.get();
+    backend_->timers().schedule(conn->readTimer, std::chrono::milliseconds(timeoutMs), [this, raw]() {
+        onReadTimeout(raw->shared_from_this());
+    });
+}
+
+void ApiServer::onReadTimeout(const ConnectionPtr& conn) {
+    if (conn->closed) return;
+    
+    if (conn->http2) {
+        conn->http2->goAway(Http2Error::NoError);
+        flushHttp2(conn, true);
+        return;
+    }
+    
+    if (conn->websocket) {
+        if (!conn->websocket->ping()) {
+            backend_->close(conn);
+            return;
+        }
+        flushWebSocket(conn, false);
+        updateReadDeadline(conn);
+        return;
+    }
+    
+    // 流式请求体接收超时，处理器已经开始执行，只能关闭连接
+    if (conn->stream && !conn->stream->bodyReceived()) {
+        backend_->close(conn);
+        return;
+    }
+    if (conn->busy) return;
+    
+    if (conn->inBuffer.empty()) {
+        backend_->close(conn);
+        return;
+    }
+    
+    conn->busy = true;
+    rejectRequest(conn, 408, "Request Timeout");
+}
+
+bool ApiServer::processRequest(const ConnectionPtr& conn) {
+    // HTTP/2连接前言（prior knowledge）的开头也是一个以空行结束的"请求"，在解析之前识别
+    const std::string_view prefaceHead = Http2Session::kPreface.substr(0, Http2Session::kPreface.find("SM"));
+    if (conn->inBuffer.compare(0, prefaceHead.size(), prefaceHead) == 0) {
+        conn->http2 = std::make_shared<Http2Session>(kMaxHeaderSize, maxBodySize_.load());
+        return true;
+    }
+    
+    size_t headerEnd = conn->inBuffer.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) {
+        if (conn->inBuffer.size() > kMaxHeaderSize) {
+            rejectRequest(conn, 431, "Request Header Fields Too Large");
+        }
+        return false;
+    }
+    
+    // 请求头已完整，决定是否追踪；请求体没有收齐时下次重新决定
+    uint64_t traceId = Tracing::sample();
+    int64_t parseStart = traceId ? Tracing::now() : 0;
+    
+    size_t bodyStart = headerEnd + 4;
+    HttpRequest request = parseRequest(conn->inBuffer.substr(0, bodyStart));
+    
+    // 根据Content-Length等待完整的请求体
+    size_t contentLength = 0;
+    std::string lengthHeader = request.getHeader("content-length");
+    if (!lengthHeader.empty()) {
+        try {
+            contentLength = std::stoull(lengthHeader);
+        } catch (...) {
+            rejectRequest(conn, 400, "Bad Request");
+            return false;
+        }
+    }
+    
+    // 请求体只按Content-Length分界，不支持分块传输编码的请求体；拒绝而不是把请求体当作下一个请求解析
+    if (!request.getHeader("transfer-encoding").empty()) {
+        rejectRequest(conn, 411, "Length Required");
+        return false;
+    }
+    
+    // Expect: 100-continue 的客户端在收到100或最终响应之前不发送请求体（curl最多等待1秒）；
+    // HTTP/1.0客户端不理解1xx响应，按规范忽略这个请求头
+    bool expectContinue = false;
+    std::string expect = request.getHeader("expect");
+    if (!expect.empty()) {
+        if (!Utils::equalsIgnoreCase(Utils::trimView(expect), "100-continue")) {
+            rejectRequest(conn, 417, "Expectation Failed");
+            return false;
+        }
+        expectContinue = request.version == "HTTP/1.1" && contentLength > 0;
+    }
+    
+    // 路由匹配，类型化参数在这里解析
+    int64_t routeStart = traceId ? Tracing::now() : 0;
+    std::string invalidParam;
+    const Route* route = router_->match(request.method, request.path, request, &invalidParam);
+    int64_t routeEnd = traceId ? Tracing::now() : 0;
+    
+    // 流式路由读完请求头即分派，请求体由处理器逐块读取
+    if (route && route->streaming) {
+        if (route->maxBodySize > 0 && contentLength > route->maxBodySize) {
+            rejectRequest(conn, 413, "Payload Too Large");
+            return false;
+        }
         
-        SOCKET clientSocket = accept(serverSocket_, (sockaddr*)&clientAddr, &clientAddrLen);
-        if (clientSocket == INVALID_SOCKET) {
-            if (running_) {
-                std::cerr << "接受连接失败: " << WSAGetLastError() << std::endl;
-            }
-            continue;
+        conn->inBuffer.erase(0, bodyStart);
+        request.clientIp = conn->clientIp;
+        request.receivedAt = std::chrono::steady_clock::now();
+        beginTrace(conn, request, traceId, parseStart, routeStart, routeEnd);
+        request.stream = std::make_shared<HttpStream>(*backend_, conn, contentLength, request.version != "HTTP/1.0");
+        conn->stream = request.stream;
+        // 100 Continue 推迟到处理器第一次读取请求体时发送，处理器不读取就回复时客户端不必上传
+        if (expectContinue && conn->inBuffer.empty()) {
+            conn->stream->expectContinue();
         }
+        conn->stream->feed(conn->inBuffer);
         
-        // 在新线程中处理客户端
-        std::thread([this, clientSocket]() {
-            handleClient(clientSocket);
-        }).detach();
+        bool keepAlive = isKeepAlive(request);
+        dispatchRequest(conn, std::move(request), route, invalidParam, keepAlive, 0);
+        return true;
+    }
+    
+    // 超过上限的请求在请求体到达之前拒绝，带 Expect: 100-continue 的客户端不会发送请求体
+    if (contentLength > maxBodySize_.load()) {
+        rejectRequest(conn, 413, "Payload Too Large");
+        return false;
+    }
+    
+    if (conn->inBuffer.size() - bodyStart < contentLength) {
+        // 客户端还没有开始发送请求体时才需要100，只发送一次
+        if (expectContinue && !conn->continueSent && conn->inBuffer.size() == bodyStart) {
+            conn->continueSent = true;
+            backend_->send(conn, HttpStream::kContinueResponse);
+        }
+        return false;
+    }
+    
+    request.body = conn->inBuffer.substr(bodyStart, contentLength);
+    conn->inBuffer.erase(0, bodyStart + contentLength);
+    conn->continueSent = false;
+    request.clientIp = conn->clientIp;
+    request.receivedAt = std::chrono::steady_clock::now();
+    beginTrace(conn, request, traceId, parseStart, routeStart, routeEnd);
+    
+    // Upgrade: h2c，这个请求成为HTTP/2的流1，响应通过HTTP/2发送
+    if (upgradeToHttp2(conn, request)) {
+        dispatchRequest(conn, std::move(request), route, invalidParam, true, 1);
+        return true;
+    }
+    
+    if (route && !route->websocketChannel.empty() && upgradeToWebSocket(conn, request, *route)) {
+        return true;
+    }
+    
+    bool keepAlive = isKeepAlive(request);
+    dispatchRequest(conn, std::move(request), route, invalidParam, keepAlive, 0);
+    return true;
+}
+
+bool ApiServer::upgradeToHttp2(const ConnectionPtr& conn, const HttpRequest& request) {
+    if (request.version != "HTTP/1.1") return false;
+    
+    // Connection 必须同时列出 Upgrade 和 HTTP2-Settings，Upgrade 中有 h2c 即可
+    std::string upgradeHeader = request.getHeader("upgrade");
+    std::string connectionHeader = request.getHeader("connection");
+    bool h2c = false;
+    for (std::string_view token : Utils::splitView(upgradeHeader, ',')) {
+        h2c = h2c || Utils::equalsIgnoreCase(Utils::trimView(token), "h2c");
+    }
+    bool upgrade = false;
+    bool settings = false;
+    for (std::string_view token : Utils::splitView(connectionHeader, ',')) {
+        token = Utils::trimView(token);
+        upgrade = upgrade || Utils::equalsIgnoreCase(token, "upgrade");
+        settings = settings || Utils::equalsIgnoreCase(token, "http2-settings");
+    }
+    auto header = request.headers.find("http2-settings");
+    if (!h2c || !upgrade || !settings || header == request.headers.end()) return false;
+    
+    auto session = std::make_shared<Http2Session>(kMaxHeaderSize, maxBodySize_.load());
+    if (!session->upgrade(header->second)) return false;
+    
+    backend_->send(conn, "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    conn->http2 = std::move(session);
+    flushHttp2(conn, false);
+    return true;
+}
+
+bool ApiServer::upgradeToWebSocket(const ConnectionPtr& conn, const HttpRequest& request, const Route& route) {
+    std::string upgradeHeader = request.getHeader("upgrade");
+    std::string connectionHeader = request.getHeader("connection");
+    bool websocket = false;
+    for (std::string_view token : Utils::splitView(upgradeHeader, ',')) {
+        websocket = websocket || Utils::equalsIgnoreCase(Utils::trimView(token), "websocket");
+    }
+    bool upgrade = false;
+    for (std::string_view token : Utils::splitView(connectionHeader, ',')) {
+        upgrade = upgrade || Utils::equalsIgnoreCase(Utils::trimView(token), "upgrade");
+    }
+    
+    // 不支持的版本按普通请求交给路由处理器，返回426和支持的版本
+    if (!websocket || !upgrade || request.version != "HTTP/1.1" ||
+        request.getHeader("sec-websocket-version") != "13") {
+        return false;
+    }
+    
+    std::string key = request.getHeader("sec-websocket-key");
+    std::string nonce;
+    if (!Utils::base64Decode(key, nonce) || nonce.size() != 16) {
+        logRequest(request, &route, 400);
+        rejectRequest(conn, 400, "Invalid Sec-WebSocket-Key");
+        return true;
+    }
+    
+    // 浏览器不对WebSocket执行同源策略，按CORS允许的源检查，防止跨站页面借用用户的连接
+    if (cors_ && !cors_->allowsOrigin(request)) {
+        logRequest(request, &route, 403);
+        rejectRequest(conn, 403, "Origin not allowed");
+        return true;
+    }
+    
+    // 浏览器的WebSocket不能设置请求头，需要密钥的端点只适用于其他客户端
+    if (route.requiredScopes != 0) {
+        ApiKeyIndex::Result result = apiKeys_->check(ApiKeyIndex::keyFrom(request), route.requiredScopes);
+        if (result != ApiKeyIndex::Result::Ok) {
+            int status = ApiKeyIndex::statusFor(result);
+            logRequest(request, &route, status);
+            rejectRequest(conn, status, ApiKeyIndex::messageFor(result));
+            return true;
+        }
+    }
+    
+    std::string accept = WebSocket::acceptKey(key);
+    if (accept.empty()) {
+        logRequest(request, &route, 500);
+        rejectRequest(conn, 500, "Internal Server Error");
+        return true;
+    }
+    
+    logRequest(request, &route, 101);
+    backend_->send(conn, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                         "Sec-WebSocket-Accept: " + accept + "\r\n\r\n");
+    conn->websocket = std::make_shared<WebSocketSession>(route.websocketChannel);
+    hub_->subscribe(conn);
+    return true;
+}
+
+void ApiServer::onWebSocketData(const ConnectionPtr& conn) {
+    // 关闭握手开始后到达的数据直接丢弃
+    bool open = !conn->closeAfterWrite && conn->websocket->receive(conn->inBuffer);
+    if (!open) {
+        conn->inBuffer.clear();
+    }
+    flushWebSocket(conn, !open || conn->readClosed);
+    updateReadDeadline(conn);
+}
+
+void ApiServer::flushWebSocket(const ConnectionPtr& conn, bool close) {
+    if (conn->closed) return;
+    if (close) {
+        conn->closeAfterWrite = true;
+    }
+    
+    std::string output = conn->websocket->takeOutput();
+    if (!output.empty()) {
+        backend_->send(conn, std::move(output));
+    } else if (conn->closeAfterWrite && backend_->pendingSendBytes(conn) == 0) {
+        backend_->close(conn);
     }
 }
 
-void ApiServer::handleClient(SOCKET clientSocket) {
-    char buffer[4096];
-    int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+void ApiServer::dispatchHttp2(const ConnectionPtr& conn, Http2Request ready) {
+    HttpRequest& request = ready.request;
+    parseUrl(ready.target, request.path, request.query);
+    request.queryParams = parseQueryString(request.query);
+    request.clientIp = conn->clientIp;
+    request.receivedAt = std::chrono::steady_clock::now();
+    request.traceId = Tracing::sample();
+    if (request.traceId) {
+        request.traceStart = Tracing::now();
+    }
+    
+    std::string invalidParam;
+    const Route* route = nullptr;
+    {
+        Tracing::Span span(request.traceId, "route");
+        route = router_->match(request.method, request.path, request, &invalidParam);
+    }
+    
+    // 流式路由依赖HTTP/1.1连接的读取暂停和分块响应，让客户端改用HTTP/1.1重试
+    if (route && route->streaming) {
+        conn->http2->resetStream(ready.streamId, Http2Error::Http11Required);
+        return;
+    }
+    
+    dispatchRequest(conn, std::move(request), route, invalidParam, true, ready.streamId);
+}
+
+void ApiServer::onSent(const ConnectionPtr& conn) {
+    if (conn->stream) {
+        conn->stream->onSent();
+    }
+}
+
+void ApiServer::onClose(const ConnectionPtr& conn) {
+    conn->readTimer.cancel();
+    if (conn->websocket) {
+        hub_->unsubscribe(conn);
+    }
+    if (conn->stream) {
+        conn->stream->abort();
+        conn->stream.reset();
+    }
+    --activeConnections_;
+}
+
+void ApiServer::beginTrace(const ConnectionPtr& conn, HttpRequest& request, uint64_t traceId, int64_t parseStart,
+                           int64_t routeStart, int64_t routeEnd) {
+    // 下一个请求的第一个字节在这之后到达
+    int64_t requestStart = conn->requestStart;
+    conn->requestStart = 0;
+    if (!traceId) return;
+    
+    request.traceId = traceId;
+    request.traceStart = requestStart != 0 ? requestStart : parseStart;
+    Tracing::record(traceId, "recv", request.traceStart, parseStart);
+    Tracing::record(traceId, "parse", parseStart, routeStart);
+    Tracing::record(traceId, "route", routeStart, routeEnd);
+}
+
+void ApiServer::dispatchRequest(const ConnectionPtr& conn, HttpRequest request, const Route* route,
+                                const std::string& invalidParam, bool keepAlive, uint32_t streamId) {
+    // HTTP/2的流互不阻塞，连接的busy由会话维护
+    if (streamId == 0) {
+        conn->busy = true;
+    }
+    
+    DispatchContext context{*this, conn, request, route, keepAlive, streamId, cors_.get(), *apiKeys_};
     
-    if (bytesReceived > 0) {
-        buffer[bytesReceived] = '\0';
-        std::string requestData(buffer);
+    // 参数类型不符时不调用处理器
+    if (!route && !invalidParam.empty()) {
+        HttpResponse response;
+        response.status(400).json("{\"error\": \"Invalid parameter: " + Utils::escapeJsonString(invalidParam) + "\"}");
+        context.respond(response);
+        return;
+    }
+    
+    // 中间件都放行后才合并和分派，协程、流式和HTTP/2的请求同样经过这条链
+    chain_(context, [&]() {
+        dispatchHandler(conn, std::move(request), route, keepAlive, streamId);
+    });
+}
+
+void ApiServer::dispatchHandler(const ConnectionPtr& conn, HttpRequest request, const Route* route, bool keepAlive,
+                                uint32_t streamId) {
+    // 键相同的并发请求只有领头请求执行处理器，CORS的响应头随Origin变化
+    std::string coalesceKey;
+    if (route && route->coalescer) {
+        coalesceKey = route->coalescer->keyFor(request);
+        if (cors_) {
+            coalesceKey += '\0';
+            coalesceKey += request.getHeader("origin");
+        }
+        if (!route->coalescer->lead(coalesceKey)) {
+            waitCoalesced(conn, *route, coalesceKey, std::move(request), keepAlive, streamId);
+            return;
+        }
+    }
+    
+    if (route && route->isAsync()) {
+        dispatchAsync(conn, *route, std::move(request), keepAlive, streamId, std::move(coalesceKey));
+        return;
+    }
+    
+    int64_t queuedAt = request.traceId ? Tracing::now() : 0;
+    workers_->submit([this, conn, route, request = std::move(request), keepAlive, streamId, queuedAt,
+                      coalesceKey = std::move(coalesceKey)]() mutable {
+        if (request.traceId) {
+            Tracing::recordAsync(request.traceId, "queue", queuedAt, Tracing::now(), "workers");
+        }
+        
+        HttpResponse response;
+        {
+            Tracing::Span span(request.traceId, "handler");
+            if (route) {
+                router_->invoke(*route, request, response);
+            } else {
+                response.status(404).text("404 Not Found");
+            }
+        }
         
-        // 解析HTTP请求
-        HttpRequest request = parseRequest(requestData);
+        if (cors_) {
+            cors_->apply(request, response);
+        }
+        
+        // 等待者登记在事件循环线程上，领头请求的响应交回事件循环后分发
+        if (!coalesceKey.empty()) {
+            backend_->post([this, conn, route, request = std::move(request), response = std::move(response), keepAlive,
+                            streamId, coalesceKey = std::move(coalesceKey)]() mutable {
+                finishCoalesced(conn, request, route, response, keepAlive, streamId, coalesceKey);
+            });
+            return;
+        }
+        
+        // HPACK编码器的状态只在事件循环线程上使用，HTTP/2的响应交回事件循环后再编码
+        if (streamId != 0) {
+            logRequest(request, route, response.statusCode);
+            backend_->post([this, conn, streamId, response = std::move(response), traceId = request.traceId]() mutable {
+                sendHttp2Response(conn, streamId, std::move(response), traceId);
+            });
+            return;
+        }
         
-        // 创建响应
+        if (!keepAlive) {
+            response.header("Connection", "close");
+        }
+        logRequest(request, route, response.statusCode);
+        std::string data;
+        {
+            Tracing::Span span(request.traceId, "serialize");
+            data = response.toString();
+        }
+        
+        // 回到事件循环线程发送响应
+        backend_->post([this, conn, data = std::move(data), keepAlive, traceId = request.traceId]() mutable {
+            completeRequest(conn, std::move(data), keepAlive, traceId);
+        });
+    });
+}
+
+void ApiServer::dispatchAsync(const ConnectionPtr& conn, const Route& route, HttpRequest request, bool keepAlive,
+                              uint32_t streamId, std::string coalesceKey) {
+    // 请求和响应在协程结束前必须保持有效
+    struct AsyncCall {
+        HttpRequest request;
         HttpResponse response;
+        std::string coalesceKey;
+    };
+    auto call = std::make_shared<AsyncCall>();
+    call->request = std::move(request);
+    call->coalesceKey = std::move(coalesceKey);
+    
+    // 流式响应的头部在处理器调用begin()时发出，CORS和Connection在那时添加
+    if (call->request.stream) {
+        AsyncCall* raw = call.get();
+        call->request.stream->setPrepare([this, raw, keepAlive](HttpResponse& response) {
+            if (cors_) {
+                cors_->apply(raw->request, response);
+            }
+            if (!keepAlive || !raw->request.stream->chunked()) {
+                response.header("Connection", "close");
+            }
+        });
+    }
+    
+    int64_t handlerStart = call->request.traceId ? Tracing::now() : 0;
+    auto onComplete = [this, conn, call, route = &route, keepAlive, streamId, handlerStart](std::exception_ptr error) {
+        // 协程处理器中间让出过线程，记在请求自己的轨道上
+        if (call->request.traceId) {
+            Tracing::recordAsync(call->request.traceId, "handler", handlerStart, Tracing::now());
+        }
+        
+        if (error) {
+            try {
+                std::rethrow_exception(error);
+            } catch (const std::exception& e) {
+                std::cerr << "协程处理器异常: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "协程处理器异常" << std::endl;
+            }
+        }
+        
+        // 流式响应已经发出头部，结束正文；出错时只能关闭连接
+        HttpStream* stream = call->request.stream.get();
+        if (stream && stream->started()) {
+            logRequest(call->request, route, call->response.statusCode);
+            if (error) {
+                conn->stream.reset();
+                conn->busy = false;
+                backend_->close(conn);
+                return;
+            }
+            completeRequest(conn, stream->trailer(), keepAlive && stream->chunked(), call->request.traceId);
+            return;
+        }
         
-        // 路由匹配
-        if (!router_->route(request.method, request.path, request, response)) {
-            response.status(404).text("404 Not Found");
+        if (error) {
+            call->response = HttpResponse();
+            call->response.status(500).text("Internal Server Error");
         }
         
-        // 发送响应
-        sendResponse(clientSocket, response);
+        if (cors_) {
+            cors_->apply(call->request, call->response);
+        }
+        if (!call->coalesceKey.empty()) {
+            finishCoalesced(conn, call->request, route, call->response, keepAlive, streamId, call->coalesceKey);
+            return;
+        }
+        finishRequest(conn, call->request, route, call->response, keepAlive, streamId);
+    };
+    
+    // 协程里 co_await 的数据库和卸载任务归属到这个请求
+    Tracing::Scope scope(call->request.traceId);
+    Task task;
+    try {
+        task = route.asyncHandler(call->request, call->response);
+    } catch (...) {
+        onComplete(std::current_exception());
+        return;
     }
+    task.start(std::move(onComplete));
+}
+
+void ApiServer::waitCoalesced(const ConnectionPtr& conn, const Route& route, const std::string& key, HttpRequest request,
+                              bool keepAlive, uint32_t streamId) {
+    int64_t waitStart = request.traceId ? Tracing::now() : 0;
+    route.coalescer->wait(key, [this, conn, route = &route, request = std::move(request), keepAlive, streamId,
+                                waitStart](const HttpResponse& response, const std::string& serialized) {
+        // 等待领头请求的时间在追踪中代替处理器
+        if (request.traceId) {
+            Tracing::recordAsync(request.traceId, "coalesced", waitStart, Tracing::now());
+        }
+        logRequest(request, route, response.statusCode);
+        if (streamId != 0) {
+            sendHttp2Response(conn, streamId, response, request.traceId);
+            return;
+        }
+        if (keepAlive) {
+            completeRequest(conn, serialized, true, request.traceId);
+            return;
+        }
+        HttpResponse closing = response;
+        closing.header("Connection", "close");
+        completeRequest(conn, closing.toString(), false, request.traceId);
+    });
+}
+
+void ApiServer::finishCoalesced(const ConnectionPtr& conn, const HttpRequest& request, const Route* route,
+                                HttpResponse& response, bool keepAlive, uint32_t streamId, const std::string& key) {
+    // 先取出等待者：发送时连接上管线化的下一个请求可能以同一个键开始新的一轮
+    std::vector<RequestCoalescer::Waiter> waiters = route->coalescer->finish(key);
+    if (!waiters.empty()) {
+        std::string serialized;
+        {
+            Tracing::Span span(request.traceId, "serialize");
+            serialized = response.toString();
+        }
+        for (auto& waiter : waiters) {
+            waiter(response, serialized);
+        }
+    }
+    finishRequest(conn, request, route, response, keepAlive, streamId);
+}
+
+void DispatchContext::respond(HttpResponse& response) {
+    // 浏览器要看到CORS头部才能读取401、429等响应的内容
+    if (cors) {
+        cors->apply(request, response);
+    }
+    server.finishRequest(conn, request, route, response, keepAlive, streamId);
+}
+
+void ApiServer::logRequest(const HttpRequest& request, const Route* route, int statusCode) {
+    ApiLogEntry entry;
+    entry.method = request.method;
+    entry.path = request.path;
+    if (route) {
+        // 汇总按路径模式，不包括查询参数的声明
+        entry.route = route->path.substr(0, route->path.find('?'));
+    }
+    entry.statusCode = statusCode;
+    entry.responseTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - request.receivedAt).count();
+    entry.ipAddress = request.clientIp;
+    entry.userAgent = request.getHeader("user-agent");
+    entry.timestamp = CoarseClock::nowMillis() / 1000;
+    (route ? *route->metrics : unmatchedMetrics_).record(statusCode, static_cast<uint64_t>(entry.responseTimeUs));
+    
+    // 整个请求：从第一个字节到生成响应，与访问日志的响应时间对应
+    if (request.traceId) {
+        Tracing::recordAsync(request.traceId, "request", request.traceStart, Tracing::now(),
+                             request.method + " " + request.path + " " + std::to_string(statusCode));
+    }
+    
+    // 实时频道有订阅者时才序列化和累计指标
+    if (!liveChannel_.empty() && hub_->subscriberCount() > 0) {
+        {
+            std::lock_guard<std::mutex> lock(liveMutex_);
+            ++liveRequests_;
+            if (statusCode >= 500) ++liveErrors_;
+            liveLatency_.add(static_cast<double>(entry.responseTimeUs));
+        }
+        publish(liveChannel_, "{\"type\": \"log\", \"log\": " + ApiLogWriter::toJson(entry) + "}");
+    }
+    
+    // 队列从空变为非空时调度一次写入，数据库忙时后续的记录合并到同一批
+    if (apiLog_->record(std::move(entry)) && dbExecutor_) {
+        dbExecutor_->submit([this]() { apiLog_->flush(*database_); });
+    }
+}
+
+void ApiServer::finishRequest(const ConnectionPtr& conn, const HttpRequest& request, const Route* route,
+                              HttpResponse& response, bool keepAlive, uint32_t streamId) {
+    logRequest(request, route, response.statusCode);
+    if (streamId != 0) {
+        sendHttp2Response(conn, streamId, std::move(response), request.traceId);
+        return;
+    }
+    
+    if (!keepAlive) {
+        response.header("Connection", "close");
+    }
+    std::string data;
+    {
+        Tracing::Span span(request.traceId, "serialize");
+        data = response.toString();
+    }
+    completeRequest(conn, std::move(data), keepAlive, request.traceId);
+}
+
+void ApiServer::sendHttp2Response(const ConnectionPtr& conn, uint32_t streamId, HttpResponse response,
+                                  uint64_t traceId) {
+    if (conn->closed) return;
+    {
+        Tracing::Span span(traceId, "serialize");
+        conn->http2->respond(streamId, std::move(response));
+    }
+    {
+        Tracing::Span span(traceId, "send");
+        flushHttp2(conn, false);
+    }
+    updateReadDeadline(conn);
+}
+
+void ApiServer::completeRequest(const ConnectionPtr& conn, std::string data, bool keepAlive, uint64_t traceId) {
+    conn->busy = false;
+    if (conn->stream) {
+        // 请求体没有读完时找不到下一个请求的开始，发送响应后关闭连接
+        if (!conn->stream->bodyReceived()) {
+            keepAlive = false;
+        }
+        conn->stream.reset();
+    }
+    if (conn->closed) return;
+    
+    if (!keepAlive) {
+        conn->closeAfterWrite = true;
+    }
+    {
+        Tracing::Span span(traceId, "send");
+        backend_->send(conn, std::move(data));
+    }
+    
+    // 继续处理管线化的后续请求
+    onData(conn);
+}
+
+void ApiServer::rejectRequest(const ConnectionPtr& conn, int statusCode, const std::string& message) {
+    HttpResponse response;
+    response.status(statusCode).header("Connection", "close").text(message);
     
-    closesocket(clientSocket);
+    conn->inBuffer.clear();
+    conn->closeAfterWrite = true;
+    backend_->send(conn, response.toString());
 }
 
 HttpRequest ApiServer::parseRequest(const std::string& requestData) {
@@ -232,14 +1011,16 @@ HttpRequest ApiServer::parseRequest(const std::string& requestData) {
     
     // 解析请求行
     if (std::getline(iss, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
         std::istringstream lineStream(line);
         lineStream >> request.method;
         
         std::string url;
         lineStream >> url;
+        lineStream >> request.version;
         
         parseUrl(url, request.path, request.query);
-        request.params = parseQueryString(request.query);
+        request.queryParams = parseQueryString(request.query);
     }
     
     // 解析头部
@@ -254,26 +1035,20 @@ HttpRequest ApiServer::parseRequest(const std::string& requestData) {
             // 去除前导空格
             value.erase(0, value.find_first_not_of(" \t"));
             
-            request.headers[Utils::toLower(key)] = value;
+            Utils::toLowerInPlace(key);
+            request.headers[std::move(key)] = std::move(value);
         }
     }
     
-    // 解析正文
-    std::string body;
-    while (std::getline(iss, line)) {
-        body += line + "\n";
-    }
-    if (!body.empty()) {
-        request.body = body.substr(0, body.length() - 1); // 移除最后的换行符
-    }
-    
     return request;
 }
 
-bool ApiServer::sendResponse(SOCKET clientSocket, const HttpResponse& response) {
-    std::string responseStr = response.toString();
-    int bytesSent = send(clientSocket, responseStr.c_str(), responseStr.length(), 0);
-    return bytesSent == responseStr.length();
+bool ApiServer::isKeepAlive(const HttpRequest& request) const {
+    std::string connection = request.getHeader("connection");
+    if (request.version == "HTTP/1.0") {
+        return Utils::equalsIgnoreCase(connection, "keep-alive");
+    }
+    return !Utils::equalsIgnoreCase(connection, "close");
 }
 
 void ApiServer::parseUrl(const std::string& url, std::string& path, std::string& query) {
@@ -287,24 +1062,146 @@ void ApiServer::parseUrl(const std::string& url, std::string& path, std::string&
     }
 }
 
-std::map<std::string, std::string> ApiServer::parseQueryString(const std::string& query) {
-    std::map<std::string, std::string> params;
+std::map<std::string, std::string, std::less<>> ApiServer::parseQueryString(const std::string& query) {
+    std::map<std::string, std::string, std::less<>> params;
     
     if (query.empty()) return params;
     
-    std::vector<std::string> pairs = Utils::split(query, '&');
-    for (const auto& pair : pairs) {
+    // 片段直接指向query，解码时才分配键和值
+    for (std::string_view pair : Utils::splitView(query, '&')) {
         size_t equalPos = pair.find('=');
-        if (equalPos != std::string::npos) {
-            std::string key = pair.substr(0, equalPos);
-            std::string value = pair.substr(equalPos + 1);
-            params[Utils::urlDecode(key)] = Utils::urlDecode(value);
+        if (equalPos != std::string_view::npos) {
+            std::string key;
+            std::string value;
+            Utils::urlDecode(pair.substr(0, equalPos), key);
+            Utils::urlDecode(pair.substr(equalPos + 1), value);
+            params[std::move(key)] = std::move(value);
         }
     }
     
     return params;
 }
 
+void ApiServer::setCors(const CorsConfig& config) {
+    if (config.enabled) {
+        cors_ = std::make_unique<Cors>(config);
+    } else {
+        cors_.reset();
+    }
+}
+
+// 限流
+std::shared_ptr<RateLimiter> ApiServer::rateLimit(const std::string& method, const std::string& path, const RateLimitConfig& config) {
+    auto limiter = std::make_shared<RateLimiter>(config);
+    return rateLimit(method, path, limiter) ? limiter : nullptr;
+}
+
+bool ApiServer::rateLimit(const std::string& method, const std::string& path, std::shared_ptr<RateLimiter> limiter) {
+    return router_->setRateLimiter(method, path, limiter);
+}
+
+bool ApiServer::requireApiKey(const std::string& method, const std::string& path, uint64_t scopes) {
+    return router_->setRequiredScopes(method, path, scopes);
+}
+
+void ApiServer::websocket(const std::string& path, const std::string& channel) {
+    router_->addRoute("GET", path, [](const HttpRequest&, HttpResponse& res) {
+        res.status(426)
+           .header("Upgrade", "websocket")
+           .header("Sec-WebSocket-Version", "13")
+           .json("{\"error\": \"WebSocket upgrade required\"}");
+    });
+    router_->setWebSocket(path, channel);
+}
+
+void ApiServer::publish(const std::string& channel, std::string message) {
+    // 第一条消息调度一次广播，事件循环处理它之前到达的消息合并到同一批
+    if (hub_->publish(channel, std::move(message))) {
+        backend_->post([this]() { hub_->flush(*backend_); });
+    }
+}
+
+ServerLoad ApiServer::getLoad() const {
+    ServerLoad load;
+    load.activeConnections = activeConnections_.load();
+    load.workerThreads = workerThreads_.load();
+    if (workers_) {
+        load.workerQueue = workers_->queueDepth();
+        load.workerBusyNs = workers_->busyNanoseconds();
+    }
+    if (dbExecutor_) {
+        load.databaseQueue = dbExecutor_->queueDepth();
+        load.databaseBusyNs = dbExecutor_->busyNanoseconds();
+    }
+    return load;
+}
+
+void ApiServer::scheduleLiveMetrics() {
+    backend_->postAfter(std::chrono::seconds(1), [this]() {
+        if (!running_) return;
+        publishLiveMetrics();
+        scheduleLiveMetrics();
+    });
+}
+
+void ApiServer::publishLiveMetrics() {
+    uint64_t requests;
+    uint64_t errors;
+    LatencySketch latency;
+    {
+        std::lock_guard<std::mutex> lock(liveMutex_);
+        requests = liveRequests_;
+        errors = liveErrors_;
+        latency = std::move(liveLatency_);
+        liveRequests_ = 0;
+        liveErrors_ = 0;
+        liveLatency_ = LatencySketch();
+    }
+    if (hub_->subscriberCount() == 0) return;
+    
+    RowCacheStats cache = database_->rowCache().stats();
+    std::string json = "{\"type\": \"metrics\", \"timestamp\": " + std::to_string(CoarseClock::nowMillis()) +
+                       ", \"requests\": " + std::to_string(requests) +
+                       ", \"errors\": " + std::to_string(errors) +
+                       ", \"p50_us\": " + std::to_string(static_cast<long long>(latency.quantile(0.50))) +
+                       ", \"p95_us\": " + std::to_string(static_cast<long long>(latency.quantile(0.95))) +
+                       ", \"p99_us\": " + std::to_string(static_cast<long long>(latency.quantile(0.99))) +
+                       ", \"active_connections\": " + std::to_string(activeConnections_.load()) +
+                       ", \"subscribers\": " + std::to_string(hub_->subscriberCount()) +
+                       ", \"dropped_logs\": " + std::to_string(apiLog_->droppedCount()) +
+                       ", \"row_cache\": {\"hits\": " + std::to_string(cache.hits) +
+                       ", \"misses\": " + std::to_string(cache.misses) +
+                       ", \"entries\": " + std::to_string(cache.entries) + "}}";
+    publish(liveChannel_, std::move(json));
+}
+
+bool ApiServer::coalesce(const std::string& path, std::vector<std::string> headers) {
+    return router_->setCoalescer(path, std::make_shared<RequestCoalescer>(std::move(headers)));
+}
+
+bool ApiServer::enableStreaming(const std::string& method, const std::string& path, size_t maxBodySize) {
+    return router_->setStreaming(method, path, maxBodySize);
+}
+
+bool ApiServer::proxy(const ProxyConfig& config) {
+    std::string error;
+    if (!ReverseProxy::validate(config, error)) {
+        std::cerr << "反向代理配置无效: " << error << std::endl;
+        return false;
+    }
+    
+    // 请求体和响应正文都边收边转发，所以是流式路由；代理线程池在start()中创建，处理器运行时已经可用
+    auto proxy = std::make_shared<ReverseProxy>(config);
+    proxies_.push_back(proxy);
+    ReverseProxy* raw = proxy.get();
+    router_->addRoute("*", config.prefix, AsyncHandler([this, raw](const HttpRequest& req, HttpResponse& res) {
+        return raw->forward(req, res, *proxyPool_, *backend_);
+    }));
+    router_->setStreaming("*", config.prefix);
+    router_->setPrefix("*", config.prefix);
+    return true;
+}
+
 // 路由注册方法
 void ApiServer::get(const std::string& path, std::function<void(const HttpRequest&, HttpResponse&)> handler) {
     router_->addRoute("GET", path, handler);
@@ -0,0 +1,290 @@
+#include "test_upstream.h"
+#include "logger.h"
+#include "utils.h"
+#include <ws2tcpip.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace {
+    const size_t kMaxHeadSize = 64 * 1024;
+    const size_t kReadSize = 64 * 1024;
+    const size_t kDefaultBodySize = 100000;
+
+    const char* reasonFor(int status) {
+        switch (status) {
+            case 100: return "Continue";
+            case 103: return "Early Hints";
+            case 200: return "OK";
+            case 404: return "Not Found";
+            case 500: return "Internal Server Error";
+            case 502: return "Bad Gateway";
+            case 503: return "Service Unavailable";
+            case 504: return "Gateway Timeout";
+            default: return "Status";
+        }
+    }
+
+    // 查询字符串中的数值参数，不存在或无效时返回默认值
+    uint64_t queryNumber(std::string_view query, std::string_view name, uint64_t fallback) {
+        for (std::string_view pair : Utils::splitView(query, '&')) {
+            size_t equals = pair.find('=');
+            if (pair.substr(0, equals) != name || equals == std::string_view::npos) continue;
+            std::string_view text = pair.substr(equals + 1);
+            uint64_t value = 0;
+            auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+            return result.ec == std::errc() && result.ptr == text.data() + text.size() ? value : fallback;
+        }
+        return fallback;
+    }
+
+    bool queryIs(std::string_view query, std::string_view name, std::string_view value) {
+        for (std::string_view pair : Utils::splitView(query, '&')) {
+            size_t equals = pair.find('=');
+            if (equals != std::string_view::npos && pair.substr(0, equals) == name && pair.substr(equals + 1) == value) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 从offset开始的循环 a-z，分段发送的正文拼起来与一次生成的相同
+    std::string pattern(size_t offset, size_t size) {
+        std::string text(size, 'a');
+        for (size_t i = 0; i < size; ++i) {
+            text[i] = static_cast<char>('a' + (offset + i) % 26);
+        }
+        return text;
+    }
+
+    bool sendAll(SOCKET socket, std::string_view data) {
+        while (!data.empty()) {
+            int length = static_cast<int>(std::min<size_t>(data.size(), 1 << 30));
+            int sent = send(socket, data.data(), length, 0);
+            if (sent <= 0) return false;
+            data.remove_prefix(static_cast<size_t>(sent));
+        }
+        return true;
+    }
+
+    void sleepMs(uint64_t ms) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+TestUpstream::TestUpstream(int port) : port_(port) {}
+
+TestUpstream::~TestUpstream() {
+    if (listenSocket_ != INVALID_SOCKET) {
+        closesocket(listenSocket_);
+    }
+}
+
+bool TestUpstream::open() {
+    listenSocket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket_ == INVALID_SOCKET) {
+        std::cerr << "创建socket失败: " << WSAGetLastError() << std::endl;
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(listenSocket_, SOL_SOCKET, SO_REUSEADDR, (char*)&opt, sizeof(opt));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr("127.0.0.1");
+    address.sin_port = htons(static_cast<u_short>(port_));
+    if (bind(listenSocket_, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR ||
+        listen(listenSocket_, SOMAXCONN) == SOCKET_ERROR) {
+        std::cerr << "测试上游监听 127.0.0.1:" << port_ << " 失败: " << WSAGetLastError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void TestUpstream::run() {
+    while (true) {
+        SOCKET client = accept(listenSocket_, nullptr, nullptr);
+        if (client == INVALID_SOCKET) {
+            std::cerr << "测试上游接受连接失败: " << WSAGetLastError() << std::endl;
+            sleepMs(100);
+            continue;
+        }
+        int noDelay = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        std::thread([this, client]() { serve(client); }).detach();
+    }
+}
+
+void TestUpstream::serve(SOCKET client) {
+    std::string buffer;
+    bool closeNext = false;
+    Request request;
+    while (readRequest(client, buffer, request)) {
+        // stale 之后的请求：不读请求体、不响应，代理看到的是一条已被关闭的空闲连接
+        if (closeNext) break;
+        if (!skipBody(client, buffer, request.contentLength)) break;
+        if (!respond(client, request, closeNext) || request.close) break;
+    }
+    closesocket(client);
+}
+
+bool TestUpstream::readRequest(SOCKET client, std::string& buffer, Request& request) {
+    size_t end;
+    while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        if (buffer.size() > kMaxHeadSize) return false;
+        size_t size = buffer.size();
+        buffer.resize(size + kReadSize);
+        int received = recv(client, &buffer[size], static_cast<int>(kReadSize), 0);
+        buffer.resize(size + static_cast<size_t>(std::max(received, 0)));
+        if (received <= 0) return false;
+    }
+
+    request = Request();
+    std::string_view head(buffer.data(), end);
+    size_t lineEnd = head.find("\r\n");
+    std::string_view requestLine = head.substr(0, lineEnd);
+
+    // GET /path?query HTTP/1.1
+    size_t methodEnd = requestLine.find(' ');
+    size_t targetEnd = requestLine.rfind(' ');
+    if (methodEnd == std::string_view::npos || targetEnd <= methodEnd) return false;
+    request.method = std::string(requestLine.substr(0, methodEnd));
+    std::string_view target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+    size_t question = target.find('?');
+    request.path = std::string(target.substr(0, question));
+    if (question != std::string_view::npos) {
+        request.query = std::string(target.substr(question + 1));
+    }
+
+    std::string_view fields = lineEnd == std::string_view::npos ? std::string_view() : head.substr(lineEnd + 2);
+    for (std::string_view line : Utils::splitView(fields, '\n')) {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) continue;
+        std::string_view name = Utils::trimView(line.substr(0, colon));
+        std::string_view value = Utils::trimView(line.substr(colon + 1));
+        if (Utils::equalsIgnoreCase(name, "host")) {
+            request.host = std::string(value);
+        } else if (Utils::equalsIgnoreCase(name, "x-forwarded-for")) {
+            request.forwardedFor = std::string(value);
+        } else if (Utils::equalsIgnoreCase(name, "content-length")) {
+            std::from_chars(value.data(), value.data() + value.size(), request.contentLength);
+        } else if (Utils::equalsIgnoreCase(name, "connection")) {
+            request.close = Utils::equalsIgnoreCase(value, "close");
+        }
+    }
+    buffer.erase(0, end + 4);
+    return true;
+}
+
+bool TestUpstream::skipBody(SOCKET client, std::string& buffer, uint64_t length) {
+    // 请求体边读边丢弃，大的上传不占用内存
+    uint64_t consumed = std::min<uint64_t>(buffer.size(), length);
+    buffer.erase(0, static_cast<size_t>(consumed));
+    length -= consumed;
+
+    std::string chunk(kReadSize, '\0');
+    while (length > 0) {
+        int received = recv(client, &chunk[0], static_cast<int>(kReadSize), 0);
+        if (received <= 0) return false;
+        if (static_cast<uint64_t>(received) > length) {
+            // 流水线上的下一个请求
+            buffer.append(chunk, static_cast<size_t>(length), static_cast<size_t>(received) - static_cast<size_t>(length));
+            length = 0;
+        } else {
+            length -= static_cast<uint64_t>(received);
+        }
+    }
+    return true;
+}
+
+std::string TestUpstream::head(int status, const std::string& extra) const {
+    return "HTTP/1.1 " + std::to_string(status) + " " + reasonFor(status) + "\r\n" +
+           "X-Upstream: " + std::to_string(port_) + "\r\n" + extra + "\r\n";
+}
+
+bool TestUpstream::respond(SOCKET client, const Request& request, bool& closeNext) {
+    requests_.fetch_add(1, std::memory_order_relaxed);
+    std::string_view path = request.path;
+    std::string_view kind = path.substr(path.rfind('/') + 1);
+    const bool headRequest = request.method == "HEAD";
+    Logger::info(std::to_string(port_) + " " + request.method + " " + request.path +
+                 (request.query.empty() ? "" : "?" + request.query), "test-upstream");
+
+    if (kind == "drop") {
+        return false;
+    }
+
+    if (kind == "chunked") {
+        size_t size = queryNumber(request.query, "size", kDefaultBodySize);
+        size_t chunkSize = std::max<size_t>(1, queryNumber(request.query, "chunk", 4096));
+        uint64_t delay = queryNumber(request.query, "delay_ms", 0);
+        if (!sendAll(client, head(200, "Content-Type: text/plain\r\nTransfer-Encoding: chunked\r\nTrailer: X-Body-Size\r\n"))) {
+            return false;
+        }
+        if (headRequest) return true;
+
+        char sizeLine[32];
+        for (size_t offset = 0; offset < size; offset += chunkSize) {
+            size_t length = std::min(chunkSize, size - offset);
+            auto result = std::to_chars(sizeLine, sizeLine + sizeof(sizeLine), length, 16);
+            std::string chunk(sizeLine, result.ptr);
+            if (offset == 0) chunk += ";first=1";
+            chunk += "\r\n" + pattern(offset, length) + "\r\n";
+            if (!sendAll(client, chunk)) return false;
+            if (delay > 0) sleepMs(delay);
+        }
+        return sendAll(client, "0\r\nX-Body-Size: " + std::to_string(size) + "\r\n\r\n");
+    }
+
+    if (kind == "close") {
+        size_t size = queryNumber(request.query, "size", kDefaultBodySize);
+        if (sendAll(client, head(200, "Content-Type: text/plain\r\nConnection: close\r\n")) && !headRequest) {
+            sendAll(client, pattern(0, size));
+        }
+        shutdown(client, SD_SEND);
+        return false;
+    }
+
+    if (kind == "stall") {
+        uint64_t ms = queryNumber(request.query, "ms", 5000);
+        if (queryIs(request.query, "at", "body")) {
+            size_t size = queryNumber(request.query, "size", kDefaultBodySize);
+            std::string extra = "Content-Type: text/plain\r\nContent-Length: " + std::to_string(size) + "\r\n";
+            if (!sendAll(client, head(200, extra))) return false;
+            if (headRequest) return true;
+            if (!sendAll(client, pattern(0, size / 2))) return false;
+            sleepMs(ms);
+            return sendAll(client, pattern(size / 2, size - size / 2));
+        }
+        sleepMs(ms);
+    }
+
+    if (kind == "early") {
+        std::string interim = "HTTP/1.1 100 Continue\r\n\r\n"
+                              "HTTP/1.1 103 Early Hints\r\nLink: </style.css>; rel=preload\r\n\r\n";
+        if (!sendAll(client, interim)) return false;
+    }
+
+    int status = kind == "status" ? static_cast<int>(queryNumber(request.query, "code", 500)) : 200;
+    if (status < 200 || status > 599) status = 500;
+    std::string body = "{\"upstream\": " + std::to_string(port_) +
+                       ", \"method\": \"" + Utils::escapeJsonString(request.method) +
+                       "\", \"path\": \"" + Utils::escapeJsonString(request.path) +
+                       "\", \"query\": \"" + Utils::escapeJsonString(request.query) +
+                       "\", \"host\": \"" + Utils::escapeJsonString(request.host) +
+                       "\", \"x_forwarded_for\": \"" + Utils::escapeJsonString(request.forwardedFor) +
+                       "\", \"body_bytes\": " + std::to_string(request.contentLength) +
+                       ", \"requests\": " + std::to_string(requests_.load(std::memory_order_relaxed)) + "}";
+    bool bodyless = status == 204 || status == 304;
+    std::string response = head(status, "Content-Type: application/json\r\n" +
+                                         (status == 204 ? std::string() : "Content-Length: " + std::to_string(body.size()) + "\r\n"));
+    if (!headRequest && !bodyless) response += body;
+    if (!sendAll(client, response)) return false;
+
+    if (kind == "stale") closeNext = true;
+    return true;
+}
@@ -0,0 +1,122 @@
+#include "thread_pool.h"
+#include "tracing.h"
+#include <algorithm>
+#include <chrono>
+
+ThreadPool::ThreadPool(size_t threadCount, std::string name)
+    : name_(std::move(name)), targetSize_(0), activeCount_(0), stopping_(false), stopped_(false) {
+    resize(threadCount);
+}
+
+ThreadPool::~ThreadPool() {
+    shutdown();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stopped_) {
+            // 线程都已退出，在调用方的线程上执行；丢弃任务会让等待它的协程永远不被恢复
+            lock.unlock();
+            task();
+            return;
+        }
+        // 停止期间仍然入队，由退出前的线程执行完
+        tasks_.push(std::move(task));
+        queued_.store(tasks_.size(), std::memory_order_relaxed);
+    }
+    condition_.notify_one();
+}
+
+void ThreadPool::resize(size_t threadCount) {
+    if (threadCount == 0) threadCount = 1;
+
+    std::vector<std::thread> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+
+        targetSize_ = threadCount;
+        while (activeCount_ < targetSize_) {
+            workers_.emplace_back([this]() { workerLoop(); });
+            ++activeCount_;
+        }
+
+        // 取出之前缩减时退出的线程
+        for (auto it = workers_.begin(); it != workers_.end();) {
+            auto retired = std::find(retired_.begin(), retired_.end(), it->get_id());
+            if (retired != retired_.end()) {
+                retired_.erase(retired);
+                finished.push_back(std::move(*it));
+                it = workers_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    // 唤醒空闲线程，多余的线程发现后退出
+    condition_.notify_all();
+
+    // 退出的线程可能还没有释放锁，在锁外等待
+    for (auto& worker : finished) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return activeCount_;
+}
+
+void ThreadPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    condition_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    // 线程都已退出：之后提交的任务直接执行，最后一个线程退出之后才入队的任务在这里执行
+    std::queue<std::function<void()>> remaining;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        remaining.swap(tasks_);
+        queued_.store(0, std::memory_order_relaxed);
+    }
+    while (!remaining.empty()) {
+        remaining.front()();
+        remaining.pop();
+    }
+}
+
+void ThreadPool::workerLoop() {
+    Tracing::setThreadName(name_);
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return stopping_ || activeCount_ > targetSize_ || !tasks_.empty(); });
+            // 停止时先执行完队列中的任务
+            if (stopping_ && tasks_.empty()) return;
+            if (!stopping_ && activeCount_ > targetSize_) {
+                --activeCount_;
+                retired_.push_back(std::this_thread::get_id());
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+            queued_.store(tasks_.size(), std::memory_order_relaxed);
+        }
+        auto start = std::chrono::steady_clock::now();
+        task();
+        busyNs_.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count()), std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,218 @@
+#include "timer_wheel.h"
+#include <algorithm>
+#include <bit>
+#include <climits>
+
+void Timer::cancel() {
+    if (wheel_) {
+        wheel_->cancel(*this);
+    }
+}
+
+TimerWheel::TimerWheel() : origin_(Clock::now()), current_(0), count_(0) {
+    occupied_.fill(0);
+}
+
+TimerWheel::~TimerWheel() {
+    // 摘下剩余的定时器，嵌入在其他对象中的定时器析构时不再访问时间轮
+    for (auto& head : slots_) {
+        while (head.next != &head) {
+            Timer* timer = static_cast<Timer*>(head.next);
+            unlink(*timer);
+            if (timer->owned_) {
+                delete timer;
+            } else {
+                timer->callback_ = nullptr;
+            }
+        }
+    }
+}
+
+uint64_t TimerWheel::toTick(Clock::time_point time, bool roundUp) const {
+    if (time <= origin_) return 0;
+
+    auto elapsed = time - origin_;
+    auto ticks = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+    uint64_t tick = static_cast<uint64_t>(ticks.count());
+    if (roundUp && ticks < elapsed) ++tick;
+    return tick;
+}
+
+void TimerWheel::schedule(Timer& timer, Clock::time_point deadline, std::function<void()> callback) {
+    if (timer.wheel_ == this) {
+        unlink(timer);
+    } else if (timer.wheel_) {
+        timer.cancel();
+    }
+
+    timer.callback_ = std::move(callback);
+    timer.expires_ = toTick(deadline, true);
+    insert(timer);
+}
+
+void TimerWheel::add(Clock::time_point deadline, std::function<void()> task) {
+    Timer* timer = new Timer();
+    timer->owned_ = true;
+    schedule(*timer, deadline, std::move(task));
+}
+
+void TimerWheel::cancel(Timer& timer) {
+    if (timer.wheel_ != this) return;
+
+    unlink(timer);
+    timer.callback_ = nullptr;
+    if (timer.owned_) {
+        delete &timer;
+    }
+}
+
+void TimerWheel::insert(Timer& timer) {
+    // 已经过期的定时器在下一个刻度执行
+    uint64_t expires = std::max(timer.expires_, current_);
+    uint64_t delta = expires - current_;
+
+    // 第n层的每个槽位跨越 64^n 个刻度
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (kSlots << (kSlotBits * level))) {
+        ++level;
+    }
+
+    // 超出最高层范围的定时器先放在最远的槽位，降层时再重新计算
+    uint64_t range = kSlots << (kSlotBits * (kLevels - 1));
+    if (delta >= range) {
+        expires = current_ + range - 1;
+    }
+
+    uint64_t index = (expires >> (kSlotBits * level)) & kSlotMask;
+    size_t slot = level * kSlots + index;
+
+    TimerLink& head = slots_[slot];
+    TimerLink* link = &timer;
+    link->prev = head.prev;
+    link->next = &head;
+    head.prev->next = link;
+    head.prev = link;
+
+    occupied_[level] |= 1ULL << index;
+    timer.slot_ = static_cast<uint16_t>(slot);
+    timer.wheel_ = this;
+    ++count_;
+}
+
+void TimerWheel::unlink(Timer& timer) {
+    TimerLink* link = &timer;
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->prev = link;
+    link->next = link;
+
+    TimerLink& head = slots_[timer.slot_];
+    if (head.next == &head) {
+        occupied_[timer.slot_ / kSlots] &= ~(1ULL << (timer.slot_ & kSlotMask));
+    }
+
+    timer.wheel_ = nullptr;
+    --count_;
+}
+
+void TimerWheel::cascade(int level, uint64_t index) {
+    if (!(occupied_[level] & (1ULL << index))) return;
+
+    TimerLink& head = slots_[level * kSlots + index];
+    while (head.next != &head) {
+        Timer* timer = static_cast<Timer*>(head.next);
+        unlink(*timer);
+        insert(*timer);
+    }
+}
+
+void TimerWheel::expireSlot(uint64_t index) {
+    // 先把整个槽位转移到临时链表，回调中添加的定时器不会在本轮执行
+    TimerLink pending;
+    TimerLink& head = slots_[index];
+    pending.next = head.next;
+    pending.prev = head.prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    head.next = &head;
+    head.prev = &head;
+
+    while (pending.next != &pending) {
+        Timer* timer = static_cast<Timer*>(pending.next);
+        unlink(*timer);
+
+        // 取出回调后再执行，回调中可以重新启动或销毁这个定时器
+        std::function<void()> callback = std::move(timer->callback_);
+        timer->callback_ = nullptr;
+        if (timer->owned_) {
+            delete timer;
+        }
+        if (callback) {
+            callback();
+        }
+    }
+}
+
+int TimerWheel::nextTimeoutMs() const {
+    if (count_ == 0) return -1;
+
+    uint64_t wake = UINT64_MAX;
+
+    // 第0层的槽位对应确切的到期刻度
+    if (occupied_[0]) {
+        uint64_t rotated = std::rotr(occupied_[0], static_cast<int>(current_ & kSlotMask));
+        wake = current_ + std::countr_zero(rotated);
+    }
+
+    // 更高的层只需要在下一个非空槽位降层时醒来
+    // 降层发生在块的起点，current_正好位于起点时该块还没有处理
+    for (int level = 1; level < kLevels; ++level) {
+        if (!occupied_[level]) continue;
+
+        int shift = kSlotBits * level;
+        uint64_t next = (current_ + (1ULL << shift) - 1) >> shift;
+        uint64_t rotated = std::rotr(occupied_[level], static_cast<int>(next & kSlotMask));
+        wake = std::min(wake, (next + std::countr_zero(rotated)) << shift);
+    }
+
+    auto remaining = origin_ + std::chrono::milliseconds(wake) - Clock::now();
+    if (remaining.count() <= 0) return 0;
+
+    // 向上取整，避免提前醒来后空转一轮
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(remaining);
+    if (ms < remaining) ms += std::chrono::milliseconds(1);
+    return static_cast<int>(std::min<long long>(ms.count(), INT_MAX));
+}
+
+void TimerWheel::runExpired() {
+    uint64_t now = toTick(Clock::now(), false);
+
+    while (current_ <= now) {
+        if (count_ == 0) {
+            current_ = now + 1;
+            return;
+        }
+
+        uint64_t index = current_ & kSlotMask;
+
+        // 第0层为空时直接跳到下一个边界
+        if (index != 0 && occupied_[0] == 0) {
+            current_ = std::min(now + 1, (current_ | kSlotMask) + 1);
+            continue;
+        }
+
+        // 到达边界时把上一层对应槽位的定时器降下来，逐层向上检查
+        if (index == 0) {
+            for (int level = 1; level < kLevels; ++level) {
+                uint64_t levelIndex = (current_ >> (kSlotBits * level)) & kSlotMask;
+                cascade(level, levelIndex);
+                if (levelIndex != 0) break;
+            }
+        }
+
+        ++current_;
+        if (occupied_[0] & (1ULL << index)) {
+            expireSlot(index);
+        }
+    }
+}
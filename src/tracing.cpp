@@ -0,0 +1,195 @@
+#include "tracing.h"
+#include "utils.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdio>
+
+namespace Tracing {
+
+std::atomic<uint32_t> sampleInterval_{0};
+thread_local uint64_t current_ = 0;
+
+namespace {
+
+struct Event {
+    uint64_t traceId = 0;
+    const char* name = nullptr;
+    int64_t begin = 0;
+    int64_t end = 0;
+    bool async = false;
+    std::string detail;
+};
+
+// 一个线程的环形缓冲区，只有所属线程写入；锁只在导出时才有竞争
+struct ThreadBuffer {
+    std::mutex mutex;
+    uint32_t tid = 0;
+    std::string name;
+    std::vector<Event> events;
+    size_t next = 0;            // 下一个写入的位置
+    size_t count = 0;
+};
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;    // 线程退出后缓冲区保留，事件仍可导出
+std::atomic<uint64_t> requestCounter{0};
+thread_local std::shared_ptr<ThreadBuffer> localBuffer;
+thread_local std::string localName;
+
+ThreadBuffer& buffer() {
+    if (!localBuffer) {
+        auto created = std::make_shared<ThreadBuffer>();
+        created->events.resize(kBufferEvents);
+        std::lock_guard<std::mutex> lock(registryMutex);
+        created->tid = static_cast<uint32_t>(registry.size() + 1);
+        created->name = localName.empty() ? "thread-" + std::to_string(created->tid) : localName;
+        registry.push_back(created);
+        localBuffer = std::move(created);
+    }
+    return *localBuffer;
+}
+
+void append(uint64_t traceId, const char* name, int64_t begin, int64_t end, std::string_view detail, bool async) {
+    ThreadBuffer& local = buffer();
+    std::lock_guard<std::mutex> lock(local.mutex);
+    Event& event = local.events[local.next];
+    event.traceId = traceId;
+    event.name = name;
+    event.begin = begin;
+    event.end = end < begin ? begin : end;
+    event.async = async;
+    event.detail.assign(detail.data(), detail.size());
+    local.next = (local.next + 1) % kBufferEvents;
+    if (local.count < kBufferEvents) ++local.count;
+}
+
+// 纳秒转换为Trace Event的微秒，保留三位小数
+void appendMicros(std::string& out, int64_t nanos) {
+    char text[32];
+    int length = std::snprintf(text, sizeof(text), "%lld.%03lld", static_cast<long long>(nanos / 1000),
+                               static_cast<long long>(nanos % 1000));
+    out.append(text, length);
+}
+
+void appendEvent(std::string& out, const char* phase, const Event& event, uint32_t tid, int64_t ts) {
+    out += "{\"name\": \"";
+    out += event.name;
+    out += "\", \"cat\": \"";
+    out += event.async ? "request" : "stage";
+    out += "\", \"ph\": \"";
+    out += phase;
+    out += "\", \"pid\": 1, \"tid\": ";
+    out += std::to_string(tid);
+    out += ", \"ts\": ";
+    appendMicros(out, ts);
+    if (phase[0] == 'X') {
+        out += ", \"dur\": ";
+        appendMicros(out, event.end - event.begin);
+    } else {
+        // 同一请求的异步事件用追踪ID归到一条轨道
+        out += ", \"id\": \"0x";
+        char id[24];
+        std::snprintf(id, sizeof(id), "%llx", static_cast<unsigned long long>(event.traceId));
+        out += id;
+        out += "\"";
+    }
+    if (phase[0] != 'e') {
+        out += ", \"args\": {\"trace_id\": " + std::to_string(event.traceId);
+        if (!event.detail.empty()) {
+            out += ", \"detail\": \"" + Utils::escapeJsonString(event.detail) + "\"";
+        }
+        out += "}";
+    }
+    out += "}";
+}
+
+}  // namespace
+
+void setSampleInterval(uint32_t interval) {
+    sampleInterval_.store(interval, std::memory_order_relaxed);
+}
+
+uint64_t sampleSlow() {
+    uint32_t interval = sampleInterval();
+    if (interval == 0) return 0;
+    uint64_t sequence = requestCounter.fetch_add(1, std::memory_order_relaxed) + 1;
+    return sequence % interval == 0 ? sequence : 0;
+}
+
+int64_t now() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void record(uint64_t traceId, const char* name, int64_t begin, int64_t end, std::string_view detail) {
+    append(traceId, name, begin, end, detail, false);
+}
+
+void recordAsync(uint64_t traceId, const char* name, int64_t begin, int64_t end, std::string_view detail) {
+    append(traceId, name, begin, end, detail, true);
+}
+
+void setThreadName(std::string name) {
+    localName = std::move(name);
+}
+
+std::string exportJson() {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers = registry;
+    }
+
+    std::string json = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    json += "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"api-server\"}}";
+    for (const auto& thread : buffers) {
+        // 复制出事件再格式化，不在持锁期间分配大块内存
+        std::vector<Event> events;
+        {
+            std::lock_guard<std::mutex> lock(thread->mutex);
+            events.reserve(thread->count);
+            size_t start = (thread->next + kBufferEvents - thread->count) % kBufferEvents;
+            for (size_t i = 0; i < thread->count; ++i) {
+                events.push_back(thread->events[(start + i) % kBufferEvents]);
+            }
+        }
+
+        json += ", {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " + std::to_string(thread->tid) +
+                ", \"args\": {\"name\": \"" + Utils::escapeJsonString(thread->name) + "\"}}";
+        for (const Event& event : events) {
+            json += ", ";
+            if (event.async) {
+                appendEvent(json, "b", event, thread->tid, event.begin);
+                json += ", ";
+                appendEvent(json, "e", event, thread->tid, event.end);
+            } else {
+                appendEvent(json, "X", event, thread->tid, event.begin);
+            }
+        }
+    }
+    json += "]}";
+    return json;
+}
+
+void clear() {
+    std::lock_guard<std::mutex> registryLock(registryMutex);
+    for (const auto& thread : registry) {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        thread->next = 0;
+        thread->count = 0;
+    }
+}
+
+size_t eventCount() {
+    std::lock_guard<std::mutex> registryLock(registryMutex);
+    size_t total = 0;
+    for (const auto& thread : registry) {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        total += thread->count;
+    }
+    return total;
+}
+
+}  // namespace Tracing
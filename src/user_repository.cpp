@@ -0,0 +1,278 @@
+#include "user_repository.h"
+#include "utils.h"
+#include <sqlite3.h>
+#include <iostream>
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+    // 列表只读取覆盖索引 idx_users_list 中的列
+    const std::string kListSql =
+        "SELECT id, username, email, created_at FROM users WHERE id > ? ORDER BY id LIMIT ?";
+
+    const std::string kFindSql =
+        "SELECT id, username, email, created_at, updated_at FROM users WHERE id = ?";
+
+    // ids以JSON数组绑定，任意数量的id共用一条预编译语句；按数组下标排序保持请求的顺序
+    const std::string kFindManySql =
+        "SELECT u.id, u.username, u.email, u.created_at, u.updated_at "
+        "FROM json_each(?) AS j JOIN users AS u ON u.id = j.value ORDER BY j.key";
+
+    const std::string kInsertSql =
+        "INSERT INTO users (username, email, password_hash) VALUES (?, ?, ?)";
+
+    // NULL参数保留原值
+    const std::string kUpdateSql =
+        "UPDATE users SET username = COALESCE(?, username), email = COALESCE(?, email), "
+        "password_hash = COALESCE(?, password_hash), updated_at = CURRENT_TIMESTAMP WHERE id = ?";
+
+    const std::string kDeleteSql = "DELETE FROM users WHERE id = ?";
+
+    const std::string kGenerateSql =
+        "INSERT OR IGNORE INTO users (username, email, password_hash) VALUES (?, ?, ?)";
+
+    // 测试用户的密码哈希，不是合法格式，无法通过校验
+    const char kDisabledPassword[] = "!";
+
+    const long long kGenerateBatchSize = 10000;
+
+    // id为NULL时自动分配，时间为NULL时取当前时间
+    const std::string kImportSql =
+        "INSERT OR IGNORE INTO users (id, username, email, password_hash, created_at, updated_at) "
+        "VALUES (?, ?, ?, ?, COALESCE(?, CURRENT_TIMESTAMP), COALESCE(?, CURRENT_TIMESTAMP))";
+
+    const std::string kExportSql =
+        "SELECT id, username, email, password_hash, created_at, updated_at FROM users WHERE id > ? ORDER BY id LIMIT ?";
+
+    // 批量导入期间的页缓存（KB），以及SQLite默认的缓存大小
+    const long long kBulkLoadCacheKb = 64 * 1024;
+    const std::string kDefaultCacheSql = "PRAGMA cache_size = -2000";
+
+    // 与 Database::initializeTables 中的定义相同
+    const std::string kCreateListIndexSql =
+        "CREATE INDEX IF NOT EXISTS idx_users_list ON users (id, username, email, created_at)";
+
+    void readUser(const DbRow& row, User& user) {
+        user.id = row.getInt(0);
+        user.username = std::string(row.getText(1));
+        user.email = std::string(row.getText(2));
+        user.createdAt = std::string(row.getText(3));
+        if (row.columnCount() > 4) {
+            user.updatedAt = std::string(row.getText(4));
+        }
+    }
+
+    const char kUsersTable[] = "users";
+
+    size_t userBytes(const User& user) {
+        return sizeof(User) + user.username.capacity() + user.email.capacity() +
+               user.createdAt.capacity() + user.updatedAt.capacity();
+    }
+
+    DbValue optionalText(const std::string& value) {
+        if (value.empty()) return nullptr;
+        return value;
+    }
+}
+
+bool UserRepository::list(long long afterId, int limit, std::vector<User>& users, bool& hasMore) {
+    users.clear();
+    hasMore = false;
+    if (limit <= 0) return true;
+
+    // 多取一行判断是否还有下一页
+    bool success = db_.forEachRow(kListSql, {afterId, static_cast<long long>(limit) + 1}, [&](const DbRow& row) {
+        if (users.size() == static_cast<size_t>(limit)) {
+            hasMore = true;
+            return false;
+        }
+        users.emplace_back();
+        readUser(row, users.back());
+        return true;
+    });
+    return success;
+}
+
+bool UserRepository::find(long long id, User& user) {
+    if (auto cached = cachedUser(db_, id)) {
+        user = *cached;
+        return true;
+    }
+
+    bool found = false;
+    bool success = db_.forEachRow(kFindSql, {id}, [&](const DbRow& row) {
+        readUser(row, user);
+        found = true;
+        return false;
+    });
+    if (!success || !found) return false;
+
+    // 事务中读到的行可能被回滚，不放入缓存
+    if (!db_.inTransaction()) {
+        db_.rowCache().put(kUsersTable, id, std::make_shared<const User>(user), userBytes(user));
+    }
+    return true;
+}
+
+std::shared_ptr<const User> UserRepository::cachedUser(Database& database, long long id) {
+    return database.rowCache().get<User>(kUsersTable, id);
+}
+
+bool UserRepository::findMany(const std::vector<long long>& ids, std::vector<User>& users) {
+    users.clear();
+    if (ids.empty()) return true;
+
+    // 去掉重复的id
+    std::unordered_set<long long> seen;
+    std::string array = "[";
+    for (long long id : ids) {
+        if (!seen.insert(id).second) continue;
+        if (array.size() > 1) array += ',';
+        array += std::to_string(id);
+    }
+    array += ']';
+
+    return db_.forEachRow(kFindManySql, {std::move(array)}, [&](const DbRow& row) {
+        users.emplace_back();
+        readUser(row, users.back());
+        return true;
+    });
+}
+
+UserWriteResult UserRepository::create(const std::string& username, const std::string& email,
+                                       const std::string& passwordHash, User& user) {
+    long long id = db_.insert(kInsertSql, {username, email, passwordHash});
+    if (id < 0) {
+        return db_.getLastErrorCode() == SQLITE_CONSTRAINT ? UserWriteResult::Conflict : UserWriteResult::Error;
+    }
+    return find(id, user) ? UserWriteResult::Ok : UserWriteResult::Error;
+}
+
+UserWriteResult UserRepository::update(long long id, const std::string& username, const std::string& email,
+                                       const std::string& passwordHash, User& user) {
+    int changes = db_.update(kUpdateSql, {optionalText(username), optionalText(email), optionalText(passwordHash), id});
+    if (changes < 0) {
+        return db_.getLastErrorCode() == SQLITE_CONSTRAINT ? UserWriteResult::Conflict : UserWriteResult::Error;
+    }
+    if (changes == 0) {
+        return UserWriteResult::NotFound;
+    }
+    return find(id, user) ? UserWriteResult::Ok : UserWriteResult::Error;
+}
+
+UserWriteResult UserRepository::remove(long long id) {
+    int changes = db_.update(kDeleteSql, {id});
+    if (changes < 0) return UserWriteResult::Error;
+    return changes == 0 ? UserWriteResult::NotFound : UserWriteResult::Ok;
+}
+
+long long UserRepository::generate(long long count) {
+    // 从当前最大id之后编号，重复执行时不会与之前生成的用户冲突
+    long long base = 0;
+    if (!db_.forEachRow("SELECT COALESCE(MAX(id), 0) FROM users", {}, [&](const DbRow& row) {
+            base = row.getInt(0);
+            return false;
+        })) {
+        return -1;
+    }
+
+    long long inserted = 0;
+    for (long long start = 0; start < count; start += kGenerateBatchSize) {
+        long long end = std::min(count, start + kGenerateBatchSize);
+        if (!db_.beginTransaction()) return -1;
+
+        for (long long i = start; i < end; ++i) {
+            std::string name = "user" + std::to_string(base + i + 1);
+            std::string email = name + "@example.com";
+            int changes = db_.update(kGenerateSql, {std::move(name), std::move(email), std::string(kDisabledPassword)});
+            if (changes < 0) {
+                db_.rollbackTransaction();
+                return -1;
+            }
+            inserted += changes;
+        }
+
+        if (!db_.commitTransaction()) {
+            db_.rollbackTransaction();
+            return -1;
+        }
+        std::cout << "已生成 " << end << "/" << count << " 个用户\r" << std::flush;
+    }
+    std::cout << std::endl;
+
+    return inserted;
+}
+
+long long UserRepository::importRows(const std::vector<UserImportRow>& rows) {
+    if (rows.empty()) return 0;
+    if (!db_.beginTransaction()) return -1;
+
+    long long inserted = 0;
+    for (const auto& row : rows) {
+        int changes = db_.update(kImportSql, {
+            row.id > 0 ? DbValue(row.id) : DbValue(nullptr),
+            row.username,
+            row.email,
+            row.passwordHash.empty() ? std::string(kDisabledPassword) : row.passwordHash,
+            optionalText(row.createdAt),
+            optionalText(row.updatedAt)});
+        if (changes < 0) {
+            db_.rollbackTransaction();
+            return -1;
+        }
+        inserted += changes;
+    }
+
+    if (!db_.commitTransaction()) {
+        db_.rollbackTransaction();
+        return -1;
+    }
+    return inserted;
+}
+
+long long UserRepository::exportRows(long long afterId, int limit, bool withHash, std::string& out) {
+    long long lastId = afterId;
+    bool success = db_.forEachRow(kExportSql, {afterId, static_cast<long long>(limit)}, [&](const DbRow& row) {
+        lastId = row.getInt(0);
+        out += "{\"id\": ";
+        out += std::to_string(lastId);
+        out += ", \"username\": \"";
+        Utils::appendJsonEscaped(row.getText(1), out);
+        out += "\", \"email\": \"";
+        Utils::appendJsonEscaped(row.getText(2), out);
+        if (withHash) {
+            out += "\", \"password_hash\": \"";
+            Utils::appendJsonEscaped(row.getText(3), out);
+        }
+        out += "\", \"created_at\": \"";
+        Utils::appendJsonEscaped(row.getText(4), out);
+        out += "\", \"updated_at\": \"";
+        Utils::appendJsonEscaped(row.getText(5), out);
+        out += "\"}\n";
+        return true;
+    });
+    return success ? lastId : -1;
+}
+
+bool UserRepository::beginBulkLoad(bool deferIndex) {
+    if (!db_.execute("PRAGMA cache_size = -" + std::to_string(kBulkLoadCacheKb))) return false;
+    return !deferIndex || db_.execute("DROP INDEX IF EXISTS idx_users_list");
+}
+
+bool UserRepository::endBulkLoad(bool deferIndex) {
+    // 先建索引，排序时仍可使用较大的缓存
+    bool success = !deferIndex || db_.execute(kCreateListIndexSql);
+    return db_.execute(kDefaultCacheSql) && success;
+}
+
+std::string UserRepository::toJson(const User& user) {
+    std::string json = "{\"id\": " + std::to_string(user.id) +
+                       ", \"username\": \"" + Utils::escapeJsonString(user.username) +
+                       "\", \"email\": \"" + Utils::escapeJsonString(user.email) +
+                       "\", \"created_at\": \"" + Utils::escapeJsonString(user.createdAt) + "\"";
+    if (!user.updatedAt.empty()) {
+        json += ", \"updated_at\": \"" + Utils::escapeJsonString(user.updatedAt) + "\"";
+    }
+    json += "}";
+    return json;
+}
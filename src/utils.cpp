@@ -5,75 +5,128 @@
 #include <iomanip>
 #include <chrono>
 #include <random>
-#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <cctype>
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <direct.h>
+#include "coarse_clock.h"
+#include "id_generator.h"
+
+namespace {
+    // 十六进制字符到数值的查找表，非十六进制字符为-1
+    constexpr std::array<int8_t, 256> kHexValues = []() {
+        std::array<int8_t, 256> table{};
+        for (auto& value : table) value = -1;
+        for (int i = 0; i < 10; ++i) table['0' + i] = static_cast<int8_t>(i);
+        for (int i = 0; i < 6; ++i) {
+            table['a' + i] = static_cast<int8_t>(10 + i);
+            table['A' + i] = static_cast<int8_t>(10 + i);
+        }
+        return table;
+    }();
+
+    // 解码到out，out可以与in相同（原地解码），返回写入的长度
+    size_t decodeUrl(const char* in, size_t length, char* out) {
+        size_t written = 0;
+        for (size_t i = 0; i < length; ++i) {
+            char c = in[i];
+            if (c == '%' && i + 2 < length) {
+                int high = kHexValues[static_cast<unsigned char>(in[i + 1])];
+                int low = kHexValues[static_cast<unsigned char>(in[i + 2])];
+                if ((high | low) >= 0) {
+                    c = static_cast<char>((high << 4) | low);
+                    i += 2;
+                }
+            } else if (c == '+') {
+                c = ' ';
+            }
+            out[written++] = c;
+        }
+        return written;
+    }
+}
 
 namespace Utils {
 
 // 字符串操作
+std::string_view trimView(std::string_view str) {
+    size_t start = str.find_first_not_of(" \t\n\r");
+    if (start == std::string_view::npos) return std::string_view();
+    
+    size_t end = str.find_last_not_of(" \t\n\r");
+    return str.substr(start, end - start + 1);
+}
+
+void toLowerInPlace(std::string& str) {
+    for (char& c : str) {
+        c = asciiToLower(c);
+    }
+}
+
+void toUpperInPlace(std::string& str) {
+    for (char& c : str) {
+        c = asciiToUpper(c);
+    }
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (asciiToLower(a[i]) != asciiToLower(b[i])) return false;
+    }
+    return true;
+}
+
 std::vector<std::string> split(const std::string& str, char delimiter) {
     std::vector<std::string> tokens;
-    std::stringstream ss(str);
-    std::string token;
-    
-    while (std::getline(ss, token, delimiter)) {
-        if (!token.empty()) {
-            tokens.push_back(token);
-        }
+    for (std::string_view token : splitView(str, delimiter)) {
+        tokens.emplace_back(token);
     }
-    
     return tokens;
 }
 
 std::string trim(const std::string& str) {
-    size_t start = str.find_first_not_of(" \t\n\r");
-    if (start == std::string::npos) return "";
-    
-    size_t end = str.find_last_not_of(" \t\n\r");
-    return str.substr(start, end - start + 1);
+    return std::string(trimView(str));
 }
 
 std::string toLower(const std::string& str) {
     std::string result = str;
-    std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+    toLowerInPlace(result);
     return result;
 }
 
 std::string toUpper(const std::string& str) {
     std::string result = str;
-    std::transform(result.begin(), result.end(), result.begin(), ::toupper);
+    toUpperInPlace(result);
     return result;
 }
 
-bool startsWith(const std::string& str, const std::string& prefix) {
-    if (str.length() < prefix.length()) return false;
-    return str.substr(0, prefix.length()) == prefix;
+bool startsWith(std::string_view str, std::string_view prefix) {
+    return str.size() >= prefix.size() && str.compare(0, prefix.size(), prefix) == 0;
 }
 
-bool endsWith(const std::string& str, const std::string& suffix) {
-    if (str.length() < suffix.length()) return false;
-    return str.substr(str.length() - suffix.length()) == suffix;
+bool endsWith(std::string_view str, std::string_view suffix) {
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
 }
 
 // URL处理
+void urlDecode(std::string_view str, std::string& out) {
+    size_t offset = out.size();
+    out.resize(offset + str.size());
+    size_t length = decodeUrl(str.data(), str.size(), &out[offset]);
+    out.resize(offset + length);
+}
+
+void urlDecodeInPlace(std::string& str) {
+    str.resize(decodeUrl(str.data(), str.size(), str.data()));
+}
+
 std::string urlDecode(const std::string& str) {
     std::string result;
-    for (size_t i = 0; i < str.length(); ++i) {
-        if (str[i] == '%' && i + 2 < str.length()) {
-            int value;
-            std::istringstream iss(str.substr(i + 1, 2));
-            iss >> std::hex >> value;
-            result += static_cast<char>(value);
-            i += 2;
-        } else if (str[i] == '+') {
-            result += ' ';
-        } else {
-            result += str[i];
-        }
-    }
+    urlDecode(std::string_view(str), result);
     return result;
 }
 
@@ -93,22 +146,91 @@ std::string urlEncode(const std::string& str) {
     return escaped.str();
 }
 
+bool base64Decode(std::string_view str, std::string& out) {
+    while (!str.empty() && str.back() == '=') {
+        str.remove_suffix(1);
+    }
+    // 去掉填充后余1个字符不可能是有效的编码
+    if (str.size() % 4 == 1) return false;
+    
+    uint32_t bits = 0;
+    int count = 0;
+    for (char c : str) {
+        uint32_t value;
+        if (c >= 'A' && c <= 'Z') value = c - 'A';
+        else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') value = c - '0' + 52;
+        else if (c == '+' || c == '-') value = 62;
+        else if (c == '/' || c == '_') value = 63;
+        else return false;
+        
+        bits = (bits << 6) | value;
+        count += 6;
+        if (count >= 8) {
+            count -= 8;
+            out.push_back(static_cast<char>((bits >> count) & 0xFF));
+        }
+    }
+    return true;
+}
+
+std::string base64Encode(std::string_view data) {
+    static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    
+    std::string out;
+    out.reserve((data.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3) {
+        uint32_t bits = (static_cast<uint8_t>(data[i]) << 16) | (static_cast<uint8_t>(data[i + 1]) << 8) |
+                        static_cast<uint8_t>(data[i + 2]);
+        out += kAlphabet[(bits >> 18) & 0x3F];
+        out += kAlphabet[(bits >> 12) & 0x3F];
+        out += kAlphabet[(bits >> 6) & 0x3F];
+        out += kAlphabet[bits & 0x3F];
+    }
+    
+    size_t rest = data.size() - i;
+    if (rest > 0) {
+        uint32_t bits = static_cast<uint8_t>(data[i]) << 16;
+        if (rest == 2) bits |= static_cast<uint8_t>(data[i + 1]) << 8;
+        out += kAlphabet[(bits >> 18) & 0x3F];
+        out += kAlphabet[(bits >> 12) & 0x3F];
+        out += rest == 2 ? kAlphabet[(bits >> 6) & 0x3F] : '=';
+        out += '=';
+    }
+    return out;
+}
+
 // JSON处理
 std::string escapeJsonString(const std::string& str) {
     std::string result;
+    appendJsonEscaped(str, result);
+    return result;
+}
+
+void appendJsonEscaped(std::string_view str, std::string& out) {
     for (char c : str) {
         switch (c) {
-            case '"': result += "\\\""; break;
-            case '\\': result += "\\\\"; break;
-            case '\b': result += "\\b"; break;
-            case '\f': result += "\\f"; break;
-            case '\n': result += "\\n"; break;
-            case '\r': result += "\\r"; break;
-            case '\t': result += "\\t"; break;
-            default: result += c; break;
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                // 其他控制字符必须写成\u00XX
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    static const char kHex[] = "0123456789abcdef";
+                    out += "\\u00";
+                    out += kHex[(c >> 4) & 0xF];
+                    out += kHex[c & 0xF];
+                } else {
+                    out += c;
+                }
+                break;
         }
     }
-    return result;
 }
 
 std::string createJsonObject(const std::map<std::string, std::string>& data) {
@@ -141,24 +263,30 @@ std::string createJsonArray(const std::vector<std::string>& data) {
 
 // 时间处理
 std::string getCurrentTimestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-    
-    std::ostringstream oss;
-    oss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    oss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-    
-    return oss.str();
+    // 由时钟服务预先格式化，不再每次调用localtime和put_time
+    return CoarseClock::timestamp();
 }
 
 std::string formatTimestamp(long long timestamp) {
-    auto time_t = static_cast<time_t>(timestamp / 1000);
+    std::tm local = {};
+    if (!localTime(timestamp / 1000, local)) {
+        return "";
+    }
     std::ostringstream oss;
-    oss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+    oss << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
     return oss.str();
 }
 
+bool localTime(long long seconds, std::tm& result) {
+    std::time_t time = static_cast<std::time_t>(seconds);
+    return localtime_s(&result, &time) == 0;
+}
+
+bool utcTime(long long seconds, std::tm& result) {
+    std::time_t time = static_cast<std::time_t>(seconds);
+    return gmtime_s(&result, &time) == 0;
+}
+
 long long getCurrentTimeMillis() {
     auto now = std::chrono::system_clock::now();
     return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
@@ -166,44 +294,24 @@ long long getCurrentTimeMillis() {
 
 // 随机数生成
 std::string generateUUID() {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<> dis(0, 15);
-    
-    std::ostringstream oss;
-    oss << std::hex;
-    
-    for (int i = 0; i < 8; ++i) oss << dis(gen);
-    oss << "-";
-    for (int i = 0; i < 4; ++i) oss << dis(gen);
-    oss << "-";
-    for (int i = 0; i < 4; ++i) oss << dis(gen);
-    oss << "-";
-    for (int i = 0; i < 4; ++i) oss << dis(gen);
-    oss << "-";
-    for (int i = 0; i < 12; ++i) oss << dis(gen);
-    
-    return oss.str();
+    // 按时间排序的UUIDv7，随机数来自线程本地的生成器
+    return IdGenerator::uuidV7String();
 }
 
 int randomInt(int min, int max) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(min, max);
-    return dis(gen);
+    if (max <= min) return min;
+    uint64_t range = static_cast<uint64_t>(static_cast<long long>(max) - min) + 1;
+    return static_cast<int>(min + static_cast<long long>(IdGenerator::randomBelow(range)));
 }
 
 std::string randomString(int length) {
     static const char charset[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, sizeof(charset) - 2);
     
     std::string result;
     result.reserve(length);
     
     for (int i = 0; i < length; ++i) {
-        result += charset[dis(gen)];
+        result += charset[IdGenerator::randomBelow(sizeof(charset) - 1)];
     }
     
     return result;
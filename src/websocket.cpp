@@ -0,0 +1,368 @@
+#include "websocket.h"
+#include "crypto.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WEBSOCKET_MASK_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WEBSOCKET_MASK_SSE2 1
+#endif
+
+namespace {
+    const char kAcceptGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+}
+
+namespace WebSocket {
+
+std::string acceptKey(std::string_view key) {
+    std::string input(key);
+    input += kAcceptGuid;
+
+    uint8_t digest[20];
+    if (!Crypto::sha1(input, digest)) return "";
+    return Utils::base64Encode(std::string_view(reinterpret_cast<const char*>(digest), sizeof(digest)));
+}
+
+void applyMask(char* data, size_t length, const uint8_t key[4], size_t phase) {
+    // 从phase开始循环的掩码；下面每一步处理的字节数都是4的倍数，掩码的相位保持不变
+    uint8_t rotated[4];
+    for (size_t i = 0; i < 4; ++i) {
+        rotated[i] = key[(phase + i) & 3];
+    }
+    uint32_t word;
+    std::memcpy(&word, rotated, sizeof(word));
+
+    size_t i = 0;
+#ifdef WEBSOCKET_MASK_AVX2
+    if (length >= 32) {
+        const __m256i mask = _mm256_set1_epi32(static_cast<int>(word));
+        for (; i + 32 <= length; i += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(chunk, mask));
+        }
+    }
+#endif
+#ifdef WEBSOCKET_MASK_SSE2
+    if (length - i >= 16) {
+        const __m128i mask = _mm_set1_epi32(static_cast<int>(word));
+        for (; i + 16 <= length; i += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(chunk, mask));
+        }
+    }
+#endif
+
+    const uint64_t mask64 = (static_cast<uint64_t>(word) << 32) | word;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t chunk;
+        std::memcpy(&chunk, data + i, sizeof(chunk));
+        chunk ^= mask64;
+        std::memcpy(data + i, &chunk, sizeof(chunk));
+    }
+    for (; i < length; ++i) {
+        data[i] = static_cast<char>(data[i] ^ rotated[i & 3]);
+    }
+}
+
+void appendFrame(WebSocketOpcode opcode, std::string_view payload, std::string& out) {
+    out += static_cast<char>(0x80 | static_cast<uint8_t>(opcode));
+    if (payload.size() < 126) {
+        out += static_cast<char>(payload.size());
+    } else if (payload.size() <= 0xFFFF) {
+        out += static_cast<char>(126);
+        out += static_cast<char>(payload.size() >> 8);
+        out += static_cast<char>(payload.size());
+    } else {
+        out += static_cast<char>(127);
+        uint64_t length = payload.size();
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out += static_cast<char>(length >> shift);
+        }
+    }
+    out += payload;
+}
+
+bool isValidUtf8(std::string_view text) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(text.data());
+    size_t length = text.size();
+    size_t i = 0;
+    while (i < length) {
+        // 连续的ASCII按8字节检查
+        if (i + 8 <= length) {
+            uint64_t chunk;
+            std::memcpy(&chunk, bytes + i, sizeof(chunk));
+            if ((chunk & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+
+        uint8_t lead = bytes[i];
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        }
+
+        // 按RFC 3629排除过长编码、代理区（U+D800-DFFF）和超过U+10FFFF的码点
+        size_t count;
+        uint8_t low = 0x80;
+        uint8_t high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            count = 1;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            count = 2;
+            if (lead == 0xE0) low = 0xA0;
+            if (lead == 0xED) high = 0x9F;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            count = 3;
+            if (lead == 0xF0) low = 0x90;
+            if (lead == 0xF4) high = 0x8F;
+        } else {
+            return false;
+        }
+        if (length - i <= count) return false;
+
+        if (bytes[i + 1] < low || bytes[i + 1] > high) return false;
+        for (size_t k = 2; k <= count; ++k) {
+            if ((bytes[i + k] & 0xC0) != 0x80) return false;
+        }
+        i += count + 1;
+    }
+    return true;
+}
+
+} // namespace WebSocket
+
+bool WebSocketSession::receive(std::string& inBuffer) {
+    size_t pos = 0;
+    bool open = true;
+    while (open) {
+        size_t available = inBuffer.size() - pos;
+        if (available < 2) break;
+
+        const auto* header = reinterpret_cast<const uint8_t*>(inBuffer.data() + pos);
+        bool fin = (header[0] & 0x80) != 0;
+        uint8_t opcode = header[0] & 0x0F;
+
+        // 没有协商扩展，RSV位必须为0；客户端发出的帧必须加掩码
+        if ((header[0] & 0x70) != 0 || (header[1] & 0x80) == 0) {
+            open = fail(WebSocketCloseCode::ProtocolError);
+            break;
+        }
+
+        uint64_t length = header[1] & 0x7F;
+        size_t headerSize = 2;
+        if (length == 126) {
+            if (available < 4) break;
+            length = (static_cast<uint64_t>(header[2]) << 8) | header[3];
+            headerSize = 4;
+        } else if (length == 127) {
+            if (available < 10) break;
+            length = 0;
+            for (size_t i = 2; i < 10; ++i) {
+                length = (length << 8) | header[i];
+            }
+            headerSize = 10;
+        }
+
+        // 控制帧不能分片，负载最多125字节；数据消息在收齐之前就检查长度，不缓冲超长的帧
+        bool control = (opcode & 0x08) != 0;
+        if (control && (!fin || length > 125)) {
+            open = fail(WebSocketCloseCode::ProtocolError);
+            break;
+        }
+        if (!control && length > kMaxMessageSize - message_.size()) {
+            open = fail(WebSocketCloseCode::MessageTooBig);
+            break;
+        }
+
+        headerSize += 4;
+        if (available < headerSize + length) break;
+
+        // 掩码键位于长度之后，负载原地去掩码
+        char* payload = &inBuffer[pos + headerSize];
+        WebSocket::applyMask(payload, static_cast<size_t>(length), header + headerSize - 4);
+        pos += headerSize + static_cast<size_t>(length);
+
+        pingOutstanding_ = false;
+        open = onFrame(fin, opcode, std::string_view(payload, static_cast<size_t>(length)));
+    }
+
+    inBuffer.erase(0, pos);
+    return open;
+}
+
+bool WebSocketSession::onFrame(bool fin, uint8_t opcode, std::string_view payload) {
+    switch (static_cast<WebSocketOpcode>(opcode)) {
+        case WebSocketOpcode::Continuation:
+            if (!fragmented_) return fail(WebSocketCloseCode::ProtocolError);
+            break;
+        case WebSocketOpcode::Text:
+        case WebSocketOpcode::Binary:
+            if (fragmented_) return fail(WebSocketCloseCode::ProtocolError);
+            text_ = static_cast<WebSocketOpcode>(opcode) == WebSocketOpcode::Text;
+            break;
+        case WebSocketOpcode::Close:
+            return onClose(payload);
+        case WebSocketOpcode::Ping:
+            if (!closeSent_) {
+                WebSocket::appendFrame(WebSocketOpcode::Pong, payload, output_);
+            }
+            return true;
+        case WebSocketOpcode::Pong:
+            return true;
+        default:
+            return fail(WebSocketCloseCode::ProtocolError);
+    }
+
+    // 数据消息只做协议检查，不交给处理器
+    message_.append(payload.data(), payload.size());
+    fragmented_ = !fin;
+    if (!fin) return true;
+
+    bool valid = !text_ || WebSocket::isValidUtf8(message_);
+    message_.clear();
+    return valid || fail(WebSocketCloseCode::InvalidPayload);
+}
+
+bool WebSocketSession::onClose(std::string_view payload) {
+    if (payload.size() == 1) return fail(WebSocketCloseCode::ProtocolError);
+
+    if (payload.size() >= 2) {
+        uint16_t code = static_cast<uint16_t>((static_cast<uint8_t>(payload[0]) << 8) | static_cast<uint8_t>(payload[1]));
+        // 1004-1006和1015保留给本地使用，不能出现在关闭帧中
+        bool valid = (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) ||
+                     (code >= 3000 && code <= 4999);
+        if (!valid) return fail(WebSocketCloseCode::ProtocolError);
+        if (!WebSocket::isValidUtf8(payload.substr(2))) return fail(WebSocketCloseCode::InvalidPayload);
+    }
+
+    // 对端发起的关闭：回送相同的状态码；本端发起的关闭到这里握手完成
+    if (!closeSent_) {
+        closeSent_ = true;
+        WebSocket::appendFrame(WebSocketOpcode::Close, payload.substr(0, 2), output_);
+    }
+    return false;
+}
+
+void WebSocketSession::close(WebSocketCloseCode code, std::string_view reason) {
+    if (closeSent_) return;
+    closeSent_ = true;
+
+    std::string payload;
+    payload += static_cast<char>(static_cast<uint16_t>(code) >> 8);
+    payload += static_cast<char>(static_cast<uint16_t>(code) & 0xFF);
+    payload += reason.substr(0, 123);
+    WebSocket::appendFrame(WebSocketOpcode::Close, payload, output_);
+}
+
+bool WebSocketSession::fail(WebSocketCloseCode code) {
+    close(code);
+    return false;
+}
+
+bool WebSocketSession::ping() {
+    if (pingOutstanding_) return false;
+    pingOutstanding_ = true;
+    if (!closeSent_) {
+        WebSocket::appendFrame(WebSocketOpcode::Ping, {}, output_);
+    }
+    return true;
+}
+
+std::string WebSocketSession::takeOutput() {
+    std::string output;
+    output.swap(output_);
+    return output;
+}
+
+bool WebSocketHub::publish(const std::string& channel, std::string message) {
+    if (subscriberCount_ == 0) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& queue = queued_[channel];
+    if (queue.size() >= kMaxQueued) return false;
+    queue.push_back(std::move(message));
+
+    // 队列从空变为非空时调度一次flush，之后的消息合并到同一批
+    if (flushScheduled_) return false;
+    flushScheduled_ = true;
+    return true;
+}
+
+void WebSocketHub::subscribe(const ConnectionPtr& conn) {
+    subscribers_[conn->websocket->channel()].push_back(conn);
+    ++subscriberCount_;
+}
+
+void WebSocketHub::unsubscribe(const ConnectionPtr& conn) {
+    auto it = subscribers_.find(conn->websocket->channel());
+    if (it == subscribers_.end()) return;
+
+    auto& list = it->second;
+    for (size_t i = 0; i < list.size(); ++i) {
+        if (list[i] != conn) continue;
+        // 广播过程中发送失败会同步关闭连接并回到这里，只清空位置，广播结束后再压缩
+        if (broadcasting_) {
+            list[i] = nullptr;
+        } else {
+            list[i] = std::move(list.back());
+            list.pop_back();
+        }
+        --subscriberCount_;
+        return;
+    }
+}
+
+void WebSocketHub::flush(IoBackend& backend) {
+    std::unordered_map<std::string, std::vector<std::string>> queued;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued.swap(queued_);
+        flushScheduled_ = false;
+    }
+
+    std::vector<ConnectionPtr> slow;
+    broadcasting_ = true;
+    for (auto& [channel, messages] : queued) {
+        auto it = subscribers_.find(channel);
+        if (it == subscribers_.end() || it->second.empty()) continue;
+
+        // 这一批消息编码为连续的帧，放在一个缓冲区中由所有订阅者共享
+        size_t total = 0;
+        for (const auto& message : messages) {
+            total += message.size() + 10;
+        }
+        auto frames = std::make_shared<std::string>();
+        frames->reserve(total);
+        for (const auto& message : messages) {
+            WebSocket::appendFrame(WebSocketOpcode::Text, message, *frames);
+        }
+        SharedBuffer buffer = std::move(frames);
+
+        auto& list = it->second;
+        for (size_t i = 0; i < list.size(); ++i) {
+            ConnectionPtr conn = list[i];
+            if (!conn || conn->closed || conn->websocket->closing()) continue;
+            if (backend.pendingSendBytes(conn) > kMaxBacklog) {
+                slow.push_back(std::move(conn));
+                continue;
+            }
+            backend.send(conn, buffer);
+        }
+    }
+    broadcasting_ = false;
+
+    for (auto& [channel, list] : subscribers_) {
+        list.erase(std::remove(list.begin(), list.end(), nullptr), list.end());
+    }
+
+    for (const auto& conn : slow) {
+        backend.close(conn);
+    }
+}